@@ -33,6 +33,34 @@ c - to vary the number of quadratures
 
       real wldisc(20)
 
+c - size distribution of the user defined models (mie)
+      real rmax_m,rmin_m,rn_m,ri_m,x1_m,x2_m,x3_m,cij_m,rsunph_m
+      real nrsunph_m
+      integer icp_m,irsunph_m
+      common /mie_in/ rmax_m,rmin_m,icp_m,rn_m(20,4),ri_m(20,4),
+     s x1_m(4),x2_m(4),x3_m(4),cij_m(4),irsunph_m,rsunph_m(50),
+     s nrsunph_m(50)
+
+c - model of the previous call and what it computed
+      logical done_l
+      integer iaer_l,ipol_l,nquad_l,icp_l,irsunph_l
+      real co_l(4),xmud_l
+      character FILE_l*80
+      real rmax_l,rmin_l,rn_l(20,4),ri_l(20,4),x1_l(4),x2_l(4),x3_l(4)
+      real cij_l(4),rsunph_l(50),nrsunph_l(50)
+      real ext_l(20),ome_l(20),gasym_l(20),phase_l(20),qhase_l(20)
+      real uhase_l(20)
+      real phasel_l(20,nqmax_p),qhasel_l(20,nqmax_p)
+      real uhasel_l(20,nqmax_p)
+      real ph_l(20,nqmax_p),qh_l(20,nqmax_p),uh_l(20,nqmax_p)
+      real ex_l(4,20),sc_l(4,20),asy_l(4,20),vi_l(4)
+      save done_l,iaer_l,ipol_l,nquad_l,icp_l,irsunph_l,co_l,xmud_l
+      save FILE_l,rmax_l,rmin_l,rn_l,ri_l,x1_l,x2_l,x3_l,cij_l
+      save rsunph_l,nrsunph_l,ext_l,ome_l,gasym_l,phase_l,qhase_l
+      save uhase_l,phasel_l,qhasel_l,uhasel_l,ph_l,qh_l,uh_l
+      save ex_l,sc_l,asy_l,vi_l
+      data done_l /.false./
+
       data wldisc /0.350,0.400,0.412,0.443,0.470,0.488,0.515,0.550,
      s             0.590,0.633,0.670,0.694,0.760,0.860,1.240,1.536,
      s             1.650,1.950,2.250,3.750/
@@ -40,6 +68,24 @@ c - to vary the number of quadratures
  
       pi=4.*atan(1.) 
 
+c - the cases of a batch (main.f) often share the model and the
+c - scattering angle: the previous results are then used again instead
+c - of being recomputed (mie computations for iaer 8 to 11). models
+c - read from a file (iaer 12) are always read.
+      if (done_l.and.iaer.eq.iaer_l.and.iaer.ne.12.and.
+     s    ipol.eq.ipol_l.and.nquad.eq.nquad_l.and.xmud.eq.xmud_l.and.
+     s    all(co.eq.co_l)) then
+        if (iaer.lt.8.or.iaer.gt.11) goto 900
+        if (FILE.eq.FILE_l.and.rmax_m.eq.rmax_l.and.
+     s      rmin_m.eq.rmin_l.and.icp_m.eq.icp_l.and.
+     s      all(rn_m.eq.rn_l).and.all(ri_m.eq.ri_l).and.
+     s      all(x1_m.eq.x1_l).and.all(x2_m.eq.x2_l).and.
+     s      all(x3_m.eq.x3_l).and.all(cij_m.eq.cij_l).and.
+     s      irsunph_m.eq.irsunph_l.and.all(rsunph_m.eq.rsunph_l).and.
+     s      all(nrsunph_m.eq.nrsunph_l)) goto 900
+      endif
+      done_l=.false.
+
 c      if(iaer.eq.0) return
  
       if (iaer.eq.12) then
@@ -296,5 +342,59 @@ c     mixing parameters calculation
       endif
       
  777  continue      
+      done_l=.true.
+      iaer_l=iaer
+      ipol_l=ipol
+      nquad_l=nquad
+      xmud_l=xmud
+      co_l=co
+      FILE_l=FILE
+      rmax_l=rmax_m
+      rmin_l=rmin_m
+      icp_l=icp_m
+      rn_l=rn_m
+      ri_l=ri_m
+      x1_l=x1_m
+      x2_l=x2_m
+      x3_l=x3_m
+      cij_l=cij_m
+      irsunph_l=irsunph_m
+      rsunph_l=rsunph_m
+      nrsunph_l=nrsunph_m
+      ext_l=ext
+      ome_l=ome
+      gasym_l=gasym
+      phase_l=phase
+      qhase_l=qhase
+      uhase_l=uhase
+      phasel_l=phasel
+      qhasel_l=qhasel
+      uhasel_l=uhasel
+      ph_l=ph
+      qh_l=qh
+      uh_l=uh
+      ex_l=ex
+      sc_l=sc
+      asy_l=asy
+      vi_l=vi
+      return
+
+c - same model as the previous call
+ 900  ext=ext_l
+      ome=ome_l
+      gasym=gasym_l
+      phase=phase_l
+      qhase=qhase_l
+      uhase=uhase_l
+      phasel=phasel_l
+      qhasel=qhasel_l
+      uhasel=uhasel_l
+      ph=ph_l
+      qh=qh_l
+      uh=uh_l
+      ex=ex_l
+      sc=sc_l
+      asy=asy_l
+      vi=vi_l
       return
       end
@@ -3,7 +3,7 @@
       real rm(-mu:mu)
       double precision xpl(-mu:mu),bp(0:mu,-mu:mu)
       integer is,ip1,j,i,k,ip,ig,l,lp,lm,ij
-      double precision xdb,a,b,c,xx,rac3,x,bt,sbp
+      double precision xdb,a,b,c,xx,rac3,x,bt,pk
 
 c - to vary the number of quadratures
       include "paramdef.inc"
@@ -14,6 +14,8 @@ c - to vary the number of quadratures
      &alphal(0:nqmax_p),betal(0:nqmax_p),gammal(0:nqmax_p),
      &zetal(0:nqmax_p)
       double precision psl(-1:nqmax_p,-mu:mu)
+c transposed psl, so that the kernel sums run over contiguous j
+      double precision pt(0:mu,0:nqmax_p)
 c - to vary the number of quadratures
 
       ip1=nquad-3
@@ -88,17 +90,29 @@ c
         xpl(j)=psl(2,j)
  1005 continue
       ij=ip1
-      do 32 j=0,mu
-        do 32 k=-mu,mu
-          sbp=0.
-          if(is.gt.ij) goto 1
-          do 33 l=is,ij
-            bt=betal(l)
-            sbp=sbp+dble(psl(l,j))*psl(l,k)*bt
-  33      continue
- 1        continue
-          if (abs(sbp).lt.1.E-30) sbp=0.
-          bp(j,k)=sbp
+      do 36 l=is,ij
+        do 37 j=0,mu
+          pt(j,l)=psl(l,j)
+   37   continue
+   36 continue
+c
+c     the sums over l are accumulated for all j at once, with j
+c     innermost so that the loop can be vectorized
+c
+      do 32 k=-mu,mu
+        do 34 j=0,mu
+          bp(j,k)=0.
+   34   continue
+        do 33 l=is,ij
+          bt=betal(l)
+          pk=psl(l,k)
+          do 38 j=0,mu
+            bp(j,k)=bp(j,k)+pt(j,l)*pk*bt
+   38     continue
+  33    continue
+        do 39 j=0,mu
+          if (abs(bp(j,k)).lt.1.E-30) bp(j,k)=0.
+   39   continue
    32 continue
       return
       end
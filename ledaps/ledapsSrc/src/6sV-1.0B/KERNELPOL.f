@@ -10,6 +10,9 @@ c - to vary the number of quadratures
      &zetal(0:nqmax_p)
       double precision psl(-1:nqmax_p,-mu:mu),rsl(-1:nqmax_p,-mu:mu)
       double precision tsl(-1:nqmax_p,-mu:mu)
+c transposed psl, rsl, tsl, so that the kernel sums run over contiguous j
+      double precision pt(0:mu,0:nqmax_p),rt(0:mu,0:nqmax_p)
+      double precision tt(0:mu,0:nqmax_p)
 c - to vary the number of quadratures
 
       integer mu
@@ -20,8 +23,7 @@ c - to vary the number of quadratures
       double precision att(0:mu,-mu:mu)
       integer is,ip1,j,i,k,ip,ig,l,lp,lm,ij
       double precision xdb,a,b,c,d,e,f,xx,rac3,x
-      double precision sbp,satt,sarr,sgr,sgt,sart
-      double precision r1,r2,r3
+      double precision r1,r2,r3,pk,rk,tk
 
 
 
@@ -147,46 +149,53 @@ c      write(6,*) "xpl,xrl,xtl ",xpl(j),xrl(j),xtl(j),j
 c      stop
       
       ij=ip1
-      do 32 j=0,mu
-        do 32 k=-mu,mu
-          sbp=0.
-	  sgr=0.
-	  sgt=0.
-	  satt=0.
-	  sarr=0.
-	  sart=0.
-          if(is.gt.ij) goto 1
-c	  write(6,*) "is,ij ",is,ij
-          do 33 l=is,ij
-	    r1=tsl(l,j)*tsl(l,k)
-	    r2=rsl(l,j)*rsl(l,k)
-	    r3=psl(l,j)*gammal(l)
-            sbp=sbp+psl(l,j)*psl(l,k)*betal(l)
-            sgr=sgr+rsl(l,k)*r3
-            sgt=sgt+tsl(l,k)*r3
-c 	  if (is.eq.3.and.j.eq.1)then
-c 	      write(6,*)j,k,l,gammal(l),psl(l,j),tsl(l,k)
-c 	      endif
-            satt=satt+r1*alphal(l)
+      do 36 l=is,ij
+        do 37 j=0,mu
+          pt(j,l)=psl(l,j)
+          rt(j,l)=rsl(l,j)
+          tt(j,l)=tsl(l,j)
+   37   continue
+   36 continue
+c
+c     the sums over l are accumulated for all j at once, with j
+c     innermost so that the loops can be vectorized
+c
+      do 32 k=-mu,mu
+        do 34 j=0,mu
+          bp(j,k)=0.
+          gr(j,k)=0.
+          gt(j,k)=0.
+          att(j,k)=0.
+          arr(j,k)=0.
+          art(j,k)=0.
+   34   continue
+        do 33 l=is,ij
+          pk=psl(l,k)
+          rk=rsl(l,k)
+          tk=tsl(l,k)
+          do 38 j=0,mu
+	    r1=tt(j,l)*tk
+	    r2=rt(j,l)*rk
+	    r3=pt(j,l)*gammal(l)
+            bp(j,k)=bp(j,k)+pt(j,l)*pk*betal(l)
+            gr(j,k)=gr(j,k)+rk*r3
+            gt(j,k)=gt(j,k)+tk*r3
+            att(j,k)=att(j,k)+r1*alphal(l)
      &          +r2*zetal(l)
-            sarr=sarr+r1*zetal(l)
+            arr(j,k)=arr(j,k)+r1*zetal(l)
      &          +r2*alphal(l)
-            sart=sart+tsl(l,j)*rsl(l,k)*alphal(l)
-     &          +rsl(l,j)*tsl(l,k)*zetal(l)
-  33      continue
- 1        continue
- 	  if (abs(sbp).lt.1.e-30) sbp =0.0
-          bp(j,k)=sbp
- 	  if (abs(sgr).lt.1.e-30) sgr =0.0
-          gr(j,k)=sgr
- 	  if (abs(sgt).lt.1.e-30) sgt =0.0
-          gt(j,k)=sgt
- 	  if (abs(satt).lt.1.e-30) satt =0.0
-          att(j,k)=satt
- 	  if (abs(sart).lt.1.e-30) sart =0.0
-          art(j,k)=sart
- 	  if (abs(sarr).lt.1.e-30) sarr =0.0
-          arr(j,k)=sarr
+            art(j,k)=art(j,k)+tt(j,l)*rk*alphal(l)
+     &          +rt(j,l)*tk*zetal(l)
+   38     continue
+  33    continue
+        do 39 j=0,mu
+ 	  if (abs(bp(j,k)).lt.1.e-30) bp(j,k)=0.0
+ 	  if (abs(gr(j,k)).lt.1.e-30) gr(j,k)=0.0
+ 	  if (abs(gt(j,k)).lt.1.e-30) gt(j,k)=0.0
+ 	  if (abs(att(j,k)).lt.1.e-30) att(j,k)=0.0
+ 	  if (abs(art(j,k)).lt.1.e-30) art(j,k)=0.0
+ 	  if (abs(arr(j,k)).lt.1.e-30) arr(j,k)=0.0
+   39   continue
    32 continue
    35 continue
 c      stop
@@ -24,6 +24,10 @@ c array for sos computation
      s xdel(0:nt),ydel(0:nt),ch(0:nt),h(0:nt),altc(0:nt)
       double precision i1(0:nt,-mu:mu),i2(0:nt,-mu:mu),i3(-mu:mu),
      s   i4(-mu:mu),in(-mu:mu),inm1(-mu:mu),inm2(-mu:mu)
+c layer attenuation for the vertical integrations (same for all orders)
+      double precision ec(0:nt,-mu:mu),ed(0:nt,-mu:mu),ex(0:nt,-mu:mu)
+c source function sums, for all levels at once
+      double precision si1(0:nt),si2(0:nt)
       
 CCCC Begin Variable for Look up table generation      
 C azimuth or scattering angle variable for LUT computation (rolut)
@@ -45,7 +49,7 @@ CCCC End Variable for Look up table generation
       double precision roavion1,roavion2,roavion,spl,sa1
       double precision beta0,beta2,roavion0
       double precision sa2,c,zi1,f,d,xpk,y
-      double precision a1,d1,g1,y1,delta0s
+      double precision a1,d1,g1,y1,delta0s,cfi,cfi0
       integer snt
       integer nt,iwr,iplane,mum1,ntp,j,it,itp,i,l,m,iborm
       integer is,isp,ig,k,jj,index,temp
@@ -312,6 +316,32 @@ c
       beta0=1.
       beta2=0.5*ron
 c
+c     attenuation across each layer, upward (k>0, layer i,i+1) and
+c     downward (k<0, layer i-1,i) directions
+c
+      do 18 k=1,mu
+      yy=rm(k)
+      do 28 i=nt-1,0,-1
+      jj=i+1
+      f=h(jj)-h(i)
+      c=exp(-f/yy)
+      ec(i,k)=c
+      ed(i,k)=1.0e+00-c
+      ex(i,k)=h(i)-h(jj)*c
+   28 continue
+   18 continue
+      do 19 k=-mu,-1
+      yy=rm(k)
+      do 29 i=1,nt
+      jj=i-1
+      f=h(i)-h(jj)
+      c=exp(f/yy)
+      ec(i,k)=c
+      ed(i,k)=1.0e+00-c
+      ex(i,k)=h(i)-h(jj)*c
+   29 continue
+   19 continue
+c
 c     fourier decomposition
 c
       do 17 j=-mu,mu
@@ -368,9 +398,9 @@ c
       f=h(jj)-h(i)
       a=(i2(jj,k)-i2(i,k))/f
       b=i2(i,k)-a*h(i)
-      c=exp(-f/yy)
-      d=1.0e+00-c
-      xx=h(i)-h(jj)*c
+      c=ec(i,k)
+      d=ed(i,k)
+      xx=ex(i,k)
       zi1=c*zi1+(d*(b+a*yy)+a*xx)*0.5e+00
       i1(i,k)=zi1
   108 continue
@@ -384,11 +414,11 @@ c
       do 109 i=1,nt
       jj=i-1
       f=h(i)-h(jj)
-      c=exp(f/yy)
-      d=1.0e+00-c
+      c=ec(i,k)
+      d=ed(i,k)
       a=(i2(i,k)-i2(jj,k))/f
       b=i2(i,k)-a*h(i)
-      xx=h(i)-h(jj)*c
+      xx=ex(i,k)
       zi1=c*zi1+(d*(b+a*yy)+a*xx)*0.5e+00
       i1(i,k)=zi1
   109 continue
@@ -422,26 +452,36 @@ c     if is < ou = 2 kernels are a mixing of aerosols and molecules kern
 c     if is >2 aerosols kernels only
 c
       if(is-2)210,210,211
+c     the sums over j are done for all the levels i at once, with i
+c     innermost so that the loops run over contiguous memory and can
+c     be vectorized
+c
   210 do455 k=1,mu
       xpk=xpl(k)
       ypk=xpl(-k)
-      do 455 i=0,nt
-      ii1=0.
-      ii2=0.
-      x=xdel(i)
-      y=ydel(i)
+      do 454 i=0,nt
+      si1(i)=0.
+      si2(i)=0.
+  454 continue
       do477 j=1,mu
       xpj=xpl(j)
       z=gb(j)
+      do 476 i=0,nt
+      x=xdel(i)
+      y=ydel(i)
       xi1=i1(i,j)
       xi2=i1(i,-j)
       bpjk=bp(j,k)*x+y*(beta0+beta2*xpj*xpk)
       bpjmk=bp(j,-k)*x+y*(beta0+beta2*xpj*ypk)
       xdb=z*(xi1*bpjk+xi2*bpjmk)
-      ii2=ii2+xdb
+      si2(i)=si2(i)+xdb
       xdb=z*(xi1*bpjmk+xi2*bpjk)
-      ii1=ii1+xdb
+      si1(i)=si1(i)+xdb
+ 476  continue
  477  continue
+      do 455 i=0,nt
+      ii1=si1(i)
+      ii2=si2(i)
       if (abs(ii2).lt.1.E-30) ii2=0.
       if (abs(ii1).lt.1.E-30) ii1=0.
       i2(i,k)=ii2
@@ -449,21 +489,27 @@ c
  455  continue
       goto 213
  211  do45 k=1,mu
-      do 45 i=0,nt
-      ii1=0.
-      ii2=0.
-      x=xdel(i)
+      do 44 i=0,nt
+      si1(i)=0.
+      si2(i)=0.
+   44 continue
       do47 j=1,mu
       z=gb(j)
+      do 46 i=0,nt
+      x=xdel(i)
       xi1=i1(i,j)
       xi2=i1(i,-j)
       bpjk=bp(j,k)*x
       bpjmk=bp(j,-k)*x
       xdb=z*(xi1*bpjk+xi2*bpjmk)
-      ii2=ii2+xdb
+      si2(i)=si2(i)+xdb
       xdb=z*(xi1*bpjmk+xi2*bpjk)
-      ii1=ii1+xdb
+      si1(i)=si1(i)+xdb
+   46 continue
    47 continue
+      do 45 i=0,nt
+      ii1=si1(i)
+      ii2=si2(i)
       if (abs(ii2).lt.1.E-30) ii2=0.
       if (abs(ii1).lt.1.E-30) ii1=0.
       i2(i,k)=ii2
@@ -481,9 +527,9 @@ c
       f=h(jj)-h(i)
       a=(i2(jj,k)-i2(i,k))/f
       b=i2(i,k)-a*h(i)
-      c=exp(-f/yy)
-      d=1.e+00-c
-      xx=h(i)-h(jj)*c
+      c=ec(i,k)
+      d=ed(i,k)
+      xx=ex(i,k)
       zi1=c*zi1+(d*(b+a*yy)+a*xx)*0.5e+00
       if (abs(zi1).le.1.E-20) zi1=0.
       i1(i,k)=zi1
@@ -498,11 +544,11 @@ c
       do 50 i=1,nt
       jj=i-1
       f=h(i)-h(jj)
-      c=exp(f/yy)
-      d=1.e+00-c
+      c=ec(i,k)
+      d=ed(i,k)
       a=(i2(i,k)-i2(jj,k))/f
       b=i2(i,k)-a*h(i)
-      xx=h(i)-h(jj)*c
+      xx=ex(i,k)
       zi1=c*zi1+(d*(b+a*yy)+a*xx)*0.5e+00
       if (abs(zi1).le.1.E-20) zi1=0.
       i1(i,k)=zi1
@@ -625,12 +671,13 @@ c     stop of the fourier decomposition
 c
       do 614 l=1,np
       phi=rp(l)
-      do 614 m=-mum1,mum1
-      if(m.gt.0) then
-      xl(m,l)=xl(m,l)+delta0s*i3(m)*cos(is*(phi+pi))
-      else
-      xl(m,l)=xl(m,l)+delta0s*i3(m)*cos(is*phi)
-      endif
+      cfi0=cos(is*phi)
+      cfi=cos(is*(phi+pi))
+      do 617 m=-mum1,0
+      xl(m,l)=xl(m,l)+delta0s*i3(m)*cfi0
+ 617  continue
+      do 614 m=1,mum1
+      xl(m,l)=xl(m,l)+delta0s*i3(m)*cfi
  614  continue
  
 C Look up table generation 
@@ -649,12 +696,13 @@ C end of look up table generation
       xl(0,1)=xl(0,1)+rm(k)*gb(k)*i3(-k)
       enddo
       endif
-      xl(mu,1)=xl(mu,1)+delta0s*i3(mu)*cos(is*(phirad+pi))
+      cfi=cos(is*(phirad+pi))
+      xl(mu,1)=xl(mu,1)+delta0s*i3(mu)*cfi
       do ifi=1,nfi
       phimul=(ifi-1)*pi/(nfi-1)
       xlphim(ifi)=xlphim(ifi)+delta0s*roavion*cos(is*(phimul+pi))
       enddo
-      xl(-mu,1)=xl(-mu,1)+delta0s*roavion*cos(is*(phirad+pi))
+      xl(-mu,1)=xl(-mu,1)+delta0s*roavion*cfi
       z=0.
       do 613 l=-mu,mu
        if (abs(i4(l)).lt.accu) goto 613
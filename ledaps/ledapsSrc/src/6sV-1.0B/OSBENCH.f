@@ -0,0 +1,232 @@
+      program osbench
+c**********************************************************************c
+c                                                                      c
+c   benchmark of the successive orders of scattering kernels           c
+c   (os in OS.f, ospol in OSPOL.f), which take most of a 6S run.       c
+c                                                                      c
+c   usage: osbench [-n repeats] [-save file | -check file]             c
+c                                                                      c
+c   the aerosol phase function and the other common blocks are set     c
+c   by a 6S run of the lndsr case (continental aerosol, TM band 2),    c
+c   then os and ospol are timed over a set of rayleigh, mixed and      c
+c   aerosol dominated cases at several sun angles.                     c
+c                                                                      c
+c   -save writes the radiances of every case to file; -check compares  c
+c   them with a file saved by another build of the kernels, and fails  c
+c   if a value differs by more than tol (relative to the largest       c
+c   value of its array).                                               c
+c                                                                      c
+c**********************************************************************c
+      include "paramdef.inc"
+      integer ncase
+      parameter (ncase=6)
+      real tol
+      parameter (tol=1.e-5)
+
+      integer nquad
+      common /num_quad/ nquad
+      real delta,sigma
+      common /sixs_del/ delta,sigma
+      integer igmax
+      common /multorder/ igmax
+      integer iwr
+      logical ier
+      common /sixs_ier/ iwr,ier
+
+      real rm(-mu_p:mu_p),gb(-mu_p:mu_p),rp(np_p),gp(np_p)
+      real anglem(mu2_p),weightm(mu2_p)
+      real xli(-mu_p:mu_p,np_p),xlq(-mu_p:mu_p,np_p)
+      real xlu(-mu_p:mu_p,np_p),xl(-mu_p:mu_p,np_p)
+      real xlphim(nfi_p)
+      real rolut(mu_p,41),rolutq(mu_p,41),rolutu(mu_p,41)
+      real filut(mu_p,41)
+      integer nfilut(mu_p)
+      real res(43)
+
+c  cases: aerosol and rayleigh optical depths, aerosol single
+c  scattering albedo, solar zenith and relative azimuth (deg)
+      real tac(ncase),trc(ncase),pizc(ncase),szac(ncase),phic(ncase)
+      data tac  /0.,   0.05, 0.2,  0.5,  1.5,  0.8 /
+      data trc  /0.25, 0.25, 0.1,  0.05, 0.02, 0.1 /
+      data pizc /0.,   0.95, 0.9,  0.9,  0.85, 0.95/
+      data szac /30.,  10.,  30.,  50.,  65.,  75. /
+      data phic /20.,  0.,   120., 60.,  170., 90. /
+
+c  saved results: ospol (i,q,u,phi) and os (i,phi) of every case
+      integer nval
+      parameter (nval=(2*mu_p+1)*np_p*4+nfi_p*2)
+      real out(nval,ncase),ref(nval,ncase)
+
+      character*256 arg,file
+      integer mode,nrep,irep,ic,i,j,k,l,mu,mu2,np,nfi,nt,mum1
+      integer inul,ideck,iout
+      real pi,pi2,xmus,xmuv,phirad,t0,t1,tpol,tos,emax,e,vmax
+      logical fail
+
+      mode=0
+      nrep=20
+      file=' '
+      i=1
+   10 if (i.gt.iargc()) goto 20
+      call getarg(i,arg)
+      if (arg.eq.'-n'.and.i.lt.iargc()) then
+       call getarg(i+1,arg)
+       read(arg,*) nrep
+      else if (arg.eq.'-save'.and.i.lt.iargc()) then
+       mode=1
+       call getarg(i+1,file)
+      else if (arg.eq.'-check'.and.i.lt.iargc()) then
+       mode=2
+       call getarg(i+1,file)
+      else
+       write(6,*) 'usage: osbench [-n repeats] [-save file | ',
+     s            '-check file]'
+       stop 1
+      endif
+      i=i+2
+      goto 10
+   20 continue
+
+c  6S run of the lndsr case, to set the common blocks
+      inul=56
+      ideck=57
+      open(inul,file='/dev/null',status='old')
+      open(ideck,status='scratch')
+      write(ideck,'(a)') '0'
+      write(ideck,'(a)') '30.00 20.00 0.00 0.00 9 15'
+      write(ideck,'(a)') '8'
+      write(ideck,'(a)') '2.00 0.30'
+      write(ideck,'(a)') '1'
+      write(ideck,'(a)') '0'
+      write(ideck,'(a)') '0.200'
+      write(ideck,'(a)') '0'
+      write(ideck,'(a)') '-1000'
+      write(ideck,'(a)') '26'
+      write(ideck,'(a)') '0'
+      write(ideck,'(a)') '0'
+      write(ideck,'(a)') '0'
+      write(ideck,'(a)') '0.140'
+      write(ideck,'(a)') '-1'
+      write(ideck,'(a)') '0'
+      rewind(ideck)
+      call sixsv(ideck,inul,res)
+      close(ideck)
+      if (ier) then
+       write(6,*) 'osbench: 6S run failed'
+       stop 1
+      endif
+
+c  gauss quadrature, as in sixsv
+      nt=nt_p
+      mu=mu_p
+      mu2=mu2_p
+      np=np_p
+      nfi=nfi_p
+      pi=acos(-1.)
+      pi2=2*pi
+      call gauss(-1.,1.,anglem,weightm,mu2)
+      call gauss(0.,pi2,rp,gp,np)
+      mum1=mu-1
+      do j=-mum1,-1
+       k=mu+j
+       rm(-j-mu)=anglem(k)
+       gb(-j-mu)=weightm(k)
+      enddo
+      do j=1,mum1
+       k=mum1+j
+       rm(mu-j)=anglem(k)
+       gb(mu-j)=weightm(k)
+      enddo
+      gb(-mu)=0.
+      gb(0)=0.
+      gb(mu)=0.
+      do i=1,mu
+       nfilut(i)=0
+      enddo
+
+c  nadir view, as in lndsr
+      xmuv=1.
+      tpol=0.
+      tos=0.
+      do irep=0,nrep
+       do ic=1,ncase
+        xmus=cos(szac(ic)*pi/180.)
+        phirad=phic(ic)*pi/180.
+        rm(-mu)=-xmuv
+        rm(mu)=xmuv
+        rm(0)=-xmus
+        call cpu_time(t0)
+        call ospol(0,tac(ic),trc(ic),pizc(ic),0.,0.,1000.,
+     s             phirad,nt,mu,np,rm,gb,rp,xli,xlq,xlu,xlphim,nfi,
+     s             nfilut,filut,rolut,rolutq,rolutu)
+        call cpu_time(t1)
+        if (irep.gt.0) tpol=tpol+t1-t0
+        if (irep.eq.0) then
+         k=0
+         call osbsav(out(1,ic),k,xli,(2*mu+1)*np)
+         call osbsav(out(1,ic),k,xlq,(2*mu+1)*np)
+         call osbsav(out(1,ic),k,xlu,(2*mu+1)*np)
+         call osbsav(out(1,ic),k,xlphim,nfi)
+        endif
+        call cpu_time(t0)
+        call os(0,tac(ic),trc(ic),pizc(ic),0.,0.,1000.,
+     s          phirad,nt,mu,np,rm,gb,rp,xl,xlphim,nfi,rolut)
+        call cpu_time(t1)
+        if (irep.gt.0) tos=tos+t1-t0
+        if (irep.eq.0) then
+         call osbsav(out(1,ic),k,xl,(2*mu+1)*np)
+         call osbsav(out(1,ic),k,xlphim,nfi)
+        endif
+       enddo
+      enddo
+      if (nrep.gt.0) then
+       write(6,100) 'ospol',1000.*tpol/(nrep*ncase)
+       write(6,100) 'os',1000.*tos/(nrep*ncase)
+      endif
+  100 format(a6,f10.3,' ms per call')
+
+      iout=58
+      if (mode.eq.1) then
+       open(iout,file=file,form='unformatted',status='unknown')
+       write(iout) out
+       close(iout)
+       write(6,*) 'results saved to ',file(1:len_trim(file))
+      endif
+      if (mode.eq.2) then
+       open(iout,file=file,form='unformatted',status='old')
+       read(iout) ref
+       close(iout)
+       fail=.false.
+       do ic=1,ncase
+        emax=0.
+        vmax=0.
+        do l=1,nval
+         vmax=max(vmax,abs(ref(l,ic)))
+        enddo
+        do l=1,nval
+         e=abs(out(l,ic)-ref(l,ic))
+         if (vmax.gt.0.) e=e/vmax
+         emax=max(emax,e)
+        enddo
+        write(6,101) ic,emax
+        if (emax.gt.tol) fail=.true.
+       enddo
+       if (fail) then
+        write(6,*) 'osbench: results differ by more than ',tol
+        stop 1
+       endif
+       write(6,*) 'osbench: results agree within ',tol
+      endif
+  101 format('case',i3,'  max relative difference',es12.4)
+      end
+
+      subroutine osbsav(out,k,x,n)
+c  append the n values of x to out(k+1...)
+      integer k,n,i
+      real out(*),x(n)
+      do i=1,n
+       out(k+i)=x(i)
+      enddo
+      k=k+n
+      return
+      end
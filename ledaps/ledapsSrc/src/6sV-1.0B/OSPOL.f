@@ -33,6 +33,11 @@ c array for sos computation
       real i4(-mu:mu),q4(-mu:mu),u4(-mu:mu)
       real in(0:2,-mu:mu),qn(0:2,-mu:mu),un(0:2,-mu:mu)
       real roIavion(-1:2),roQavion(-1:2),roUavion(-1:2)
+c layer attenuation for the vertical integrations (same for all orders)
+      double precision ec(0:nt,-mu:mu),ed(0:nt,-mu:mu),ex(0:nt,-mu:mu)
+c source function sums, for all levels at once
+      double precision si1(0:nt),si2(0:nt),sq1(0:nt),sq2(0:nt)
+      double precision su1(0:nt),su2(0:nt)
       
 CCCC Begin Variable for Look up table generation      
 C azimuth or scattering angle variable for LUT computation (rolut)
@@ -51,7 +56,7 @@ CCCC End Variable for Look up table generation
       double precision ppp2,ppp1,ca,cr,ratio
       double precision tap,piz,acu,acu2,ha,xmus,zx,yy,dd
       double precision taup,th,xt1,xt2,pi,phi,aaaa,ron,spl
-      double precision sa1,sa2,sb1,sb2,sc1,sc2
+      double precision sa1,sa2,sb1,sb2,sc1,sc2,cfi,sfi,cfi0,sfi0
       double precision beta0,beta2,gamma2,alpha2
       double precision zi1,zq1,zu1,c,f,d,y
       double precision a1,d1,g1,y1,r1,delta0s
@@ -286,6 +291,32 @@ c
       gamma2=-ron*sqrt(1.5)
       alpha2=3.*ron
 c
+c     attenuation across each layer, upward (k>0, layer i,i+1) and
+c     downward (k<0, layer i-1,i) directions
+c
+      do 18 k=1,mu
+        yy=rm(k)
+        do 28 i=nt-1,0,-1
+          jj=i+1
+          f=h(jj)-h(i)
+          c=exp(-f/yy)
+          ec(i,k)=c
+          ed(i,k)=1.0e+00-c
+          ex(i,k)=h(i)-h(jj)*c
+   28   continue
+   18 continue
+      do 19 k=-mu,-1
+        yy=rm(k)
+        do 29 i=1,nt
+          jj=i-1
+          f=h(i)-h(jj)
+          c=exp(f/yy)
+          ec(i,k)=c
+          ed(i,k)=1.0e+00-c
+          ex(i,k)=h(i)-h(jj)*c
+   29   continue
+   19 continue
+c
 c     fourier decomposition
 c
       do 17 j=-mu,mu
@@ -361,9 +392,9 @@ c
            do 108 i=nt-1,0,-1
               jj=i+1
               f=h(jj)-h(i)
-              c=exp(-f/yy)
-              d=1.0e+00-c
-              xx=h(i)-h(jj)*c
+              c=ec(i,k)
+              d=ed(i,k)
+              xx=ex(i,k)
 
               a=(i2(jj,k)-i2(i,k))/f
               b=i2(i,k)-a*h(i)
@@ -394,9 +425,9 @@ c
           do 109 i=1,nt
             jj=i-1
             f=h(i)-h(jj)
-            c=exp(f/yy)
-            d=1.0e+00-c
-            xx=h(i)-h(jj)*c
+            c=ec(i,k)
+            d=ed(i,k)
+            xx=ex(i,k)
  
             a=(i2(i,k)-i2(jj,k))/f
             b=i2(i,k)-a*h(i)
@@ -454,30 +485,36 @@ c     if is < ou = 2 kernels are a mixing of aerosols and molecules kern
 c     if is >2 aerosols kernels only
 c
         if(is-2)210,210,211
-  210   do455 k=1,mu
+c     the sums over j are done for all the levels i at once, with i
+c     innermost so that the loops run over contiguous memory and can
+c     be vectorized
+c
+  210   do 455 k=1,mu
           xpk=xpl(k)
           xrk=xrl(k)
           xtk=xtl(k)
           ypk=xpl(-k)
           yrk=xrl(-k)
           ytk=xtl(-k)
-          do 455 i=0,nt
-            ii1=0.
-            ii2=0.
-            qq1=0.
-            qq2=0.
-            uu1=0.
-            uu2=0.
-            x=xdel(i)
-            y=ydel(i)
-            do477 j=1,mu
-              z=gb(j)
-              xpj=xpl(j)
-              xrj=xrl(j)
-              xtj=xtl(j)
-              ypj=xpl(-j)
-              yrj=xrl(-j)
-              ytj=xtl(-j)
+          do 454 i=0,nt
+            si1(i)=0.
+            si2(i)=0.
+            sq1(i)=0.
+            sq2(i)=0.
+            su1(i)=0.
+            su2(i)=0.
+  454     continue
+          do 477 j=1,mu
+            z=gb(j)
+            xpj=xpl(j)
+            xrj=xrl(j)
+            xtj=xtl(j)
+            ypj=xpl(-j)
+            yrj=xrl(-j)
+            ytj=xtl(-j)
+            do 476 i=0,nt
+              x=xdel(i)
+              y=ydel(i)
               xi1=i1(i,j)
               xi2=i1(i,-j)
               xq1=q1(i,j)
@@ -507,23 +544,31 @@ c
 
               xdb=xi1*bpjk+xi2*bpjmk+xq1*grkj+xq2*grkmj
               xdb=xdb-xu1*gtkj-xu2*gtkmj
-              ii2=ii2+xdb*z
+              si2(i)=si2(i)+xdb*z
               xdb=xi1*bpjmk+xi2*bpjk+xq1*grkmj+xq2*grkj
-	      xdb=xdb+xu1*gtkmj+xu2*gtkj
-              ii1=ii1+xdb*z
+              xdb=xdb+xu1*gtkmj+xu2*gtkj
+              si1(i)=si1(i)+xdb*z
               xdb=xi1*grjk+xi2*grjmk+xq1*arrjk+xq2*arrjmk
               xdb=xdb-xu1*artjk+xu2*artjmk
-	      qq2=qq2+xdb*z
-	      xdb=xi1*grjmk+xi2*grjk+xq1*arrjmk+xq2*arrjk
-	      xdb=xdb-xu1*artjmk+xu2*artjk
-	      qq1=qq1+xdb*z
+              sq2(i)=sq2(i)+xdb*z
+              xdb=xi1*grjmk+xi2*grjk+xq1*arrjmk+xq2*arrjk
+              xdb=xdb-xu1*artjmk+xu2*artjk
+              sq1(i)=sq1(i)+xdb*z
               xdb=xi1*gtjk-xi2*gtjmk+xq1*artkj+xq2*artkmj
               xdb=xdb-xu1*attjk-xu2*attjmk
-	      uu2=uu2-xdb*z
+              su2(i)=su2(i)-xdb*z
               xdb=xi1*gtjmk-xi2*gtjk-xq1*artkmj-xq2*artkj
               xdb=xdb-xu1*attjmk-xu2*attjk
-	      uu1=uu1-xdb*z
- 477        continue
+              su1(i)=su1(i)-xdb*z
+  476       continue
+  477     continue
+          do 455 i=0,nt
+            ii1=si1(i)
+            ii2=si2(i)
+            qq1=sq1(i)
+            qq2=sq2(i)
+            uu1=su1(i)
+            uu2=su2(i)
             if (abs(ii2).lt.1.E-30) ii2=0.
             if (abs(ii1).lt.1.E-30) ii1=0.
             if (abs(qq2).lt.1.E-30) qq2=0.
@@ -536,21 +581,23 @@ c
             q2(i,-k)=qq1
             u2(i,k)=uu2
             u2(i,-k)=uu1
- 455    continue
+  455   continue
         goto 213
 
 
- 211    do45 k=1,mu
-          do 45 i=0,nt
-            ii1=0.
-            ii2=0.
-            qq1=0.
-            qq2=0.
-            uu1=0.
-            uu2=0.
-            x=xdel(i)
-            do47 j=1,mu
-              z=gb(j)
+ 211    do 45 k=1,mu
+          do 44 i=0,nt
+            si1(i)=0.
+            si2(i)=0.
+            sq1(i)=0.
+            sq2(i)=0.
+            su1(i)=0.
+            su2(i)=0.
+   44     continue
+          do 47 j=1,mu
+            z=gb(j)
+            do 46 i=0,nt
+              x=xdel(i)
               xi1=i1(i,j)
               xi2=i1(i,-j)
               xq1=q1(i,j)
@@ -568,34 +615,42 @@ c
               grjmk=gr(j,-k)*x
               grkj=gr(k,j)*x
               grkmj=gr(k,-j)*x
-	      arrjk=arr(j,k)*x
-	      arrjmk=arr(j,-k)*x
-	      artjk=art(j,k)*x
-	      artjmk=art(j,-k)*x
-	      artkj=art(k,j)*x
-	      artkmj=art(k,-j)*x
-	      attjk=att(j,k)*x
-	      attjmk=att(j,-k)*x
+              arrjk=arr(j,k)*x
+              arrjmk=arr(j,-k)*x
+              artjk=art(j,k)*x
+              artjmk=art(j,-k)*x
+              artkj=art(k,j)*x
+              artkmj=art(k,-j)*x
+              attjk=att(j,k)*x
+              attjmk=att(j,-k)*x
 
               xdb=xi1*bpjk+xi2*bpjmk+xq1*grkj+xq2*grkmj
               xdb=xdb-xu1*gtkj-xu2*gtkmj
-              ii2=ii2+xdb*z
+              si2(i)=si2(i)+xdb*z
               xdb=xi1*bpjmk+xi2*bpjk+xq1*grkmj+xq2*grkj
-	      xdb=xdb+xu1*gtkmj+xu2*gtkj
-              ii1=ii1+xdb*z
+              xdb=xdb+xu1*gtkmj+xu2*gtkj
+              si1(i)=si1(i)+xdb*z
               xdb=xi1*grjk+xi2*grjmk+xq1*arrjk+xq2*arrjmk
               xdb=xdb-xu1*artjk+xu2*artjmk
-	      qq2=qq2+xdb*z
-	      xdb=xi1*grjmk+xi2*grjk+xq1*arrjmk+xq2*arrjk
-	      xdb=xdb-xu1*artjmk+xu2*artjk
-	      qq1=qq1+xdb*z
+              sq2(i)=sq2(i)+xdb*z
+              xdb=xi1*grjmk+xi2*grjk+xq1*arrjmk+xq2*arrjk
+              xdb=xdb-xu1*artjmk+xu2*artjk
+              sq1(i)=sq1(i)+xdb*z
               xdb=xi1*gtjk-xi2*gtjmk+xq1*artkj+xq2*artkmj
               xdb=xdb-xu1*attjk-xu2*attjmk
-	      uu2=uu2-xdb*z
+              su2(i)=su2(i)-xdb*z
               xdb=xi1*gtjmk-xi2*gtjk-xq1*artkmj-xq2*artkj
               xdb=xdb-xu1*attjmk-xu2*attjk
-	      uu1=uu1-xdb*z
-   47       continue
+              su1(i)=su1(i)-xdb*z
+   46       continue
+   47     continue
+          do 45 i=0,nt
+            ii1=si1(i)
+            ii2=si2(i)
+            qq1=sq1(i)
+            qq2=sq2(i)
+            uu1=su1(i)
+            uu2=su2(i)
             if (abs(ii2).lt.1.E-30) ii2=0.
             if (abs(ii1).lt.1.E-30) ii1=0.
             if (abs(qq2).lt.1.E-30) qq2=0.
@@ -623,9 +678,9 @@ c
           do 48 i=nt-1,0,-1
             jj=i+1
             f=h(jj)-h(i)
-            c=exp(-f/yy)
-            d=1.e+00-c
-            xx=h(i)-h(jj)*c
+            c=ec(i,k)
+            d=ed(i,k)
+            xx=ex(i,k)
 
             a=(i2(jj,k)-i2(i,k))/f
             b=i2(i,k)-a*h(i)
@@ -659,9 +714,9 @@ c
           do 50 i=1,nt
             jj=i-1
             f=h(i)-h(jj)
-            c=exp(f/yy)
-            d=1.e+00-c
-            xx=h(i)-h(jj)*c
+            c=ec(i,k)
+            d=ed(i,k)
+            xx=ex(i,k)
 
             a=(i2(i,k)-i2(jj,k))/f
             b=i2(i,k)-a*h(i)
@@ -910,17 +965,19 @@ c
 
         do 614 l=1,np
           phi=rp(l)
-          do 614 m=-mum1,mum1
-            if(m.gt.0) then
-              xli(m,l)=xli(m,l)+delta0s*i3(m)*cos(is*(phi+pi))
-              xlq(m,l)=xlq(m,l)+delta0s*q3(m)*cos(is*(phi+pi))
-              xlu(m,l)=xlu(m,l)+delta0s*u3(m)*sin(is*(phi+pi))
-            else
-              xli(m,l)=xli(m,l)+delta0s*i3(m)*cos(is*phi)
-              xlq(m,l)=xlq(m,l)+delta0s*q3(m)*cos(is*phi)
-              xlu(m,l)=xlu(m,l)+delta0s*u3(m)*sin(is*phi)
-            endif
-
+          cfi0=cos(is*phi)
+          sfi0=sin(is*phi)
+          cfi=cos(is*(phi+pi))
+          sfi=sin(is*(phi+pi))
+          do 615 m=-mum1,0
+            xli(m,l)=xli(m,l)+delta0s*i3(m)*cfi0
+            xlq(m,l)=xlq(m,l)+delta0s*q3(m)*cfi0
+            xlu(m,l)=xlu(m,l)+delta0s*u3(m)*sfi0
+ 615      continue
+          do 614 m=1,mum1
+            xli(m,l)=xli(m,l)+delta0s*i3(m)*cfi
+            xlq(m,l)=xlq(m,l)+delta0s*q3(m)*cfi
+            xlu(m,l)=xlu(m,l)+delta0s*u3(m)*sfi
  614    continue
  
  
@@ -928,9 +985,11 @@ C Look up table generation
       do m=1,mu
       do l=1,nfilut(m)
       phimul=filut(m,l)*pi/180.
-      rolut(m,l)=rolut(m,l)+delta0s*i3(m)*cos(is*(phimul+pi))
-      rolutq(m,l)=rolutq(m,l)+delta0s*q3(m)*cos(is*(phimul+pi))
-      rolutu(m,l)=rolutu(m,l)+delta0s*u3(m)*sin(is*(phimul+pi))
+      cfi=cos(is*(phimul+pi))
+      sfi=sin(is*(phimul+pi))
+      rolut(m,l)=rolut(m,l)+delta0s*i3(m)*cfi
+      rolutq(m,l)=rolutq(m,l)+delta0s*q3(m)*cfi
+      rolutu(m,l)=rolutu(m,l)+delta0s*u3(m)*sfi
       enddo
       enddo
 C end of look up table generation 
@@ -946,12 +1005,14 @@ C end of look up table generation
             xlu(0,1)=xlu(0,1)+rm(k)*gb(k)*u3(-k)
           enddo
         endif
-        xli(mu,1)=xli(mu,1)+delta0s*i3(mu)*cos(is*(phirad+pi))
-        xlq(mu,1)=xlq(mu,1)+delta0s*q3(mu)*cos(is*(phirad+pi))
-        xlu(mu,1)=xlu(mu,1)+delta0s*u3(mu)*sin(is*(phirad+pi))
-        xli(-mu,1)=xli(-mu,1)+delta0s*roIavion(-1)*cos(is*(phirad+pi))
-        xlq(-mu,1)=xlq(-mu,1)+delta0s*roQavion(-1)*cos(is*(phirad+pi))
-        xlu(-mu,1)=xlu(-mu,1)+delta0s*roUavion(-1)*sin(is*(phirad+pi))
+        cfi=cos(is*(phirad+pi))
+        sfi=sin(is*(phirad+pi))
+        xli(mu,1)=xli(mu,1)+delta0s*i3(mu)*cfi
+        xlq(mu,1)=xlq(mu,1)+delta0s*q3(mu)*cfi
+        xlu(mu,1)=xlu(mu,1)+delta0s*u3(mu)*sfi
+        xli(-mu,1)=xli(-mu,1)+delta0s*roIavion(-1)*cfi
+        xlq(-mu,1)=xlq(-mu,1)+delta0s*roQavion(-1)*cfi
+        xlu(-mu,1)=xlu(-mu,1)+delta0s*roUavion(-1)*sfi
         do ifi=1,nfi
         phimul=(ifi-1)*pi/(nfi-1)
         xlphim(ifi)=xlphim(ifi)+delta0s*roIavion(-1)*cos(is*(phimul+pi))
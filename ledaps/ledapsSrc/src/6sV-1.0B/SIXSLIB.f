@@ -0,0 +1,71 @@
+      subroutine sixslib(asol,phi0,avis,phiv,month,jday,uw,uo3,
+     s                   iaer,taer55,xps,iwave,wlinf,wlsup,nresp,resp,
+     s                   ro,res,ierr)
+c**********************************************************************c
+c                                                                      c
+c   in-process entry point of 6S, called from C through sixs_run()     c
+c   (sixs_lib.c). it runs the case normally given on the command       c
+c   cards below and returns the integrated results in res, without     c
+c   starting a process or writing a report:                            c
+c                                                                      c
+c     0                            user defined geometry               c
+c     asol phi0 avis phiv month jday                                   c
+c     8                            user water vapor and ozone          c
+c     uw uo3                                                           c
+c     iaer                         aerosol model                       c
+c     0                            aot at 550 nm given                 c
+c     taer55                                                           c
+c     xps                          target altitude                     c
+c     -1000                        satellite level                     c
+c     iwave                        predefined band (2 to 118) or       c
+c                                  1 followed by wlinf wlsup resp      c
+c     0 0 0 ro                     lambertian uniform ground           c
+c     -1                           no atmospheric correction           c
+c     0                            no surface polarization             c
+c                                                                      c
+c   ierr is 0 on success and 1 when 6S rejected the parameters.        c
+c                                                                      c
+c**********************************************************************c
+      integer month,jday,iaer,iwave,nresp,ierr
+      real asol,phi0,avis,phiv,uw,uo3,taer55,xps,wlinf,wlsup,ro
+      real resp(*),res(*)
+      integer iscr,inul,i
+      logical ier
+      integer iwr
+      common/sixs_ier/iwr,ier
+
+      iscr=55
+      inul=56
+      ierr=0
+
+      open(iscr,status='scratch',form='formatted')
+      write(iscr,*) 0
+      write(iscr,*) asol,phi0,avis,phiv,month,jday
+      write(iscr,*) 8
+      write(iscr,*) uw,uo3
+      write(iscr,*) iaer
+      write(iscr,*) 0
+      write(iscr,*) taer55
+      write(iscr,*) xps
+      write(iscr,*) -1000
+      write(iscr,*) iwave
+      if (iwave.eq.1) then
+       write(iscr,*) wlinf,wlsup
+       write(iscr,*) (resp(i),i=1,nresp)
+      endif
+      write(iscr,*) 0
+      write(iscr,*) 0
+      write(iscr,*) 0
+      write(iscr,*) ro
+      write(iscr,*) -1
+      write(iscr,*) 0
+      rewind(iscr)
+
+      open(inul,file='/dev/null',status='old')
+      call sixsv(iscr,inul,res)
+      if (ier) ierr=1
+      close(inul)
+      close(iscr)
+
+      return
+      end
@@ -0,0 +1,61 @@
+#include <stdio.h>
+#include <string.h>
+#include "sixs_lib.h"
+
+#define sixslib sixslib_
+
+/* Prototype for the Fortran entry point (SIXSLIB.f) */
+void sixslib(float *asol, float *phi0, float *avis, float *phiv, int *month,
+             int *jday, float *uw, float *uo3, int *iaer, float *taer55,
+             float *xps, int *iwave, float *wlinf, float *wlsup, int *nresp,
+             float *resp, float *ro, float *res, int *ierr);
+
+/* Run one 6S case in-process.  Returns 0 on success, -1 when the parameters
+   are invalid or 6S rejected them (the 6S diagnostic goes to the report,
+   which is not written in library mode).  6S keeps its state in COMMON
+   blocks, so only one case may run at a time in a given process. */
+int sixs_run(const sixs_params_t *params, sixs_results_t *results) {
+	sixs_params_t p;
+	float res[SIXS_NB_RESULTS];
+	int ierr;
+
+	if (params->band == SIXS_BAND_FILTER &&
+	    (params->nresp < 1 || params->nresp > SIXS_MAX_RESP)) {
+		fprintf(stderr,"ERROR: sixs_run: invalid filter function size %d\n",
+		        params->nresp);
+		return -1;
+	}
+
+	/* the Fortran side takes every argument by reference */
+	memcpy(&p,params,sizeof(sixs_params_t));
+	sixslib(&p.sza,&p.saz,&p.vza,&p.vaz,&p.month,&p.day,&p.uwv,&p.uoz,
+	        &p.aer_model,&p.aot550,&p.target_alt,&p.band,&p.wlinf,&p.wlsup,
+	        &p.nresp,p.resp,&p.srefl,res,&ierr);
+	if (ierr) {
+		fprintf(stderr,"ERROR: sixs_run: 6S rejected the parameters\n");
+		return -1;
+	}
+
+	sixs_unpack_results(res,results);
+	return 0;
+}
+
+/* Unpack the SIXS_NB_RESULTS values of sixsv() (the res array, also written
+   by the batch mode of sixsV1.0B) */
+void sixs_unpack_results(const float *res, sixs_results_t *results) {
+	memcpy(results->tg_wv,&res[0],3*sizeof(float));
+	memcpy(results->tg_oz,&res[3],3*sizeof(float));
+	memcpy(results->tg_co2,&res[6],3*sizeof(float));
+	memcpy(results->tg_o2,&res[9],3*sizeof(float));
+	memcpy(results->tg_no2,&res[12],3*sizeof(float));
+	memcpy(results->tg_ch4,&res[15],3*sizeof(float));
+	memcpy(results->tg_co,&res[18],3*sizeof(float));
+	memcpy(results->t_ray,&res[21],3*sizeof(float));
+	memcpy(results->t_aer,&res[24],3*sizeof(float));
+	memcpy(results->t_tot,&res[27],3*sizeof(float));
+	memcpy(results->sph_alb,&res[30],3*sizeof(float));
+	memcpy(results->opt_depth,&res[33],3*sizeof(float));
+	memcpy(results->refl,&res[36],3*sizeof(float));
+	memcpy(results->tg_glob,&res[39],3*sizeof(float));
+	results->app_refl=res[42];
+}
@@ -0,0 +1,61 @@
+#ifndef SIXS_LIB_H
+#define SIXS_LIB_H
+
+/* In-process interface to 6sV1.0B (libsixs.a).  A case is described by the
+   same parameters the lndsr command cards used to carry (user geometry, user
+   water vapor/ozone, standard aerosol model with aot550, lambertian uniform
+   ground) and the integrated results are returned directly instead of being
+   scraped from the printed report. */
+
+#define SIXS_MAX_RESP 1501	/* max filter function values (0.0025 um step) */
+#define SIXS_NB_RESULTS 43	/* values returned by the Fortran sixsv() */
+
+/* Predefined 6S band for a user defined filter function */
+#define SIXS_BAND_FILTER 1
+
+typedef struct {
+	float sza,saz,vza,vaz;	/* solar/view zenith and azimuth (deg) */
+	int month,day;
+	float uwv,uoz;		/* water vapor (g/cm2) and ozone (cm-atm) */
+	int aer_model;		/* 6S aerosol model (1=continental) */
+	float aot550;		/* aerosol optical thickness at 550 nm */
+	float target_alt;	/* 6S xps: >=0 sea level, <0 altitude in km */
+	int band;		/* 6S predefined band or SIXS_BAND_FILTER */
+	float wlinf,wlsup;	/* filter function range (um) */
+	int nresp;		/* number of filter function values */
+	float resp[SIXS_MAX_RESP];	/* filter function */
+	float srefl;		/* constant surface reflectance */
+} sixs_params_t;
+
+/* The gaseous and scattering transmittances are [downward,upward,total],
+   the spherical albedo, optical depth and reflectance are
+   [rayleigh,aerosol,total], as in the "integrated values" of the report. */
+typedef struct {
+	float tg_wv[3];		/* water vapor transmittance */
+	float tg_oz[3];		/* ozone transmittance */
+	float tg_co2[3];	/* co2 transmittance */
+	float tg_o2[3];		/* oxygen transmittance */
+	float tg_no2[3];	/* no2 transmittance */
+	float tg_ch4[3];	/* ch4 transmittance */
+	float tg_co[3];		/* co transmittance */
+	float t_ray[3];		/* rayleigh scattering transmittance */
+	float t_aer[3];		/* aerosol scattering transmittance */
+	float t_tot[3];		/* total scattering transmittance */
+	float sph_alb[3];	/* spherical albedo */
+	float opt_depth[3];	/* optical depth */
+	float refl[3];		/* atmospheric intrinsic reflectance (I) */
+	float tg_glob[3];	/* global gaseous transmittance */
+	float app_refl;		/* apparent reflectance at the sensor */
+} sixs_results_t;
+
+/* Record written per case by "sixsV1.0B -batch -binary" */
+typedef struct {
+	int icase;		/* case number, from 1 */
+	int ierr;		/* 1 if 6S rejected the case */
+	float res[SIXS_NB_RESULTS];	/* results, see sixs_unpack_results() */
+} sixs_record_t;
+
+int sixs_run(const sixs_params_t *params, sixs_results_t *results);
+void sixs_unpack_results(const float *res, sixs_results_t *results);
+
+#endif
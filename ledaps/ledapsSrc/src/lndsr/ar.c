@@ -3,10 +3,14 @@
 08-01-2013: Modified divide by 10000. to multiply by 0.0001 since
             that is faster.  Gail Schmidt, USGS EROS LSRD
 ***************************************************************/
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 #include "ar.h"
 #include "const.h"
 #include "error.h"
 #include "sixs_runs.h"
+#include "gapfill.h"
 
 #define AOT_MIN_NB_SAMPLES 100
 
@@ -25,10 +29,140 @@ void csalbr(float *tau_ray,float *actual_S_r);
 int compute_aot(int band,float rho_toa,float rho_surf_est,float ts,float tv, float phi, float uoz, float uwv, float spres,sixs_tables_t *sixs_tables,float *aot);
 int update_gridcell_atmos_coefs(int irow,int icol,atmos_t *atmos_coef,Ar_gridcell_t *ar_gridcell, sixs_tables_t *sixs_tables,int **line_ar,Lut_t *lut,int nband, int bkgd_aerosol);
 
+static bool ArRegion(int il_ar, int is_ar, Lut_t *lut, Img_coord_int_t *size_in,
+        int16 ***line_in, char **ddv_line, int **line_ar, int **line_ar_stats,
+        Ar_stats_t *ar_stats, Ar_gridcell_t *ar_gridcell,
+        sixs_tables_t *sixs_tables, Ar_thread_t *ar_work);
+static short ArSelect(short *a, int n, int k);
+static void ArSortFirst(int n, int k, short **collect_band, short *collect_band7, short *select_buf);
+
+bool ArWorkInit(Lut_t *lut, Ar_gridcell_t *ar_gridcell, Ar_work_t *ar_work)
+/* Allocates the buffers Ar uses for every region of the scene, one set
+   per thread */
+{
+  int ib, it;
+  int nsamps = lut->ar_region_size.s * lut->ar_region_size.l;
+  Ar_thread_t *thread;
+
+#ifdef _OPENMP
+  ar_work->nthreads = omp_get_max_threads();
+#else
+  ar_work->nthreads = 1;
+#endif
+  ar_work->thread = (Ar_thread_t *)calloc((size_t)ar_work->nthreads,
+    sizeof(Ar_thread_t));
+  if (ar_work->thread == NULL)
+    RETURN_ERROR("allocating aerosol thread buffers", "ArWorkInit", false);
+
+  /* The threads are zeroed by calloc, so on failure ArWorkFree releases
+     whatever was allocated so far */
+  for (it = 0; it < ar_work->nthreads; it++) {
+    thread = &ar_work->thread[it];
+    for (ib = 0; ib < 3; ib++)
+      if ((thread->collect_band[ib] = (short *)malloc(nsamps * sizeof(short))) == NULL) {
+        ArWorkFree(ar_work);
+        RETURN_ERROR("allocating dark target buffer", "ArWorkInit", false);
+      }
+    if ((thread->collect_band7 = (short *)malloc(nsamps * sizeof(short))) == NULL) {
+      ArWorkFree(ar_work);
+      RETURN_ERROR("allocating dark target buffer", "ArWorkInit", false);
+    }
+    if ((thread->select_buf = (short *)malloc(nsamps * sizeof(short))) == NULL) {
+      ArWorkFree(ar_work);
+      RETURN_ERROR("allocating dark target buffer", "ArWorkInit", false);
+    }
+/**
+	Allocate memory for atmos_coef_ar struct used in filtering aot based on AC red band.
+	A region only needs the coefficients of its own grid cell, so one row
+	of the grid is enough.
+**/
+    if (allocate_mem_atmos_coeff(ar_gridcell->nbcols,&thread->atmos_coef_ar)) {
+      ArWorkFree(ar_work);
+      RETURN_ERROR("allocating atmos_coef_ar", "ArWorkInit", false);
+    }
+    thread->ar_stats.nfill = 0;
+    thread->ar_stats.first = true;
+  }
+  return true;
+}
+
+void ArWorkFree(Ar_work_t *ar_work)
+{
+  int ib, it;
+  Ar_thread_t *thread;
+
+  for (it = 0; it < ar_work->nthreads; it++) {
+    thread = &ar_work->thread[it];
+    for (ib = 0; ib < 3; ib++)
+      free(thread->collect_band[ib]);
+    free(thread->collect_band7);
+    free(thread->select_buf);
+    free_mem_atmos_coeff(&thread->atmos_coef_ar);
+  }
+  free(ar_work->thread);
+}
+
 bool Ar(int il_ar,Lut_t *lut, Img_coord_int_t *size_in, int16 ***line_in, 
         char **ddv_line, int **line_ar, int **line_ar_stats,
         Ar_stats_t *ar_stats, Ar_gridcell_t *ar_gridcell,
-        sixs_tables_t *sixs_tables) 
+        sixs_tables_t *sixs_tables, Ar_work_t *ar_work) 
+/*
+  Computes the aerosol of the regions of row il_ar.  The regions are
+  independent, so with OpenMP they are shared by the threads, each one
+  with its own buffers and statistics (ar_work).  The statistics are
+  merged in ar_stats at the end, in thread order.
+*/
+{
+  int is_ar, nb_regions, ithread, i;
+  bool status = true;
+  Ar_stats_t *thread_stats;
+
+  nb_regions = (size_in->s + lut->ar_region_size.s - 1) / lut->ar_region_size.s;
+
+  /* With DEBUG_AR the regions are run in order, for the diagnostics file */
+#if defined(_OPENMP) && !defined(DEBUG_AR)
+  #pragma omp parallel for schedule(dynamic) private(ithread) reduction(&&:status)
+#endif
+  for (is_ar = 0; is_ar < nb_regions; is_ar++) {
+#if defined(_OPENMP) && !defined(DEBUG_AR)
+    ithread = omp_get_thread_num();
+#else
+    ithread = 0;
+#endif
+    if (!ArRegion(il_ar, is_ar, lut, size_in, line_in, ddv_line, line_ar,
+        line_ar_stats, &ar_work->thread[ithread].ar_stats, ar_gridcell,
+        sixs_tables, &ar_work->thread[ithread]))
+      status = false;
+  }
+
+  for (i = 0; i < ar_work->nthreads; i++) {
+    thread_stats = &ar_work->thread[i].ar_stats;
+    ar_stats->nfill += thread_stats->nfill;
+    if (!thread_stats->first) {
+      if (ar_stats->first) {
+        ar_stats->ar_min = thread_stats->ar_min;
+        ar_stats->ar_max = thread_stats->ar_max;
+        ar_stats->first = false;
+      } else {
+        if (thread_stats->ar_min < ar_stats->ar_min)
+          ar_stats->ar_min = thread_stats->ar_min;
+        if (thread_stats->ar_max > ar_stats->ar_max)
+          ar_stats->ar_max = thread_stats->ar_max;
+      }
+    }
+    thread_stats->nfill = 0;
+    thread_stats->first = true;
+  }
+
+  if (!status)
+    RETURN_ERROR("computing the aerosol of a region", "Ar", false);
+  return true;
+}
+
+static bool ArRegion(int il_ar, int is_ar, Lut_t *lut, Img_coord_int_t *size_in,
+        int16 ***line_in, char **ddv_line, int **line_ar, int **line_ar_stats,
+        Ar_stats_t *ar_stats, Ar_gridcell_t *ar_gridcell,
+        sixs_tables_t *sixs_tables, Ar_thread_t *ar_work) 
 {
 /***
 ddv_line contains results of cloud_screening when this routine is called
@@ -42,14 +176,13 @@ bit 7 = snow
 The DDV flag in ddv_line (bit 0) is updated in this routine
 
 ***/
-  int is, il,i,j;
-  int is_ar;
+  int is, il,i;
   int is_start, is_end;
   int ib;
   double sum_band[3],sum_band_sq[3];
   double sum_srefl,sum_srefl_sq;
 /*  float rho_surf; */
-  short *collect_band[3],*collect_band7,tmp_short;
+  short *collect_band[3],*collect_band7;
   int collect_nbsamps;
   
   int nb_all_pixs,nb_water_pixs,nb_fill_pixs,nb_cld_pixs,nb_cldshadow_pixs,nb_snow_pixs;
@@ -72,27 +205,16 @@ The DDV flag in ddv_line (bit 0) is updated in this routine
 	float a_CH4_b7=0.030172, b_CH4_b7=0.79652;
 
 
-	atmos_t atmos_coef_ar;
+	atmos_t *atmos_coef_ar=&ar_work->atmos_coef_ar;
+	Ar_gridcell_t row_gridcell;
 	float rho;
 	int nb_negative_red,nb_red_obs,ipt;
 
 	for (ib=0;ib<3;ib++)
-		if ((collect_band[ib]=(short *)malloc(lut->ar_region_size.s*lut->ar_region_size.l*sizeof(short)))==NULL)
-			return false;
-	if ((collect_band7=(short *)malloc(lut->ar_region_size.s*lut->ar_region_size.l*sizeof(short)))==NULL)
-		return false;
-/**
-	Allocate memory for atmos_coef_ar struct used in filtering aot based on AC red band
-**/
-	if (allocate_mem_atmos_coeff(ar_gridcell->nbrows*ar_gridcell->nbcols,&atmos_coef_ar))
-		return false;
-
-  /* Do for each region along a line */
-
-  for (is_start = 0, is_ar = 0; 
-       is_start < size_in->s; 
-       is_start += lut->ar_region_size.s, is_ar++) {
+		collect_band[ib]=ar_work->collect_band[ib];
+	collect_band7=ar_work->collect_band7;
 
+    is_start = is_ar * lut->ar_region_size.s;
     is_end = is_start + lut->ar_region_size.s - 1;
     if (is_end >= size_in->s) is_end = size_in->s - 1;
 
@@ -222,28 +344,13 @@ exclude clouds, cloud shadow & snow pixels flagged by the internal cloud mask
 #endif
     } else {
 
+ /*		collect_nbsamps=(int)(collect_nbsamps *0.1);  Take 10% of the observations */
+		if (collect_nbsamps >= 2*AOT_MIN_NB_SAMPLES) {
+
 /**
 		Sort collected observations
 **/
-/*    printf("Sort %d obs\n",collect_nbsamps); fflush(stdout); */
-		for (i=0;i<(collect_nbsamps-1);i++) {
-			for (j=i+1;j<collect_nbsamps;j++) {
-				if (collect_band[0][j] < collect_band[0][i]) {
-					for (ib=0;ib<3;ib++) {
-						tmp_short=collect_band[ib][i];
-						collect_band[ib][i]=collect_band[ib][j];
-						collect_band[ib][j]=tmp_short;
-					}
-					tmp_short=collect_band7[i];
-					collect_band7[i]=collect_band7[j];
-					collect_band7[j]=tmp_short;
-				}
-			}
-		}
-
-
- /*		collect_nbsamps=(int)(collect_nbsamps *0.1);  Take 10% of the observations */
-		if (collect_nbsamps >= 2*AOT_MIN_NB_SAMPLES) {
+		ArSortFirst(collect_nbsamps,2*AOT_MIN_NB_SAMPLES,collect_band,collect_band7,ar_work->select_buf);
 
 /*
 		start_i=0;
@@ -354,12 +461,17 @@ printf ("DEBUG: fraction_clouds: %f (< 1e-10)\n", fraction_clouds);
 	Filter aot : Correct red band using retreived aot. if over 30% of the corrected refelctances are
     negative, reject aot.
 ***/
-		if (update_gridcell_atmos_coefs(il_ar,is_ar,&atmos_coef_ar,ar_gridcell,sixs_tables,line_ar,lut,6, 0))
+		/* atmos_coef_ar holds a single row of the grid: update it through a
+		   one-row view of ar_gridcell starting at row il_ar */
+		row_gridcell=*ar_gridcell;
+		row_gridcell.nbrows=1;
+		row_gridcell.ray=&ar_gridcell->ray[il_ar*ar_gridcell->nbcols];
+		if (update_gridcell_atmos_coefs(0,is_ar,atmos_coef_ar,&row_gridcell,sixs_tables,line_ar,lut,6, 0))
 			return false;
 		ib=2; /*  test with red band */
 		nb_red_obs=0;
 		nb_negative_red=0;
-		ipt=il_ar*lut->ar_size.s+is_ar;
+		ipt=is_ar;
     	for (il = 0; il < lut->ar_region_size.l; il++) {
       		for (is = is_start; is < (is_end + 1); is++) {
 			if (!(ddv_line[il][is]&0x08)) {
@@ -369,18 +481,18 @@ printf ("DEBUG: fraction_clouds: %f (< 1e-10)\n", fraction_clouds);
      	                        rho6=(float)line_in[il][4][is]*0.0001;
      	                        rho1=(float)line_in[il][0][is]*0.0001;
 	                        rho7 /= T_g_b7;  /* correct for water vapor and other gases*/
-     			        rho=(rho/atmos_coef_ar.tgOG[ib][ipt]-atmos_coef_ar.rho_ra[ib][ipt]);
-				rho /= (atmos_coef_ar.tgH2O[ib][ipt]*atmos_coef_ar.td_ra[ib][ipt]*atmos_coef_ar.tu_ra[ib][ipt]);
-				rho /= (1.+atmos_coef_ar.S_ra[ib][ipt]*rho);
-     			        rho4=(rho/atmos_coef_ar.tgOG[3][ipt]-atmos_coef_ar.rho_ra[3][ipt]);
-				rho4 /= (atmos_coef_ar.tgH2O[3][ipt]*atmos_coef_ar.td_ra[3][ipt]*atmos_coef_ar.tu_ra[3][ipt]);
-				rho4 /= (1.+atmos_coef_ar.S_ra[3][ipt]*rho4);
-     			        rho6=(rho/atmos_coef_ar.tgOG[4][ipt]-atmos_coef_ar.rho_ra[4][ipt]);
-				rho6 /= (atmos_coef_ar.tgH2O[4][ipt]*atmos_coef_ar.td_ra[4][ipt]*atmos_coef_ar.tu_ra[4][ipt]);
-				rho6 /= (1.+atmos_coef_ar.S_ra[4][ipt]*rho6);
-     			        rho1=(rho/atmos_coef_ar.tgOG[0][ipt]-atmos_coef_ar.rho_ra[0][ipt]);
-				rho1 /= (atmos_coef_ar.tgH2O[0][ipt]*atmos_coef_ar.td_ra[0][ipt]*atmos_coef_ar.tu_ra[0][ipt]);
-				rho1 /= (1.+atmos_coef_ar.S_ra[0][ipt]*rho1);
+     			        rho=(rho/atmos_coef_ar->tgOG[ib][ipt]-atmos_coef_ar->rho_ra[ib][ipt]);
+				rho /= (atmos_coef_ar->tgH2O[ib][ipt]*atmos_coef_ar->td_ra[ib][ipt]*atmos_coef_ar->tu_ra[ib][ipt]);
+				rho /= (1.+atmos_coef_ar->S_ra[ib][ipt]*rho);
+     			        rho4=(rho/atmos_coef_ar->tgOG[3][ipt]-atmos_coef_ar->rho_ra[3][ipt]);
+				rho4 /= (atmos_coef_ar->tgH2O[3][ipt]*atmos_coef_ar->td_ra[3][ipt]*atmos_coef_ar->tu_ra[3][ipt]);
+				rho4 /= (1.+atmos_coef_ar->S_ra[3][ipt]*rho4);
+     			        rho6=(rho/atmos_coef_ar->tgOG[4][ipt]-atmos_coef_ar->rho_ra[4][ipt]);
+				rho6 /= (atmos_coef_ar->tgH2O[4][ipt]*atmos_coef_ar->td_ra[4][ipt]*atmos_coef_ar->tu_ra[4][ipt]);
+				rho6 /= (1.+atmos_coef_ar->S_ra[4][ipt]*rho6);
+     			        rho1=(rho/atmos_coef_ar->tgOG[0][ipt]-atmos_coef_ar->rho_ra[0][ipt]);
+				rho1 /= (atmos_coef_ar->tgH2O[0][ipt]*atmos_coef_ar->td_ra[0][ipt]*atmos_coef_ar->tu_ra[0][ipt]);
+				rho1 /= (1.+atmos_coef_ar->S_ra[0][ipt]*rho1);
 				nb_red_obs++;
 			
 				if ((rho < 0.) || (rho > rho7 )) /*eric introduced that to get rid of the salt pan */
@@ -472,15 +584,86 @@ printf ("DEBUG: fraction_clouds: %f (< 1e-10)\n", fraction_clouds);
 
 	  }
     }
-  }
-	for (ib=0;ib<3;ib++)
-		free(collect_band[ib]);
-	free(collect_band7);
+  return true;
+}
 
-	if(free_mem_atmos_coeff(&atmos_coef_ar))
-		return false;
 
-  return true;
+/**
+	Puts in collect_band[*][0..k-1] the observations that the exchange sort
+	by band 1 of all the n observations would put there, in the same order
+	(including the order of ties).  Only those are used.
+
+	A pass of the exchange sort only moves the strictly decreasing chain
+	of values met from its first position, and every value larger than
+	the k-th smallest comes before any smaller one in that chain, so
+	dropping these values doesn't change the relative order of the others
+	in the first k passes.  The values are then kept in their order and
+	the first k passes of the exchange sort are run on them only.
+**/
+static void ArSortFirst(int n, int k, short **collect_band, short *collect_band7, short *select_buf) {
+	int i,j,m,ib;
+	short max_val,tmp_short;
+
+	for (i=0;i<n;i++)
+		select_buf[i]=collect_band[0][i];
+	max_val=ArSelect(select_buf,n,k-1);
+
+	m=0;
+	for (j=0;j<n;j++) {
+		if (collect_band[0][j] > max_val) continue;
+		for (ib=0;ib<3;ib++)
+			collect_band[ib][m]=collect_band[ib][j];
+		collect_band7[m]=collect_band7[j];
+		m++;
+	}
+
+	for (i=0;i<k && i<(m-1);i++) {
+		for (j=i+1;j<m;j++) {
+			if (collect_band[0][j] < collect_band[0][i]) {
+				for (ib=0;ib<3;ib++) {
+					tmp_short=collect_band[ib][i];
+					collect_band[ib][i]=collect_band[ib][j];
+					collect_band[ib][j]=tmp_short;
+				}
+				tmp_short=collect_band7[i];
+				collect_band7[i]=collect_band7[j];
+				collect_band7[j]=tmp_short;
+			}
+		}
+	}
+}
+
+/* Returns the k-th smallest (from 0) of the n values of a, which are
+   reordered (quickselect) */
+static short ArSelect(short *a, int n, int k) {
+	int lo,hi,i,j;
+	short pivot,tmp_short;
+
+	lo=0;
+	hi=n-1;
+	while (lo<hi) {
+		pivot=a[lo+(hi-lo)/2];
+		i=lo;
+		j=hi;
+		while (i<=j) {
+			while (a[i]<pivot) i++;
+			while (a[j]>pivot) j--;
+			if (i<=j) {
+				tmp_short=a[i];
+				a[i]=a[j];
+				a[j]=tmp_short;
+				i++;
+				j--;
+			}
+		}
+		if (k<=j)
+			hi=j;
+		else if (k>=i)
+			lo=i;
+		else
+			break;
+	}
+	return a[k];
 }
 
 
@@ -773,19 +956,16 @@ Original version: Thu Dec  7 15:46:05 EST 1995
 
 
 !Design Notes:   
+Missing cells with at least 3 valid cells within 3 grid points are filled
+by passes of the gap filling engine (gapfill.c), until a pass fills
+nothing; the gaps left are set to 60.
 !END****************************************************************************
 */
-   int i,j,k,l,count,last_value,More_Gaps,nbfills;
-   float dist,sum_value,sum_dist;
-   char **missing_flag,*missing_flag_array;
-   int min_nb_values,n,max_distance;
-
-	if ((missing_flag_array=(char *)calloc(lut->ar_size.l*lut->ar_size.s,sizeof(char)))==NULL)
-		return 0;
-	if ((missing_flag=(char **)calloc(lut->ar_size.l,sizeof(char *)))==NULL)
-		return 0;
-	for (i=0;i<lut->ar_size.l;i++)
-		missing_flag[i]=&missing_flag_array[i*lut->ar_size.s];
+   int i,j,count,last_value;
+   gapfill_t gf;
+   float *value;
+   unsigned char *valid;
+   
 /**
 Start by counting valid values
 if nb gaps = 0 do nothing
@@ -809,70 +989,37 @@ if nb gaps = 1 duplicate value everywhere
 			}
 		return 0;
 	}
- 	More_Gaps=1;
-	nbfills=1;
-	while ((More_Gaps)&&(nbfills != 0)) {
- 		More_Gaps=0;
-                nbfills=0;
-		for (i=0;i<lut->ar_size.l;i++) {
-			for (j=0;j<lut->ar_size.s;j++) {
-				missing_flag[i][j]=0;
-				if (line_ar[i][ib][j]==lut->aerosol_fill)  {
-					missing_flag[i][j]=1;
-					More_Gaps=1;
-				}
-			}
+
+	if (allocate_gapfill(&gf,lut->ar_size.l,lut->ar_size.s,1,3))
+		return -1;
+	value=(float *)malloc(lut->ar_size.l*lut->ar_size.s*sizeof(float));
+	valid=(unsigned char *)malloc(lut->ar_size.l*lut->ar_size.s);
+	if (value==NULL || valid==NULL) {
+		free(value);
+		free(valid);
+		free_gapfill(&gf);
+		return -1;
+	}
+	for (i=0;i<lut->ar_size.l;i++) {
+		for (j=0;j<lut->ar_size.s;j++) {
+			value[i*lut->ar_size.s+j]=line_ar[i][ib][j];
+			valid[i*lut->ar_size.s+j]=(line_ar[i][ib][j] != lut->aerosol_fill);
 		}
-		if (More_Gaps) {
-	
-			for (i=0;i<lut->ar_size.l;i++) {
-				for (j=0;j<lut->ar_size.s;j++) {
+	}
 
 /**
-Look for at least 3 neighboring valid values within 4 GPs
-smooth
+Look for at least 3 neighboring valid values within 3 GPs
 **/
-					min_nb_values=3;
-					max_distance=3;	
-					if (missing_flag[i][j]) {
-						sum_dist=0.;
-						sum_value=0.;
-						n=0;
-						for (k=i-max_distance;k<=(i+max_distance);k++) {
-							if ((k>=0)&&(k<lut->ar_size.l)) {
-								for (l=j-max_distance;l<=(j+max_distance);l++) {
-									if ((l>=0)&&(l<lut->ar_size.s)) {
-										if (!missing_flag[k][l]) {
-											dist=sqrt((k-i)*(k-i)+(l-j)*(l-j));
-											sum_dist += dist;
-											sum_value += (dist*line_ar[k][ib][l]);
-											n++;
-										}
-									}
-								}
-							}
-						}
-						if ((n>=min_nb_values)&&(sum_dist!=0.)) {
-/*						printf("Gaps in %d %d  band %d was filled \n",i,j,ib); */
-							line_ar[i][ib][j]=sum_value/sum_dist;
-							nbfills=nbfills+1;
-						}
-						else
-						{
-/*						printf("Gaps in %d %d  band %d was NOT filled \n",i,j,ib);*/
-						}
-					}
-				}
-			}
-		}
- 	}
-	if ((More_Gaps)&&(nbfills == 0)) {
+	gapfill_iterate(&gf,&value,valid,3,3,1);
+
 	for (i=0;i<lut->ar_size.l;i++) {
 		for (j=0;j<lut->ar_size.s;j++) {
-			if (line_ar[i][ib][j] == lut->aerosol_fill)  line_ar[i][ib][j]=60;
-			}
-			}
-			}
-	   
- 	return 0;
+			if (line_ar[i][ib][j] == lut->aerosol_fill)
+				line_ar[i][ib][j]=valid[i*lut->ar_size.s+j]?(int)value[i*lut->ar_size.s+j]:60;
+		}
+	}
+	free(value);
+	free(valid);
+	free_gapfill(&gf);
+	return 0;
 }
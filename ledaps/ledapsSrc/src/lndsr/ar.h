@@ -13,10 +13,29 @@ typedef struct {
   long nfill;
 } Ar_stats_t;
 
+/* Buffers of a thread of the aerosol retrieval */
+typedef struct {
+  short *collect_band[3];  /* Dark target observations of a region, bands
+                              1 to 3 */
+  short *collect_band7;    /* Band 7 surface reflectance of the
+                              observations */
+  short *select_buf;       /* Work buffer for the band 1 order statistic */
+  atmos_t atmos_coef_ar;   /* Coefficients used to filter the AOT */
+  Ar_stats_t ar_stats;     /* Statistics of the regions done by the
+                              thread */
+} Ar_thread_t;
+
+typedef struct {
+  int nthreads;            /* Number of threads */
+  Ar_thread_t *thread;     /* Buffers of each thread */
+} Ar_work_t;
+
 bool Ar(int il_ar,Lut_t *lut, Img_coord_int_t *size_in, int16 ***line_in,
         char **ddv_line, int **line_ar, int **line_ar_stats,
         Ar_stats_t *ar_stats, Ar_gridcell_t *ar_gridcell,
-        sixs_tables_t *sixs_tables);
+        sixs_tables_t *sixs_tables, Ar_work_t *ar_work);
+bool ArWorkInit(Lut_t *lut, Ar_gridcell_t *ar_gridcell, Ar_work_t *ar_work);
+void ArWorkFree(Ar_work_t *ar_work);
 
 int ArInterp(Lut_t *lut, Img_coord_int_t *loc, int ***line_ar, int *inter_aot);
 int Fill_Ar_Gaps(Lut_t *lut, int ***line_ar, int ib);
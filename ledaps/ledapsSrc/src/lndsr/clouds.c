@@ -3,6 +3,8 @@
 #include "error.h"
 #include "sixs_runs.h"
 #include "clouds.h"
+#include "dilate.h"
+#include "gapfill.h"
 
 /****************************************************************************
 History:
@@ -20,110 +22,147 @@ Modified on 2/5/2014 by Gail Schmidt, USGS/EROS
 
 extern atmos_t atmos_coef;
 
-int allocate_mem_atmos_coeff(int nbpts,atmos_t *atmos_coef);
-int free_mem_atmos_coeff(atmos_t *atmos_coef);
-int SrInterpAtmCoef(Lut_t *lut, Img_coord_int_t *input_loc, atmos_t *atmos_coef,atmos_t *interpol_atmos_coef);
+/* Threshold of band 6 for snow (and possibly salt pan) */
+#define TEMP_SNOW_THSHLD 380.
 
-bool cloud_detection_pass1(Lut_t *lut, int nsamp, int il, int16 **line_in, uint8 *qa_line, int16 *b6_line, float *atemp_line, cld_diags_t *cld_diags) {
+int allocate_cld_line(Lut_t *lut, int nsamp, cld_line_t *cld_line) {
+	int ib;
+	float *buf;
+	if (!SrInterpInit(lut, nsamp, &cld_line->interp))
+		return -1;
+	if ((cld_line->buf=(float *)calloc((size_t)(NBAND_REFL_MAX+2)*nsamp,sizeof(float)))==NULL) {
+		SrInterpFree(&cld_line->interp);
+		return -1;
+	}
+	buf=cld_line->buf;
+	for (ib=0;ib<NBAND_REFL_MAX;ib++,buf+=nsamp)
+		cld_line->rho[ib]=buf;
+	cld_line->thshld1=buf;
+	cld_line->thshld2=buf+nsamp;
+	return 0;
+}
 
+void free_cld_line(cld_line_t *cld_line) {
+	SrInterpFree(&cld_line->interp);
+	free(cld_line->buf);
+	cld_line->buf=NULL;
+}
+
+static void cld_rho_line(Sr_interp_t *interp, int ib, int nsamp, int16 *line_in, float *rho) {
+/* Corrects band ib of a line with the interpolated coefficients, with the
+   same mix of float and double as the per-pixel code had; the loop has no
+   branches so it vectorizes (see VECT_OPTIONS in the Makefile) */
 	int is;
-	bool is_fill;
-	Img_coord_int_t loc;
-	float tmpflt;
-	float rho1,rho3,rho4,rho5,rho7,t6;
-	atmos_t interpol_atmos_coef;
-   	int C1,C1p,C2=0,C2p,C3,C3p,C4=0,C5=0,water;
-	int cld_row,cld_col;
-   float vra,ndvi;
+	float r,tmpflt;
+	const float *tgOG=interp->tgOG[ib];
+	const float *tgH2O=interp->tgH2O[ib];
+	const float *td_ra=interp->td_ra[ib];
+	const float *tu_ra=interp->tu_ra[ib];
+	const float *rho_ra=interp->rho_ra[ib];
+	const float *S_ra=interp->S_ra[ib];
+
+	for (is=0;is<nsamp;is++) {
+		r=line_in[is]*0.0001;
+		r=(r/tgOG[is]-rho_ra[is]);
+		tmpflt=(tgH2O[is]*td_ra[is]*tu_ra[is]);
+		r /= tmpflt;
+		r /= (1.+S_ra[is]*r);
+		rho[is]=r;
+	}
+}
 
-	allocate_mem_atmos_coeff(1,&interpol_atmos_coef);
-  	loc.l = il;
-	cld_row=il/cld_diags->cellheight;
+bool cloud_detection_pass1(Lut_t *lut, cld_line_t *cld_line, int nsamp, int il, int16 **line_in, uint8 *qa_line, int16 *b6_line, float *atemp_line, uint8 *clear_line, float *rho7_line) {
+/**
+flag the clear land pixels of line il used for the clear sky statistics
+(clear_line) and give their band 7 reflectance (rho7_line); the statistics
+are accumulated by update_cld_diags
+**/
+	int is;
+	float rho1,rho3,rho4,rho5,rho7,t6;
+	int valid,C1,C2,C3,C4,C5,water,nz;
+	float vra,ndvi,tmpflt,denom;
+	const int is_tm=(lut->meta.inst==INST_TM);
+	const float *r1=cld_line->rho[0],*r3=cld_line->rho[2],*r4=cld_line->rho[3];
+	const float *r5=cld_line->rho[4],*r7=cld_line->rho[5];
+	const int16 *b3=line_in[2];
+
+	if (!SrInterpLine(lut, il, &atmos_coef, &cld_line->interp))
+		RETURN_ERROR("interpolating the atmospheric coefficients", "cloud_detection_pass1", false);
+	cld_rho_line(&cld_line->interp, 0, nsamp, line_in[0], cld_line->rho[0]);
+	cld_rho_line(&cld_line->interp, 2, nsamp, line_in[2], cld_line->rho[2]);
+	cld_rho_line(&cld_line->interp, 3, nsamp, line_in[3], cld_line->rho[3]);
+	cld_rho_line(&cld_line->interp, 4, nsamp, line_in[4], cld_line->rho[4]);
+	cld_rho_line(&cld_line->interp, 5, nsamp, line_in[5], cld_line->rho[5]);
 
 	for (is = 0; is < nsamp; is++) {
-    	loc.s = is;
-		cld_col=is/cld_diags->cellwidth;
-
-		if ((qa_line[is]&0x01)==0x01)
-			is_fill=true;
-		else
-			is_fill=false;
-		if (! is_fill) {
-		  if (((qa_line[is]&0x08)==0x00)||((lut->meta.inst==INST_TM)&&(line_in[2][is]<5000))) { /* no saturation in band 3 */
-	 		SrInterpAtmCoef(lut, &loc, &atmos_coef, &interpol_atmos_coef);
-			
-	 		rho1=line_in[0][is]*0.0001;
-      		rho1=(rho1/interpol_atmos_coef.tgOG[0][0]-interpol_atmos_coef.rho_ra[0][0]);
-			tmpflt=(interpol_atmos_coef.tgH2O[0][0]*interpol_atmos_coef.td_ra[0][0]*interpol_atmos_coef.tu_ra[0][0]);
-			rho1 /= tmpflt;
-			rho1 /= (1.+interpol_atmos_coef.S_ra[0][0]*rho1);
-	 		rho3=line_in[2][is]*0.0001;
-      		rho3=(rho3/interpol_atmos_coef.tgOG[2][0]-interpol_atmos_coef.rho_ra[2][0]);
-			tmpflt=(interpol_atmos_coef.tgH2O[2][0]*interpol_atmos_coef.td_ra[2][0]*interpol_atmos_coef.tu_ra[2][0]);
-			rho3 /= tmpflt;
-			rho3 /= (1.+interpol_atmos_coef.S_ra[2][0]*rho3);
-	 		rho4=line_in[3][is]*0.0001;
-      		rho4=(rho4/interpol_atmos_coef.tgOG[3][0]-interpol_atmos_coef.rho_ra[3][0]);
-			tmpflt=(interpol_atmos_coef.tgH2O[3][0]*interpol_atmos_coef.td_ra[3][0]*interpol_atmos_coef.tu_ra[3][0]);
-			rho4 /= tmpflt;
-			rho4 /= (1.+interpol_atmos_coef.S_ra[3][0]*rho4);
-	 		rho5=line_in[4][is]*0.0001;
-      		rho5=(rho5/interpol_atmos_coef.tgOG[4][0]-interpol_atmos_coef.rho_ra[4][0]);
-			tmpflt=(interpol_atmos_coef.tgH2O[4][0]*interpol_atmos_coef.td_ra[4][0]*interpol_atmos_coef.tu_ra[4][0]);
-			rho5 /= tmpflt;
-			rho5 /= (1.+interpol_atmos_coef.S_ra[4][0]*rho5);
-	 		rho7=line_in[5][is]*0.0001;
-      		rho7=(rho7/interpol_atmos_coef.tgOG[5][0]-interpol_atmos_coef.rho_ra[5][0]);
-			tmpflt=(interpol_atmos_coef.tgH2O[5][0]*interpol_atmos_coef.td_ra[5][0]*interpol_atmos_coef.tu_ra[5][0]);
-			rho7 /= tmpflt;
-			rho7 /= (1.+interpol_atmos_coef.S_ra[5][0]*rho7);
-			t6=b6_line[is]*0.1;
-
-			vra=rho1-rho3/2;
+		/* not fill and no saturation in band 3 */
+		valid=((qa_line[is]&0x01)==0x00)&(((qa_line[is]&0x08)==0x00)|(is_tm&(b3[is]<5000)));
+
+		rho1=r1[is];
+		rho3=r3[is];
+		rho4=r4[is];
+		rho5=r5[is];
+		rho7=r7[is];
+		t6=b6_line[is]*0.1;
+
+		vra=rho1-rho3/2;
+		C1=(vra>VRA_THRESHOLD);
+		C2=(t6 < (atemp_line[is]-7.));  
+		tmpflt=rho4/rho3;
+		C3=(tmpflt>=0.9)&(tmpflt<=1.3);
+		C4=(rho7 > 0.03);
+		C5=(rho3 > 0.6)|(rho4 > 0.6);
 					
-			C1=(int)(vra>VRA_THRESHOLD);
-			C1p=!C1;
-			C2=(t6 < (atemp_line[is]-7.));  
-			C2p=(t6 > (atemp_line[is]-7.));
-   
-			tmpflt=rho4/rho3;
-			C3=((tmpflt>=0.9)&&(tmpflt<=1.3));
-			C3p=!C3;
+/**
+		Water test :
+		ndvi < 0 => water
+		((0<ndvi<0.1) or (b4<5%)) and b5 < 0.01 => turbid water
+**/
+		denom=rho4+rho3;
+		ndvi=(rho4-rho3)/denom; /* taken as 0.01 where denom is 0 */
+		nz=(denom != 0);
+		water=(nz&(ndvi < 0))|((((!nz)|((ndvi>0)&(ndvi<0.1)))|(rho4<0.05))&(rho5<0.02));
 
-			C4=(rho7 > 0.03);
+		clear_line[is]=valid&(!water)&(t6 > (atemp_line[is]-20.))&(!C5)&(!((C1|C3)&C2&C4));
+		rho7_line[is]=rho7;
+	}
+	return true;
+}
 
-			C5=((rho3 > 0.6)||(rho4 > 0.6));
-					
+void update_cld_diags(cld_diags_t *cld_diags, int il_start, int nlines, int nsamp, int16 **b6_line, uint8 **clear_line, float **rho7_line) {
 /**
-			Water test :
-			ndvi < 0 => water
-			((0<ndvi<0.1) or (b4<5%)) and b5 < 0.01 => turbid water
+add the clear pixels of lines il_start to il_start+nlines-1 to the sums of
+the clear sky statistics. The cells are shared out between the threads,
+each one adding the pixels of its cells in line order, so the sums don't
+depend on the number of threads.
 **/
-			if ((rho4+rho3) != 0)
-				ndvi=(rho4-rho3)/(rho4+rho3);
-			else
-				ndvi=0.01;
-			water=(ndvi < 0)||((((ndvi>0)&&(ndvi<0.1))||(rho4<0.05))&&(rho5<0.02));
-
-			if (!water) { /* if not water */
-				if ((t6 > (atemp_line[is]-20.)) && (!C5)) { 
-					if (!((C1||C3)&&C2&&C4)) { /* clear */
-						cld_diags->avg_t6_clear[cld_row][cld_col] += t6;
-						cld_diags->std_t6_clear[cld_row][cld_col] += (t6*t6);
-						cld_diags->avg_b7_clear[cld_row][cld_col] += rho7;
-						cld_diags->std_b7_clear[cld_row][cld_col] += (rho7*rho7);
-						cld_diags->nb_t6_clear[cld_row][cld_col] ++;
-					}
-				} 
+	int cld_row,cld_col,j,is,is_end;
+	float t6,rho7;
+
+#ifdef _OPENMP
+	#pragma omp parallel for schedule(static) private(cld_row,j,is,is_end,t6,rho7)
+#endif
+	for (cld_col=0;cld_col<cld_diags->nbcols;cld_col++) {
+		is_end=(cld_col+1)*cld_diags->cellwidth;
+		if (is_end > nsamp)
+			is_end=nsamp;
+		for (j=0;j<nlines;j++) {
+			cld_row=(il_start+j)/cld_diags->cellheight;
+			for (is=cld_col*cld_diags->cellwidth;is<is_end;is++) {
+				if (!clear_line[j][is]) continue;
+				t6=b6_line[j][is]*0.1;
+				rho7=rho7_line[j][is];
+				cld_diags->avg_t6_clear[cld_row][cld_col] += t6;
+				cld_diags->std_t6_clear[cld_row][cld_col] += (t6*t6);
+				cld_diags->avg_b7_clear[cld_row][cld_col] += rho7;
+				cld_diags->std_b7_clear[cld_row][cld_col] += (rho7*rho7);
+				cld_diags->nb_t6_clear[cld_row][cld_col] ++;
 			}
-		  } 
-		} 
+		}
 	}
-	free_mem_atmos_coeff(&interpol_atmos_coef);
-	return true;
 }
 
-bool cloud_detection_pass2(Lut_t *lut, int nsamp, int il, int16 **line_in, uint8 *qa_line, int16 *b6_line, cld_diags_t *cld_diags, char *ddv_line) {
+bool cloud_detection_pass2(Lut_t *lut, cld_line_t *cld_line, int nsamp, int il, int16 **line_in, uint8 *qa_line, int16 *b6_line, cld_diags_t *cld_diags, char *ddv_line) {
 
 /**
 use ddv_line to store internal cloud screening info
@@ -133,192 +172,119 @@ bit 4 = land/water mask 1=land 0=water
 bit 5 = cloud 0=clear 1=cloudy
 bit 6 = cloud shadow 
 bit 7 = snow
+
+The thermal thresholds are set first for the line, then the tests are
+applied to every pixel as mask arithmetic and the result is selected from
+the fill, saturated band 3 and unsaturated cases.
 **/
-	int is;
-	int il_ar,is_ar;
-	bool is_fill, thermal_band;
-	Img_coord_int_t loc;
-	float rho1,rho2,rho3,rho4,rho5,rho7,t6;
-	atmos_t interpol_atmos_coef;
-   	int C1,C1p,C2,C2p,C3,C3p,C4,C5,water;
+	int is,ib;
+	int ddv,ddv0,land,res_sat,res_unsat,is_fill,is_sat3,is_sat5;
+	int C1,C2,C4,C5,water,cloudy,snow,nz;
 	int cld_row,cld_col;
-	float vra,ndvi,ndsi,temp_snow_thshld;
-	float temp_b6_clear,temp_thshld1,temp_thshld2,avg_b7_clear,atemp_ancillary;
-	float tmpflt,tmpflt_arr[10];
-
-	thermal_band=true;
-	if (b6_line == NULL) 
-		thermal_band=false;
-	temp_snow_thshld=380.; /* now flag snow and possibly salt pan */
-	allocate_mem_atmos_coeff(1,&interpol_atmos_coef);
-  	loc.l = il;
+	float rho1,rho2,rho3,rho4,rho5,rho7,t6;
+	float vra,ndvi,ndsi,denom;
+	float temp_b6_clear,atemp_ancillary,tmpflt_arr[10];
+	cld_diags_row_t row;
+	float *thshld1=cld_line->thshld1,*thshld2=cld_line->thshld2;
+	const float *r1=cld_line->rho[0],*r2=cld_line->rho[1],*r3=cld_line->rho[2];
+	const float *r4=cld_line->rho[3],*r5=cld_line->rho[4],*r7=cld_line->rho[5];
+	const int16 *b3=line_in[2],*b5=line_in[4];
+	const int is_tm=(lut->meta.inst==INST_TM);
+	const int in_fill=lut->in_fill;
+
+	if (!SrInterpLine(lut, il, &atmos_coef, &cld_line->interp))
+		RETURN_ERROR("interpolating the atmospheric coefficients", "cloud_detection_pass2", false);
+	for (ib=0;ib<6;ib++)
+		cld_rho_line(&cld_line->interp, ib, nsamp, line_in[ib], cld_line->rho[ib]);
+
+	if (b6_line == NULL) { /* no thermal band - cannot run cloud mask */
+		for (is = 0; is < nsamp; is++) {
+			ddv0=ddv_line[is]&0x44; /* reset all bits except cloud shadow and adjacent cloud */ 
+			is_fill=((qa_line[is]&0x01)==0x01);
+			is_sat3=((qa_line[is]&0x08)==0x08)|(is_tm&(b3[is]>=5000));
+			rho3=r3[is];
+			rho4=r4[is];
+			rho5=r5[is];
+			denom=rho4+rho3;
+			ndvi=(rho4-rho3)/denom; /* taken as 0.01 where denom is 0 */
+			nz=(denom != 0);
+			water=(nz&(ndvi < 0))|((((!nz)|((ndvi>0)&(ndvi<0.1)))|(rho4<0.05))&(rho5<0.02));
+			res_unsat=ddv0&0xdf; /* assume clear */
+			res_unsat=water?(res_unsat&0xef):(res_unsat|0x10);
+			ddv=is_sat3?ddv0:res_unsat;
+			ddv_line[is]=(char)(is_fill?0x08:ddv);
+		}
+		return true;
+	}
+
+	/* thermal thresholds from the clear sky statistics */
 	cld_row=il/cld_diags->cellheight;
-	il_ar=il/lut->ar_region_size.l;
-	if (il_ar >= lut->ar_size.l)
-		il_ar=lut->ar_size.l-1;
+	clddiags_row(cld_diags, il, &row);
 	for (is = 0; is < nsamp; is++) {
-    	loc.s = is;
+		thshld1[is]=thshld2[is]=0.;
+		if ((b6_line[is] == in_fill)||((qa_line[is]&0x01)==0x01))
+			continue;
 		cld_col=is/cld_diags->cellwidth;
-		is_ar=is/lut->ar_region_size.s;
-		if (is_ar >= lut->ar_size.s)
-			is_ar=lut->ar_size.s-1;
-
-		is_fill=false;
-		if (thermal_band) {
-			if (b6_line[is]== lut->in_fill) {
-				is_fill=true;
-				ddv_line[is] = 0x08;
-			}
-		}
-
-		if ((qa_line[is]&0x01)==0x01) {
-			is_fill=true;
-			ddv_line[is] = 0x08;
-		}
-		if (! is_fill) {
-			ddv_line[is] &= 0x44; /* reset all bits except cloud shadow and adjacent cloud */ 
-
-		  if (((qa_line[is]&0x08)==0x08)||((lut->meta.inst==INST_TM)&&(line_in[2][is]>=5000))) {  /* saturated band 3 */
-			if (thermal_band) {
-				t6=b6_line[is]*0.1;
-
-				interpol_clddiags_1pixel(cld_diags, il,is,tmpflt_arr);
-				temp_b6_clear=tmpflt_arr[0];
-				avg_b7_clear=tmpflt_arr[1];
-				atemp_ancillary=tmpflt_arr[2];
-			    if (temp_b6_clear < 0.) {
-					temp_thshld1=atemp_ancillary-20.;
-					temp_thshld2=atemp_ancillary-20.;
-				} else {
-					if (cld_diags->std_t6_clear[cld_row][cld_col] > 0.) {
-						temp_thshld1=temp_b6_clear-(cld_diags->std_t6_clear[cld_row][cld_col]+4.);
-						temp_thshld2=temp_b6_clear-(cld_diags->std_t6_clear[cld_row][cld_col]);
-					} else {
-						temp_thshld1=temp_b6_clear-4.;
-						temp_thshld2=temp_b6_clear-2.;
-					}
-				}
-		    	if ((((qa_line[is]&0x20)==0x20)||((lut->meta.inst==INST_TM)&&(line_in[4][is]>=5000)))&&(t6 < temp_thshld1)) {  /* saturated band 5 and t6 < threshold => cloudy */
-					ddv_line[is] &= 0xbf; /* reset shadow bit */
-					ddv_line[is] &= 0xfb; /* reset adjacent cloud bit */
-					ddv_line[is] |= 0x20; /* set cloud bit */
-				} else if ((line_in[4][is]<2000)&&(t6 < temp_snow_thshld)) { /* snow */
-					ddv_line[is] |= 0x80;
-				} else { /* assume cloudy */
-					ddv_line[is] &= 0xbf; /* reset shadow bit */
-					ddv_line[is] &= 0xfb; /* reset adjacent cloud bit */
-					ddv_line[is] |= 0x20; /* set cloud bit */
-				}
-			}
-		  } else {
-	 		SrInterpAtmCoef(lut, &loc, &atmos_coef, &interpol_atmos_coef);
-			
-	 		rho1=line_in[0][is]*0.0001;
-      		rho1=(rho1/interpol_atmos_coef.tgOG[0][0]-interpol_atmos_coef.rho_ra[0][0]);
-			tmpflt=(interpol_atmos_coef.tgH2O[0][0]*interpol_atmos_coef.td_ra[0][0]*interpol_atmos_coef.tu_ra[0][0]);
-			rho1 /= tmpflt;
-			rho1 /= (1.+interpol_atmos_coef.S_ra[0][0]*rho1);
-	 		rho2=line_in[1][is]*0.0001;
-      		rho2=(rho2/interpol_atmos_coef.tgOG[1][0]-interpol_atmos_coef.rho_ra[1][0]);
-			tmpflt=(interpol_atmos_coef.tgH2O[1][0]*interpol_atmos_coef.td_ra[1][0]*interpol_atmos_coef.tu_ra[1][0]);
-			rho2 /= tmpflt;
-			rho2 /= (1.+interpol_atmos_coef.S_ra[1][0]*rho2);
-	 		rho3=line_in[2][is]*0.0001;
-      		rho3=(rho3/interpol_atmos_coef.tgOG[2][0]-interpol_atmos_coef.rho_ra[2][0]);
-			tmpflt=(interpol_atmos_coef.tgH2O[2][0]*interpol_atmos_coef.td_ra[2][0]*interpol_atmos_coef.tu_ra[2][0]);
-			rho3 /= tmpflt;
-			rho3 /= (1.+interpol_atmos_coef.S_ra[2][0]*rho3);
-	 		rho4=line_in[3][is]*0.0001;
-      		rho4=(rho4/interpol_atmos_coef.tgOG[3][0]-interpol_atmos_coef.rho_ra[3][0]);
-			tmpflt=(interpol_atmos_coef.tgH2O[3][0]*interpol_atmos_coef.td_ra[3][0]*interpol_atmos_coef.tu_ra[3][0]);
-			rho4 /= tmpflt;
-			rho4 /= (1.+interpol_atmos_coef.S_ra[3][0]*rho4);
-	 		rho5=line_in[4][is]*0.0001;
-      		rho5=(rho5/interpol_atmos_coef.tgOG[4][0]-interpol_atmos_coef.rho_ra[4][0]);
-			tmpflt=(interpol_atmos_coef.tgH2O[4][0]*interpol_atmos_coef.td_ra[4][0]*interpol_atmos_coef.tu_ra[4][0]);
-			rho5 /= tmpflt;
-			rho5 /= (1.+interpol_atmos_coef.S_ra[4][0]*rho5);
-	 		rho7=line_in[5][is]*0.0001;
-      		rho7=(rho7/interpol_atmos_coef.tgOG[5][0]-interpol_atmos_coef.rho_ra[5][0]);
-			tmpflt=(interpol_atmos_coef.tgH2O[5][0]*interpol_atmos_coef.td_ra[5][0]*interpol_atmos_coef.tu_ra[5][0]);
-			rho7 /= tmpflt;
-			rho7 /= (1.+interpol_atmos_coef.S_ra[5][0]*rho7);
-			if (thermal_band)
-				t6=b6_line[is]*0.1;
-
-			interpol_clddiags_1pixel(cld_diags, il,is,tmpflt_arr);
-			temp_b6_clear=tmpflt_arr[0];
-			avg_b7_clear=tmpflt_arr[1];
-			atemp_ancillary=tmpflt_arr[2];
-
-			if (temp_b6_clear < 0.) {
-				temp_thshld1=atemp_ancillary-20.;
-				temp_thshld2=atemp_ancillary-20.;
+		interpol_clddiags_row(cld_diags, &row, is, tmpflt_arr);
+		temp_b6_clear=tmpflt_arr[0];
+		atemp_ancillary=tmpflt_arr[2];
+		if (temp_b6_clear < 0.) {
+			thshld1[is]=atemp_ancillary-20.;
+			thshld2[is]=atemp_ancillary-20.;
+		} else {
+			if (cld_diags->std_t6_clear[cld_row][cld_col] > 0.) {
+				thshld1[is]=temp_b6_clear-(cld_diags->std_t6_clear[cld_row][cld_col]+4.);
+				thshld2[is]=temp_b6_clear-(cld_diags->std_t6_clear[cld_row][cld_col]);
 			} else {
-				if (cld_diags->std_t6_clear[cld_row][cld_col] > 0.) {
-					temp_thshld1=temp_b6_clear-(cld_diags->std_t6_clear[cld_row][cld_col]+4.);
-					temp_thshld2=temp_b6_clear-(cld_diags->std_t6_clear[cld_row][cld_col]);
-				} else {
-					temp_thshld1=temp_b6_clear-4.;
-					temp_thshld2=temp_b6_clear-2.;
-				}
+				thshld1[is]=temp_b6_clear-4.;
+				thshld2[is]=temp_b6_clear-2.;
 			}
+		}
+	}
 
-			if (thermal_band) {
-				vra=rho1-rho3/2.;
-					
-				C1=(int)(vra>VRA_THRESHOLD);
-				C1p=!C1;
-					
-           		C2=(t6 < temp_thshld1);  
-            	C2p=(t6 > temp_thshld1);
-   
-				tmpflt=rho4/rho3;
-				C3=((tmpflt>=0.9)&&(tmpflt<=1.2));
-				C3p=!C3;
-
-				C4=(rho7 > 0.03);
-
-            	C5=(t6 < temp_thshld2)&&C1;
-			}
-					
+	for (is = 0; is < nsamp; is++) {
+		ddv0=ddv_line[is]&0x44; /* reset all bits except cloud shadow and adjacent cloud */ 
+		is_fill=(b6_line[is] == in_fill)|((qa_line[is]&0x01)==0x01);
+		is_sat3=((qa_line[is]&0x08)==0x08)|(is_tm&(b3[is]>=5000));
+		t6=b6_line[is]*0.1;
+
+		/* saturated band 3: saturated band 5 and t6 < threshold => cloudy,
+		   else snow if band 5 is dark and cold enough, else cloudy */
+		is_sat5=((qa_line[is]&0x20)==0x20)|(is_tm&(b5[is]>=5000));
+		snow=(!(is_sat5&(t6 < thshld1[is])))&(b5[is]<2000)&(t6 < TEMP_SNOW_THSHLD);
+		res_sat=snow?(ddv0|0x80):((ddv0&0xbb)|0x20);
+
+		/* not saturated: cloud, snow and water tests */
+		rho1=r1[is];
+		rho2=r2[is];
+		rho3=r3[is];
+		rho4=r4[is];
+		rho5=r5[is];
+		rho7=r7[is];
+		vra=rho1-rho3/2.;
+		C1=(vra>VRA_THRESHOLD);
+		C2=(t6 < thshld1[is]);  
+		C4=(rho7 > 0.03);
+		C5=(t6 < thshld2[is])&C1;
 /**
-			Water test :
-			ndvi < 0 => water
-			((0<ndvi<0.1) or (b4<5%)) and b5 < 0.01 => turbid water
+		Water test :
+		ndvi < 0 => water
+		((0<ndvi<0.1) or (b4<5%)) and b5 < 0.01 => turbid water
 **/
-			if ((rho4+rho3) != 0)
-				ndvi=(rho4-rho3)/(rho4+rho3);
-			else
-				ndvi=0.01;
-			water=(ndvi < 0)||((((ndvi>0)&&(ndvi<0.1))||(rho4<0.05))&&(rho5<0.02));
-			if (thermal_band) {
-			if (!water) { /* if not water */
-				ddv_line[is] |= 0x10;
-				if ((C2||C5)&&C4) { /* cloudy */
-					ddv_line[is] &= 0xbf; /* reset shadow bit */
-					ddv_line[is] &= 0xfb; /* reset adjacent cloud bit */
-					ddv_line[is] |= 0x20; /* set cloud bit */
-				} else { /* clear */
-					ddv_line[is] &= 0xdf;
-					ndsi=(rho2-rho5)/(rho2+rho5);
-					if ((ndsi > 0.3)&&(t6 < temp_snow_thshld)&&(rho4 > 0.2))
-						ddv_line[is] |= 0x80;
-				}
-			} else 
-				ddv_line[is] &= 0xef; 
-			} else { /* no thermal band - cannot run cloud mask */
-				ddv_line[is] &= 0xdf; /* assume clear */
-				if (!water) { /* if not water */
-					ddv_line[is] |= 0x10;
-				} else {
-					ddv_line[is] &= 0xef; 
-				}
-			}
-		  }
-		} 
+		denom=rho4+rho3;
+		ndvi=(rho4-rho3)/denom; /* taken as 0.01 where denom is 0 */
+		nz=(denom != 0);
+		water=(nz&(ndvi < 0))|((((!nz)|((ndvi>0)&(ndvi<0.1)))|(rho4<0.05))&(rho5<0.02));
+		cloudy=(C2|C5)&C4;
+		ndsi=(rho2-rho5)/(rho2+rho5);
+		snow=(ndsi > 0.3)&(t6 < TEMP_SNOW_THSHLD)&(rho4 > 0.2);
+		land=ddv0|0x10;
+		res_unsat=cloudy?((land&0xbb)|0x20):((land&0xdf)|(snow?0x80:0));
+		res_unsat=water?(ddv0&0xef):res_unsat;
+
+		ddv=is_sat3?res_sat:res_unsat;
+		ddv_line[is]=(char)(is_fill?0x08:ddv);
 	}
-	free_mem_atmos_coeff(&interpol_atmos_coef);
 	return true;
 }
 
@@ -332,128 +298,176 @@ bit 4 = land/water mask 1=land 0=water
 bit 5 = cloud 0=clear 1=cloudy
 bit 6 = cloud shadow 
 bit 7 = snow
-**/
 
-	int il,is,il_adj,is_adj,buf_ind;
-	int k;
+the cloudy pixels of the middle block flag the clear pixels of lines
+il-dilate_dist..il+dilate_dist-1 and samples is-dilate_dist..is+dilate_dist-1
+as adjacent cloud, in the three blocks
+**/
 
-	for (il=0;il<lut->ar_region_size.l;il++) {
+	int i,il,is,buf_ind;
+	const int nl=lut->ar_region_size.l;
+	dilate_t dil;
+	const unsigned char *dmask;
+	unsigned char *line,flag;
+
+	if (dilate_dist < 1)
+		return true;
+	if (dilate_dist >= nl)
+		RETURN_ERROR("dilation distance not smaller than the block size", "dilate_cloud_mask", false);
+	if (allocate_dilate(&dil,nsamp,dilate_dist,dilate_dist-1,dilate_dist,dilate_dist-1))
+		RETURN_ERROR("allocating the dilation buffers", "dilate_cloud_mask", false);
+
+	/* push i completes line i-dilate_dist of the middle block */
+	for (i=0;i<nl+2*dilate_dist-1;i++) {
+		dmask=dilate_push(&dil,(i<nl)?(unsigned char *)cloud_buf[1][i]:NULL,0x20);
+		il=i-dilate_dist;
+		buf_ind=1;
+		if (il < 0) {
+			buf_ind--;
+			il += nl;
+		}
+		if (il >= nl) {
+			buf_ind++;
+			il -= nl;
+		}
+		line=(unsigned char *)cloud_buf[buf_ind][il];
 		for (is=0;is<nsamp;is++) {
-
-			if (cloud_buf[1][il][is] & 0x20) { /* if cloudy dilate */
-
-				for (k=(il-dilate_dist);k<(il+dilate_dist);k++) {
-					il_adj=k;
-					buf_ind=1;
-					if (k < 0) {
-						buf_ind--;
-						il_adj += lut->ar_region_size.l; 
-					}
-					if (k >= lut->ar_region_size.l) {
-						buf_ind++;
-						il_adj -= lut->ar_region_size.l; 
-					}
-					if ((il_adj>=0)&&(il_adj<lut->ar_region_size.l)) {
-						for (is_adj=(is-dilate_dist);is_adj<(is+dilate_dist);is_adj++) {
-							if ((is_adj>=0)&&(is_adj<nsamp)) {
-								if (!(cloud_buf[buf_ind][il_adj][is_adj] & 0x20)) { /* if not cloudy */
-									cloud_buf[buf_ind][il_adj][is_adj] &= 0xfb; /* reset adjacent cloud bit */
-									cloud_buf[buf_ind][il_adj][is_adj] &= 0xbf; /* reset shadow bit */
-									cloud_buf[buf_ind][il_adj][is_adj] |= 0x04; /* set adjacent cloud bit */
-								}
-							}
-						}
-					}
-				}
-			} /* if cloudy */
+			/* not cloudy: reset the shadow bit, set the adjacent cloud bit */
+			flag=(unsigned char)((line[is]&0xbb)|0x04);
+			line[is]=(dmask[is]&&!(line[is]&0x20))?flag:line[is];
 		}
 	}
+	free_dilate(&dil);
 	return true;
 }
+static void cast_line_shadows(Lut_t *lut, int nsamp, int il, int il_start, int16 *b6_line, cld_diags_t *cld_diags, const char *cloud_line, const double *proj_l, const double *proj_s, float pixel_size, int *shd) {
+/**
+project the cloudy pixels of line il of the middle block on the ground;
+shd gets, for each cloudy pixel in sample order, the index of its shadow
+in the three blocks ((line+nlines)*nsamp+sample, the line counted from
+the middle block) or -1 if it has none
+**/
+	int is,is_end,is_ar,shd_x,shd_y,k;
+	const int nl=lut->ar_region_size.l;
+	float t6,temp_b6_clear,atemp_ancillary,tmpflt_arr[10];
+	float cld_height,dx,dy;
+	const float conv_factor=6.;
+	cld_diags_row_t row;
+
+	clddiags_row(cld_diags, il+il_start, &row);
+	k=0;
+	for (is=0;is<nsamp;is++) {
+		if (!(cloud_line[is] & 0x20))
+			continue;
+		/* run of cloudy pixels */
+		for (is_end=is+1;is_end<nsamp && (cloud_line[is_end] & 0x20);is_end++)
+			;
+		for (;is<is_end;is++,k++) {
+			shd[k]=-1;
+			t6=b6_line[is]*0.1;
+			interpol_clddiags_row(cld_diags, &row, is, tmpflt_arr);
+			temp_b6_clear=tmpflt_arr[0];
+			atemp_ancillary=tmpflt_arr[2];
+			if (temp_b6_clear>0)
+				cld_height=(temp_b6_clear-t6)/conv_factor;
+			else
+				cld_height=(atemp_ancillary-t6)/conv_factor;
+			if (cld_height <= 0.)
+				continue;
 
+			/* the view angle offset is not applied (nadir view) */
+			is_ar=is/lut->ar_region_size.s;
+			if (is_ar >= lut->ar_size.s)
+				is_ar = lut->ar_size.s - 1;
+			dy=proj_l[is_ar]*cld_height;
+			dx=proj_s[is_ar]*cld_height;
+			shd_x=is-dx*1000./pixel_size;
+			shd_y=il+dy*1000./pixel_size;
+			if ((shd_x>=0)&&(shd_x<nsamp)&&(shd_y>=-nl)&&(shd_y<2*nl))
+				shd[k]=(shd_y+nl)*nsamp+shd_x;
+		}
+	}
+}
 
 bool cast_cloud_shadow(Lut_t *lut, int nsamp, int il_start, int16 ***line_in, int16 **b6_line, cld_diags_t *cld_diags, char ***cloud_buf, Ar_gridcell_t *ar_gridcell, float pixel_size, float adjust_north) {
+/**
+Cloud Shadow
 
-	int il,is,il_ar,is_ar,shd_buf_ind;
-	float t6,temp_b6_clear,atemp_ancillary,tmpflt_arr[10];
-	float conv_factor,cld_height,ts,tv,fs,fv,dx,dy;
-	int shd_x,shd_y;
+the shadow of a cloudy pixel of the middle block is cast along the sun
+direction, at the height given by its temperature; the clear pixel it
+falls on is flagged as cloud shadow. Only the cloudy pixels are visited.
+The lines are projected in parallel, then the shadows are set, so no two
+threads write the same pixel.
+**/
+	int il,is,il_ar,is_ar,k,n,nb_cld,shd_buf_ind,shd_y;
+	const int nl=lut->ar_region_size.l;
+	int *cld_start,*shd;
+	double *proj_l,*proj_s;
+	float ts,fs;
+	char *cld_pix;
+
+	/* cloudy pixels of each line; nothing to do for a clear block */
+	if ((cld_start=(int *)malloc((nl+1)*sizeof(int)))==NULL)
+		RETURN_ERROR("allocating the cloud shadow buffers", "cast_cloud_shadow", false);
+	nb_cld=0;
+	for (il=0;il<nl;il++) {
+		cld_start[il]=nb_cld;
+		n=0;
+		for (is=0;is<nsamp;is++)
+			n+=((cloud_buf[1][il][is] & 0x20) != 0);
+		nb_cld+=n;
+	}
+	cld_start[nl]=nb_cld;
+	if (nb_cld == 0) {
+		free(cld_start);
+		return true;
+	}
 
-/***
-			Cloud Shadow
-***/
+	/* projection of a unit cloud height in each aerosol cell of the row */
 	il_ar=il_start/lut->ar_region_size.l;
 	if (il_ar >= lut->ar_size.l)
 		il_ar=lut->ar_size.l-1;
-	for (il=0;il<lut->ar_region_size.l;il++) {
-		for (is=0;is<nsamp;is++) {
-			is_ar=is/lut->ar_region_size.s;
-			if (is_ar >= lut->ar_size.s)
-				is_ar = lut->ar_size.s - 1;
-
-			t6=b6_line[il][is]*0.1;
-			interpol_clddiags_1pixel(cld_diags, il+il_start,is,tmpflt_arr);
-			temp_b6_clear=tmpflt_arr[0];
-			atemp_ancillary=tmpflt_arr[2];
+	shd=(int *)malloc(nb_cld*sizeof(int));
+	proj_l=(double *)malloc(2*lut->ar_size.s*sizeof(double));
+	if ((shd==NULL)||(proj_l==NULL)) {
+		free(cld_start);
+		free(shd);
+		free(proj_l);
+		RETURN_ERROR("allocating the cloud shadow buffers", "cast_cloud_shadow", false);
+	}
+	proj_s=proj_l+lut->ar_size.s;
+	for (is_ar=0;is_ar<lut->ar_size.s;is_ar++) {
+		ts=ar_gridcell->sun_zen[il_ar*lut->ar_size.s+is_ar]/DEG;
+		fs=(ar_gridcell->rel_az[il_ar*lut->ar_size.s+is_ar]-adjust_north)/DEG;
+		proj_l[is_ar]=cos(fs)*tan(ts);
+		proj_s[is_ar]=sin(fs)*tan(ts);
+	}
 
-			if (cloud_buf[1][il][is] & 0x20) { /* if cloudy cast shadow */
-				conv_factor=6.;
-				while (conv_factor <= 6.) {
-					if (temp_b6_clear>0)
-      					cld_height=(temp_b6_clear-t6)/conv_factor;
-					else
-      					cld_height=(atemp_ancillary-t6)/conv_factor;
-      				if (cld_height > 0. ) {
-      					ts=ar_gridcell->sun_zen[il_ar*lut->ar_size.s+is_ar]/DEG;
-      					fs=(ar_gridcell->rel_az[il_ar*lut->ar_size.s+is_ar]-adjust_north)/DEG;
-      					tv=ar_gridcell->view_zen[il_ar*lut->ar_size.s+is_ar]/DEG;
-      					fv=0.;
-/*
-      					dy=sin(fv-2.*M_PI)*tan(tv)*cld_height;
-      					dx=cos(fv-2.*M_PI)*tan(tv)*cld_height;
-*/
-      					dy=sin(2.*M_PI-fv)*tan(tv)*cld_height;
-      					dx=cos(2.*M_PI-fv)*tan(tv)*cld_height;
-	
-						dy=0;
-						dx=0;
+#ifdef _OPENMP
+	#pragma omp parallel for schedule(dynamic)
+#endif
+	for (il=0;il<nl;il++) {
+		if (cld_start[il+1] > cld_start[il])
+			cast_line_shadows(lut, nsamp, il, il_start, b6_line[il], cld_diags,
+			  cloud_buf[1][il], proj_l, proj_s, pixel_size, shd+cld_start[il]);
+	}
 
-      					shd_x=is-dx*1000./pixel_size;
-      					shd_y=il+dy*1000./pixel_size;
-/*
-      					dy=sin(fs-2.*M_PI)*tan(ts)*cld_height;
-      					dx=cos(fs-2.*M_PI)*tan(ts)*cld_height;
-*/
-      					dy=cos(fs)*tan(ts)*cld_height;
-      					dx=sin(fs)*tan(ts)*cld_height;
-
-      					shd_x=shd_x-dx*1000./pixel_size;
-      					shd_y=shd_y+dy*1000./pixel_size;
-
-      					if ((shd_x>=0)&&(shd_x<nsamp)) {
-							shd_buf_ind=1;
-							if (shd_y<0) {
-								shd_buf_ind--;
-								shd_y += lut->ar_region_size.l;
-							}
-							if (shd_y >= lut->ar_region_size.l) {
-								shd_buf_ind++;
-								shd_y -= lut->ar_region_size.l;
-							}
-       						if ((shd_y >= 0)&&(shd_y < lut->ar_region_size.l)) {
-         						if ((cloud_buf[shd_buf_ind][shd_y][shd_x]&0x20)==0x00) /* if clear observation */
-         							cloud_buf[shd_buf_ind][shd_y][shd_x] |= 0x40;
-       							}
-						}
-      				} /*end if cld_height >0*/
-					conv_factor += 1.;
-				} /* while (conv_fact <= 6.) */
-			}
-		}
+	/* flag the clear pixels under the shadows */
+	for (k=0;k<nb_cld;k++) {
+		if (shd[k] < 0)
+			continue;
+		shd_y=shd[k]/nsamp;
+		shd_buf_ind=shd_y/nl;
+		cld_pix=&cloud_buf[shd_buf_ind][shd_y-shd_buf_ind*nl][shd[k]-shd_y*nsamp];
+		if ((*cld_pix&0x20)==0x00) /* if clear observation */
+			*cld_pix |= 0x40;
 	}
+
+	free(cld_start);
+	free(shd);
+	free(proj_l);
 	return true;
 }
-
 bool dilate_shadow_mask(Lut_t *lut, int nsamp, char ***cloud_buf, int dilate_dist) {
 /**
 use ddv_line to store internal cloud screening info
@@ -463,45 +477,43 @@ bit 4 = land/water mask 1=land 0=water
 bit 5 = cloud 0=clear 1=cloudy
 bit 6 = cloud shadow 
 bit 7 = snow
-**/
 
-	int il,is,il_adj,is_adj,buf_ind;
-	int k;
-	char *fill_mask;
+the cloud shadow pixels of the first block flag the pixels of lines
+il-dilate_dist..il+dilate_dist and samples is-dilate_dist..is+dilate_dist
+that are not cloud or adjacent cloud as cloud shadow, in the first two
+blocks; the shadows set here aren't dilated again
+**/
 
-	if ((fill_mask=(char *)calloc(lut->ar_region_size.l*nsamp,sizeof(char)))==NULL)
-		return false;
-	for (il=0;il<lut->ar_region_size.l;il++) {
-		for (is=0;is<nsamp;is++) {
-			if ((cloud_buf[0][il][is] & 0x40)&&(!fill_mask[il*nsamp+is])) { /* if cloud shadow dilate */
-				for (k=(il-dilate_dist);k<=(il+dilate_dist);k++) {
-					il_adj=k;
-					buf_ind=0;
-					if (k >= lut->ar_region_size.l) {
-						buf_ind++;
-						il_adj -= lut->ar_region_size.l; 
-					}
-					if (k>=0) {
-						if ((il_adj>=0)&&(il_adj<lut->ar_region_size.l)) {
-							for (is_adj=(is-dilate_dist);is_adj<=(is+dilate_dist);is_adj++) {
-								if ((is_adj>=0)&&(is_adj<nsamp)) {
-									if (!((cloud_buf[buf_ind][il_adj][is_adj] & 0x20)||
-									  	(cloud_buf[buf_ind][il_adj][is_adj] & 0x04)||
-									  	(cloud_buf[buf_ind][il_adj][is_adj] & 0x40))) { /* if not cloud, adjacent cloud or cloud shadow */
-										cloud_buf[buf_ind][il_adj][is_adj] |= 0x40; /* set adjacent cloud shadow bit */
-										fill_mask[il_adj*nsamp+is_adj]=1;
-									}
-								}
-							}
-						}
-					}
-				}
-			} /* if cloud shadow */
+	int i,il,is,buf_ind;
+	const int nl=lut->ar_region_size.l;
+	dilate_t dil;
+	const unsigned char *dmask;
+	unsigned char *line;
+
+	if (dilate_dist < 0)
+		return true;
+	if (dilate_dist >= nl)
+		RETURN_ERROR("dilation distance not smaller than the block size", "dilate_shadow_mask", false);
+	if (allocate_dilate(&dil,nsamp,dilate_dist,dilate_dist,dilate_dist,dilate_dist))
+		RETURN_ERROR("allocating the dilation buffers", "dilate_shadow_mask", false);
+
+	/* push i completes line i-dilate_dist, which was pushed before it is
+	   changed */
+	for (i=0;i<nl+2*dilate_dist;i++) {
+		dmask=dilate_push(&dil,(i<nl)?(unsigned char *)cloud_buf[0][i]:NULL,0x40);
+		il=i-dilate_dist;
+		if (il < 0)
+			continue;
+		buf_ind=0;
+		if (il >= nl) {
+			buf_ind++;
+			il -= nl;
 		}
+		line=(unsigned char *)cloud_buf[buf_ind][il];
+		for (is=0;is<nsamp;is++)
+			line[is]|=(unsigned char)((dmask[is]&&!(line[is]&0x24))?0x40:0);
 	}
-	free(fill_mask);
-
-
+	free_dilate(&dil);
 	return true;
 }
 
@@ -577,7 +589,7 @@ int free_cld_diags(cld_diags_t *cld_diags) {
 	return 0;
 }
 
-void fill_cld_diags(cld_diags_t *cld_diags) {
+int fill_cld_diags(cld_diags_t *cld_diags) {
 /*
 !Description: fill in missing values in the T6Clear grid based
 on existing values (spatial interpolation). Missing values have been previously
@@ -604,139 +616,71 @@ Original version: Thu Dec  7 15:46:05 EST 1995
 
 
 !Design Notes:   
+Each missing cell is filled from the original values by the gap filling
+engine (gapfill.c), with the smallest window holding at least 3 values
+within 4 GPs, else 2 values within 6 GPs, else 1 value within 10 GPs.
 !END****************************************************************************
 */
-   int i,j,k,l,pass,count;
-   float lastt6,dist,sumt6,sumdist,lastb7,sumb7;
-   char missing_flag[300][300];
-	int min_nb_values,n,max_distance;
+   int i,j,count,n;
+   float lastt6,lastb7;
+   static const int min_valid[3]={3,2,1},max_radius[3]={4,6,10};
+   gapfill_t gf;
+   float *value[2];
+   unsigned char *valid;
    
 	count=0;
 	for (i=0;i<cld_diags->nbrows;i++) {
 		for (j=0;j<cld_diags->nbcols;j++) {
-			missing_flag[i][j]=1;
 			if (cld_diags->avg_t6_clear[i][j]!=-9999.)  {
       		count++;
 				lastt6=cld_diags->avg_t6_clear[i][j];
 				lastb7=cld_diags->avg_b7_clear[i][j];
-				missing_flag[i][j]=0;
 			}
 		}
 	} 
 	if (count==0)
-      return;
+      return 0;
 	if (count==1) {
 		for (i=0;i<cld_diags->nbrows;i++)
 			for (j=0;j<cld_diags->nbcols;j++) {
 				cld_diags->avg_t6_clear[i][j]=lastt6;
 				cld_diags->avg_b7_clear[i][j]=lastb7;
 			}
-		return;
+		return 0;
 	}
 	
+	n=cld_diags->nbrows*cld_diags->nbcols;
+	if (allocate_gapfill(&gf,cld_diags->nbrows,cld_diags->nbcols,2,10))
+		return -1;
+	value[0]=(float *)malloc(2*n*sizeof(float));
+	valid=(unsigned char *)malloc(n);
+	if (value[0]==NULL || valid==NULL) {
+		free(value[0]);
+		free(valid);
+		free_gapfill(&gf);
+		return -1;
+	}
+	value[1]=value[0]+n;
 	for (i=0;i<cld_diags->nbrows;i++) {
 		for (j=0;j<cld_diags->nbcols;j++) {
+			value[0][i*cld_diags->nbcols+j]=cld_diags->avg_t6_clear[i][j];
+			value[1][i*cld_diags->nbcols+j]=cld_diags->avg_b7_clear[i][j];
+			valid[i*cld_diags->nbcols+j]=(cld_diags->avg_t6_clear[i][j]!=-9999.);
+		}
+	}
 
-/**
-Look for at least 3 neighboring valid values within 4 GPs
-**/
-			min_nb_values=3;
-			max_distance=4;	
-			pass=0;
-			while ((cld_diags->avg_t6_clear[i][j]==-9999.)&&(pass<max_distance)) {
-				pass++;
-				sumdist=0.;
-				sumt6=0.;
-				sumb7=0.;
-				n=0;
-				for (k=i-pass;k<=(i+pass);k++) {
-					if ((k>=0)&&(k<cld_diags->nbrows)) {
-						for (l=j-pass;l<=(j+pass);l++) {
-							if ((l>=0)&&(l<cld_diags->nbcols)) {
-								if (!missing_flag[k][l]) {
-									dist=sqrt((k-i)*(k-i)+(l-j)*(l-j));
-									sumdist += dist;
-									sumt6 += (dist*cld_diags->avg_t6_clear[k][l]);
-									sumb7 += (dist*cld_diags->avg_b7_clear[k][l]);
-									n++;
-								}
-							}
-						}
-					}
-				}
-				if ((n>=min_nb_values)&&(sumdist!=0.)) {
-					cld_diags->avg_t6_clear[i][j]=sumt6/sumdist;
-					cld_diags->avg_b7_clear[i][j]=sumb7/sumdist;
-				}
-			}
-/**
-Look for at least 2 neighboring valid values within 6 GPs
-**/
-			min_nb_values=2;
-			max_distance=6;	
-			pass=0;
-			while ((cld_diags->avg_t6_clear[i][j]==-9999.)&&(pass<max_distance)) {
-				pass++;
-				sumdist=0.;
-				sumt6=0.;
-				sumb7=0.;
-				n=0;
-				for (k=i-pass;k<=(i+pass);k++) {
-					if ((k>=0)&&(k<cld_diags->nbrows)) {
-						for (l=j-pass;l<=(j+pass);l++) {
-							if ((l>=0)&&(l<cld_diags->nbcols)) {
-								if (!missing_flag[k][l]) {
-									dist=sqrt((k-i)*(k-i)+(l-j)*(l-j));
-									sumdist += dist;
-									sumt6 += (dist*cld_diags->avg_t6_clear[k][l]);
-									sumb7 += (dist*cld_diags->avg_b7_clear[k][l]);
-									n++;
-								}
-							}
-						}
-					}
-				}
-				if ((n>=min_nb_values)&&(sumdist!=0.)) {
-					cld_diags->avg_t6_clear[i][j]=sumt6/sumdist;
-					cld_diags->avg_b7_clear[i][j]=sumb7/sumdist;
-				}
-			}
-/**
-Look for at least 1 neighboring valid values within 10 GPs
-**/
-			min_nb_values=1;
-			max_distance=10;	
-			pass=0;
-			while ((cld_diags->avg_t6_clear[i][j]==-9999.)&&(pass<max_distance)) {
-				pass++;
-				sumdist=0.;
-				sumt6=0.;
-				sumb7=0.;
-				n=0;
-				for (k=i-pass;k<=(i+pass);k++) {
-					if ((k>=0)&&(k<cld_diags->nbrows)) {
-						for (l=j-pass;l<=(j+pass);l++) {
-							if ((l>=0)&&(l<cld_diags->nbcols)) {
-								if (!missing_flag[k][l]) {
-									dist=sqrt((k-i)*(k-i)+(l-j)*(l-j));
-									sumdist += dist;
-									sumt6 += (dist*cld_diags->avg_t6_clear[k][l]);
-									sumb7 += (dist*cld_diags->avg_b7_clear[k][l]);
-									n++;
-								}
-							}
-						}
-					}
-				}
-				if ((n>=min_nb_values)&&(sumdist!=0.)) {
-					cld_diags->avg_t6_clear[i][j]=sumt6/sumdist;
-					cld_diags->avg_b7_clear[i][j]=sumb7/sumdist;
-				}
-			}
-			
-			
+	gapfill_stages(&gf,value,valid,3,min_valid,max_radius);
+
+	for (i=0;i<cld_diags->nbrows;i++) {
+		for (j=0;j<cld_diags->nbcols;j++) {
+			cld_diags->avg_t6_clear[i][j]=value[0][i*cld_diags->nbcols+j];
+			cld_diags->avg_b7_clear[i][j]=value[1][i*cld_diags->nbcols+j];
 		}
 	}
+	free(value[0]);
+	free(valid);
+	free_gapfill(&gf);
+	return 0;
 }
 
 int interpol_clddiags_1pixel(cld_diags_t *cld_diags, int img_line, int img_sample,float *inter_value) 
@@ -758,51 +702,66 @@ int interpol_clddiags_1pixel(cld_diags_t *cld_diags, int img_line, int img_sampl
         temp is available (i.e. there were clear pixels to compute the average
         thermal temp).  Many of the users of these interpolated values use the
         airtemp_2m as the default if the band6 clear temps are not valid.
+
+    The line part (grid rows and line weights) is set by clddiags_row, so
+    that callers working on a line only compute it once.
  */
 
 {
-typedef struct {
-  int l;                /* line number */
-  int s;                /* sample number */
-} Img_coord_int_t;
-	
-  Img_coord_int_t p[4];
-  int i, n, n_anc;
+  cld_diags_row_t row;
+
+  clddiags_row(cld_diags, img_line, &row);
+  interpol_clddiags_row(cld_diags, &row, img_sample, inter_value);
+  return 0;
+}
+
+void clddiags_row(cld_diags_t *cld_diags, int img_line, cld_diags_row_t *row)
+/* grid rows of points 0,1 and 2,3 of img_line, and their line distances */
+{
+  int i, cell_half_height;
+  float dl;
+
+  cell_half_height = (cld_diags->cellheight + 1) / 2;
+
+  row->l[0] = (img_line - cell_half_height) / cld_diags->cellheight;
+  if (row->l[0]<0)
+  	row->l[0]=0;
+  row->l[1] = row->l[0] + 1;
+  if (row->l[1] >= cld_diags->nbrows) {
+    row->l[1] = cld_diags->nbrows - 1;
+    if (row->l[0] > 0) row->l[0]--;
+  }    
+
+  for (i = 0; i < 2; i++) {
+    dl = fabs(img_line - cell_half_height) - (row->l[i] * cld_diags->cellheight);
+    row->dl[i] = fabs(dl) / cld_diags->cellheight; 
+  }
+}
+
+void interpol_clddiags_row(cld_diags_t *cld_diags, const cld_diags_row_t *row, int img_sample, float *inter_value)
+/* interpol_clddiags_1pixel for a sample of the line set by clddiags_row */
+{
+  int ps[2];
+  int i, l, s, n, n_anc;
   float dl, ds, w;
   float sum[10], sum_w, sum_anc_w;
 
-  int cell_half_height,cell_half_width;
+  int cell_half_width;
 
   	for (i=0;i<3;i++) 
     inter_value[i] = -9999.;
 
-  cell_half_height = (cld_diags->cellheight + 1) / 2;
   cell_half_width = (cld_diags->cellwidth + 1) / 2;
 
-  p[0].l = (img_line - cell_half_height) / cld_diags->cellheight;
-  if (p[0].l<0)
-  	p[0].l=0;
-  p[2].l = p[0].l + 1;
-  if (p[2].l >= cld_diags->nbrows) {
-    p[2].l = cld_diags->nbrows - 1;
-    if (p[0].l > 0) p[0].l--;
-  }    
-      
-  p[1].l = p[0].l;
-  p[3].l = p[2].l;
-
-  p[0].s = (img_sample - cell_half_width) / cld_diags->cellwidth;
-  if (p[0].s < 0)
-  	p[0].s=0;
-  p[1].s = p[0].s + 1;
-
-  if (p[1].s >= cld_diags->nbcols) {
-    p[1].s = cld_diags->nbcols - 1;
-    if (p[0].s > 0) p[0].s--;
-  }    
+  ps[0] = (img_sample - cell_half_width) / cld_diags->cellwidth;
+  if (ps[0] < 0)
+  	ps[0]=0;
+  ps[1] = ps[0] + 1;
 
-  p[2].s = p[0].s;
-  p[3].s = p[1].s;
+  if (ps[1] >= cld_diags->nbcols) {
+    ps[1] = cld_diags->nbcols - 1;
+    if (ps[0] > 0) ps[0]--;
+  }    
 
   n = 0;
   n_anc = 0;
@@ -811,26 +770,24 @@ typedef struct {
   for (i=0;i<3;i++)
   	sum[i]=0.;
   for (i = 0; i < 4; i++) {
-    if (p[i].l != -1  &&  p[i].s != -1) {
-
-      dl = fabs(img_line - cell_half_height) - (p[i].l * cld_diags->cellheight);
-      dl = fabs(dl) / cld_diags->cellheight; 
-      ds = fabs(img_sample - cell_half_width) - (p[i].s * cld_diags->cellwidth);
-      ds = fabs(ds) / cld_diags->cellwidth; 
-      w = (1.0 - dl) * (1.0 - ds);
-
-      if (cld_diags->avg_t6_clear[p[i].l][p[i].s] != -9999.) {
-        n++;
-        sum_w += w;
-        sum[0] += (cld_diags->avg_t6_clear[p[i].l][p[i].s] * w);
-        sum[1] += (cld_diags->avg_b7_clear[p[i].l][p[i].s] * w);
-      }
-
-      if (cld_diags->airtemp_2m[p[i].l][p[i].s] != -9999) {
-        n_anc++;
-        sum_anc_w += w;
-        sum[2] += (cld_diags->airtemp_2m[p[i].l][p[i].s] * w);
-      }
+    l = row->l[i/2];
+    s = ps[i%2];
+    dl = row->dl[i/2];
+    ds = fabs(img_sample - cell_half_width) - (s * cld_diags->cellwidth);
+    ds = fabs(ds) / cld_diags->cellwidth; 
+    w = (1.0 - dl) * (1.0 - ds);
+
+    if (cld_diags->avg_t6_clear[l][s] != -9999.) {
+      n++;
+      sum_w += w;
+      sum[0] += (cld_diags->avg_t6_clear[l][s] * w);
+      sum[1] += (cld_diags->avg_b7_clear[l][s] * w);
+    }
+
+    if (cld_diags->airtemp_2m[l][s] != -9999) {
+      n_anc++;
+      sum_anc_w += w;
+      sum[2] += (cld_diags->airtemp_2m[l][s] * w);
     }
   }
 
@@ -842,6 +799,4 @@ typedef struct {
   if ((n_anc > 0) && (sum_anc_w>0)) {
     inter_value[2] = sum[2] / sum_anc_w;
   }
-
-  return 0;
 }
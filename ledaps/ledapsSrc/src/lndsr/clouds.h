@@ -5,6 +5,7 @@
 #include "bool.h"
 #include "lut.h"
 #include "sixs_runs.h"
+#include "sr.h"
 
 #define CLDDIAGS_CELLHEIGHT_1KM 40
 #define CLDDIAGS_CELLWIDTH_1KM 40
@@ -19,15 +20,33 @@ typedef struct cld_diags_t {
 	int **nb_t6_clear;
 }cld_diags_t;
 
+/* Line part of the interpolation of the cloud diagnostics */
+typedef struct {
+	int l[2];		/* grid rows of the upper and lower points */
+	float dl[2];		/* their line distances, in cells */
+} cld_diags_row_t;
+
+/* Line buffers of the cloud detection passes; one per thread */
+typedef struct {
+	Sr_interp_t interp;		/* atmospheric coefficients of the line */
+	float *rho[NBAND_REFL_MAX];	/* corrected reflectances of the line */
+	float *thshld1,*thshld2;	/* thermal thresholds of the line */
+	float *buf;
+} cld_line_t;
 
 
 int allocate_cld_diags(struct cld_diags_t *cld_diags,int cell_height, int cell_width, int scene_height, int scene_width);
 int free_cld_diags(struct cld_diags_t *cld_diags);
-void fill_cld_diags(cld_diags_t *cld_diags);
+int fill_cld_diags(cld_diags_t *cld_diags);
 int interpol_clddiags_1pixel(cld_diags_t *cld_diags, int img_line, int img_sample,float *inter_value);
-
-bool cloud_detection_pass1(Lut_t *lut, int nsamp, int il, int16 **line_in, uint8 *qa_line, int16 *b6_line,float *atemp_line, cld_diags_t *cld_diags);
-bool cloud_detection_pass2(Lut_t *lut, int nsamp, int il, int16 **line_in, uint8 *qa_line, int16 *b6_line, cld_diags_t *cld_diags,char *ddv_line);
+void clddiags_row(cld_diags_t *cld_diags, int img_line, cld_diags_row_t *row);
+void interpol_clddiags_row(cld_diags_t *cld_diags, const cld_diags_row_t *row, int img_sample, float *inter_value);
+void update_cld_diags(cld_diags_t *cld_diags, int il_start, int nlines, int nsamp, int16 **b6_line, uint8 **clear_line, float **rho7_line);
+int allocate_cld_line(Lut_t *lut, int nsamp, cld_line_t *cld_line);
+void free_cld_line(cld_line_t *cld_line);
+
+bool cloud_detection_pass1(Lut_t *lut, cld_line_t *cld_line, int nsamp, int il, int16 **line_in, uint8 *qa_line, int16 *b6_line,float *atemp_line, uint8 *clear_line, float *rho7_line);
+bool cloud_detection_pass2(Lut_t *lut, cld_line_t *cld_line, int nsamp, int il, int16 **line_in, uint8 *qa_line, int16 *b6_line, cld_diags_t *cld_diags,char *ddv_line);
 bool cast_cloud_shadow(Lut_t *lut, int nsamp, int il_start, int16 ***line_in, int16 **b6_line, cld_diags_t *cld_diags, char ***cloud_buf, Ar_gridcell_t *ar_gridcell, float pixel_size, float adjust_north);
 bool dilate_cloud_mask(Lut_t *lut, int nsamp, char ***cloud_buf, int dilate_dist);
 bool dilate_shadow_mask(Lut_t *lut, int nsamp, char ***cloud_buf, int dilate_dist);
@@ -0,0 +1,79 @@
+#include <stdlib.h>
+#include <string.h>
+#include "dilate.h"
+
+int allocate_dilate(dilate_t *dil, int nsamp, int up, int down, int left,
+                    int right) {
+	memset(dil,0,sizeof(dilate_t));
+	if (nsamp<1 || up<0 || down<0 || left<0 || right<0)
+		return -1;
+	dil->nsamp=nsamp;
+	dil->up=up;
+	dil->down=down;
+	dil->left=left;
+	dil->right=right;
+	dil->nwin=up+down+1;
+	dil->ring=(unsigned char *)malloc((size_t)dil->nwin*nsamp);
+	dil->count=(int *)malloc(nsamp*sizeof(int));
+	dil->out=(unsigned char *)malloc(nsamp);
+	if (dil->ring==NULL || dil->count==NULL || dil->out==NULL) {
+		free_dilate(dil);
+		return -1;
+	}
+	dilate_reset(dil);
+	return 0;
+}
+
+void free_dilate(dilate_t *dil) {
+	free(dil->ring);
+	free(dil->count);
+	free(dil->out);
+	dil->ring=dil->out=NULL;
+	dil->count=NULL;
+}
+
+void dilate_reset(dilate_t *dil) {
+	memset(dil->ring,0,(size_t)dil->nwin*dil->nsamp);
+	memset(dil->count,0,dil->nsamp*sizeof(int));
+	dil->npush=0;
+}
+
+/* Add a source line (NULL for an empty line), the pixels with one of bits
+   set being the set ones; returns the output line it completes */
+const unsigned char *dilate_push(dilate_t *dil, const unsigned char *line,
+                                 unsigned char bits) {
+	const int nsamp=dil->nsamp,left=dil->left,right=dil->right;
+	unsigned char *h=dil->ring+(size_t)(dil->npush%dil->nwin)*nsamp;
+	unsigned char *out=dil->out;
+	int *count=dil->count;
+	int is,n;
+
+	/* the line leaving the window shares its slot with the new one */
+	for (is=0;is<nsamp;is++)
+		count[is]-=h[is];
+
+	/* dilate along the line; n counts the set pixels of
+	   is-right..is+left */
+	if (line==NULL) {
+		for (is=0;is<nsamp;is++)
+			h[is]=0;
+	} else {
+		n=0;
+		for (is=0;is<=left && is<nsamp;is++)
+			n+=((line[is]&bits)!=0);
+		for (is=0;is<nsamp;is++) {
+			h[is]=(n>0);
+			if (is+left+1<nsamp)
+				n+=((line[is+left+1]&bits)!=0);
+			if (is-right>=0)
+				n-=((line[is-right]&bits)!=0);
+		}
+	}
+
+	for (is=0;is<nsamp;is++) {
+		count[is]+=h[is];
+		out[is]=(count[is]!=0);
+	}
+	dil->npush++;
+	return out;
+}
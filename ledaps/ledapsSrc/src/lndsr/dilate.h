@@ -0,0 +1,37 @@
+#ifndef DILATE_H
+#define DILATE_H
+
+/* Streaming binary dilation by a rectangle.  A set source pixel at
+   (il,is) sets the output pixels of lines il-up..il+down and samples
+   is-left..is+right.  The rectangle is separable: each source line is
+   dilated along the line with a running count, and the output lines
+   with a running count per sample of the dilated lines in the window,
+   so the cost per pixel doesn't depend on the size of the rectangle.
+
+   The source lines are pushed in order.  The output line completed by
+   the n-th push (n from 0) is line n-up of the source; once the last
+   source line is pushed, up+down empty lines (NULL) give the last output
+   lines.  The output is 1 where set and 0 elsewhere; the caller decides
+   what to do with the pixels it covers.
+
+   This is shared by lndsr, lndsrbm and the L8 surface reflectance code,
+   so it only uses standard C types. */
+
+typedef struct {
+	int nsamp;
+	int up,down,left,right;
+	int nwin;		/* lines in the window, up+down+1 */
+	int npush;		/* source lines pushed since dilate_reset */
+	unsigned char *ring;	/* [nwin][nsamp] dilated lines of the window */
+	int *count;		/* set lines of the window at each sample */
+	unsigned char *out;	/* output line */
+} dilate_t;
+
+int allocate_dilate(dilate_t *dil, int nsamp, int up, int down, int left,
+                    int right);
+void free_dilate(dilate_t *dil);
+void dilate_reset(dilate_t *dil);
+const unsigned char *dilate_push(dilate_t *dil, const unsigned char *line,
+                                 unsigned char bits);
+
+#endif
@@ -0,0 +1,184 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "gapfill.h"
+
+int allocate_gapfill(gapfill_t *gf, int nrows, int ncols, int nplanes,
+                     int max_radius) {
+	const int w=2*max_radius+1;
+	int k,l;
+	memset(gf,0,sizeof(gapfill_t));
+	if (nrows<1 || ncols<1 || nplanes<0 || max_radius<0)
+		return -1;
+	gf->nrows=nrows;
+	gf->ncols=ncols;
+	gf->nplanes=nplanes;
+	gf->max_radius=max_radius;
+	gf->sat=(int *)malloc((size_t)(nrows+1)*(ncols+1)*sizeof(int));
+	gf->dist=(float *)malloc((size_t)w*w*sizeof(float));
+	if (nplanes>0) {
+		gf->cells=(int *)malloc((size_t)nrows*ncols*sizeof(int));
+		gf->fill=(float *)malloc((size_t)nrows*ncols*nplanes*sizeof(float));
+	}
+	if (gf->sat==NULL || gf->dist==NULL ||
+	    (nplanes>0 && (gf->cells==NULL || gf->fill==NULL))) {
+		free_gapfill(gf);
+		return -1;
+	}
+	for (k=-max_radius;k<=max_radius;k++)
+		for (l=-max_radius;l<=max_radius;l++)
+			gf->dist[(k+max_radius)*w+l+max_radius]=sqrt(k*k+l*l);
+	return 0;
+}
+
+void free_gapfill(gapfill_t *gf) {
+	free(gf->sat);
+	free(gf->cells);
+	free(gf->fill);
+	free(gf->dist);
+	gf->sat=gf->cells=NULL;
+	gf->fill=gf->dist=NULL;
+}
+
+/* Build the summed area table of count, the number of valid cells (or of
+   valid pixels of a tile) of each cell */
+void gapfill_count(gapfill_t *gf, const unsigned char *count) {
+	const int ncols=gf->ncols,w=ncols+1;
+	int *sat=gf->sat;
+	int i,j,row_sum;
+
+	for (j=0;j<w;j++)
+		sat[j]=0;
+	for (i=0;i<gf->nrows;i++) {
+		sat[(i+1)*w]=0;
+		row_sum=0;
+		for (j=0;j<ncols;j++) {
+			row_sum+=count[i*ncols+j];
+			sat[(i+1)*w+j+1]=sat[i*w+j+1]+row_sum;
+		}
+	}
+}
+
+/* Valid cells of rows row0..row1 and columns col0..col1, clipped to the
+   grid */
+int gapfill_nvalid(const gapfill_t *gf, int row0, int col0, int row1,
+                   int col1) {
+	const int w=gf->ncols+1;
+	if (row0<0) row0=0;
+	if (col0<0) col0=0;
+	if (row1>=gf->nrows) row1=gf->nrows-1;
+	if (col1>=gf->ncols) col1=gf->ncols-1;
+	if (row0>row1 || col0>col1)
+		return 0;
+	return gf->sat[(row1+1)*w+col1+1]-gf->sat[row0*w+col1+1]-
+	       gf->sat[(row1+1)*w+col0]+gf->sat[row0*w+col0];
+}
+
+/* Distance weighted average of the valid cells within radius (up to
+   max_radius) of (row,col), for each plane */
+static void weighted_average(const gapfill_t *gf, float **value,
+                             const unsigned char *valid, int row, int col,
+                             int radius, float *avg) {
+	const int ncols=gf->ncols,w=2*gf->max_radius+1;
+	const float *dist_row;
+	int k,l,p,k0,k1,l0,l1;
+	float dist,sum_dist;
+
+	k0=(row-radius<0)?0:row-radius;
+	k1=(row+radius>=gf->nrows)?gf->nrows-1:row+radius;
+	l0=(col-radius<0)?0:col-radius;
+	l1=(col+radius>=ncols)?ncols-1:col+radius;
+	for (p=0;p<gf->nplanes;p++)
+		avg[p]=0.;
+	sum_dist=0.;
+	for (k=k0;k<=k1;k++) {
+		dist_row=gf->dist+(k-row+gf->max_radius)*w+gf->max_radius-col;
+		for (l=l0;l<=l1;l++) {
+			if (!valid[k*ncols+l])
+				continue;
+			dist=dist_row[l];
+			sum_dist += dist;
+			for (p=0;p<gf->nplanes;p++)
+				avg[p] += (dist*value[p][k*ncols+l]);
+		}
+	}
+	for (p=0;p<gf->nplanes;p++)
+		avg[p]=avg[p]/sum_dist;
+}
+
+/* Fill each missing cell from the cells valid on entry: stage s uses the
+   smallest radius up to max_radius[s] (at most the one allocated) whose
+   window holds min_valid[s] (>0) valid cells, the stages being tried in
+   order.  valid isn't changed; returns the number of cells left missing */
+int gapfill_stages(gapfill_t *gf, float **value, const unsigned char *valid,
+                   int nstages, const int *min_valid, const int *max_radius) {
+	const int ncols=gf->ncols;
+	int i,j,p,s,radius,nleft;
+	float *avg=gf->fill;
+
+	gapfill_count(gf,valid);
+	nleft=0;
+	for (i=0;i<gf->nrows;i++) {
+		for (j=0;j<ncols;j++) {
+			if (valid[i*ncols+j])
+				continue;
+			radius=0;
+			for (s=0;s<nstages && radius==0;s++) {
+				for (radius=1;radius<=max_radius[s];radius++)
+					if (gapfill_nvalid(gf,i-radius,j-radius,i+radius,
+					    j+radius)>=min_valid[s])
+						break;
+				if (radius>max_radius[s])
+					radius=0;
+			}
+			if (radius==0) {
+				nleft++;
+				continue;
+			}
+			weighted_average(gf,value,valid,i,j,radius,avg);
+			for (p=0;p<gf->nplanes;p++)
+				value[p][i*ncols+j]=avg[p];
+		}
+	}
+	return nleft;
+}
+
+/* Fill the missing cells with min_valid (>0) valid cells within radius
+   (at most the one allocated) in passes, the cells filled by a pass being
+   valid for the next ones, until a pass fills nothing; with truncate the
+   filled values are truncated to integers.  valid is updated; returns the
+   number of cells left missing */
+int gapfill_iterate(gapfill_t *gf, float **value, unsigned char *valid,
+                    int radius, int min_valid, int truncate) {
+	const int ncols=gf->ncols,ncell=gf->nrows*gf->ncols;
+	int i,j,c,p,n,nleft;
+	float *fill;
+
+	nleft=0;
+	for (c=0;c<ncell;c++)
+		nleft+=!valid[c];
+	while (nleft>0) {
+		gapfill_count(gf,valid);
+		n=0;
+		for (i=0;i<gf->nrows;i++) {
+			for (j=0;j<ncols;j++) {
+				if (valid[i*ncols+j] || gapfill_nvalid(gf,i-radius,
+				    j-radius,i+radius,j+radius)<min_valid)
+					continue;
+				weighted_average(gf,value,valid,i,j,radius,
+				                 &gf->fill[n*gf->nplanes]);
+				gf->cells[n++]=i*ncols+j;
+			}
+		}
+		if (n==0)
+			break;
+		for (c=0;c<n;c++) {
+			fill=&gf->fill[c*gf->nplanes];
+			for (p=0;p<gf->nplanes;p++)
+				value[p][gf->cells[c]]=truncate?(float)(int)fill[p]:fill[p];
+			valid[gf->cells[c]]=1;
+		}
+		nleft-=n;
+	}
+	return nleft;
+}
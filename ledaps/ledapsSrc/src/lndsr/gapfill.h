@@ -0,0 +1,42 @@
+#ifndef GAPFILL_H
+#define GAPFILL_H
+
+/* Filling of the missing cells of a grid from the valid cells around
+   them.  The valid cells are counted in a summed area table, so the
+   number of valid cells of any window costs four lookups: the cells that
+   can't be filled yet are skipped without looking at their neighbours,
+   and the smallest window holding enough valid cells is found without
+   summing it.
+
+   A missing cell is filled with the average of the valid cells of its
+   window weighted by their distance to it, the cells being taken in line
+   order, as the lndsr fills always did.  A pass only uses the cells that
+   were valid before it, so the result doesn't depend on the order the
+   cells are visited in.
+
+   This is shared by the lndsr aerosol and clear-sky grids, so it only uses
+   standard C types. */
+
+typedef struct {
+	int nrows,ncols;
+	int nplanes;		/* planes of values filled together, 0 to
+				   only count */
+	int max_radius;		/* largest window radius */
+	float *dist;		/* [2*max_radius+1]^2 distances to the center */
+	int *sat;		/* [nrows+1][ncols+1] valid cells above and left */
+	int *cells;		/* cells filled by a pass */
+	float *fill;		/* [cell][plane] their values */
+} gapfill_t;
+
+int allocate_gapfill(gapfill_t *gf, int nrows, int ncols, int nplanes,
+                     int max_radius);
+void free_gapfill(gapfill_t *gf);
+void gapfill_count(gapfill_t *gf, const unsigned char *count);
+int gapfill_nvalid(const gapfill_t *gf, int row0, int col0, int row1,
+                   int col1);
+int gapfill_stages(gapfill_t *gf, float **value, const unsigned char *valid,
+                   int nstages, const int *min_valid, const int *max_radius);
+int gapfill_iterate(gapfill_t *gf, float **value, unsigned char *valid,
+                    int radius, int min_valid, int truncate);
+
+#endif
@@ -57,6 +57,7 @@
 */
 
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 #include "input.h"
 #include "error.h"
@@ -66,6 +67,9 @@
 
 #define INPUT_FILL (-9999)
 
+/* Size of the reads filling the input cache */
+#define INPUT_CACHE_CHUNK (16*1024*1024)
+
 /* Functions */
 Input_t *OpenInput(Espa_internal_meta_t *metadata, bool thermal)
 /* 
@@ -216,9 +220,13 @@ bool FreeInput(Input_t *this)
     for (ib = 0; ib < this->nband; ib++) {
       free(this->file_name[ib]);
       this->file_name[ib] = NULL;
+      free(this->cache[ib]);
+      this->cache[ib] = NULL;
     }
     free(this->file_name_qa);
     this->file_name_qa = NULL;
+    free(this->cache_qa);
+    this->cache_qa = NULL;
 
     free(this);
     this = NULL;
@@ -240,6 +248,13 @@ bool GetInputLine(Input_t *this, int iband, int iline, int16 *line)
     RETURN_ERROR("band number out of range", "GetInputLine", false);
   if (iline < 0 || iline >= this->size.l)
     RETURN_ERROR("line number out of range", "GetInputLine", false);
+
+  if (this->cache[iband] != NULL) {
+    memcpy(line, &this->cache[iband][(size_t)iline * this->size.s],
+           (size_t)this->size.s * sizeof(int16));
+    return true;
+  }
+
   if (!this->open[iband])
     RETURN_ERROR("band not open", "GetInputLine", false);
 
@@ -265,6 +280,13 @@ bool GetInputQALine(Input_t *this, int iline, uint8 *line)
     RETURN_ERROR("invalid input structure", "GetInputQALine", false);
   if (iline < 0  ||  iline >= this->size.l) 
     RETURN_ERROR("line index out of range", "GetInputQALine", false);
+
+  if (this->cache_qa != NULL) {
+    memcpy(line, &this->cache_qa[(size_t)iline * this->size.s],
+           (size_t)this->size.s * sizeof(uint8));
+    return true;
+  }
+
   if (!this->open_qa)
     RETURN_ERROR("QA band not open", "GetInputQALine", false);
 
@@ -280,6 +302,90 @@ bool GetInputQALine(Input_t *this, int iline, uint8 *line)
 }
 
 
+/* Read a whole file into buf with large sequential reads */
+static bool ReadInputFile(FILE *fp, void *buf, size_t nbytes)
+{
+  char *ptr = (char *)buf;
+  size_t nread;
+
+  if (fseek(fp, 0L, SEEK_SET))
+    return false;
+  while (nbytes > 0) {
+    nread = nbytes < INPUT_CACHE_CHUNK ? nbytes : INPUT_CACHE_CHUNK;
+    if (fread(ptr, 1, nread, fp) != nread)
+      return false;
+    ptr += nread;
+    nbytes -= nread;
+  }
+  return true;
+}
+
+
+bool CacheInput(Input_t *this, size_t *budget)
+/* 
+!C******************************************************************************
+
+!Description: 'CacheInput' reads the open bands (and QA band) of the input
+ in memory, so the passes of lndsr read their lines from memory instead of
+ seeking in the files for each of them.
+ 
+!Input Parameters:
+ this           'input' data structure
+ budget         memory available for the cache (bytes)
+
+!Output Parameters:
+ this           'input' data structure; the following fields are modified:
+                   cache, cache_qa
+ budget         memory left for other caches (bytes)
+ (returns)      status:
+                  'true' = okay; the input is not cached when it doesn't fit
+                           in the budget and its lines are read from the files
+		  'false' = error return
+
+!END****************************************************************************
+*/
+{
+  size_t npix, nbytes;
+  int ib;
+
+  if (this == NULL) 
+    RETURN_ERROR("invalid input structure", "CacheInput", false);
+
+  npix = (size_t)this->size.l * this->size.s;
+  nbytes = 0;
+  for (ib = 0; ib < this->nband; ib++)
+    if (this->open[ib]) nbytes += npix * sizeof(int16);
+  if (this->open_qa) nbytes += npix * sizeof(uint8);
+  if (nbytes == 0) return true;
+  if (nbytes > *budget) {
+    printf("Input not cached (%lu MB, over the INPUT_CACHE_MB or "
+      "LEDAPS_INPUT_CACHE_MB budget); lines are read from the files\n",
+      (unsigned long)(nbytes >> 20));
+    return true;
+  }
+
+  for (ib = 0; ib < this->nband; ib++) {
+    if (!this->open[ib]) continue;
+    this->cache[ib] = (int16 *)malloc(npix * sizeof(int16));
+    if (this->cache[ib] == NULL)
+      RETURN_ERROR("allocating input cache", "CacheInput", false);
+    if (!ReadInputFile(this->fp_bin[ib], this->cache[ib], 
+                       npix * sizeof(int16)))
+      RETURN_ERROR("reading input band in cache", "CacheInput", false);
+  }
+  if (this->open_qa) {
+    this->cache_qa = (uint8 *)malloc(npix * sizeof(uint8));
+    if (this->cache_qa == NULL)
+      RETURN_ERROR("allocating input QA cache", "CacheInput", false);
+    if (!ReadInputFile(this->fp_bin_qa, this->cache_qa, npix * sizeof(uint8)))
+      RETURN_ERROR("reading input QA band in cache", "CacheInput", false);
+  }
+
+  *budget -= nbytes;
+  return true;
+}
+
+
 bool InputMetaCopy(Input_meta_t *this, int nband, Input_meta_t *copy) 
 {
   int ib;
@@ -368,10 +474,12 @@ bool GetXMLInput(Input_t *this, Espa_internal_meta_t *metadata, bool thermal)
         this->file_name[ib] = NULL;
         this->open[ib] = false;
         this->fp_bin[ib] = NULL;
+        this->cache[ib] = NULL;
     }
     this->open_qa = false;
     this->file_name_qa = NULL;
     this->fp_bin_qa = NULL;
+    this->cache_qa = NULL;
 
     /* Pull the appropriate data from the XML file */
     if (!strcmp (gmeta->satellite, "LANDSAT_1"))
@@ -79,6 +79,9 @@ typedef struct {
   bool open_qa;            /* Flag to indicate whether the specific input
                               file is open for access; 'true' = open, 
                               'false' = not open */
+  int16 *cache[NBAND_REFL_MAX]; /* Bands read in memory by CacheInput;
+                                   NULL = lines are read from the file */
+  uint8 *cache_qa;         /* QA band read in memory by CacheInput */
 } Input_t;
 
 /* Prototypes */
@@ -90,5 +93,6 @@ bool FreeInput(Input_t *this);
 bool InputMetaCopy(Input_meta_t *this, int nband, Input_meta_t *copy);
 bool GetXMLInput(Input_t *this, Espa_internal_meta_t *metadata, bool thermal);
 bool GetInputQALine(Input_t *this, int iline, uint8 *line);
+bool CacheInput(Input_t *this, size_t *budget);
 
 #endif
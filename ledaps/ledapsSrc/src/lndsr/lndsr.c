@@ -45,9 +45,13 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <string.h>
 #include <unistd.h>
 #include <math.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 #include "lndsr.h"
 #include "keyvalue.h"
@@ -65,6 +69,8 @@
 
 #include "read_grib_tools.h"
 #include "sixs_runs.h"
+#include "sixs_cache.h"
+#include "sixs_lut.h"
 
 #define AERO_NB_BANDS 3
 #define AERO_STATS_NB_BANDS 3
@@ -76,6 +82,48 @@
 /* #define DEBUG_AR	0 */
 /* #define DEBUG_CLD 1 */
 
+/* Lines per block of the surface reflectance pass */
+#define SR_BLOCK_LINES_PER_THREAD 4
+#define SR_BLOCK_MIN_LINES 16
+
+/* Block of lines of the surface reflectance pass */
+typedef struct {
+  int il_start;         /* First line of the block */
+  int nlines;           /* Number of lines in the block */
+  int16 ***line_in;     /* Input lines [line][band][sample] */
+  int16 **b6_line;      /* Thermal band lines [line][sample] */
+  int16 ***line_out;    /* Output lines [line][band][sample] */
+} Sr_block_t;
+
+/* The cloud, cloud shadow and dark target flags of the scene are kept
+   between the passes in one plane of bytes [line][sample]; above this size
+   it is mapped on a temporary file instead of being kept in memory */
+#define DDV_PLANE_MAX_MEM (512*1024*1024)
+
+/* Plane of dark target flags */
+typedef struct {
+  char *data;           /* Flags [line][sample] */
+  size_t size;          /* Size of the plane (bytes) */
+  bool mapped;          /* Whether the plane is mapped on a file */
+} Ddv_plane_t;
+
+/* Air temperature of cloud screening pass 1, mapped exactly on nodes every
+   ATEMP_GRID_STEP lines and samples (and on the last line and sample) and
+   expanded bilinearly in between; the grid is only used when it is within
+   ATEMP_GRID_MAX_ERR (K, one count of the thermal band) of the exact value
+   at the centers of its cells */
+#define ATEMP_GRID_STEP 40
+#define ATEMP_GRID_MAX_ERR 0.1
+
+/* Air temperature grid */
+typedef struct {
+  int nlines, nsamps;   /* Size of the scene */
+  int step;             /* Lines and samples between the nodes */
+  int nrows, ncols;     /* Number of nodes */
+  float *data;          /* Air temperature at the nodes [row][col] */
+  float *row;           /* Nodes interpolated to a line [col] */
+} Atemp_grid_t;
+
 /* DEM Definition: U_char format, 1 count = 100 meters */
 /* 0 = 0 meters */
 
@@ -113,18 +161,24 @@ int32 data_type,n_attrs,rank;
 #endif
 void chand(float *phi,float *muv,float *mus,float *tau_ray,float *actual_rho_ray);
 void csalbr(float *tau_ray,float *actual_S_r);
+int compute_gridcell_ray(Ar_gridcell_t *ar_gridcell,int nband);
 int update_atmos_coefs(atmos_t *atmos_coef,Ar_gridcell_t *ar_gridcell, sixs_tables_t *sixs_tables,int ***line_ar,Lut_t *lut,int nband, int bkgd_aerosol);
 int update_gridcell_atmos_coefs(int irow,int icol,atmos_t *atmos_coef,Ar_gridcell_t *ar_gridcell, sixs_tables_t *sixs_tables,int **line_ar,Lut_t *lut,int nband, int bkgd_aerosol);
 void set_sixs_path_from(const char *path);
 float calcuoz(short jday,float flat);
 float get_dem_spres(short *dem,float lat,float lon);
 void swapbytes(void *val,int nbbytes);
+int allocate_sr_block(Sr_block_t *blk, int nlines, int nband, int nband_out, int nsamp);
+void free_sr_block(Sr_block_t *blk);
+void compute_sr_qa_line(Lut_t *lut, Sr_interp_t *sr_interp, Sr_stats_t *sr_stats, int nband, int nsamp, int il, int16 **line_in, int16 *b6_line, char *ddv_line, int ***line_ar, int ***line_ar_stats, int16 **line_out);
+int allocate_ddv_plane(Ddv_plane_t *plane, size_t size);
+void free_ddv_plane(Ddv_plane_t *plane);
+bool get_pixel_atemp(Geoloc_t *space, t_ncep_ancillary *anc, int tmpint, double coef, int il, int is, float *atemp);
+int allocate_atemp_grid(Atemp_grid_t *grid, int step, int nlines, int nsamps);
+void free_atemp_grid(Atemp_grid_t *grid);
+bool fill_atemp_grid(Atemp_grid_t *grid, Geoloc_t *space, t_ncep_ancillary *anc, int tmpint, double coef, float *max_err);
+void expand_atemp_grid(Atemp_grid_t *grid, int il, float *atemp_line);
 
-#ifdef SAVE_6S_RESULTS
-#define SIXS_RESULTS_FILENAME "SIXS_RUN_RESULTS.TXT"
-int read_6S_results_from_file(char *filename,sixs_tables_t *sixs_tables);
-int write_6S_results_to_file(char *filename,sixs_tables_t *sixs_tables);
-#endif
 void sun_angles (short jday,float gmt,float flat,float flon,float *ts,float *fs);
 /* Functions */
 
@@ -135,7 +189,7 @@ int main (int argc, const char **argv) {
   InputOzon_t *ozon_input = NULL;
   Lut_t *lut = NULL;
   Output_t *output = NULL;
-  int i,j,il, is,ib,i_aot,j_aot,ifree;
+  int i,j,il, is,ib,ifree;
   int il_start, il_end, il_ar, il_region, is_ar;
   int16 *line_out[NBAND_SR_MAX];
   int16 *line_out_buf = NULL;
@@ -150,20 +204,28 @@ int main (int argc, const char **argv) {
   int *line_ar_stats_buf = NULL;
   int16** b6_line = NULL;
   int16* b6_line_buf = NULL;
-  float *atemp_line = NULL;
+  float **atemp_line = NULL;
+  float **rho7_line = NULL;
+  uint8 **clear_line = NULL;
+  cld_line_t *cld_line = NULL;
   uint8** qa_line = NULL;
   uint8* qa_line_buf = NULL;
   char **ddv_line = NULL;
-  char *ddv_line_buf = NULL;
+  Ddv_plane_t ddv_plane;
+  size_t ddv_region_size;
   char **rot_cld[3],**ptr_rot_cld[3],**ptr_tmp_cld;
   char **rot_cld_block_buf = NULL;
   char *rot_cld_buf = NULL;
   char envi_file[STR_SIZE]; /* name of the output ENVI header file */
   char *cptr = NULL;        /* pointer to the file extension */
-  bool refl_is_fill;
 
   Sr_stats_t sr_stats;
+  Sr_stats_t *sr_thread_stats = NULL;
+  Sr_interp_t *sr_interp = NULL;
+  Sr_block_t sr_block[3], *blk;
+  int nthreads, ithread, sr_block_nlines, nblocks;
   Ar_stats_t ar_stats;
+  Ar_work_t ar_work;
   Ar_gridcell_t ar_gridcell;
   float *prwv_in[NBAND_PRWV_MAX];
   float *prwv_in_buf = NULL;
@@ -172,14 +234,12 @@ int main (int argc, const char **argv) {
                                for polar scenes that are ascending or flipped */
   
   int nbpts;
-  int inter_aot[3];
   float scene_gmt;
 
   Geoloc_t *space = NULL;
   Space_def_t space_def;
   char *dem_name = NULL;
   Img_coord_float_t img;
-  Img_coord_int_t loc;
   Geo_coord_t geo;
 
   t_ncep_ancillary anc_O3,anc_WV,anc_SP,anc_ATEMP;
@@ -188,19 +248,24 @@ int main (int argc, const char **argv) {
   float tmpflt_arr[4];
   double coef;
   int tmpint;
+  size_t cache_budget;        /* memory left for the input cache (bytes) */
   int osize;
   int debug_flag;
 
   sixs_tables_t sixs_tables;
+  sixs_lut_t *sixs_lut;
   float center_lat,center_lon;
+#if defined(DEBUG_AR) || defined(DEBUG_CLD)
   char tmpfilename[128];
-  FILE *fdtmp/*, *fdtmp2 */;
-  int tmpid;                  /* file ID for temporary file (ID not used) */
+#endif
   
   short *dem_array;
   int dem_available;
   
   cld_diags_t cld_diags;
+  Atemp_grid_t atemp_grid;
+  bool use_atemp_grid;
+  float atemp_grid_err;
   	
   float flat,flon/*,fts,ffs*/;
   double delta_y,delta_x;
@@ -214,10 +279,6 @@ int main (int argc, const char **argv) {
   Espa_global_meta_t *gmeta = NULL;   /* pointer to global meta */
   Envi_header_t envi_hdr;             /* output ENVI header information */
   
-  /* Vermote additional variable declaration for the cloud mask May 29 2007 */
-  int anom;
-  float t6,t6s_seuil;
-  
   printf ("\nRunning lndsr ....\n");
   debug_flag= DEBUG_FLAG;
   no_ozone_file=0;
@@ -412,19 +473,31 @@ printf ("DEBUG: solar zenith angle: %f\n", input->meta.sun_zen * DEG);
 	}
   }
 
-  /* Allocate memory for one air temperature line */
-    atemp_line = (float *)calloc((size_t)(input->size.s),sizeof(float));
-    if (atemp_line == NULL) EXIT_ERROR("allocating atemp line", "main");
+  /* Allocate memory for the air temperature, band 7 and clear pixel lines
+     of the cloud screening */
+    atemp_line = (float **)calloc((size_t)(lut->ar_region_size.l),sizeof(float *));
+    rho7_line = (float **)calloc((size_t)(lut->ar_region_size.l),sizeof(float *));
+    clear_line = (uint8 **)calloc((size_t)(lut->ar_region_size.l),sizeof(uint8 *));
+    if (atemp_line == NULL || rho7_line == NULL || clear_line == NULL)
+      EXIT_ERROR("allocating atemp line", "main");
+    atemp_line[0] = (float *)calloc((size_t)(input->size.s * 
+      lut->ar_region_size.l),sizeof(float));
+    rho7_line[0] = (float *)calloc((size_t)(input->size.s * 
+      lut->ar_region_size.l),sizeof(float));
+    clear_line[0] = (uint8 *)calloc((size_t)(input->size.s * 
+      lut->ar_region_size.l),sizeof(uint8));
+    if (atemp_line[0] == NULL || rho7_line[0] == NULL || clear_line[0] == NULL)
+      EXIT_ERROR("allocating atemp line buffer", "main");
+    for (il = 1; il < lut->ar_region_size.l; il++) {
+      atemp_line[il]=atemp_line[il-1]+input->size.s;
+      rho7_line[il]=rho7_line[il-1]+input->size.s;
+      clear_line[il]=clear_line[il-1]+input->size.s;
+    }
 	 
-  /* Allocate memory for ddv line */
+  /* Allocate memory for ddv line; the lines point into the dark target
+     plane of the region being processed */
     ddv_line = (char**)calloc((size_t)(lut->ar_region_size.l),sizeof(char *));
     if (ddv_line == NULL) EXIT_ERROR("allocating ddv line", "main");
-    ddv_line_buf = (char*)calloc((size_t)(input->size.s * lut->ar_region_size.l),sizeof(char));
-    if (ddv_line_buf == NULL) EXIT_ERROR("allocating ddv line buffer", "main");
-	 for (il = 0; il < lut->ar_region_size.l; il++) {
-	 	ddv_line[il]=ddv_line_buf;
-		ddv_line_buf += input->size.s;
-	 }
 
   /* Allocate memory for rotating cloud buffer */
 
@@ -474,6 +547,9 @@ printf ("DEBUG: solar zenith angle: %f\n", input->meta.sun_zen * DEG);
   ar_gridcell.spres_dem=(float *)calloc((size_t)(lut->ar_size.s * lut->ar_size.l),sizeof(float));
   if (ar_gridcell.spres_dem == NULL)
     EXIT_ERROR("allocating ar_gridcell.spres_dem", "main");
+  ar_gridcell.ray=(Gridcell_ray_t *)calloc((size_t)(lut->ar_size.s * lut->ar_size.l),sizeof(Gridcell_ray_t));
+  if (ar_gridcell.ray == NULL)
+    EXIT_ERROR("allocating ar_gridcell.ray", "main");
 
 
   /* Allocate memory for output lines */
@@ -722,9 +798,6 @@ printf ("Acquisition Time: %02d:%02d:%fZ\n", input->meta.acq_date.hour, input->m
 	printf("True North adjustment = %f\n",adjust_north);
 
 
-#ifdef SAVE_6S_RESULTS
-	if (read_6S_results_from_file(SIXS_RESULTS_FILENAME,&sixs_tables)) {
-#endif
 /****
 	Run 6S and compute atmcor params
 ****/
@@ -786,11 +859,23 @@ printf ("Acquisition Time: %02d:%02d:%fZ\n", input->meta.acq_date.hour, input->m
 		default:
 			EXIT_ERROR("Unknown Instrument", "main");
 	}
-	create_6S_tables(&sixs_tables, &input->meta);
-#ifdef SAVE_6S_RESULTS
-	write_6S_results_to_file(SIXS_RESULTS_FILENAME,&sixs_tables);
+	if (param->sixs_lut_file != NULL) {
+		/* Interpolate in the precomputed 6S LUT, if the scene is on it */
+		sixs_lut = read_6S_lut(param->sixs_lut_file);
+		if (sixs_lut == NULL)
+			EXIT_ERROR("reading the 6S LUT", "main");
+		if (interpol_6S_lut(sixs_lut, &sixs_tables) == 0) {
+			printf("6S tables interpolated from %s\n", param->sixs_lut_file);
+		} else {
+			printf("WARNING: scene not covered by the 6S LUT, running 6S\n");
+			create_6S_tables_cached(&sixs_tables, param->sixs_workers,
+			  param->sixs_cache_dir);
+		}
+		free_6S_lut(sixs_lut);
+	} else {
+		create_6S_tables_cached(&sixs_tables, param->sixs_workers,
+		  param->sixs_cache_dir);
 	}
-#endif
 /***
    interpolate ancillary data for AR grid cells
 ***/
@@ -877,9 +962,25 @@ printf ("Acquisition Time: %02d:%02d:%fZ\n", input->meta.acq_date.hour, input->m
 	if (allocate_mem_atmos_coeff(nbpts,&atmos_coef))
         EXIT_ERROR("Allocating memory for atmos_coef", "main");
 
+    /* The geometry and pressure of the grid cells are final from here on */
+	compute_gridcell_ray(&ar_gridcell,input->nband);
+
     printf("Compute Atmos Params with aot550 = 0.01\n"); fflush(stdout);
 	update_atmos_coefs(&atmos_coef,&ar_gridcell, &sixs_tables,line_ar, lut,input->nband, 1);
 
+  /* The input is read by the three passes below; read it in memory once
+     if it fits in the cache budget */
+  if (param->input_cache_mb == 0) {
+    printf("Input cache disabled (INPUT_CACHE_MB or LEDAPS_INPUT_CACHE_MB "
+      "is 0); lines are read from the files\n");
+  } else {
+    cache_budget = (size_t)param->input_cache_mb << 20;
+    if (!CacheInput(input, &cache_budget))
+      EXIT_ERROR("caching input data", "main");
+    if (param->thermal_band && !CacheInput(input_b6, &cache_budget))
+      EXIT_ERROR("caching input thermal data", "main");
+  }
+
   /* Read input first time and compute clear pixels stats for internal cloud screening */
 
 /* allocate memory for cld_diags structure and clear sum and nb of obs */	
@@ -887,7 +988,45 @@ printf ("Acquisition Time: %02d:%02d:%fZ\n", input->meta.acq_date.hour, input->m
      		EXIT_ERROR("couldn't allocate memory from cld_diags","main");
 	}
 
-  for (il = 0; il < input->size.l; il++) {
+  /* The lines of an aerosol region are read, then screened in parallel with
+     OpenMP (ENABLE_THREADING=yes); each thread has its own line buffers */
+#ifdef _OPENMP
+  nthreads = omp_get_max_threads();
+#else
+  nthreads = 1;
+#endif
+  cld_line = (cld_line_t *)calloc((size_t)nthreads, sizeof(cld_line_t));
+  if (cld_line == NULL)
+    EXIT_ERROR("allocating cloud screening thread buffers", "main");
+  for (i = 0; i < nthreads; i++) {
+    if (allocate_cld_line(lut, input->size.s, &cld_line[i]))
+      EXIT_ERROR("allocating cloud screening line buffers", "main");
+  }
+
+  /* The air temperature is only used with the thermal band */
+  use_atemp_grid = false;
+  tmpint=(int)(scene_gmt/anc_ATEMP.timeres);
+  if (tmpint>=(anc_ATEMP.nblayers-1))
+    tmpint=anc_ATEMP.nblayers-2;
+  coef=(double)(scene_gmt-anc_ATEMP.time[tmpint])/anc_ATEMP.timeres;
+  if (param->thermal_band) {
+    if (allocate_atemp_grid(&atemp_grid, ATEMP_GRID_STEP, input->size.l,
+                            input->size.s))
+      EXIT_ERROR("allocating air temperature grid", "main");
+    if (!fill_atemp_grid(&atemp_grid, space, &anc_ATEMP, tmpint, coef,
+                         &atemp_grid_err))
+      EXIT_ERROR("mapping from space (2)", "main");
+    use_atemp_grid = (atemp_grid_err <= ATEMP_GRID_MAX_ERR);
+    printf("Air temperature grid: max error %f K, %s\n", atemp_grid_err,
+           use_atemp_grid ? "used" : "mapping every pixel");
+  }
+
+  for (il_start = 0; il_start < input->size.l; 
+       il_start += lut->ar_region_size.l) {
+    il_end = il_start + lut->ar_region_size.l - 1;
+    if (il_end >= input->size.l) il_end = input->size.l - 1;
+
+   for (il = il_start, il_region = 0; il <= il_end; il++, il_region++) {
 	if (!(il%100)) 
     {
        printf("Cloud screening for line %d\r",il);
@@ -896,38 +1035,52 @@ printf ("Acquisition Time: %02d:%02d:%fZ\n", input->meta.acq_date.hour, input->m
 
     /* Read each input band */
     for (ib = 0; ib < input->nband; ib++) {
-      if (!GetInputLine(input, ib, il, line_in[0][ib]))
+      if (!GetInputLine(input, ib, il, line_in[il_region][ib]))
         EXIT_ERROR("reading input data for a line (b)", "main");
     }
-    if (!GetInputQALine(input, il, qa_line[0]))
+    if (!GetInputQALine(input, il, qa_line[il_region]))
       EXIT_ERROR("reading input data for qa_line (1)", "main");
     if (param->thermal_band) {
-     if (!GetInputLine(input_b6, 0, il, b6_line[0]))
+     if (!GetInputLine(input_b6, 0, il, b6_line[il_region]))
        EXIT_ERROR("reading input data for b6_line (1)", "main");
     }
 
-    tmpint=(int)(scene_gmt/anc_ATEMP.timeres);
-    if (tmpint>=(anc_ATEMP.nblayers-1))
-	tmpint=anc_ATEMP.nblayers-2;
-    coef=(double)(scene_gmt-anc_ATEMP.time[tmpint])/anc_ATEMP.timeres;
-	img.is_fill=false;
-	img.l=il;
-    for (is=0;is < input->size.s; is++) {
-	img.s=is;
-		if (!from_space(space, &img, &geo))
-    	   EXIT_ERROR("mapping from space (2)", "main");
-        flat=geo.lat * DEG;
-        flon=geo.lon * DEG;
+    if (param->thermal_band) {
+      if (use_atemp_grid)
+        expand_atemp_grid(&atemp_grid, il, atemp_line[il_region]);
+      else {
+        for (is=0;is < input->size.s; is++) {
+          if (!get_pixel_atemp(space, &anc_ATEMP, tmpint, coef, il, is,
+                               &atemp_line[il_region][is]))
+            EXIT_ERROR("mapping from space (2)", "main");
+        }
+      }
+    }
+   }
 
-    	interpol_spatial_anc(&anc_ATEMP,flat,flon,tmpflt_arr);
-    	atemp_line[is]=(1.-coef)*tmpflt_arr[tmpint]+coef*tmpflt_arr[tmpint+1];
-	}
     /* Run Cld Screening Pass1 and compute stats */
-    if (param->thermal_band)
-      if (!cloud_detection_pass1(lut, input->size.s, il, line_in[0],
-        qa_line[0], b6_line[0], atemp_line,&cld_diags))
-          EXIT_ERROR("running cloud detection pass 1", "main");
+    if (param->thermal_band) {
+#ifdef _OPENMP
+      #pragma omp parallel for schedule(dynamic) private(ithread)
+#endif
+      for (il_region = 0; il_region <= il_end - il_start; il_region++) {
+#ifdef _OPENMP
+        ithread = omp_get_thread_num();
+#else
+        ithread = 0;
+#endif
+        if (!cloud_detection_pass1(lut, &cld_line[ithread], input->size.s,
+          il_start + il_region, line_in[il_region], qa_line[il_region],
+          b6_line[il_region], atemp_line[il_region], clear_line[il_region],
+          rho7_line[il_region]))
+            EXIT_ERROR("running cloud detection pass 1", "main");
+      }
+      update_cld_diags(&cld_diags, il_start, il_end - il_start + 1,
+        input->size.s, b6_line, clear_line, rho7_line);
+    }
   } /* end for */
+  if (param->thermal_band)
+    free_atemp_grid(&atemp_grid);
 
   if (param->thermal_band) {
 	for (il=0;il<cld_diags.nbrows;il++) {
@@ -977,7 +1130,8 @@ printf ("Acquisition Time: %02d:%02d:%fZ\n", input->meta.acq_date.hour, input->m
 			}
 		}
 	}
-	fill_cld_diags(&cld_diags);
+	if (fill_cld_diags(&cld_diags))
+		EXIT_ERROR("filling cloud diagnostics", "main");
 #ifdef DEBUG_CLD
 	for (il=0;il<cld_diags.nbrows;il++) 
 		for (is=0;is<cld_diags.nbcols;is++) 
@@ -987,14 +1141,11 @@ printf ("Acquisition Time: %02d:%02d:%fZ\n", input->meta.acq_date.hour, input->m
 #endif
   }
 /***
-	Create dark target temporary file
+	Create dark target plane, a whole number of regions
 ***/
-	strcpy(tmpfilename, "temporary_dark_target_XXXXXX");
-    if ((tmpid = mkstemp (tmpfilename)) < 1)
-      EXIT_ERROR("creating filename for dark target temporary file", "main");
-    close(tmpid);
-	if ((fdtmp=fopen(tmpfilename,"w"))==NULL)
-      EXIT_ERROR("creating dark target temporary file", "main");
+	ddv_region_size=(size_t)lut->ar_region_size.l*input->size.s;
+	if (allocate_ddv_plane(&ddv_plane,ddv_region_size*lut->ar_size.l))
+      EXIT_ERROR("allocating dark target plane", "main");
 
   /* Read input second time and create cloud and cloud shadow masks */
   ptr_rot_cld[0]=rot_cld[0];
@@ -1033,15 +1184,24 @@ printf ("Acquisition Time: %02d:%02d:%fZ\n", input->meta.acq_date.hour, input->m
 	  if (param->thermal_band) {
       	if (!GetInputLine(input_b6, 0, il, b6_line[il_region]))
       	 EXIT_ERROR("reading input data for b6_line (2)", "main");
+	  }
+    }
 
-        /* Run Cld Screening Pass2 */
-	    if (!cloud_detection_pass2(lut, input->size.s, il, line_in[il_region], qa_line[il_region], b6_line[il_region], &cld_diags , ptr_rot_cld[1][il_region]))
-      	  EXIT_ERROR("running cloud detection pass 2", "main");
-	  } else {
-	    if (!cloud_detection_pass2(lut, input->size.s, il, line_in[il_region], qa_line[il_region], NULL, &cld_diags , ptr_rot_cld[1][il_region]))
-      	  EXIT_ERROR("running cloud detection pass 2", "main");
-      }
-
+    /* Run Cld Screening Pass2 */
+#ifdef _OPENMP
+    #pragma omp parallel for schedule(dynamic) private(ithread)
+#endif
+    for (il_region = 0; il_region <= il_end - il_start; il_region++) {
+#ifdef _OPENMP
+      ithread = omp_get_thread_num();
+#else
+      ithread = 0;
+#endif
+      if (!cloud_detection_pass2(lut, &cld_line[ithread], input->size.s,
+        il_start + il_region, line_in[il_region], qa_line[il_region],
+        param->thermal_band ? b6_line[il_region] : NULL, &cld_diags,
+        ptr_rot_cld[1][il_region]))
+          EXIT_ERROR("running cloud detection pass 2", "main");
     }
 	if (param->thermal_band) {
 		/* Cloud Mask Dilation : 5 pixels */
@@ -1053,13 +1213,14 @@ printf ("Acquisition Time: %02d:%02d:%fZ\n", input->meta.acq_date.hour, input->m
       		EXIT_ERROR("running cloud shadow detection", "main");
 
 		/* Dilate Cloud shadow */
-		dilate_shadow_mask(lut, input->size.s, ptr_rot_cld, 5);
+		if (!dilate_shadow_mask(lut, input->size.s, ptr_rot_cld, 5))
+      		EXIT_ERROR("running cloud shadow dilation", "main");
 	}
 /***
-	Save cloud and cloud shadow in temporary file
+	Save cloud and cloud shadow of the previous region in the dark target plane
 ***/
 	if (il_ar > 0)
-		if (fwrite(ptr_rot_cld[0][0],lut->ar_region_size.l*input->size.s,1,fdtmp)!=1) EXIT_ERROR("writing dark target to temporary file", "main");
+		memcpy(ddv_plane.data+(il_ar-1)*ddv_region_size,ptr_rot_cld[0][0],ddv_region_size);
 	ptr_tmp_cld=ptr_rot_cld[0];
 	ptr_rot_cld[0]=ptr_rot_cld[1];
 	ptr_rot_cld[1]=ptr_rot_cld[2];
@@ -1068,20 +1229,18 @@ printf ("Acquisition Time: %02d:%02d:%fZ\n", input->meta.acq_date.hour, input->m
 		memset(&ptr_rot_cld[2][i][0],0,input->size.s);
   }
 /** Last Block */
-  dilate_shadow_mask(lut, input->size.s, ptr_rot_cld, 5);
-  if (fwrite(ptr_rot_cld[0][0],lut->ar_region_size.l*input->size.s,1,fdtmp)!=1) EXIT_ERROR("writing dark target to temporary file", "main");
-   fclose(fdtmp);
+  if (!dilate_shadow_mask(lut, input->size.s, ptr_rot_cld, 5))
+    EXIT_ERROR("running cloud shadow dilation", "main");
+  memcpy(ddv_plane.data+(il_ar-1)*ddv_region_size,ptr_rot_cld[0][0],ddv_region_size);
+  for (i = 0; i < nthreads; i++)
+    free_cld_line(&cld_line[i]);
+  free(cld_line);
 
-
-/***
-	Open temporary file for read and write
-***/
-	if ((fdtmp=fopen(tmpfilename,"r+"))==NULL) EXIT_ERROR("opening dark target temporary file (r+)", "main");
-/*	
-	if ((fdtmp2=fopen("Temporary_AOT1_File.dat","w"))==NULL) EXIT_ERROR("creating temporary aot1 file", "main");
-*/
   /* Read input second time and compute the aerosol for each region */
 
+  if (!ArWorkInit(lut, &ar_gridcell, &ar_work))
+    EXIT_ERROR("allocating the aerosol buffers", "main");
+
   for (il_start = 0, il_ar = 0; 
        il_start < input->size.l; 
        il_start += lut->ar_region_size.l, il_ar++) {
@@ -1099,8 +1258,9 @@ printf ("Acquisition Time: %02d:%02d:%fZ\n", input->meta.acq_date.hour, input->m
     il_end = il_start + lut->ar_region_size.l - 1;
     if (il_end >= input->size.l) il_end = input->size.l - 1;
 	 
-	if (fseek(fdtmp,(long)(il_ar*lut->ar_region_size.l*input->size.s),SEEK_SET)) EXIT_ERROR("seeking in temporary file (r)", "main");
-	if (fread(ddv_line[0],lut->ar_region_size.l*input->size.s,1,fdtmp)!=1) EXIT_ERROR("reading dark target to temporary file", "main");
+	/* The dark target map of the region is updated in place */
+	for (il = 0; il < lut->ar_region_size.l; il++)
+		ddv_line[il]=ddv_plane.data+il_ar*ddv_region_size+(size_t)il*input->size.s;
 
     /* Read each input band for each line in region */
 
@@ -1121,22 +1281,12 @@ printf ("Acquisition Time: %02d:%02d:%fZ\n", input->meta.acq_date.hour, input->m
 	diags_il_ar=il_ar;
 #endif
     if (!Ar(il_ar,lut, &input->size, line_in, ddv_line, line_ar[il_ar],
-        line_ar_stats[il_ar], &ar_stats, &ar_gridcell, &sixs_tables))
+        line_ar_stats[il_ar], &ar_stats, &ar_gridcell, &sixs_tables,
+        &ar_work))
       EXIT_ERROR("computing aerosol", "main");
-/***
-	Save dark target map in temporary file
-***/
-	if (fseek(fdtmp,il_ar*lut->ar_region_size.l*input->size.s,SEEK_SET)) EXIT_ERROR("seeking in temporary file (w)", "main");
-	if (fwrite(ddv_line[0],lut->ar_region_size.l*input->size.s,1,fdtmp)!=1) EXIT_ERROR("writing dark target to temporary file", "main");
-/**
-	if (fwrite(line_ar[il_ar][0],lut->ar_size.s*2,1,fdtmp2)!=1) EXIT_ERROR("writing aot1 to temporary file", "main");
-**/
   }
   printf("\n");
-  fclose(fdtmp);
-/**
-  fclose(fdtmp2);
-**/
+  ArWorkFree(&ar_work);
 #ifdef DEBUG_AR
 	fclose(fd_ar_diags);
 #endif
@@ -1144,7 +1294,8 @@ printf ("Acquisition Time: %02d:%02d:%fZ\n", input->meta.acq_date.hour, input->m
 	Fill Gaps in the coarse resolution aerosol product for bands 1(0), 2(1) and 3(2)
 	**/
 /*    printf("write Fill Gaps ..."); fflush(stdout); */
-   Fill_Ar_Gaps(lut, line_ar, 0);
+   if (Fill_Ar_Gaps(lut, line_ar, 0))
+     EXIT_ERROR("filling aerosol gaps", "main");
 /*    printf("WARNING NOT FILLING GAPS IN THE AEROSOL");*/
 /*    printf("Done\n"); fflush(stdout); */
 /*
@@ -1165,128 +1316,130 @@ printf ("Acquisition Time: %02d:%02d:%fZ\n", input->meta.acq_date.hour, input->m
 
   /* Re-read input and compute surface reflectance */
 
-/***
-	Open temporary file for read
-***/
-	if ((fdtmp=fopen(tmpfilename,"r"))==NULL) EXIT_ERROR("opening dark target temporary file", "main");
+  /* The lines are processed by blocks in a three-stage pipeline: while
+     block k is corrected, block k+1 is read and block k-1 is written, so
+     at most three blocks are in memory.  With OpenMP (ENABLE_THREADING=yes)
+     the reader and the writer each take a thread and all the threads share
+     the lines of the block being corrected; the blocks are written in
+     order, so the output doesn't depend on the number of threads. */
+  sr_block_nlines = SR_BLOCK_LINES_PER_THREAD * nthreads;
+  if (sr_block_nlines < SR_BLOCK_MIN_LINES)
+    sr_block_nlines = SR_BLOCK_MIN_LINES;
+  nblocks = (input->size.l + sr_block_nlines - 1) / sr_block_nlines;
+
+  for (i = 0; i < 3; i++) {
+    if (allocate_sr_block(&sr_block[i], sr_block_nlines, input->nband,
+        output->nband_tot, input->size.s))
+      EXIT_ERROR("allocating surface reflectance block", "main");
+  }
+  sr_interp = (Sr_interp_t *)calloc((size_t)nthreads, sizeof(Sr_interp_t));
+  sr_thread_stats = (Sr_stats_t *)calloc((size_t)nthreads,
+    sizeof(Sr_stats_t));
+  if (sr_interp == NULL  ||  sr_thread_stats == NULL)
+    EXIT_ERROR("allocating surface reflectance thread buffers", "main");
+  for (i = 0; i < nthreads; i++) {
+    if (!SrInterpInit(lut, input->size.s, &sr_interp[i]))
+      EXIT_ERROR("allocating the surface reflectance interpolation", "main");
+    sr_thread_stats[i] = sr_stats;
+  }
 
-  for (il = 0; il < input->size.l; il++) {
-	if (!(il%100)) 
+  for (i = 0; i < nblocks + 2; i++) {
+#ifdef _OPENMP
+    #pragma omp parallel private (blk, il, ib, j, ithread)
+#endif
     {
-       printf("Processing surface reflectance for line %d\r",il);
-       fflush(stdout);
-    }
-    /* Re-read each input band */
-
-    for (ib = 0; ib < input->nband; ib++) {
-      if (!GetInputLine(input, ib, il, line_in[0][ib]))
-        EXIT_ERROR("reading input data for a line (b)", "main");
-    }
-    
-     if (!GetInputLine(input_b6, 0, il, b6_line[0]))
-       EXIT_ERROR("reading input data for b6_line (1)", "main");
-
-    /* Compute the surface reflectance */
-  	if (!Sr(lut, input->size.s, il, line_in[0], line_out, &sr_stats))
- 	  EXIT_ERROR("computing surface reflectance for a line", "main");
-
-/***
-	Read line from dark target temporary file
-***/
-	if (fread(ddv_line[0],input->size.s,1,fdtmp)!=1) EXIT_ERROR("reading line from dark target temporary file", "main");
-
-	loc.l=il;
-  	 i_aot=il/lut->ar_region_size.l;
-	 for (is=0;is<input->size.s;is++) {
-	 	loc.s=is;
-		j_aot=is/lut->ar_region_size.s;
-
-        /* Initialize all QA bands to off */
-        line_out[lut->nband+FILL][is] = QA_OFF;
-        line_out[lut->nband+DDV][is] = QA_OFF;
-        line_out[lut->nband+CLOUD][is] = QA_OFF;
-        line_out[lut->nband+CLOUD_SHADOW][is] = QA_OFF;
-        line_out[lut->nband+SNOW][is] = QA_OFF;
-        line_out[lut->nband+LAND_WATER][is] = QA_OFF;   /* land */
-        line_out[lut->nband+ADJ_CLOUD][is] = QA_OFF;
-
-        /* Determine if this is a fill pixel -- mark as fill if any reflective
-           band for this pixel is fill */
-        refl_is_fill = false;
-        for (ib = 0; ib < input->nband; ib++) {
-		    if (line_in[0][ib][is] == lut->in_fill)
-                if (!refl_is_fill)
-                    refl_is_fill = true;
+      /* Reader: block i */
+#ifdef _OPENMP
+      #pragma omp single nowait
+#endif
+      if (i < nblocks) {
+        blk = &sr_block[i % 3];
+        blk->il_start = i * sr_block_nlines;
+        blk->nlines = input->size.l - blk->il_start;
+        if (blk->nlines > sr_block_nlines)
+          blk->nlines = sr_block_nlines;
+        for (j = 0; j < blk->nlines; j++) {
+          il = blk->il_start + j;
+          for (ib = 0; ib < input->nband; ib++) {
+            if (!GetInputLine(input, ib, il, blk->line_in[j][ib]))
+              EXIT_ERROR("reading input data for a line (b)", "main");
+          }
+          if (!GetInputLine(input_b6, 0, il, blk->b6_line[j]))
+            EXIT_ERROR("reading input data for b6_line (1)", "main");
         }
+      }
 
-        /* Process QA for each pixel */
-		if (!refl_is_fill) {  /* AOT / opacity */
-			ArInterp(lut, &loc, line_ar, inter_aot); 
-			line_out[lut->nband][is] = inter_aot[0];
-        /**
-        Set bits for internal cloud mask
-        bit 0: fill
-        bit 6: dense dark vegetation (DDV)
-        bit 8: SR-based cloud
-        bit 9: SR-based cloud shadow
-        bit 10: SR-based snow
-        bit 11: Spectral test-based land/water mask
-        bit 12: SR-based adjacent cloud
-        **/
-        if (ddv_line[0][is]&0x01)
-            line_out[lut->nband+DDV][is] = QA_ON;  /* set dark target bit */
-        if (ddv_line[0][is]&0x10)
-            line_out[lut->nband+LAND_WATER][is] = QA_OFF;  /* land */
-        else
-            line_out[lut->nband+LAND_WATER][is] = QA_ON;  /* water */
-        if (ddv_line[0][is]&0x20)
-            line_out[lut->nband+CLOUD][is] = QA_ON;  /* set internal cloud mask bit */
-        if (ddv_line[0][is]&0x80)
-            line_out[lut->nband+SNOW][is] = QA_ON;  /* set internal snow mask bit */
-        /* try to redo the cloud mask Vermote May 29 2007 */
-        /* reset cloud shadow and cloud adjacent bits - these are set
-           again in lndsrbm */
-        line_out[lut->nband+CLOUD_SHADOW][is] = QA_OFF;
-        line_out[lut->nband+ADJ_CLOUD][is] = QA_OFF;
-				
-		anom=line_out[0][is]-line_out[2][is]/2.;
-		t6=b6_line[0][is]*0.1;
-		t6s_seuil=280.+(1000.*0.01);
-		if (( ( anom > 300 ) && ( line_out[4][is] > 300) && ( t6 < t6s_seuil) )
-           || ( (line_out[2][is] > 5000) && ( t6 < t6s_seuil)))
-			line_out[lut->nband+CLOUD][is] = QA_ON;  /* set internal cloud mask bit */
-        else
-            line_out[lut->nband+CLOUD][is] = QA_OFF;  /* reset internal cloud mask */
-
-	   	line_out[lut->nband+NB_DARK][is]=line_ar_stats[i_aot][0][j_aot];
-	  	line_out[lut->nband+AVG_DARK][is]=line_ar_stats[i_aot][1][j_aot];
-	   	line_out[lut->nband+STD_DARK][is]=line_ar_stats[i_aot][2][j_aot];
-		} else {
-	   	line_out[lut->nband][is]=lut->aerosol_fill;
-	   	line_out[lut->nband+FILL][is] = QA_ON;  /* set fill bit */
-	   	line_out[lut->nband+NB_DARK][is]=0;
-	  	line_out[lut->nband+AVG_DARK][is]=lut->in_fill;
-	   	line_out[lut->nband+STD_DARK][is]=lut->in_fill;
-		}
-    } /* for is */
+      /* Writer: block i-2 */
+#ifdef _OPENMP
+      #pragma omp single nowait
+#endif
+      if (i >= 2) {
+        blk = &sr_block[(i - 2) % 3];
+        for (j = 0; j < blk->nlines; j++) {
+          il = blk->il_start + j;
+          if (!(il%100)) 
+          {
+             printf("Processing surface reflectance for line %d\r",il);
+             fflush(stdout);
+          }
+          /* line_out holds every output band of the line in output band
+             order: surface reflectance, atmospheric opacity and the QA
+             bands, which PutOutputLine writes as 8-bit products */
+          for (ib = 0; ib < output->nband_out; ib++) {
+            if (!PutOutputLine(output, ib, il, blk->line_out[j][ib]))
+              EXIT_ERROR("writing output data for a line", "main");
+          }
+        }
+      }
 
-  /* Write each output band */
-  for (ib = 0; ib < output->nband_out; ib++) {
-    if (ib >= lut->nband+FILL && ib <= lut->nband+ADJ_CLOUD) {
-       /* fill, DDV, cloud, cloud shadow, snow, land/water, and adjacent
-          cloud QA bands are all 8-bit products */
-      if (!PutOutputLine(output, ib, il, line_out[ib]))
-        EXIT_ERROR("writing output data for a line", "main");
+      /* Workers: block i-1 */
+      if (i >= 1  &&  i <= nblocks) {
+        blk = &sr_block[(i - 1) % 3];
+#ifdef _OPENMP
+        #pragma omp for schedule(dynamic) nowait
+#endif
+        for (j = 0; j < blk->nlines; j++) {
+#ifdef _OPENMP
+          ithread = omp_get_thread_num();
+#else
+          ithread = 0;
+#endif
+          compute_sr_qa_line(lut, &sr_interp[ithread],
+            &sr_thread_stats[ithread], input->nband, input->size.s,
+            blk->il_start + j, blk->line_in[j], blk->b6_line[j],
+            ddv_plane.data + (size_t)(blk->il_start + j) * input->size.s,
+            line_ar, line_ar_stats, blk->line_out[j]);
+        }
+      }
     }
-    else {
-      if (!PutOutputLine(output, ib, il, line_out[ib]))
-        EXIT_ERROR("writing output data for a line", "main");
+  }  /* for blocks */
+  printf("\n");
+  free_ddv_plane(&ddv_plane);
+
+  /* Merge the statistics of the threads */
+  for (i = 0; i < nthreads; i++) {
+    for (ib = 0; ib < lut->nband; ib++) {
+      sr_stats.nfill[ib] += sr_thread_stats[i].nfill[ib];
+      sr_stats.nsatu[ib] += sr_thread_stats[i].nsatu[ib];
+      sr_stats.nout_range[ib] += sr_thread_stats[i].nout_range[ib];
+      if (sr_thread_stats[i].first[ib]) continue;
+      if (sr_stats.first[ib]) {
+        sr_stats.sr_min[ib] = sr_thread_stats[i].sr_min[ib];
+        sr_stats.sr_max[ib] = sr_thread_stats[i].sr_max[ib];
+        sr_stats.first[ib] = false;
+      } else {
+        if (sr_thread_stats[i].sr_min[ib] < sr_stats.sr_min[ib])
+          sr_stats.sr_min[ib] = sr_thread_stats[i].sr_min[ib];
+        if (sr_thread_stats[i].sr_max[ib] > sr_stats.sr_max[ib])
+          sr_stats.sr_max[ib] = sr_thread_stats[i].sr_max[ib];
+      }
     }
+    SrInterpFree(&sr_interp[i]);
   }
-  }  /* for il */
-  printf("\n");
-  fclose(fdtmp);
-  unlink(tmpfilename); 
+  free(sr_interp);
+  free(sr_thread_stats);
+  for (i = 0; i < 3; i++)
+    free_sr_block(&sr_block[i]);
 	
   /* Print the statistics, skip bands that don't exist */
   printf(" total pixels %ld\n", ((long)input->size.l * (long)input->size.s));
@@ -1355,12 +1508,17 @@ printf ("Acquisition Time: %02d:%02d:%fZ\n", input->meta.acq_date.hour, input->m
   free(line_in[0]);
   free(line_in);
   free(qa_line[0]);
+  free(atemp_line[0]);
+  free(atemp_line);
+  free(rho7_line[0]);
+  free(rho7_line);
+  free(clear_line[0]);
+  free(clear_line);
   free(qa_line);
   if (param->thermal_band) {
   	free(b6_line[0]);
   	free(b6_line);
   }
-  free(ddv_line[0]);
   free(ddv_line);
   free(rot_cld[0][0]);
   free(rot_cld[0]);
@@ -1372,6 +1530,7 @@ printf ("Acquisition Time: %02d:%02d:%fZ\n", input->meta.acq_date.hour, input->m
   free(ar_gridcell.wv);
   free(ar_gridcell.spres);
   free(ar_gridcell.ozone);
+  free(ar_gridcell.ray);
 
   for (ifree=0; ifree<(param->num_ncep_files>0?4:1); ifree++) {
      if (anc_O3.data[ifree]!=NULL) free(anc_O3.data[ifree]);
@@ -1392,60 +1551,321 @@ printf ("Acquisition Time: %02d:%02d:%fZ\n", input->meta.acq_date.hour, input->m
 	  
 int allocate_mem_atmos_coeff(int nbpts,atmos_t *atmos_coef) {
 	int ib;
+	float *coef;
 	if ((atmos_coef->computed=(int *)malloc(nbpts*sizeof(int)))==(int *)NULL)
 		return -1;
-	for (ib=0;ib<7;ib++) {
-		if ((atmos_coef->tgOG[ib]=(float *)malloc(nbpts*sizeof(float)))==(float *)NULL)
-			return -1;
-		if ((atmos_coef->tgH2O[ib]=(float *)malloc(nbpts*sizeof(float)))==(float *)NULL)
-			return -1;
-		if ((atmos_coef->td_ra[ib]=(float *)malloc(nbpts*sizeof(float)))==(float *)NULL)
-			return -1;
-		if ((atmos_coef->tu_ra[ib]=(float *)malloc(nbpts*sizeof(float)))==(float *)NULL)
-			return -1;
-		if ((atmos_coef->rho_mol[ib]=(float *)malloc(nbpts*sizeof(float)))==(float *)NULL)
-			return -1;
-		if ((atmos_coef->rho_ra[ib]=(float *)malloc(nbpts*sizeof(float)))==(float *)NULL)
-			return -1;
-		if ((atmos_coef->td_da[ib]=(float *)malloc(nbpts*sizeof(float)))==(float *)NULL)
-			return -1;
-		if ((atmos_coef->tu_da[ib]=(float *)malloc(nbpts*sizeof(float)))==(float *)NULL)
-			return -1;
-		if ((atmos_coef->S_ra[ib]=(float *)malloc(nbpts*sizeof(float)))==(float *)NULL)
-			return -1;
-		if ((atmos_coef->td_r[ib]=(float *)malloc(nbpts*sizeof(float)))==(float *)NULL)
-			return -1;
-		if ((atmos_coef->tu_r[ib]=(float *)malloc(nbpts*sizeof(float)))==(float *)NULL)
-			return -1;
-		if ((atmos_coef->S_r[ib]=(float *)malloc(nbpts*sizeof(float)))==(float *)NULL)
-			return -1;
-		if ((atmos_coef->rho_r[ib]=(float *)malloc(nbpts*sizeof(float)))==(float *)NULL)
-			return -1;
+	if ((atmos_coef->coef=(float *)malloc((size_t)NB_ATMOS_COEF*7*nbpts*sizeof(float)))==(float *)NULL) {
+		free(atmos_coef->computed);
+		return -1;
 	}
+	coef=atmos_coef->coef;
+	for (ib=0;ib<7;ib++,coef+=nbpts) atmos_coef->tgOG[ib]=coef;
+	for (ib=0;ib<7;ib++,coef+=nbpts) atmos_coef->tgH2O[ib]=coef;
+	for (ib=0;ib<7;ib++,coef+=nbpts) atmos_coef->td_ra[ib]=coef;
+	for (ib=0;ib<7;ib++,coef+=nbpts) atmos_coef->tu_ra[ib]=coef;
+	for (ib=0;ib<7;ib++,coef+=nbpts) atmos_coef->rho_mol[ib]=coef;
+	for (ib=0;ib<7;ib++,coef+=nbpts) atmos_coef->rho_ra[ib]=coef;
+	for (ib=0;ib<7;ib++,coef+=nbpts) atmos_coef->td_da[ib]=coef;
+	for (ib=0;ib<7;ib++,coef+=nbpts) atmos_coef->tu_da[ib]=coef;
+	for (ib=0;ib<7;ib++,coef+=nbpts) atmos_coef->S_ra[ib]=coef;
+	for (ib=0;ib<7;ib++,coef+=nbpts) atmos_coef->td_r[ib]=coef;
+	for (ib=0;ib<7;ib++,coef+=nbpts) atmos_coef->tu_r[ib]=coef;
+	for (ib=0;ib<7;ib++,coef+=nbpts) atmos_coef->S_r[ib]=coef;
+	for (ib=0;ib<7;ib++,coef+=nbpts) atmos_coef->rho_r[ib]=coef;
 	return 0;
 }
 
 int free_mem_atmos_coeff(atmos_t *atmos_coef) {
-	int ib;
 	free(atmos_coef->computed);
-	for(ib=0;ib<7;ib++) {
-		free(atmos_coef->tgOG[ib]);
-		free(atmos_coef->tgH2O[ib]);
-		free(atmos_coef->td_ra[ib]);
-		free(atmos_coef->tu_ra[ib]);
-		free(atmos_coef->rho_mol[ib]);
-		free(atmos_coef->rho_ra[ib]);
-		free(atmos_coef->td_da[ib]);
-		free(atmos_coef->tu_da[ib]);
-		free(atmos_coef->S_ra[ib]);
-		free(atmos_coef->td_r[ib]);
-		free(atmos_coef->tu_r[ib]);
-		free(atmos_coef->S_r[ib]);
-		free(atmos_coef->rho_r[ib]);
+	free(atmos_coef->coef);
+	return 0;
+}
+
+int allocate_sr_block(Sr_block_t *blk, int nlines, int nband, int nband_out, int nsamp) {
+	int il,ib;
+	int16 *in_buf,*out_buf;
+	blk->il_start=0;
+	blk->nlines=0;
+	blk->line_in=(int16 ***)calloc((size_t)nlines,sizeof(int16 **));
+	blk->line_out=(int16 ***)calloc((size_t)nlines,sizeof(int16 **));
+	blk->b6_line=(int16 **)calloc((size_t)nlines,sizeof(int16 *));
+	if (blk->line_in==NULL || blk->line_out==NULL || blk->b6_line==NULL)
+		return -1;
+	if ((blk->line_in[0]=(int16 **)calloc((size_t)(nlines*nband),sizeof(int16 *)))==NULL)
+		return -1;
+	if ((blk->line_out[0]=(int16 **)calloc((size_t)(nlines*nband_out),sizeof(int16 *)))==NULL)
+		return -1;
+	if ((in_buf=(int16 *)calloc((size_t)nlines*(nband+1)*nsamp,sizeof(int16)))==NULL)
+		return -1;
+	if ((out_buf=(int16 *)calloc((size_t)nlines*nband_out*nsamp,sizeof(int16)))==NULL)
+		return -1;
+	for (il=0;il<nlines;il++) {
+		blk->line_in[il]=blk->line_in[0]+il*nband;
+		blk->line_out[il]=blk->line_out[0]+il*nband_out;
+		for (ib=0;ib<nband;ib++,in_buf+=nsamp)
+			blk->line_in[il][ib]=in_buf;
+		for (ib=0;ib<nband_out;ib++,out_buf+=nsamp)
+			blk->line_out[il][ib]=out_buf;
+		blk->b6_line[il]=in_buf;
+		in_buf+=nsamp;
+	}
+	return 0;
+}
+
+void free_sr_block(Sr_block_t *blk) {
+	free(blk->line_in[0][0]);
+	free(blk->line_out[0][0]);
+	free(blk->line_in[0]);
+	free(blk->line_out[0]);
+	free(blk->line_in);
+	free(blk->line_out);
+	free(blk->b6_line);
+}
+
+int allocate_ddv_plane(Ddv_plane_t *plane, size_t size) {
+/* Allocates the dark target plane in memory, or maps it on a temporary
+   file when it is larger than DDV_PLANE_MAX_MEM.  The file is unlinked as
+   soon as it is mapped, so it doesn't outlive the run and concurrent runs
+   don't share it. */
+	char filename[64];
+	int fd;
+	plane->size=size;
+	plane->mapped=(size>DDV_PLANE_MAX_MEM);
+	if (!plane->mapped) {
+		plane->data=(char *)calloc(size,sizeof(char));
+		return (plane->data==NULL)?-1:0;
+	}
+	strcpy(filename,"temporary_dark_target_XXXXXX");
+	if ((fd=mkstemp(filename))<0)
+		return -1;
+	unlink(filename);
+	if (ftruncate(fd,(off_t)size)) {
+		close(fd);
+		return -1;
+	}
+	plane->data=(char *)mmap(NULL,size,PROT_READ|PROT_WRITE,MAP_SHARED,fd,0);
+	close(fd);
+	if (plane->data==(char *)MAP_FAILED) {
+		plane->data=NULL;
+		return -1;
+	}
+	return 0;
+}
+
+void free_ddv_plane(Ddv_plane_t *plane) {
+	if (plane->mapped)
+		munmap(plane->data,plane->size);
+	else
+		free(plane->data);
+	plane->data=NULL;
+}
+
+bool get_pixel_atemp(Geoloc_t *space, t_ncep_ancillary *anc, int tmpint, double coef, int il, int is, float *atemp) {
+/* Exact air temperature of a pixel, at the scene time (tmpint, coef) */
+	Img_coord_float_t img;
+	Geo_coord_t geo;
+	float tmpflt_arr[4];
+	img.is_fill=false;
+	img.l=il;
+	img.s=is;
+	if (!from_space(space, &img, &geo))
+		return false;
+	interpol_spatial_anc(anc,geo.lat * DEG,geo.lon * DEG,tmpflt_arr);
+	*atemp=(1.-coef)*tmpflt_arr[tmpint]+coef*tmpflt_arr[tmpint+1];
+	return true;
+}
+
+int allocate_atemp_grid(Atemp_grid_t *grid, int step, int nlines, int nsamps) {
+	grid->nlines=nlines;
+	grid->nsamps=nsamps;
+	grid->step=step;
+	grid->nrows=(nlines-1+step-1)/step+1;
+	grid->ncols=(nsamps-1+step-1)/step+1;
+	grid->data=(float *)malloc((size_t)grid->nrows*grid->ncols*sizeof(float));
+	grid->row=(float *)malloc(grid->ncols*sizeof(float));
+	if (grid->data==NULL || grid->row==NULL) {
+		free_atemp_grid(grid);
+		return -1;
 	}
 	return 0;
 }
 
+void free_atemp_grid(Atemp_grid_t *grid) {
+	free(grid->data);
+	free(grid->row);
+	grid->data=grid->row=NULL;
+}
+
+bool fill_atemp_grid(Atemp_grid_t *grid, Geoloc_t *space, t_ncep_ancillary *anc, int tmpint, double coef, float *max_err) {
+/* Maps the nodes, then compares the expanded grid with the exact air
+   temperature at the center of each cell; max_err is the largest
+   difference (K) */
+	int ir,ic,il,is,step=grid->step;
+	float exact,*line;
+
+	for (ir=0;ir<grid->nrows;ir++) {
+		il=ir*step;
+		if (il>=grid->nlines) il=grid->nlines-1;
+		for (ic=0;ic<grid->ncols;ic++) {
+			is=ic*step;
+			if (is>=grid->nsamps) is=grid->nsamps-1;
+			if (!get_pixel_atemp(space,anc,tmpint,coef,il,is,&grid->data[ir*grid->ncols+ic]))
+				return false;
+		}
+	}
+
+	*max_err=0.;
+	if ((line=(float *)malloc(grid->nsamps*sizeof(float)))==NULL)
+		return false;
+	for (ir=0;ir<grid->nrows-1;ir++) {
+		il=ir*step+step;
+		if (il>=grid->nlines) il=grid->nlines-1;
+		il=(ir*step+il)/2;
+		expand_atemp_grid(grid,il,line);
+		for (ic=0;ic<grid->ncols-1;ic++) {
+			is=ic*step+step;
+			if (is>=grid->nsamps) is=grid->nsamps-1;
+			is=(ic*step+is)/2;
+			if (!get_pixel_atemp(space,anc,tmpint,coef,il,is,&exact)) {
+				free(line);
+				return false;
+			}
+			if (fabs(exact-line[is])>*max_err)
+				*max_err=fabs(exact-line[is]);
+		}
+	}
+	free(line);
+	return true;
+}
+
+void expand_atemp_grid(Atemp_grid_t *grid, int il, float *atemp_line) {
+/* Air temperature of line il, bilinear between the nodes */
+	int ir,ic,is,is0,is1,l0,l1,step=grid->step,ncols=grid->ncols;
+	float wl,ds,*row=grid->row;
+	const float *r0,*r1;
+
+	ir=il/step;
+	if (ir>grid->nrows-2) ir=grid->nrows-2;
+	if (ir<0) {
+		/* single line of nodes */
+		r0=r1=grid->data;
+		wl=0.;
+	} else {
+		l0=ir*step;
+		l1=l0+step;
+		if (l1>=grid->nlines) l1=grid->nlines-1;
+		r0=grid->data+ir*ncols;
+		r1=r0+ncols;
+		wl=(float)(il-l0)/(l1-l0);
+	}
+	for (ic=0;ic<ncols;ic++)
+		row[ic]=(1.-wl)*r0[ic]+wl*r1[ic];
+
+	if (ncols==1) {
+		atemp_line[0]=row[0];
+		return;
+	}
+	for (ic=0;ic<ncols-1;ic++) {
+		is0=ic*step;
+		is1=is0+step;
+		if (is1>=grid->nsamps) is1=grid->nsamps-1;
+		ds=(row[ic+1]-row[ic])/(is1-is0);
+		for (is=is0;is<is1;is++)
+			atemp_line[is]=row[ic]+ds*(is-is0);
+	}
+	atemp_line[grid->nsamps-1]=row[ncols-1];
+}
+
+void compute_sr_qa_line(Lut_t *lut, Sr_interp_t *sr_interp, Sr_stats_t *sr_stats, int nband, int nsamp, int il, int16 **line_in, int16 *b6_line, char *ddv_line, int ***line_ar, int ***line_ar_stats, int16 **line_out) {
+/* Computes the surface reflectance and the QA of line il */
+  Img_coord_int_t loc;
+  int is,ib,i_aot,j_aot;
+  int inter_aot[3];
+  bool refl_is_fill;
+  /* Vermote additional variable declaration for the cloud mask May 29 2007 */
+  int anom;
+  float t6,t6s_seuil;
+
+    /* Compute the surface reflectance */
+  	if (!Sr(lut, sr_interp, nsamp, il, line_in, line_out, sr_stats))
+ 	  EXIT_ERROR("computing surface reflectance for a line", "compute_sr_qa_line");
+
+	loc.l=il;
+  	 i_aot=il/lut->ar_region_size.l;
+	 for (is=0;is<nsamp;is++) {
+	 	loc.s=is;
+		j_aot=is/lut->ar_region_size.s;
+
+        /* Initialize all QA bands to off */
+        line_out[lut->nband+FILL][is] = QA_OFF;
+        line_out[lut->nband+DDV][is] = QA_OFF;
+        line_out[lut->nband+CLOUD][is] = QA_OFF;
+        line_out[lut->nband+CLOUD_SHADOW][is] = QA_OFF;
+        line_out[lut->nband+SNOW][is] = QA_OFF;
+        line_out[lut->nband+LAND_WATER][is] = QA_OFF;   /* land */
+        line_out[lut->nband+ADJ_CLOUD][is] = QA_OFF;
+
+        /* Determine if this is a fill pixel -- mark as fill if any reflective
+           band for this pixel is fill */
+        refl_is_fill = false;
+        for (ib = 0; ib < nband; ib++) {
+		    if (line_in[ib][is] == lut->in_fill)
+                if (!refl_is_fill)
+                    refl_is_fill = true;
+        }
+
+        /* Process QA for each pixel */
+		if (!refl_is_fill) {  /* AOT / opacity */
+			ArInterp(lut, &loc, line_ar, inter_aot); 
+			line_out[lut->nband][is] = inter_aot[0];
+        /**
+        Set bits for internal cloud mask
+        bit 0: fill
+        bit 6: dense dark vegetation (DDV)
+        bit 8: SR-based cloud
+        bit 9: SR-based cloud shadow
+        bit 10: SR-based snow
+        bit 11: Spectral test-based land/water mask
+        bit 12: SR-based adjacent cloud
+        **/
+        if (ddv_line[is]&0x01)
+            line_out[lut->nband+DDV][is] = QA_ON;  /* set dark target bit */
+        if (ddv_line[is]&0x10)
+            line_out[lut->nband+LAND_WATER][is] = QA_OFF;  /* land */
+        else
+            line_out[lut->nband+LAND_WATER][is] = QA_ON;  /* water */
+        if (ddv_line[is]&0x20)
+            line_out[lut->nband+CLOUD][is] = QA_ON;  /* set internal cloud mask bit */
+        if (ddv_line[is]&0x80)
+            line_out[lut->nband+SNOW][is] = QA_ON;  /* set internal snow mask bit */
+        /* try to redo the cloud mask Vermote May 29 2007 */
+        /* reset cloud shadow and cloud adjacent bits - these are set
+           again in lndsrbm */
+        line_out[lut->nband+CLOUD_SHADOW][is] = QA_OFF;
+        line_out[lut->nband+ADJ_CLOUD][is] = QA_OFF;
+				
+		anom=line_out[0][is]-line_out[2][is]/2.;
+		t6=b6_line[is]*0.1;
+		t6s_seuil=280.+(1000.*0.01);
+		if (( ( anom > 300 ) && ( line_out[4][is] > 300) && ( t6 < t6s_seuil) )
+           || ( (line_out[2][is] > 5000) && ( t6 < t6s_seuil)))
+			line_out[lut->nband+CLOUD][is] = QA_ON;  /* set internal cloud mask bit */
+        else
+            line_out[lut->nband+CLOUD][is] = QA_OFF;  /* reset internal cloud mask */
+
+	   	line_out[lut->nband+NB_DARK][is]=line_ar_stats[i_aot][0][j_aot];
+	  	line_out[lut->nband+AVG_DARK][is]=line_ar_stats[i_aot][1][j_aot];
+	   	line_out[lut->nband+STD_DARK][is]=line_ar_stats[i_aot][2][j_aot];
+		} else {
+	   	line_out[lut->nband][is]=lut->aerosol_fill;
+	   	line_out[lut->nband+FILL][is] = QA_ON;  /* set fill bit */
+	   	line_out[lut->nband+NB_DARK][is]=0;
+	  	line_out[lut->nband+AVG_DARK][is]=lut->in_fill;
+	   	line_out[lut->nband+STD_DARK][is]=lut->in_fill;
+		}
+    } /* for is */
+}
+
 float calcuoz(short jday,float flat) {
 /******************************************************************************
 !C
@@ -1600,28 +2020,66 @@ void swapbytes(void *val,int nbbytes) {
     tmpptr1[i]=tmpptr2[nbbytes-i-1];
 }
 
+/* Rayleigh optical depth at sea level; index=5 => band 7 */
+static const float tau_ray_sealevel[7]={0.16511,0.08614,0.04716,0.01835,0.00113,0.00037};
+
+/* Compute the Rayleigh terms of every grid cell at its surface pressure
+   (DEM-based pressure correction); they don't depend on the aerosol */
+int compute_gridcell_ray(Ar_gridcell_t *ar_gridcell,int nband) {
+	int ib,ipt,nbpts;
+	float mus,muv,phi,ratio_spres,tau_ray;
+	Gridcell_ray_t *ray;
+
+	nbpts=ar_gridcell->nbrows*ar_gridcell->nbcols;
+#ifdef _OPENMP
+	#pragma omp parallel for schedule(static) private(ib,mus,muv,phi,ratio_spres,tau_ray,ray)
+#endif
+	for (ipt=0;ipt<nbpts;ipt++) {
+		ray=&ar_gridcell->ray[ipt];
+		mus=cos(ar_gridcell->sun_zen[ipt]*RAD);
+		muv=cos(ar_gridcell->view_zen[ipt]*RAD);
+		phi=ar_gridcell->rel_az[ipt];
+		ratio_spres=ar_gridcell->spres[ipt]/1013.;
+		for (ib=0;ib < nband; ib++) {
+			tau_ray=tau_ray_sealevel[ib]*ratio_spres;
+	
+			chand(&phi,&muv,&mus,&tau_ray,&ray->rho_r[ib]);
+
+			ray->T_r_down[ib]=((2./3.+mus)+(2./3.-mus)*exp(-tau_ray/mus))/(4./3.+tau_ray); /* downward */
+			ray->T_r_up[ib] = ((2./3.+muv)+(2./3.-muv)*exp(-tau_ray/muv))/(4./3.+tau_ray); /* upward */
+
+			csalbr(&tau_ray,&ray->S_r[ib]);
+		}
+	}
+	return 0;
+}
+
+/* The grid cells are independent, so they are updated in parallel */
 int update_atmos_coefs(atmos_t *atmos_coef,Ar_gridcell_t *ar_gridcell, sixs_tables_t *sixs_tables,int ***line_ar,Lut_t *lut,int nband, int bkgd_aerosol) {
-	int irow,icol;
-	for (irow=0;irow<ar_gridcell->nbrows;irow++)
-		for (icol=0;icol<ar_gridcell->nbcols;icol++)
-			update_gridcell_atmos_coefs(irow,icol,atmos_coef,ar_gridcell, sixs_tables,line_ar[irow],lut,nband,bkgd_aerosol);
+	int irow,icol,ipt,nbpts;
+	nbpts=ar_gridcell->nbrows*ar_gridcell->nbcols;
+#ifdef _OPENMP
+	#pragma omp parallel for schedule(static) private(irow,icol)
+#endif
+	for (ipt=0;ipt<nbpts;ipt++) {
+		irow=ipt/ar_gridcell->nbcols;
+		icol=ipt%ar_gridcell->nbcols;
+		update_gridcell_atmos_coefs(irow,icol,atmos_coef,ar_gridcell, sixs_tables,line_ar[irow],lut,nband,bkgd_aerosol);
+	}
 	return 0;
 }
 
 int update_gridcell_atmos_coefs(int irow,int icol,atmos_t *atmos_coef,Ar_gridcell_t *ar_gridcell, sixs_tables_t *sixs_tables,int **line_ar,Lut_t *lut,int nband, int bkgd_aerosol) {
 	int ib,ipt,k;
-	float mus,muv,phi,ratio_spres,tau_ray,aot550;
+	float aot550;
 	double coef;
 	float actual_rho_ray,actual_T_ray_up,actual_T_ray_down,actual_S_r;
 	float rho_ray_P0,T_ray_up_P0,T_ray_down_P0,S_r_P0;
 	float lamda[7]={486.,570.,660.,835.,1669.,0.,2207.};
-	float tau_ray_sealevel[7]={0.16511,0.08614,0.04716,0.01835,0.00113,0.00037}; /* index=5 => band 7 */
+	const Gridcell_ray_t *ray;
 
 		ipt=irow*ar_gridcell->nbcols+icol;	
-		mus=cos(ar_gridcell->sun_zen[ipt]*RAD);
-		muv=cos(ar_gridcell->view_zen[ipt]*RAD);
-		phi=ar_gridcell->rel_az[ipt];
-		ratio_spres=ar_gridcell->spres[ipt]/1013.;
+		ray=&ar_gridcell->ray[ipt];
 		if (bkgd_aerosol) {
 			atmos_coef->computed[ipt]=1;
 			aot550=0.01;
@@ -1645,7 +2103,6 @@ int update_gridcell_atmos_coefs(int irow,int icol,atmos_t *atmos_coef,Ar_gridcel
 		coef=(aot550-sixs_tables->aot[k])/(sixs_tables->aot[k+1]-sixs_tables->aot[k]);
 
 
-/*                printf("pressure ratio %d %d %f \n",irow,icol,ratio_spres);*/
 		for (ib=0;ib < nband; ib++) {
 			atmos_coef->tgOG[ib][ipt]=sixs_tables->T_g_og[ib];				
 			atmos_coef->tgH2O[ib][ipt]=sixs_tables->T_g_wv[ib];				
@@ -1657,16 +2114,12 @@ int update_gridcell_atmos_coefs(int irow,int icol,atmos_t *atmos_coef,Ar_gridcel
 			atmos_coef->tu_da[ib][ipt]=(1.-coef)*sixs_tables->T_a_up[ib][k]+coef*sixs_tables->T_a_up[ib][k+1];
 			atmos_coef->S_ra[ib][ipt]=(1.-coef)*sixs_tables->S_ra[ib][k]+coef*sixs_tables->S_ra[ib][k+1];
 /**
-			compute DEM-based pressure correction for each grid point
+			DEM-based pressure correction for each grid point (compute_gridcell_ray)
 **/
-			tau_ray=tau_ray_sealevel[ib]*ratio_spres;
-	
-			chand(&phi,&muv,&mus,&tau_ray,&actual_rho_ray);
-
-			actual_T_ray_down=((2./3.+mus)+(2./3.-mus)*exp(-tau_ray/mus))/(4./3.+tau_ray); /* downward */
-			actual_T_ray_up = ((2./3.+muv)+(2./3.-muv)*exp(-tau_ray/muv))/(4./3.+tau_ray); /* upward */
-
-			csalbr(&tau_ray,&actual_S_r);
+			actual_rho_ray=ray->rho_r[ib];
+			actual_T_ray_down=ray->T_r_down[ib];
+			actual_T_ray_up=ray->T_r_up[ib];
+			actual_S_r=ray->S_r[ib];
 						
 			rho_ray_P0=sixs_tables->rho_r[ib];
 			T_ray_down_P0=sixs_tables->T_r_down[ib];
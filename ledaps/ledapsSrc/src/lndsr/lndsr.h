@@ -95,6 +95,14 @@ typedef enum {
 
 extern const Key_string_t Ozsrc_string[OZSRC_MAX];
 
+/* Rayleigh terms of a grid cell at its surface pressure.  They only depend
+   on the cell geometry and pressure, so they are computed once per cell
+   (compute_gridcell_ray) and reused by every update of the coefficients */
+typedef struct {
+  float rho_r[NBAND_REFL_MAX],T_r_down[NBAND_REFL_MAX];
+  float T_r_up[NBAND_REFL_MAX],S_r[NBAND_REFL_MAX];
+} Gridcell_ray_t;
+
 typedef struct {
   int nbrows,nbcols;
   float *lat,*lon;
@@ -102,12 +110,18 @@ typedef struct {
   float *wv,*spres,*ozone,*spres_dem;
   float *line_lat,*line_lon,*line_sun_zen,*line_view_zen,*line_rel_az;
   float *line_wv,*line_spres,*line_ozone,*line_spres_dem;
+  Gridcell_ray_t *ray;
 } Ar_gridcell_t;
 
+/* The coefficients of all the bands and grid points are kept in one block,
+   coef[coefficient][band][point]; the per-band pointers point into it */
+#define NB_ATMOS_COEF 13
+
 typedef struct {
 int *computed;
 float *tgOG[7],*tgH2O[7],*td_ra[7],*tu_ra[7],*rho_mol[7],*rho_ra[7],*td_da[7],*tu_da[7],*S_ra[7];
 float *td_r[7],*tu_r[7],*S_r[7],*rho_r[7];
+float *coef;
 } atmos_t;
 
 int allocate_mem_atmos_coeff(int nbpts,atmos_t *atmos_coef);
@@ -0,0 +1,281 @@
+/**************************************************************************
+! Description:
+  lndsrlut builds the precomputed 6S lookup table lndsr uses in place of
+  the per-scene 6S runs (SIXS_LUT_FILE parameter), then checks the table
+  against direct 6S runs at random points of the grid and reports the
+  interpolation error of every term, to help size the grid.
+
+  usage: lndsrlut [-workers n] [-validate n] [-sza list] [-phi list]
+                  [-uwv list] [-uoz list] TM|ETM lut_file
+
+  The lists are comma separated and increasing.  The scattering terms are
+  computed on the sza x phi grid, the gas transmittances on the
+  sza x uwv x uoz grid (see sixs_lut.h).  The fixed 6S inputs are the ones
+  lndsr uses.
+**************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <math.h>
+
+#include "sixs_runs.h"
+#include "sixs_lut.h"
+
+#define LUT_MAX_NODES 200
+
+/* Fixed 6S inputs, as set in lndsr */
+#define LUT_VZA 0.
+#define LUT_MONTH 9
+#define LUT_DAY 15
+#define LUT_SREFL 0.14
+#define LUT_TARGET_ALT 0.
+
+/* Default grids */
+static const char *default_sza="0,5,10,15,20,25,30,35,40,45,50,55,60,65,70,"
+  "75,80";
+static const char *default_phi="0,360";
+static const char *default_uwv="0,0.25,0.5,1,1.5,2,2.5,3,3.5,4,5,6,7,8";
+static const char *default_uoz="0.15,0.2,0.25,0.3,0.35,0.4,0.45,0.5,0.55";
+
+/* Terms reported by the validation */
+#define LUT_FIELD(f) {#f,offsetof(sixs_tables_t,f),sizeof(((sixs_tables_t *)0)->f)/sizeof(float)}
+static const struct {
+	const char *name;
+	size_t offset;
+	int nvals;
+} lut_fields[] = {
+	LUT_FIELD(aot_wavelength),
+	LUT_FIELD(S_r),
+	LUT_FIELD(T_a_up),
+	LUT_FIELD(T_a_down),
+	LUT_FIELD(T_a),
+	LUT_FIELD(rho_ra),
+	LUT_FIELD(rho_a),
+	LUT_FIELD(S_ra),
+	LUT_FIELD(T_ra_up),
+	LUT_FIELD(T_ra_down),
+	LUT_FIELD(T_ra),
+	LUT_FIELD(T_r_up),
+	LUT_FIELD(T_r_down),
+	LUT_FIELD(T_r),
+	LUT_FIELD(T_g_wv),
+	LUT_FIELD(T_g_og),
+	LUT_FIELD(rho_r)
+};
+#define LUT_NB_FIELDS (int)(sizeof(lut_fields)/sizeof(lut_fields[0]))
+
+static int parse_list(const char *str, float *vals);
+static void set_fixed_inputs(sixs_tables_t *sixs_tables, Sixs_Inst_t inst);
+static void validate_lut(const sixs_lut_t *lut, int nvalid, int nworkers);
+static void usage(void);
+
+/* sixs_runs.c still refers to the 6S executable for the functions lndsr
+   doesn't use */
+char *get_sixs_path() {
+	return "sixsV1.0B";
+}
+
+int main(int argc, char **argv) {
+	const char *sza_list=default_sza,*phi_list=default_phi;
+	const char *uwv_list=default_uwv,*uoz_list=default_uoz;
+	float sza[LUT_MAX_NODES],phi[LUT_MAX_NODES];
+	float uwv[LUT_MAX_NODES],uoz[LUT_MAX_NODES];
+	int nsza,nphi,nuwv,nuoz;
+	int nworkers=0,nvalid=10;
+	int i,k,l,m,n;
+	Sixs_Inst_t inst;
+	sixs_tables_t sixs_tables;
+	sixs_lut_t *lut;
+	float *node;
+
+	for (i=1;i<argc && argv[i][0]=='-';i+=2) {
+		if (i+1>=argc)
+			usage();
+		if (!strcmp(argv[i],"-workers"))
+			nworkers=atoi(argv[i+1]);
+		else if (!strcmp(argv[i],"-validate"))
+			nvalid=atoi(argv[i+1]);
+		else if (!strcmp(argv[i],"-sza"))
+			sza_list=argv[i+1];
+		else if (!strcmp(argv[i],"-phi"))
+			phi_list=argv[i+1];
+		else if (!strcmp(argv[i],"-uwv"))
+			uwv_list=argv[i+1];
+		else if (!strcmp(argv[i],"-uoz"))
+			uoz_list=argv[i+1];
+		else
+			usage();
+	}
+	if (argc-i!=2)
+		usage();
+	if (!strcmp(argv[i],"TM"))
+		inst=SIXS_INST_TM;
+	else if (!strcmp(argv[i],"ETM"))
+		inst=SIXS_INST_ETM;
+	else
+		usage();
+
+	if ((nsza=parse_list(sza_list,sza))<1 ||
+	    (nphi=parse_list(phi_list,phi))<1 ||
+	    (nuwv=parse_list(uwv_list,uwv))<1 ||
+	    (nuoz=parse_list(uoz_list,uoz))<1) {
+		fprintf(stderr,"ERROR: invalid grid list\n");
+		exit(-1);
+	}
+	if ((lut=alloc_6S_lut(nsza,nphi,nsza,nuwv,nuoz))==NULL) {
+		fprintf(stderr,"ERROR: allocating the 6S LUT\n");
+		exit(-1);
+	}
+	memcpy(lut->sza,sza,nsza*sizeof(float));
+	memcpy(lut->phi,phi,nphi*sizeof(float));
+	memcpy(lut->gas_sza,sza,nsza*sizeof(float));
+	memcpy(lut->uwv,uwv,nuwv*sizeof(float));
+	memcpy(lut->uoz,uoz,nuoz*sizeof(float));
+	lut->Inst=inst;
+	lut->month=LUT_MONTH;
+	lut->day=LUT_DAY;
+	lut->vza=LUT_VZA;
+	lut->srefl=LUT_SREFL;
+	lut->target_alt=LUT_TARGET_ALT;
+
+	/* Scattering grid; uwv and uoz only change the gas transmittances.
+	   With a nadir view the relative azimuth has no effect, so all the
+	   azimuth nodes of a sza share one run. */
+	set_fixed_inputs(&sixs_tables,inst);
+	sixs_tables.uwv=uwv[0];
+	sixs_tables.uoz=uoz[0];
+	for (k=0;k<nsza;k++)
+		for (l=0;l<nphi;l++) {
+			node=lut->scat+((size_t)k*nphi+l)*lut->nscat;
+			if (l>0 && LUT_VZA==0.) {
+				memcpy(node,node-lut->nscat,lut->nscat*sizeof(float));
+				continue;
+			}
+			printf("Scattering node sza %.2f phi %.2f\n",sza[k],phi[l]);
+			sixs_tables.sza=sza[k];
+			sixs_tables.phi=phi[l];
+			create_6S_tables(&sixs_tables,nworkers);
+			pack_6S_lut_scat(&sixs_tables,node);
+		}
+	memcpy(lut->aot,sixs_tables.aot,sizeof(lut->aot));
+
+	/* Gas grid; the gas transmittances don't depend on the aerosol, so
+	   only the first AOT is run */
+	set_fixed_inputs(&sixs_tables,inst);
+	for (k=0;k<nsza;k++)
+		for (m=0;m<nuwv;m++)
+			for (n=0;n<nuoz;n++) {
+				printf("Gas node sza %.2f uwv %.2f uoz %.2f\n",sza[k],uwv[m],
+				  uoz[n]);
+				sixs_tables.sza=sza[k];
+				sixs_tables.uwv=uwv[m];
+				sixs_tables.uoz=uoz[n];
+				create_6S_tables_naot(&sixs_tables,1,nworkers);
+				pack_6S_lut_gas(&sixs_tables,lut->gas+
+				  (((size_t)k*nuwv+m)*nuoz+n)*SIXS_LUT_NB_GAS);
+			}
+
+	if (write_6S_lut(argv[i+1],lut))
+		exit(-1);
+	printf("6S LUT written to %s\n",argv[i+1]);
+
+	if (nvalid>0)
+		validate_lut(lut,nvalid,nworkers);
+	free_6S_lut(lut);
+	return 0;
+}
+
+/* Compare the interpolated tables with direct 6S runs at nvalid random
+   points inside the grid */
+static void validate_lut(const sixs_lut_t *lut, int nvalid, int nworkers) {
+	sixs_tables_t direct,interp;
+	double max_abs[LUT_NB_FIELDS],max_rel[LUT_NB_FIELDS];
+	double sum_sq[LUT_NB_FIELDS];
+	double err,ref;
+	const float *vd,*vi;
+	float phi_max;
+	int i,f,k,nvals;
+
+	for (f=0;f<LUT_NB_FIELDS;f++)
+		max_abs[f]=max_rel[f]=sum_sq[f]=0.;
+
+	/* Fixed seed, so a report can be reproduced */
+	srand48(1);
+	phi_max=lut->phi[lut->nphi-1];
+	if (phi_max>=360.)
+		phi_max=359.99;
+	for (i=0;i<nvalid;i++) {
+		set_fixed_inputs(&direct,lut->Inst);
+		direct.sza=lut->sza[0]+drand48()*(lut->sza[lut->nsza-1]-lut->sza[0]);
+		direct.phi=lut->phi[0]+drand48()*(phi_max-lut->phi[0]);
+		direct.uwv=lut->uwv[0]+drand48()*(lut->uwv[lut->nuwv-1]-lut->uwv[0]);
+		direct.uoz=lut->uoz[0]+drand48()*(lut->uoz[lut->nuoz-1]-lut->uoz[0]);
+		interp=direct;
+		printf("Validation point %d: sza %.2f phi %.2f uwv %.2f uoz %.2f\n",
+		  i+1,direct.sza,direct.phi,direct.uwv,direct.uoz);
+		if (interpol_6S_lut(lut,&interp)) {
+			fprintf(stderr,"ERROR: validation point outside the 6S LUT\n");
+			exit(-1);
+		}
+		create_6S_tables(&direct,nworkers);
+
+		for (f=0;f<LUT_NB_FIELDS;f++) {
+			vd=(const float *)((const char *)&direct+lut_fields[f].offset);
+			vi=(const float *)((const char *)&interp+lut_fields[f].offset);
+			for (k=0;k<lut_fields[f].nvals;k++) {
+				err=fabs((double)vi[k]-vd[k]);
+				ref=fabs((double)vd[k]);
+				if (err>max_abs[f])
+					max_abs[f]=err;
+				if (ref>0. && err/ref>max_rel[f])
+					max_rel[f]=err/ref;
+				sum_sq[f]+=err*err;
+			}
+		}
+	}
+
+	printf("\n6S LUT interpolation error over %d points (all bands and "
+	  "AOTs)\n",nvalid);
+	printf("%-16s %12s %12s %12s\n","term","max abs","rms abs","max rel %");
+	for (f=0;f<LUT_NB_FIELDS;f++) {
+		nvals=lut_fields[f].nvals*nvalid;
+		printf("%-16s %12.6f %12.6f %12.4f\n",lut_fields[f].name,max_abs[f],
+		  sqrt(sum_sq[f]/nvals),100.*max_rel[f]);
+	}
+}
+
+static void set_fixed_inputs(sixs_tables_t *sixs_tables, Sixs_Inst_t inst) {
+	memset(sixs_tables,0,sizeof(sixs_tables_t));
+	sixs_tables->Inst=inst;
+	sixs_tables->vza=LUT_VZA;
+	sixs_tables->month=LUT_MONTH;
+	sixs_tables->day=LUT_DAY;
+	sixs_tables->srefl=LUT_SREFL;
+	sixs_tables->target_alt=LUT_TARGET_ALT;
+}
+
+/* Returns the number of values, or -1 if the list isn't increasing */
+static int parse_list(const char *str, float *vals) {
+	char *end;
+	int n;
+
+	for (n=0;n<LUT_MAX_NODES;n++) {
+		vals[n]=(float)strtod(str,&end);
+		if (end==str || (n>0 && vals[n]<=vals[n-1]))
+			return -1;
+		if (*end=='\0')
+			return n+1;
+		if (*end!=',')
+			return -1;
+		str=end+1;
+	}
+	return -1;
+}
+
+static void usage(void) {
+	fprintf(stderr,"usage: lndsrlut [-workers n] [-validate n] [-sza list] "
+	  "[-phi list] [-uwv list] [-uoz list] TM|ETM lut_file\n");
+	exit(-1);
+}
@@ -93,6 +93,10 @@ typedef enum {
   PARAM_OZON_FILE,
   PARAM_DEM_FILE,
   PARAM_LEDAPSVERSION,
+  PARAM_SIXS_WORKERS,
+  PARAM_SIXS_CACHE_DIR,
+  PARAM_SIXS_LUT_FILE,
+  PARAM_INPUT_CACHE_MB,
   PARAM_END,
   PARAM_MAX
 } Param_key_t;
@@ -105,6 +109,10 @@ Key_string_t Param_string[PARAM_MAX] = {
   {(int)PARAM_OZON_FILE, "OZON_FIL"},
   {(int)PARAM_DEM_FILE,  "DEM_FILE"},
   {(int)PARAM_LEDAPSVERSION,  "LEDAPSVersion"},
+  {(int)PARAM_SIXS_WORKERS,  "SIXS_WORKERS"},
+  {(int)PARAM_SIXS_CACHE_DIR,  "SIXS_CACHE_DIR"},
+  {(int)PARAM_SIXS_LUT_FILE,  "SIXS_LUT_FILE"},
+  {(int)PARAM_INPUT_CACHE_MB,  "INPUT_CACHE_MB"},
   {(int)PARAM_END,       "END"}
 };
 
@@ -138,6 +146,7 @@ Param_t *GetParam(int argc, const char **argv)
   char temp[MAX_STR_LEN + 1];
   Param_key_t param_key;
   char *param_file_name;
+  char *env_value;
   bool got_start, got_end;
 
   if (argc < 2) 
@@ -169,6 +178,58 @@ Param_t *GetParam(int argc, const char **argv)
   this->dem_file = NULL;
   this->dem_flag = false;
   this->thermal_band=false;
+  this->sixs_workers = 1;
+  this->sixs_cache_dir = NULL;
+  this->sixs_lut_file = NULL;
+  this->input_cache_mb = INPUT_CACHE_MB_DEFAULT;
+
+  /* The number of 6S workers may also come from the environment; the
+     parameter file takes precedence */
+  env_value = getenv("LEDAPS_SIXS_WORKERS");
+  if (env_value != NULL && strlen(env_value) > 0) {
+    if (sscanf(env_value, "%d", &this->sixs_workers) != 1 ||
+        this->sixs_workers < 0) {
+      fclose(fp);
+      free(this);
+      RETURN_ERROR("invalid LEDAPS_SIXS_WORKERS value", "GetParam", NULL);
+    }
+  }
+
+  /* Same for the 6S results cache directory */
+  env_value = getenv("LEDAPS_SIXS_CACHE_DIR");
+  if (env_value != NULL && strlen(env_value) > 0) {
+    this->sixs_cache_dir = DupString(env_value);
+    if (this->sixs_cache_dir == NULL) {
+      fclose(fp);
+      free(this);
+      RETURN_ERROR("duplicating 6S cache directory", "GetParam", NULL);
+    }
+  }
+
+  /* And for the precomputed 6S LUT */
+  env_value = getenv("LEDAPS_SIXS_LUT_FILE");
+  if (env_value != NULL && strlen(env_value) > 0) {
+    this->sixs_lut_file = DupString(env_value);
+    if (this->sixs_lut_file == NULL) {
+      fclose(fp);
+      free(this->sixs_cache_dir);
+      free(this);
+      RETURN_ERROR("duplicating 6S LUT file name", "GetParam", NULL);
+    }
+  }
+
+  /* And for the input cache budget */
+  env_value = getenv("LEDAPS_INPUT_CACHE_MB");
+  if (env_value != NULL && strlen(env_value) > 0) {
+    if (sscanf(env_value, "%d", &this->input_cache_mb) != 1 ||
+        this->input_cache_mb < 0) {
+      fclose(fp);
+      free(this->sixs_cache_dir);
+      free(this->sixs_lut_file);
+      free(this);
+      RETURN_ERROR("invalid LEDAPS_INPUT_CACHE_MB value", "GetParam", NULL);
+    }
+  }
 
   /* Populate the data structure */
   this->param_file_name = DupString(param_file_name);
@@ -341,6 +402,72 @@ Param_t *GetParam(int argc, const char **argv)
         }
         break;
 
+      case PARAM_SIXS_WORKERS:
+        if (key.nval <= 0) {
+          error_string = "no number of 6S workers";
+          break;
+        } else if (key.nval > 1) {
+          error_string = "too many numbers of 6S workers";
+          break;
+        }
+        key.value[0][key.len_value[0]] = '\0';
+        if (sscanf(key.value[0], "%d", &this->sixs_workers) != 1 ||
+            this->sixs_workers < 0) {
+          error_string = "invalid number of 6S workers";
+          break;
+        }
+        break;
+
+      case PARAM_SIXS_CACHE_DIR:
+        if (key.nval <= 0) {
+          error_string = "no 6S cache directory";
+          break;
+        } else if (key.nval > 1) {
+          error_string = "too many 6S cache directories";
+          break;
+        }
+        key.value[0][key.len_value[0]] = '\0';
+        free(this->sixs_cache_dir);
+        this->sixs_cache_dir = DupString(key.value[0]);
+        if (this->sixs_cache_dir == NULL) {
+          error_string = "duplicating 6S cache directory";
+          break;
+        }
+        break;
+
+      case PARAM_SIXS_LUT_FILE:
+        if (key.nval <= 0) {
+          error_string = "no 6S LUT file name";
+          break;
+        } else if (key.nval > 1) {
+          error_string = "too many 6S LUT file names";
+          break;
+        }
+        key.value[0][key.len_value[0]] = '\0';
+        free(this->sixs_lut_file);
+        this->sixs_lut_file = DupString(key.value[0]);
+        if (this->sixs_lut_file == NULL) {
+          error_string = "duplicating 6S LUT file name";
+          break;
+        }
+        break;
+
+      case PARAM_INPUT_CACHE_MB:
+        if (key.nval <= 0) {
+          error_string = "no input cache size";
+          break;
+        } else if (key.nval > 1) {
+          error_string = "too many input cache sizes";
+          break;
+        }
+        key.value[0][key.len_value[0]] = '\0';
+        if (sscanf(key.value[0], "%d", &this->input_cache_mb) != 1 ||
+            this->input_cache_mb < 0) {
+          error_string = "invalid input cache size";
+          break;
+        }
+        break;
+
       case PARAM_END:
         if (key.nval != 0) {
           error_string = "no value expected (end key)";
@@ -412,6 +539,8 @@ bool FreeParam(Param_t *this)
   if (this != NULL) {
     free(this->param_file_name);
     free(this->input_xml_file_name);
+    free(this->sixs_cache_dir);
+    free(this->sixs_lut_file);
     free(this);
   }
   return true;
@@ -64,6 +64,10 @@
 
 #include "bool.h"
 
+/* Default memory budget for the input cache (MB); a TM/ETM scene with its
+   thermal and QA bands takes about 900 MB */
+#define INPUT_CACHE_MB_DEFAULT (2048)
+
 /* Parameter data structure type definition */
 
 typedef struct {
@@ -79,6 +83,14 @@ typedef struct {
   int  num_ozon_files;        /* number of Ozone hdf files           */
   char *dem_file;             /* DEM file name                       */
   bool dem_flag;              /* false if not present use default    */
+  int sixs_workers;           /* number of 6S worker processes       */
+                              /* (0 = one per online CPU)            */
+  char *sixs_cache_dir;       /* 6S results cache directory          */
+                              /* (NULL = no cache)                   */
+  char *sixs_lut_file;        /* precomputed 6S LUT file name        */
+                              /* (NULL = run 6S)                     */
+  int input_cache_mb;         /* memory budget for the input cache   */
+                              /* (MB; 0 = read lines from the files) */
 } Param_t;
 
 /* Prototypes */
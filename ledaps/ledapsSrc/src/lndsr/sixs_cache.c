@@ -0,0 +1,239 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <math.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+#include "sixs_cache.h"
+
+/* Persistent cache of the 6S tables.  Each entry is a small binary file
+   named after a 64-bit FNV-1a hash of a key string made of the 6S inputs,
+   quantized exactly as they are passed to 6S, so two scenes with the same
+   key get bit-identical tables.  The cache directory can be shared by many
+   lndsr processes: an entry is built under an exclusive lock on its own
+   lock file (so a given case is normally run once; the lock file is
+   removed when done) and published with an atomic rename (so readers
+   never see a partial file). */
+
+#define SIXS_CACHE_MAGIC "LDSR6SC"
+#define SIXS_CACHE_KEY_LEN 512
+
+typedef struct {
+	char magic[8];
+	int version;
+	int nbands,naot;
+	int key_len;
+} sixs_cache_header_t;
+
+/* Table members filled by create_6S_tables, in file order */
+#define SIXS_CACHE_FIELD(f) {offsetof(sixs_tables_t,f),sizeof(((sixs_tables_t *)0)->f)}
+static const struct {
+	size_t offset,size;
+} sixs_cache_fields[] = {
+	SIXS_CACHE_FIELD(aot),
+	SIXS_CACHE_FIELD(aot_wavelength),
+	SIXS_CACHE_FIELD(S_r),
+	SIXS_CACHE_FIELD(T_a_up),
+	SIXS_CACHE_FIELD(T_a_down),
+	SIXS_CACHE_FIELD(T_a),
+	SIXS_CACHE_FIELD(rho_ra),
+	SIXS_CACHE_FIELD(rho_a),
+	SIXS_CACHE_FIELD(S_ra),
+	SIXS_CACHE_FIELD(T_ra_up),
+	SIXS_CACHE_FIELD(T_ra_down),
+	SIXS_CACHE_FIELD(T_ra),
+	SIXS_CACHE_FIELD(T_r_up),
+	SIXS_CACHE_FIELD(T_r_down),
+	SIXS_CACHE_FIELD(T_r),
+	SIXS_CACHE_FIELD(T_g_wv),
+	SIXS_CACHE_FIELD(T_g_og),
+	SIXS_CACHE_FIELD(rho_r)
+};
+#define SIXS_CACHE_NB_FIELDS \
+	(int)(sizeof(sixs_cache_fields)/sizeof(sixs_cache_fields[0]))
+
+static void make_6S_cache_key(const sixs_tables_t *sixs_tables, char *key);
+static int read_6S_cache_entry(const char *filename, const char *key,
+                               sixs_tables_t *sixs_tables);
+static int write_6S_cache_entry(const char *cache_dir, const char *filename,
+                                const char *key,
+                                const sixs_tables_t *sixs_tables);
+
+/* Fill the 6S tables from the cache in cache_dir, or run 6S and add the
+   tables to the cache.  Without a cache directory, or if the cache can't
+   be used, this is create_6S_tables. */
+int create_6S_tables_cached(sixs_tables_t *sixs_tables, int nworkers,
+                            const char *cache_dir) {
+	char key[SIXS_CACHE_KEY_LEN];
+	char *filename,*lock_filename;
+	unsigned long long hash;
+	int i,lock_fd;
+
+	if (cache_dir==NULL || strlen(cache_dir)==0)
+		return create_6S_tables(sixs_tables,nworkers);
+
+	make_6S_cache_key(sixs_tables,key);
+	hash=14695981039346656037ULL;
+	for (i=0;key[i]!='\0';i++) {
+		hash^=(unsigned char)key[i];
+		hash*=1099511628211ULL;
+	}
+
+	filename=(char *)malloc(strlen(cache_dir)+32);
+	lock_filename=(char *)malloc(strlen(cache_dir)+32);
+	if (filename==NULL || lock_filename==NULL) {
+		fprintf(stderr,"ERROR: allocating the 6S cache file names\n");
+		exit(-1);
+	}
+	sprintf(filename,"%s/sixs_%016llx.bin",cache_dir,hash);
+	sprintf(lock_filename,"%s/sixs_%016llx.lock",cache_dir,hash);
+
+	/* Another lndsr may be creating the directory at the same time */
+	if (mkdir(cache_dir,0775)<0 && errno!=EEXIST) {
+		printf("WARNING: can't create 6S cache directory %s, running 6S\n",
+		  cache_dir);
+		free(filename);
+		free(lock_filename);
+		return create_6S_tables(sixs_tables,nworkers);
+	}
+
+	/* The lock is released when lock_fd is closed, also if we die */
+	lock_fd=open(lock_filename,O_RDONLY|O_CREAT,0666);
+	if (lock_fd<0 || flock(lock_fd,LOCK_EX)<0) {
+		printf("WARNING: can't lock 6S cache entry %s, running 6S\n",
+		  lock_filename);
+		if (lock_fd>=0) {
+			unlink(lock_filename);
+			close(lock_fd);
+		}
+		free(filename);
+		free(lock_filename);
+		return create_6S_tables(sixs_tables,nworkers);
+	}
+
+	if (read_6S_cache_entry(filename,key,sixs_tables)==0) {
+		printf("6S tables read from cache %s\n",filename);
+	} else {
+		create_6S_tables(sixs_tables,nworkers);
+		if (write_6S_cache_entry(cache_dir,filename,key,sixs_tables)==0)
+			printf("6S tables written to cache %s\n",filename);
+		else
+			printf("WARNING: can't write 6S cache entry %s\n",filename);
+	}
+
+	/* The lock file is removed while it is held.  A run waiting on it
+	   then locks a removed file, and at worst computes the entry again:
+	   the entry itself is published by a rename */
+	unlink(lock_filename);
+	close(lock_fd);
+	free(filename);
+	free(lock_filename);
+	return 0;
+}
+
+/* The key holds every input of the 6S runs, at the precision 6S gets
+   them (see create_6S_tables) */
+static void make_6S_cache_key(const sixs_tables_t *sixs_tables, char *key) {
+	sprintf(key,"v%d inst=%d month=%d day=%d sza=%.2f phi=%.2f vza=%.2f "
+	  "uwv=%.2f uoz=%.2f alt=%.6f srefl=%.3f",SIXS_CACHE_VERSION,
+	  (int)sixs_tables->Inst,sixs_tables->month,sixs_tables->day,
+	  SIXS_QUANT(sixs_tables->sza,0.01),SIXS_QUANT(sixs_tables->phi,0.01),
+	  SIXS_QUANT(sixs_tables->vza,0.01),SIXS_QUANT(sixs_tables->uwv,0.01),
+	  SIXS_QUANT(sixs_tables->uoz,0.01),sixs_tables->target_alt,
+	  SIXS_QUANT(sixs_tables->srefl,0.001));
+}
+
+/* Returns 0 on a hit; a missing, truncated or foreign file is a miss */
+static int read_6S_cache_entry(const char *filename, const char *key,
+                               sixs_tables_t *sixs_tables) {
+	FILE *fd;
+	sixs_cache_header_t header;
+	char file_key[SIXS_CACHE_KEY_LEN];
+	sixs_tables_t entry;
+	int i;
+
+	if ((fd=fopen(filename,"rb"))==NULL)
+		return -1;
+	if (fread(&header,sizeof(header),1,fd)!=1 ||
+	    memcmp(header.magic,SIXS_CACHE_MAGIC,sizeof(header.magic))!=0 ||
+	    header.version!=SIXS_CACHE_VERSION ||
+	    header.nbands!=SIXS_NB_BANDS || header.naot!=SIXS_NB_AOT ||
+	    header.key_len!=(int)strlen(key) ||
+	    fread(file_key,1,header.key_len,fd)!=(size_t)header.key_len ||
+	    memcmp(file_key,key,header.key_len)!=0) {
+		fclose(fd);
+		return -1;
+	}
+	for (i=0;i<SIXS_CACHE_NB_FIELDS;i++)
+		if (fread((char *)&entry+sixs_cache_fields[i].offset,
+		    sixs_cache_fields[i].size,1,fd)!=1) {
+			fclose(fd);
+			return -1;
+		}
+	fclose(fd);
+
+	for (i=0;i<SIXS_CACHE_NB_FIELDS;i++)
+		memcpy((char *)sixs_tables+sixs_cache_fields[i].offset,
+		  (char *)&entry+sixs_cache_fields[i].offset,
+		  sixs_cache_fields[i].size);
+	return 0;
+}
+
+/* Write the entry to a temporary file in the cache directory and rename
+   it into place */
+static int write_6S_cache_entry(const char *cache_dir, const char *filename,
+                                const char *key,
+                                const sixs_tables_t *sixs_tables) {
+	FILE *fd;
+	sixs_cache_header_t header;
+	char *tmp_filename;
+	int i,tmp_fd,status;
+
+	tmp_filename=(char *)malloc(strlen(cache_dir)+32);
+	if (tmp_filename==NULL)
+		return -1;
+	sprintf(tmp_filename,"%s/sixs_tmp_XXXXXX",cache_dir);
+	if ((tmp_fd=mkstemp(tmp_filename))<0) {
+		free(tmp_filename);
+		return -1;
+	}
+	if ((fd=fdopen(tmp_fd,"wb"))==NULL) {
+		close(tmp_fd);
+		unlink(tmp_filename);
+		free(tmp_filename);
+		return -1;
+	}
+
+	memset(&header,0,sizeof(header));
+	memcpy(header.magic,SIXS_CACHE_MAGIC,sizeof(header.magic));
+	header.version=SIXS_CACHE_VERSION;
+	header.nbands=SIXS_NB_BANDS;
+	header.naot=SIXS_NB_AOT;
+	header.key_len=(int)strlen(key);
+	status=0;
+	if (fwrite(&header,sizeof(header),1,fd)!=1 ||
+	    fwrite(key,1,header.key_len,fd)!=(size_t)header.key_len)
+		status=-1;
+	for (i=0;i<SIXS_CACHE_NB_FIELDS && !status;i++)
+		if (fwrite((const char *)sixs_tables+sixs_cache_fields[i].offset,
+		    sixs_cache_fields[i].size,1,fd)!=1)
+			status=-1;
+	if (fflush(fd)!=0 || fsync(fileno(fd))<0)
+		status=-1;
+	if (fclose(fd)!=0)
+		status=-1;
+	if (!status) {
+		chmod(tmp_filename,0664);
+		if (rename(tmp_filename,filename)<0)
+			status=-1;
+	}
+	if (status)
+		unlink(tmp_filename);
+	free(tmp_filename);
+	return status;
+}
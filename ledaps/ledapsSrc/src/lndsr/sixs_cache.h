@@ -0,0 +1,12 @@
+#ifndef SIXS_CACHE_H
+#define SIXS_CACHE_H
+#include "sixs_runs.h"
+
+/* Bump when the 6S code or the way the tables are built changes, so
+   entries computed by an older lndsr are no longer used */
+#define SIXS_CACHE_VERSION 2
+
+int create_6S_tables_cached(sixs_tables_t *sixs_tables, int nworkers,
+                            const char *cache_dir);
+
+#endif
@@ -0,0 +1,348 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <math.h>
+#include "sixs_lut.h"
+
+/* The table is written by lndsrlut in the native byte order:
+     header  : magic, version, Inst, month, day, nbands, naot, nscat,
+               vza, srefl, target_alt, aot[naot],
+               nsza, nphi, ngas_sza, nuwv, nuoz
+     axes    : sza[nsza], phi[nphi], gas_sza[ngas_sza], uwv[nuwv], uoz[nuoz]
+     data    : scat[nsza*nphi*nscat], gas[ngas_sza*nuwv*nuoz*nbands*2] */
+
+#define SIXS_LUT_MAGIC "LDSR6SLU"
+#define SIXS_LUT_AXIS_EPS 1e-4
+#define SIXS_LUT_MAX_SCAT (16*SIXS_NB_BANDS*SIXS_NB_AOT)
+
+/* Table members interpolated on the scattering grid, in node order */
+#define SIXS_LUT_FIELD(f) {offsetof(sixs_tables_t,f),sizeof(((sixs_tables_t *)0)->f)}
+static const struct {
+	size_t offset,size;
+} sixs_lut_scat_fields[] = {
+	SIXS_LUT_FIELD(aot_wavelength),
+	SIXS_LUT_FIELD(S_r),
+	SIXS_LUT_FIELD(T_a_up),
+	SIXS_LUT_FIELD(T_a_down),
+	SIXS_LUT_FIELD(T_a),
+	SIXS_LUT_FIELD(rho_ra),
+	SIXS_LUT_FIELD(rho_a),
+	SIXS_LUT_FIELD(S_ra),
+	SIXS_LUT_FIELD(T_ra_up),
+	SIXS_LUT_FIELD(T_ra_down),
+	SIXS_LUT_FIELD(T_ra),
+	SIXS_LUT_FIELD(T_r_up),
+	SIXS_LUT_FIELD(T_r_down),
+	SIXS_LUT_FIELD(T_r),
+	SIXS_LUT_FIELD(rho_r)
+};
+#define SIXS_LUT_NB_SCAT_FIELDS \
+	(int)(sizeof(sixs_lut_scat_fields)/sizeof(sixs_lut_scat_fields[0]))
+
+static int lut_axis_pos(const float *axis, int n, float x, int *i0, int *i1,
+                        double *w);
+
+sixs_lut_t *alloc_6S_lut(int nsza, int nphi, int ngas_sza, int nuwv,
+                         int nuoz) {
+	sixs_lut_t *lut;
+	int i;
+
+	if (nsza<1 || nphi<1 || ngas_sza<1 || nuwv<1 || nuoz<1)
+		return NULL;
+	if ((lut=(sixs_lut_t *)calloc(1,sizeof(sixs_lut_t)))==NULL)
+		return NULL;
+	lut->nsza=nsza;
+	lut->nphi=nphi;
+	lut->ngas_sza=ngas_sza;
+	lut->nuwv=nuwv;
+	lut->nuoz=nuoz;
+	lut->nscat=0;
+	for (i=0;i<SIXS_LUT_NB_SCAT_FIELDS;i++)
+		lut->nscat+=(int)(sixs_lut_scat_fields[i].size/sizeof(float));
+	lut->sza=(float *)malloc(nsza*sizeof(float));
+	lut->phi=(float *)malloc(nphi*sizeof(float));
+	lut->gas_sza=(float *)malloc(ngas_sza*sizeof(float));
+	lut->uwv=(float *)malloc(nuwv*sizeof(float));
+	lut->uoz=(float *)malloc(nuoz*sizeof(float));
+	lut->scat=(float *)malloc((size_t)nsza*nphi*lut->nscat*sizeof(float));
+	lut->gas=(float *)malloc((size_t)ngas_sza*nuwv*nuoz*SIXS_LUT_NB_GAS*
+	  sizeof(float));
+	if (lut->sza==NULL || lut->phi==NULL || lut->gas_sza==NULL ||
+	    lut->uwv==NULL || lut->uoz==NULL || lut->scat==NULL ||
+	    lut->gas==NULL) {
+		free_6S_lut(lut);
+		return NULL;
+	}
+	return lut;
+}
+
+void free_6S_lut(sixs_lut_t *lut) {
+	if (lut==NULL)
+		return;
+	free(lut->sza);
+	free(lut->phi);
+	free(lut->gas_sza);
+	free(lut->uwv);
+	free(lut->uoz);
+	free(lut->scat);
+	free(lut->gas);
+	free(lut);
+}
+
+sixs_lut_t *read_6S_lut(const char *filename) {
+	FILE *fd;
+	sixs_lut_t *lut;
+	char magic[8];
+	int version,inst,month,day,nbands,naot,nscat;
+	int nsza,nphi,ngas_sza,nuwv,nuoz;
+	float vza,srefl,target_alt,aot[SIXS_NB_AOT];
+	size_t nscat_vals,ngas_vals;
+
+	if ((fd=fopen(filename,"rb"))==NULL) {
+		fprintf(stderr,"ERROR: can't open 6S LUT %s\n",filename);
+		return NULL;
+	}
+	if (fread(magic,1,8,fd)!=8 || memcmp(magic,SIXS_LUT_MAGIC,8)!=0 ||
+	    fread(&version,sizeof(int),1,fd)!=1 ||
+	    fread(&inst,sizeof(int),1,fd)!=1 ||
+	    fread(&month,sizeof(int),1,fd)!=1 ||
+	    fread(&day,sizeof(int),1,fd)!=1 ||
+	    fread(&nbands,sizeof(int),1,fd)!=1 ||
+	    fread(&naot,sizeof(int),1,fd)!=1 ||
+	    fread(&nscat,sizeof(int),1,fd)!=1) {
+		fprintf(stderr,"ERROR: %s is not a 6S LUT\n",filename);
+		fclose(fd);
+		return NULL;
+	}
+	if (version!=SIXS_LUT_VERSION || nbands!=SIXS_NB_BANDS ||
+	    naot!=SIXS_NB_AOT) {
+		fprintf(stderr,"ERROR: 6S LUT %s has version %d, %d bands and %d "
+		  "AOTs; expected version %d, %d bands and %d AOTs\n",filename,
+		  version,nbands,naot,SIXS_LUT_VERSION,SIXS_NB_BANDS,SIXS_NB_AOT);
+		fclose(fd);
+		return NULL;
+	}
+	if (fread(&vza,sizeof(float),1,fd)!=1 ||
+	    fread(&srefl,sizeof(float),1,fd)!=1 ||
+	    fread(&target_alt,sizeof(float),1,fd)!=1 ||
+	    fread(aot,sizeof(float),SIXS_NB_AOT,fd)!=SIXS_NB_AOT ||
+	    fread(&nsza,sizeof(int),1,fd)!=1 ||
+	    fread(&nphi,sizeof(int),1,fd)!=1 ||
+	    fread(&ngas_sza,sizeof(int),1,fd)!=1 ||
+	    fread(&nuwv,sizeof(int),1,fd)!=1 ||
+	    fread(&nuoz,sizeof(int),1,fd)!=1 ||
+	    (lut=alloc_6S_lut(nsza,nphi,ngas_sza,nuwv,nuoz))==NULL) {
+		fprintf(stderr,"ERROR: reading the 6S LUT header from %s\n",
+		  filename);
+		fclose(fd);
+		return NULL;
+	}
+	if (lut->nscat!=nscat) {
+		fprintf(stderr,"ERROR: 6S LUT %s has %d values per node, expected "
+		  "%d\n",filename,nscat,lut->nscat);
+		free_6S_lut(lut);
+		fclose(fd);
+		return NULL;
+	}
+	lut->Inst=(Sixs_Inst_t)inst;
+	lut->month=month;
+	lut->day=day;
+	lut->vza=vza;
+	lut->srefl=srefl;
+	lut->target_alt=target_alt;
+	memcpy(lut->aot,aot,sizeof(aot));
+
+	nscat_vals=(size_t)nsza*nphi*nscat;
+	ngas_vals=(size_t)ngas_sza*nuwv*nuoz*SIXS_LUT_NB_GAS;
+	if (fread(lut->sza,sizeof(float),nsza,fd)!=(size_t)nsza ||
+	    fread(lut->phi,sizeof(float),nphi,fd)!=(size_t)nphi ||
+	    fread(lut->gas_sza,sizeof(float),ngas_sza,fd)!=(size_t)ngas_sza ||
+	    fread(lut->uwv,sizeof(float),nuwv,fd)!=(size_t)nuwv ||
+	    fread(lut->uoz,sizeof(float),nuoz,fd)!=(size_t)nuoz ||
+	    fread(lut->scat,sizeof(float),nscat_vals,fd)!=nscat_vals ||
+	    fread(lut->gas,sizeof(float),ngas_vals,fd)!=ngas_vals) {
+		fprintf(stderr,"ERROR: reading the 6S LUT data from %s\n",
+		  filename);
+		free_6S_lut(lut);
+		fclose(fd);
+		return NULL;
+	}
+	fclose(fd);
+	return lut;
+}
+
+int write_6S_lut(const char *filename, const sixs_lut_t *lut) {
+	FILE *fd;
+	int header[7],grid[5],status;
+	float fixed[3];
+	size_t nscat_vals,ngas_vals;
+
+	if ((fd=fopen(filename,"wb"))==NULL) {
+		fprintf(stderr,"ERROR: can't create 6S LUT %s\n",filename);
+		return -1;
+	}
+	header[0]=SIXS_LUT_VERSION;
+	header[1]=(int)lut->Inst;
+	header[2]=lut->month;
+	header[3]=lut->day;
+	header[4]=SIXS_NB_BANDS;
+	header[5]=SIXS_NB_AOT;
+	header[6]=lut->nscat;
+	fixed[0]=lut->vza;
+	fixed[1]=lut->srefl;
+	fixed[2]=lut->target_alt;
+	grid[0]=lut->nsza;
+	grid[1]=lut->nphi;
+	grid[2]=lut->ngas_sza;
+	grid[3]=lut->nuwv;
+	grid[4]=lut->nuoz;
+	nscat_vals=(size_t)lut->nsza*lut->nphi*lut->nscat;
+	ngas_vals=(size_t)lut->ngas_sza*lut->nuwv*lut->nuoz*SIXS_LUT_NB_GAS;
+
+	status=0;
+	if (fwrite(SIXS_LUT_MAGIC,1,8,fd)!=8 ||
+	    fwrite(header,sizeof(int),7,fd)!=7 ||
+	    fwrite(fixed,sizeof(float),3,fd)!=3 ||
+	    fwrite(lut->aot,sizeof(float),SIXS_NB_AOT,fd)!=SIXS_NB_AOT ||
+	    fwrite(grid,sizeof(int),5,fd)!=5 ||
+	    fwrite(lut->sza,sizeof(float),lut->nsza,fd)!=(size_t)lut->nsza ||
+	    fwrite(lut->phi,sizeof(float),lut->nphi,fd)!=(size_t)lut->nphi ||
+	    fwrite(lut->gas_sza,sizeof(float),lut->ngas_sza,fd)!=
+	      (size_t)lut->ngas_sza ||
+	    fwrite(lut->uwv,sizeof(float),lut->nuwv,fd)!=(size_t)lut->nuwv ||
+	    fwrite(lut->uoz,sizeof(float),lut->nuoz,fd)!=(size_t)lut->nuoz ||
+	    fwrite(lut->scat,sizeof(float),nscat_vals,fd)!=nscat_vals ||
+	    fwrite(lut->gas,sizeof(float),ngas_vals,fd)!=ngas_vals)
+		status=-1;
+	if (fclose(fd)!=0)
+		status=-1;
+	if (status)
+		fprintf(stderr,"ERROR: writing the 6S LUT %s\n",filename);
+	return status;
+}
+
+/* Copy the scattering terms of the tables to a LUT node */
+void pack_6S_lut_scat(const sixs_tables_t *sixs_tables, float *node) {
+	int i;
+
+	for (i=0;i<SIXS_LUT_NB_SCAT_FIELDS;i++) {
+		memcpy(node,(const char *)sixs_tables+sixs_lut_scat_fields[i].offset,
+		  sixs_lut_scat_fields[i].size);
+		node+=sixs_lut_scat_fields[i].size/sizeof(float);
+	}
+}
+
+/* Copy the gas transmittances of the tables to a LUT node */
+void pack_6S_lut_gas(const sixs_tables_t *sixs_tables, float *node) {
+	memcpy(node,sixs_tables->T_g_wv,SIXS_NB_BANDS*sizeof(float));
+	memcpy(node+SIXS_NB_BANDS,sixs_tables->T_g_og,
+	  SIXS_NB_BANDS*sizeof(float));
+}
+
+/* Fill the tables for the sza, phi, uwv and uoz already set in them by
+   multilinear interpolation in the LUT.  Returns -1 if the LUT doesn't
+   apply: other instrument or fixed inputs, or a point outside the grid. */
+int interpol_6S_lut(const sixs_lut_t *lut, sixs_tables_t *sixs_tables) {
+	int is[2],ip[2],ig[2],iw[2],io[2];
+	double ws,wp,wg,ww,wo,wt;
+	double scat[SIXS_LUT_MAX_SCAT];
+	double gas[SIXS_LUT_NB_GAS];
+	float node[SIXS_LUT_MAX_SCAT];
+	const float *lut_node;
+	float phi,*dst;
+	int a,b,c,i,k;
+
+	if (lut->Inst!=sixs_tables->Inst || lut->month!=sixs_tables->month ||
+	    lut->day!=sixs_tables->day ||
+	    SIXS_QUANT(lut->vza,0.01)!=SIXS_QUANT(sixs_tables->vza,0.01) ||
+	    SIXS_QUANT(lut->srefl,0.001)!=SIXS_QUANT(sixs_tables->srefl,0.001) ||
+	    lut->target_alt!=sixs_tables->target_alt) {
+		printf("WARNING: the 6S LUT was built for other fixed 6S inputs\n");
+		return -1;
+	}
+	if (lut->nscat>SIXS_LUT_MAX_SCAT)
+		return -1;
+
+	phi=fmod(sixs_tables->phi,360.);
+	if (phi<0.)
+		phi+=360.;
+	if (lut_axis_pos(lut->sza,lut->nsza,sixs_tables->sza,&is[0],&is[1],&ws) ||
+	    lut_axis_pos(lut->phi,lut->nphi,phi,&ip[0],&ip[1],&wp) ||
+	    lut_axis_pos(lut->gas_sza,lut->ngas_sza,sixs_tables->sza,&ig[0],&ig[1],
+	      &wg) ||
+	    lut_axis_pos(lut->uwv,lut->nuwv,sixs_tables->uwv,&iw[0],&iw[1],&ww) ||
+	    lut_axis_pos(lut->uoz,lut->nuoz,sixs_tables->uoz,&io[0],&io[1],&wo)) {
+		printf("WARNING: sza %.2f phi %.2f uwv %.2f uoz %.2f is outside the "
+		  "6S LUT grid\n",sixs_tables->sza,phi,sixs_tables->uwv,
+		  sixs_tables->uoz);
+		return -1;
+	}
+
+	/* Bilinear interpolation of the scattering terms */
+	for (k=0;k<lut->nscat;k++)
+		scat[k]=0.;
+	for (a=0;a<2;a++)
+		for (b=0;b<2;b++) {
+			wt=(a?ws:1.-ws)*(b?wp:1.-wp);
+			if (wt==0.)
+				continue;
+			lut_node=lut->scat+((size_t)is[a]*lut->nphi+ip[b])*lut->nscat;
+			for (k=0;k<lut->nscat;k++)
+				scat[k]+=wt*lut_node[k];
+		}
+	for (k=0;k<lut->nscat;k++)
+		node[k]=(float)scat[k];
+	dst=node;
+	for (i=0;i<SIXS_LUT_NB_SCAT_FIELDS;i++) {
+		memcpy((char *)sixs_tables+sixs_lut_scat_fields[i].offset,dst,
+		  sixs_lut_scat_fields[i].size);
+		dst+=sixs_lut_scat_fields[i].size/sizeof(float);
+	}
+
+	/* Trilinear interpolation of the gas transmittances */
+	for (k=0;k<SIXS_LUT_NB_GAS;k++)
+		gas[k]=0.;
+	for (a=0;a<2;a++)
+		for (b=0;b<2;b++)
+			for (c=0;c<2;c++) {
+				wt=(a?wg:1.-wg)*(b?ww:1.-ww)*(c?wo:1.-wo);
+				if (wt==0.)
+					continue;
+				lut_node=lut->gas+(((size_t)ig[a]*lut->nuwv+iw[b])*lut->nuoz+
+				  io[c])*SIXS_LUT_NB_GAS;
+				for (k=0;k<SIXS_LUT_NB_GAS;k++)
+					gas[k]+=wt*lut_node[k];
+			}
+	for (k=0;k<SIXS_NB_BANDS;k++) {
+		sixs_tables->T_g_wv[k]=(float)gas[k];
+		sixs_tables->T_g_og[k]=(float)gas[SIXS_NB_BANDS+k];
+	}
+
+	memcpy(sixs_tables->aot,lut->aot,sizeof(lut->aot));
+	return 0;
+}
+
+/* Locate x on an increasing axis: the result is
+   (1-w)*value[i0] + w*value[i1].  Returns -1 if x is outside the axis. */
+static int lut_axis_pos(const float *axis, int n, float x, int *i0, int *i1,
+                        double *w) {
+	int i;
+
+	if (x<axis[0]-SIXS_LUT_AXIS_EPS || x>axis[n-1]+SIXS_LUT_AXIS_EPS)
+		return -1;
+	if (n==1) {
+		*i0=*i1=0;
+		*w=0.;
+		return 0;
+	}
+	for (i=0;i<n-2 && x>axis[i+1];i++);
+	*i0=i;
+	*i1=i+1;
+	*w=(x-axis[i])/(axis[i+1]-axis[i]);
+	if (*w<0.)
+		*w=0.;
+	if (*w>1.)
+		*w=1.;
+	return 0;
+}
@@ -0,0 +1,39 @@
+#ifndef SIXS_LUT_H
+#define SIXS_LUT_H
+#include "sixs_runs.h"
+
+/* Precomputed 6S lookup table.  The scattering terms (Rayleigh, aerosol)
+   don't depend on the absorbing gases, and the gas transmittances don't
+   depend on the aerosol, so they are kept on two grids:
+     scattering : sza x phi, every band and AOT of the tables
+     gas        : sza x uwv x uoz, T_g_wv and T_g_og of every band
+   The other 6S inputs (view zenith, date, target altitude, surface
+   reflectance, AOT values) are fixed when the table is built. */
+
+#define SIXS_LUT_VERSION 1
+#define SIXS_LUT_NB_GAS (2*SIXS_NB_BANDS)
+
+typedef struct {
+	Sixs_Inst_t Inst;
+	int month,day;
+	float vza,srefl,target_alt;
+	float aot[SIXS_NB_AOT];
+	int nsza,nphi;		/* scattering grid */
+	float *sza,*phi;
+	int ngas_sza,nuwv,nuoz;	/* gas transmittance grid */
+	float *gas_sza,*uwv,*uoz;
+	int nscat;		/* values per scattering node */
+	float *scat;		/* [nsza][nphi][nscat] */
+	float *gas;		/* [ngas_sza][nuwv][nuoz][SIXS_LUT_NB_GAS] */
+} sixs_lut_t;
+
+sixs_lut_t *alloc_6S_lut(int nsza, int nphi, int ngas_sza, int nuwv,
+                         int nuoz);
+void free_6S_lut(sixs_lut_t *lut);
+sixs_lut_t *read_6S_lut(const char *filename);
+int write_6S_lut(const char *filename, const sixs_lut_t *lut);
+void pack_6S_lut_scat(const sixs_tables_t *sixs_tables, float *node);
+void pack_6S_lut_gas(const sixs_tables_t *sixs_tables, float *node);
+int interpol_6S_lut(const sixs_lut_t *lut, sixs_tables_t *sixs_tables);
+
+#endif
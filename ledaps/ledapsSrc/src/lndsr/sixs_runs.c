@@ -2,7 +2,13 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <math.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/wait.h>
 #include "sixs_runs.h"
+#include "sixs_lib.h"
 #include "external_pgm.h"
 
 struct etm_spectral_function_t {
@@ -12,19 +18,37 @@ struct etm_spectral_function_t {
 	float response[SIXS_NB_BANDS][155];
 } etm_spectral_function_t;
 
-int create_6S_tables(sixs_tables_t *sixs_tables, Input_meta_t *meta) {
-	char cmd[128],sixs_cmd_filename[1024],sixs_out_filename[1024],line_in[256];
-    /* char tmp_file[1024], cmd_string[1024]; */
-	int i,j,k;
-	FILE *fd;
-	float tgoz,tgco2,tgo2,tgno2,tgch4,tgco;
+/* Record sent back by a 6S worker process */
+typedef struct {
+	int icase;
+	sixs_results_t results;
+} sixs_case_record_t;
+
+static int run_6S_cases_parallel(const sixs_params_t *cases,
+                                 sixs_results_t *results, int ncases,
+                                 int nworkers);
+static int read_6S_record(int fd, sixs_case_record_t *rec);
+static void store_6S_results(sixs_tables_t *sixs_tables, int i, int j,
+                             const sixs_results_t *res);
+static int run_6S_batch(const char *deck_filename, int ncases,
+                        sixs_results_t *results);
+
+/* Fill the 6S tables for the scene.  The SIXS_NB_BANDS x SIXS_NB_AOT cases
+   are run by nworkers processes (0 = one per online CPU, 1 = serially in
+   the lndsr process). */
+int create_6S_tables(sixs_tables_t *sixs_tables, int nworkers) {
+	return create_6S_tables_naot(sixs_tables,SIXS_NB_AOT,nworkers);
+}
+
+/* Same as create_6S_tables, but only for the first naot AOTs; the gas
+   transmittances and the Rayleigh terms only need the first one */
+int create_6S_tables_naot(sixs_tables_t *sixs_tables, int naot,
+                          int nworkers) {
+	int i,j,k,ncases,status;
 	int tm_band[SIXS_NB_BANDS]={25,26,27,28,29,30};
-    char short_name[1024];
-    char local_granule_id[1024];
-    char acq_date_string[MAX_DATE_LEN + 1];
-    const char *sat_names[SAT_MAX] = {"1", "2", "3", "4", "5", "7"};
-    const char *inst_names[INST_MAX] = {"M", "T", "E"};
-    const char *wrs_names[WRS_MAX] = {"1", "2"};
+	sixs_params_t sixs_params;
+	sixs_params_t *cases;
+	sixs_results_t *results;
 	
 	struct etm_spectral_function_t etm_spectral_function = {
 		{54,61,65,81,131,155},
@@ -55,304 +79,250 @@ int create_6S_tables(sixs_tables_t *sixs_tables, Input_meta_t *meta) {
 	sixs_tables->aot[13]=1.80;
 	sixs_tables->aot[14]=2.00;
 	
-    /* Determine the 6s command and output filenames */
-    if (sprintf(short_name, "L%s%s%s", sat_names[meta->sat], 
-        inst_names[meta->inst], "SR") < 0) {
-        fprintf(stderr, "ERROR:creating short name\n");
-        exit(-1);
-    }
+	/* Set up the 6S case; the parameters are quantized to the precision
+	   that was used on the 6S command cards */
+	memset(&sixs_params,0,sizeof(sixs_params_t));
+	sixs_params.sza=SIXS_QUANT(sixs_tables->sza,0.01);
+	sixs_params.saz=SIXS_QUANT(sixs_tables->phi,0.01);
+	sixs_params.vza=SIXS_QUANT(sixs_tables->vza,0.01);
+	sixs_params.vaz=0.;
+	sixs_params.month=sixs_tables->month;
+	sixs_params.day=sixs_tables->day;
+	sixs_params.uwv=SIXS_QUANT(sixs_tables->uwv,0.01);
+	sixs_params.uoz=SIXS_QUANT(sixs_tables->uoz,0.01);
+	sixs_params.aer_model=1;	/* continental model */
+	sixs_params.target_alt=sixs_tables->target_alt;
+	sixs_params.srefl=SIXS_QUANT(sixs_tables->srefl,0.001);
 
-    if (!FormatDate(&meta->acq_date, DATE_FORMAT_DATEB, acq_date_string)) {
-        fprintf(stderr, "ERROR:formatting acquisition date\n");
-        exit(-1);
-    }
-    acq_date_string[4] = '\0';
-
-    sprintf(local_granule_id, "%s.a%4s%3s.w%1sp%03dr%03d",
-        short_name, acq_date_string, &acq_date_string[5],
-        wrs_names[meta->wrs_sys], meta->ipath, meta->irow);
-    sprintf (sixs_cmd_filename, "sixs_cmd_%s", local_granule_id);
-    sprintf (sixs_out_filename, "sixs_output_%s", local_granule_id);
-	
-	/* Run 6s */
+	/* Set up the band x AOT cases */
+	ncases=SIXS_NB_BANDS*naot;
+	cases=(sixs_params_t *)malloc(ncases*sizeof(sixs_params_t));
+	results=(sixs_results_t *)malloc(ncases*sizeof(sixs_results_t));
+	if (cases==NULL || results==NULL) {
+		fprintf(stderr,"ERROR: allocating the 6S cases\n");
+		exit(-1);
+	}
 	for (i=0;i<SIXS_NB_BANDS;i++) {
-		for (j=0;j<SIXS_NB_AOT;j++) {
-			printf("Processing 6s for band %d  AOT %2d\r",i+1,j+1);
-            fflush(stdout);
-			if ((fd=fopen(sixs_cmd_filename,"w"))==NULL) {
-				fprintf(stderr,"ERROR: creating temporary file %s\n",sixs_cmd_filename);
+		switch (sixs_tables->Inst) {
+			case SIXS_INST_TM:
+				sixs_params.band=tm_band[i];
+			break;
+			case SIXS_INST_ETM:
+				sixs_params.band=SIXS_BAND_FILTER;
+				sixs_params.wlinf=etm_spectral_function.wlinf[i];
+				sixs_params.wlsup=etm_spectral_function.wlsup[i];
+				sixs_params.nresp=etm_spectral_function.nbvals[i];
+				for (k=0;k<etm_spectral_function.nbvals[i];k++)
+					sixs_params.resp[k]=etm_spectral_function.response[i][k];
+			break;
+			default:
+				fprintf(stderr,"ERROR: Unknown Instrument in six_run parameters\n");
 				exit(-1);
-			}
+		}
+		for (j=0;j<naot;j++) {
+			sixs_params.aot550=SIXS_QUANT(sixs_tables->aot[j],0.001);
+			cases[i*naot+j]=sixs_params;
+		}
+	}
 
-			fprintf(fd,"%s <<+ >%s\n",get_sixs_path(),sixs_out_filename);
-			fprintf(fd,"0 (user defined)\n");
-			fprintf(fd,"%.2f %.2f %.2f %.2f %d %d (geometrical conditions sza saz vza vaz month day)\n",sixs_tables->sza,sixs_tables->phi,sixs_tables->vza,0.,sixs_tables->month,sixs_tables->day);
-			fprintf(fd,"8 (option for water vapor and ozone)\n");
-			fprintf(fd,"%.2f %.2f (water vapor and ozone)\n",sixs_tables->uwv,sixs_tables->uoz);
-			fprintf(fd,"1 (continental model)\n");
-			fprintf(fd,"0 (option for optical thickness at 550 nm)\n");
-			fprintf(fd,"%.3f (value of aot550\n",sixs_tables->aot[j]);
-			fprintf(fd,"%f (target level)\n",sixs_tables->target_alt);
-			fprintf(fd,"-1000 (sensor level : -1000=satellite level)\n");
-			switch (sixs_tables->Inst) {
-				case SIXS_INST_TM:
-					fprintf(fd,"%d (predefined band)\n",tm_band[i]);
-				break;
-				case SIXS_INST_ETM:
-					fprintf(fd,"1 (user defined filter function)\n");
-					fprintf(fd,"%05.3f %05.3f (wlinf wlsup)\n",etm_spectral_function.wlinf[i],etm_spectral_function.wlsup[i]);
-					for (k=0;k<etm_spectral_function.nbvals[i];k++) {
-						fprintf(fd,"%05.3f ",etm_spectral_function.response[i][k]);
-						if (!((k+1)%10))
-							fprintf(fd,"\n");
-					}
-					if (k%10)
-						fprintf(fd,"\n");
-				break;
-				default:
-					fprintf(stderr,"ERROR: Unknown Instrument in six_run parameters\n");
-					exit(-1);
-			}
-			fprintf(fd,"0 (homogeneous surface)\n");
-			fprintf(fd,"0 (no directional effects)\n");
-			fprintf(fd,"0 (constant value for rho)\n");
-			fprintf(fd,"%.3f (value of rho)\n",sixs_tables->srefl);
-			fprintf(fd,"-1 (no atmospheric correction)\n");
-			fprintf(fd,"0\n");
-			fprintf(fd,"+\n");
-			fclose(fd);
-	
-            /* Modified 9/26/2014 to run bash shell vs. sh */
-			sprintf(cmd,"bash %s",sixs_cmd_filename);
-			if (system(cmd)) {
-				fprintf(stderr,"ERROR: Can't run 6S \n");
-				exit(-1);
+	/* Run 6s in-process, or in a pool of worker processes (6S keeps its
+	   state in COMMON blocks so the cases cannot run in threads) */
+	if (nworkers < 1)
+		nworkers=(int)sysconf(_SC_NPROCESSORS_ONLN);
+	if (nworkers > ncases)
+		nworkers=ncases;
+	if (nworkers > 1) {
+		printf("Processing 6s with %d workers\n",nworkers);
+		status=run_6S_cases_parallel(cases,results,ncases,nworkers);
+	} else {
+		status=0;
+		for (k=0;k<ncases && !status;k++) {
+			printf("Processing 6s for band %d  AOT %2d\r",k/naot+1,
+			  k%naot+1);
+            fflush(stdout);
+			status=sixs_run(&cases[k],&results[k]);
+		}
+	}
+	if (status) {
+		fprintf(stderr,"ERROR: Can't run 6S \n");
+		exit(-1);
+	}
+
+	/* Assemble the tables in band/AOT order */
+	for (i=0;i<SIXS_NB_BANDS;i++)
+		for (j=0;j<naot;j++)
+			store_6S_results(sixs_tables,i,j,&results[i*naot+j]);
+	printf ("\n");
+	free(cases);
+	free(results);
+	return 0;
+}
+
+/* Run the 6S cases in nworkers forked processes.  Worker w runs the cases
+   w, w+nworkers, ... and sends (case index, results) records back through
+   its pipe, so the results land at their case index whatever the completion
+   order.  Returns 0 when every case was run, -1 otherwise. */
+static int run_6S_cases_parallel(const sixs_params_t *cases,
+                                 sixs_results_t *results, int ncases,
+                                 int nworkers) {
+	sixs_case_record_t rec;
+	struct pollfd *fds;
+	pid_t *pids;
+	int pipefd[2];
+	int w,k,n,nopen,ndone,status,wstatus;
+
+	fds=(struct pollfd *)malloc(nworkers*sizeof(struct pollfd));
+	pids=(pid_t *)malloc(nworkers*sizeof(pid_t));
+	if (fds==NULL || pids==NULL) {
+		fprintf(stderr,"ERROR: allocating the 6S workers\n");
+		free(fds);
+		free(pids);
+		return -1;
+	}
+
+	/* don't let the workers inherit buffered output */
+	fflush(stdout);
+	fflush(stderr);
+
+	status=0;
+	for (w=0;w<nworkers;w++) {
+		if (pipe(pipefd)) {
+			fprintf(stderr,"ERROR: creating pipe for 6S worker %d\n",w);
+			status=-1;
+			break;
+		}
+		pids[w]=fork();
+		if (pids[w]<0) {
+			fprintf(stderr,"ERROR: starting 6S worker %d\n",w);
+			close(pipefd[0]);
+			close(pipefd[1]);
+			status=-1;
+			break;
+		}
+		if (pids[w]==0) {
+			/* worker */
+			close(pipefd[0]);
+			for (k=0;k<w;k++)
+				close(fds[k].fd);
+			for (k=w;k<ncases;k+=nworkers) {
+				rec.icase=k;
+				if (sixs_run(&cases[k],&rec.results))
+					_exit(1);
+				if (write(pipefd[1],&rec,sizeof(rec))!=sizeof(rec))
+					_exit(1);
 			}
-	
-			if ((fd=fopen(sixs_out_filename,"r"))==NULL) {
-				fprintf(stderr,"ERROR: reading temporary file %s\n",sixs_out_filename);
-				exit(-1);
+			close(pipefd[1]);
+			_exit(0);
+		}
+		close(pipefd[1]);
+		fds[w].fd=pipefd[0];
+		fds[w].events=POLLIN;
+	}
+	nworkers=w;
+
+	/* Collect the records until every worker closed its pipe */
+	nopen=nworkers;
+	ndone=0;
+	while (nopen > 0) {
+		if (poll(fds,nworkers,-1) < 0) {
+			if (errno==EINTR)
+				continue;
+			fprintf(stderr,"ERROR: waiting for the 6S workers\n");
+			status=-1;
+			break;
+		}
+		for (w=0;w<nworkers;w++) {
+			if (fds[w].fd < 0 || !fds[w].revents)
+				continue;
+			n=read_6S_record(fds[w].fd,&rec);
+			if (n <= 0) {
+				if (n < 0)
+					status=-1;
+				close(fds[w].fd);
+				fds[w].fd=-1;
+				nopen--;
+				continue;
 			}
-			while (fgets(line_in,256,fd)) {
-				line_in[strlen(line_in)-1]='\0';
-				if (j==0) {
-					if (!strncmp(line_in,"*      rayl.  sca. trans. :",27)) {
-						k=27;
-						while (line_in[k]==' ')
-							k++;
-						sscanf(&line_in[k],"%f",&sixs_tables->T_r_down[i]);
-						while (line_in[k]!=' ')		/* downward */
-							k++;
-						while (line_in[k]==' ')		/* blank */
-							k++;
-						sscanf(&line_in[k],"%f",&sixs_tables->T_r_up[i]);
-						while (line_in[k]!=' ')		/* upward */
-							k++;
-						while (line_in[k]==' ')		/* blank */
-							k++;
-						sscanf(&line_in[k],"%f",&sixs_tables->T_r[i]);
-					}
-					if (!strncmp(line_in,"*      water   \"     \"    :",27)) {
-						k=27;
-						while (line_in[k]==' ')
-							k++;
-						while (line_in[k]!=' ')		/* downward */
-							k++;
-						while (line_in[k]==' ')		/* blank */
-							k++;
-						while (line_in[k]!=' ')		/* upward */
-							k++;
-						while (line_in[k]==' ')		/* blank */
-							k++;
-						sscanf(&line_in[k],"%f",&sixs_tables->T_g_wv[i]);
-					}
-					if (!strncmp(line_in,"*      ozone   \"     \"    :",27)) {
-						k=27;
-						while (line_in[k]==' ')
-							k++;
-						while (line_in[k]!=' ')		/* downward */
-							k++;
-						while (line_in[k]==' ')		/* blank */
-							k++;
-						while (line_in[k]!=' ')		/* upward */
-							k++;
-						while (line_in[k]==' ')		/* blank */
-							k++;
-						sscanf(&line_in[k],"%f",&tgoz);
-					}
-					if (!strncmp(line_in,"*      co2     \"     \"    :",27)) {
-						k=27;
-						while (line_in[k]==' ')
-							k++;
-						while (line_in[k]!=' ')		/* downward */
-							k++;
-						while (line_in[k]==' ')		/* blank */
-							k++;
-						while (line_in[k]!=' ')		/* upward */
-							k++;
-						while (line_in[k]==' ')		/* blank */
-							k++;
-						sscanf(&line_in[k],"%f",&tgco2);
-					}
-					if (!strncmp(line_in,"*      oxyg    \"     \"    :",27)) {
-						k=27;
-						while (line_in[k]==' ')
-							k++;
-						while (line_in[k]!=' ')		/* downward */
-							k++;
-						while (line_in[k]==' ')		/* blank */
-							k++;
-						while (line_in[k]!=' ')		/* upward */
-							k++;
-						while (line_in[k]==' ')		/* blank */
-							k++;
-						sscanf(&line_in[k],"%f",&tgo2);
-					}
-					if (!strncmp(line_in,"*      no2     \"     \"    :",27)) {
-						k=27;
-						while (line_in[k]==' ')
-							k++;
-						while (line_in[k]!=' ')		/* downward */
-							k++;
-						while (line_in[k]==' ')		/* blank */
-							k++;
-						while (line_in[k]!=' ')		/* upward */
-							k++;
-						while (line_in[k]==' ')		/* blank */
-							k++;
-						sscanf(&line_in[k],"%f",&tgno2);
-					}
-					if (!strncmp(line_in,"*      ch4     \"     \"    :",27)) {
-						k=27;
-						while (line_in[k]==' ')
-							k++;
-						while (line_in[k]!=' ')		/* downward */
-							k++;
-						while (line_in[k]==' ')		/* blank */
-							k++;
-						while (line_in[k]!=' ')		/* upward */
-							k++;
-						while (line_in[k]==' ')		/* blank */
-							k++;
-						sscanf(&line_in[k],"%f",&tgch4);
-					}
-					if (!strncmp(line_in,"*      co      \"     \"    :",27)) {
-						k=27;
-						while (line_in[k]==' ')
-							k++;
-						while (line_in[k]!=' ')		/* downward */
-							k++;
-						while (line_in[k]==' ')		/* blank */
-							k++;
-						while (line_in[k]!=' ')		/* upward */
-							k++;
-						while (line_in[k]==' ')		/* blank */
-							k++;
-						sscanf(&line_in[k],"%f",&tgco);
-					}
-					sixs_tables->T_g_og[i]=tgoz*tgco2*tgo2*tgno2*tgno2*tgch4*tgco;
-				}
-				if (!strncmp(line_in,"*      spherical albedo   :",27)) {
-					k=27;
-					while (line_in[k]==' ')			/* blank */
-						k++;
-					if (j==0)
-						sscanf(&line_in[k],"%f",&sixs_tables->S_r[i]);
-					while (line_in[k]!=' ')			/* Rayleigh */
-						k++;
-					while (line_in[k]==' ')			/* blank */
-						k++;
-					while (line_in[k]!=' ')			/* Aerosol */
-						k++;
-					while (line_in[k]==' ')			/* blank */
-						k++;
-					sscanf(&line_in[k],"%f",&sixs_tables->S_ra[i][j]);
-				}
-				if (!strncmp(line_in,"*      optical depth total:",27)) {
-					k=27;
-					while (line_in[k]==' ')			/* blank */
-						k++;
-					while (line_in[k]!=' ')			/* Rayleigh */
-						k++;
-					while (line_in[k]==' ')			/* blank */
-						k++;
-					sscanf(&line_in[k],"%f",&sixs_tables->aot_wavelength[i][j]);
-				}
-				if (!strncmp(line_in,"*      aeros. sca.   \"    :",27)) {
-					k=27;
-					while (line_in[k]==' ')
-						k++;
-					sscanf(&line_in[k],"%f",&sixs_tables->T_a_down[i][j]);
-					while (line_in[k]!=' ')		/* downward */
-						k++;
-					while (line_in[k]==' ')		/* blank */
-						k++;
-					sscanf(&line_in[k],"%f",&sixs_tables->T_a_up[i][j]);
-					while (line_in[k]!=' ')		/* upward */
-						k++;
-					while (line_in[k]==' ')		/* blank */
-						k++;
-					sscanf(&line_in[k],"%f",&sixs_tables->T_a[i][j]);
-				}
-				if (!strncmp(line_in,"*      total  sca.   \"    :",27)) {
-					k=27;
-					while (line_in[k]==' ')
-						k++;
-					sscanf(&line_in[k],"%f",&sixs_tables->T_ra_down[i][j]);
-					while (line_in[k]!=' ')		/* downward */
-						k++;
-					while (line_in[k]==' ')		/* blank */
-						k++;
-					sscanf(&line_in[k],"%f",&sixs_tables->T_ra_up[i][j]);
-					while (line_in[k]!=' ')		/* upward */
-						k++;
-					while (line_in[k]==' ')		/* blank */
-						k++;
-					sscanf(&line_in[k],"%f",&sixs_tables->T_ra[i][j]);
-				}
-				if (!strncmp(line_in,"*      reflectance I      :",27)) {
-					k=27;
-					while (line_in[k]==' ')		/* blank */
-						k++;
-					if (j==0)
-						sscanf(&line_in[k],"%f",&sixs_tables->rho_r[i]);
-					while (line_in[k]!=' ')		/* rayleigh */
-						k++;
-					while (line_in[k]==' ')		/* blank */
-						k++;
-					sscanf(&line_in[k],"%f",&sixs_tables->rho_a[i][j]);
-					while (line_in[k]!=' ')		/* aerosols */
-						k++;
-					while (line_in[k]==' ')		/* blank */
-						k++;
-					sscanf(&line_in[k],"%f",&sixs_tables->rho_ra[i][j]);
-				}
+			if (rec.icase < 0 || rec.icase >= ncases) {
+				status=-1;
+				continue;
 			}
-			fclose(fd);
-/* For OZONE debugging:
-	        sprintf (tmp_file, "%s_b%d_aot%02d", sixs_cmd_filename, i, j);
-            sprintf (cmd_string, "cp %s %s", sixs_cmd_filename, tmp_file);
-            system (cmd_string);
-	        sprintf (tmp_file, "%s_b%d_aot%02d", sixs_out_filename, i, j);
-            sprintf (cmd_string, "cp %s %s", sixs_out_filename, tmp_file);
-            system (cmd_string);
-*/
-		}  /* for j */
-	}  /* for i */
-	printf ("\n");
-	unlink(sixs_cmd_filename);
-	unlink(sixs_out_filename);
-	return 0;
+			results[rec.icase]=rec.results;
+			ndone++;
+			printf("Processing 6s case %2d of %d\r",ndone,ncases);
+			fflush(stdout);
+		}
+	}
+	for (w=0;w<nworkers;w++) {
+		if (fds[w].fd >= 0)
+			close(fds[w].fd);
+		if (waitpid(pids[w],&wstatus,0)<0 || !WIFEXITED(wstatus) ||
+		    WEXITSTATUS(wstatus)!=0)
+			status=-1;
+	}
+	if (ndone != ncases)
+		status=-1;
+
+	free(fds);
+	free(pids);
+	return status;
+}
+
+/* Read one whole record from a worker pipe.  Returns 1 when a record was
+   read, 0 at end of file and -1 on error or truncated record. */
+static int read_6S_record(int fd, sixs_case_record_t *rec) {
+	char *buf=(char *)rec;
+	size_t nread=0;
+	ssize_t n;
+
+	while (nread < sizeof(sixs_case_record_t)) {
+		n=read(fd,buf+nread,sizeof(sixs_case_record_t)-nread);
+		if (n < 0) {
+			if (errno==EINTR)
+				continue;
+			return -1;
+		}
+		if (n == 0)
+			return nread ? -1 : 0;
+		nread+=n;
+	}
+	return 1;
+}
+
+/* Copy the integrated 6S results of band i and AOT j into the tables; the
+   Rayleigh and gaseous terms do not depend on the AOT and are taken from
+   the first AOT */
+static void store_6S_results(sixs_tables_t *sixs_tables, int i, int j,
+                             const sixs_results_t *res) {
+	if (j==0) {
+		sixs_tables->T_r_down[i]=res->t_ray[0];
+		sixs_tables->T_r_up[i]=res->t_ray[1];
+		sixs_tables->T_r[i]=res->t_ray[2];
+		sixs_tables->T_g_wv[i]=res->tg_wv[2];
+		sixs_tables->T_g_og[i]=res->tg_oz[2]*res->tg_co2[2]*res->tg_o2[2]*
+		  res->tg_no2[2]*res->tg_no2[2]*res->tg_ch4[2]*res->tg_co[2];
+		sixs_tables->S_r[i]=res->sph_alb[0];
+		sixs_tables->rho_r[i]=res->refl[0];
+	}
+	sixs_tables->S_ra[i][j]=res->sph_alb[2];
+	sixs_tables->aot_wavelength[i][j]=res->opt_depth[1];
+	sixs_tables->T_a_down[i][j]=res->t_aer[0];
+	sixs_tables->T_a_up[i][j]=res->t_aer[1];
+	sixs_tables->T_a[i][j]=res->t_aer[2];
+	sixs_tables->T_ra_down[i][j]=res->t_tot[0];
+	sixs_tables->T_ra_up[i][j]=res->t_tot[1];
+	sixs_tables->T_ra[i][j]=res->t_tot[2];
+	sixs_tables->rho_a[i][j]=res->refl[1];
+	sixs_tables->rho_ra[i][j]=res->refl[2];
 }
 
 /* This function is not actually used in lndsr processing */
 int create_6S_tables_water(sixs_tables_t *sixs_tables) {
-	char cmd[128],sixs_cmd_filename[128],sixs_out_filename[128],line_in[256];
-	int i,j,k;
+	char sixs_deck_filename[128];
+	int i,j,k,ncases,deck_fd;
 	FILE *fd;
-	float tgoz,tgco2,tgo2,tgno2,tgch4,tgco;
+	sixs_results_t *results;
 	int tm_band[SIXS_NB_BANDS]={25,26,27,28,29,30};
-    char *tmpstr;
 	
 	struct etm_spectral_function_t etm_spectral_function = {
 		{54,61,65,81,131,155},
@@ -384,24 +354,17 @@ int create_6S_tables_water(sixs_tables_t *sixs_tables) {
 	sixs_tables->aot[14]=2.00;
 	printf ("DEBUG: in compute_6S_tables_water -- shouldn't be here!\n");
 	
-	if ((tmpstr = tmpnam(sixs_cmd_filename)) == NULL) {
-      fprintf(stderr,"ERROR: creating temporary file %s\n",sixs_cmd_filename);
-      exit(-1);
-    }
-	if ((tmpstr = tmpnam(sixs_out_filename)) == NULL) {
-      fprintf(stderr,"ERROR: creating temporary file %s\n",sixs_out_filename);
-      exit(-1);
-    }
+	/* The ocean surface needs the BRDF options of 6S, which libsixs doesn't
+	   have, so the cases go through one 6S process in batch mode */
+	strcpy(sixs_deck_filename,"sixs_deck_XXXXXX");
+	if ((deck_fd=mkstemp(sixs_deck_filename))<0 ||
+	    (fd=fdopen(deck_fd,"w"))==NULL) {
+		fprintf(stderr,"ERROR: creating temporary file %s\n",sixs_deck_filename);
+		exit(-1);
+	}
 	
 	for (i=0;i<SIXS_NB_BANDS;i++) {
 		for (j=0;j<SIXS_NB_AOT;j++) {
-			printf("Processing Band %d  AOT %d\n",i+1,j+1);
-			if ((fd=fopen(sixs_cmd_filename,"w"))==NULL) {
-				fprintf(stderr,"ERROR: creating temporary file %s\n",sixs_cmd_filename);
-				exit(-1);
-			}
-
-			fprintf(fd,"%s <<+ >%s\n",get_sixs_path(),sixs_out_filename);
 			fprintf(fd,"0 (user defined)\n");
 			fprintf(fd,"%.2f %.2f %.2f %.2f %d %d (geometrical conditions sza saz vza vaz month day)\n",sixs_tables->sza,sixs_tables->phi,sixs_tables->vza,0.,sixs_tables->month,sixs_tables->day);
 			fprintf(fd,"8 (option for water vapor and ozone)\n");
@@ -434,255 +397,47 @@ int create_6S_tables_water(sixs_tables_t *sixs_tables) {
 			fprintf(fd,"1 (directional effects)\n");
 			fprintf(fd,"6 (Ocean)\n");
 			fprintf(fd,"2.0 0.0 0.0 .10 (wind speed(m/s) wind azimuth(deg) salinity(deg) pigment concentration(mg/m3))\n");
-			fprintf(fd,"%.3f (value of rho)\n",sixs_tables->srefl);
 			fprintf(fd,"-1 (no atmospheric correction)\n");
-			fprintf(fd,"+\n");
-			fclose(fd);
-	
-            /* Modified 9/26/2014 to run bash shell vs. sh */
-			sprintf(cmd,"bash %s",sixs_cmd_filename);
-			if (system(cmd)) {
-				fprintf(stderr,"ERROR: Can't run 6S \n");
-				exit(-1);
-			}
-	
-			if ((fd=fopen(sixs_out_filename,"r"))==NULL) {
-				fprintf(stderr,"ERROR: reading temporary file %s\n",sixs_out_filename);
-				exit(-1);
-			}
-			while (fgets(line_in,256,fd)) {
-				line_in[strlen(line_in)-1]='\0';
-				if (j==0) {
-					if (!strncmp(line_in,"*      rayl.  sca. trans. :",27)) {
-						k=27;
-						while (line_in[k]==' ')
-							k++;
-						sscanf(&line_in[k],"%f",&sixs_tables->T_r_down[i]);
-						while (line_in[k]!=' ')		/* downward */
-							k++;
-						while (line_in[k]==' ')		/* blank */
-							k++;
-						sscanf(&line_in[k],"%f",&sixs_tables->T_r_up[i]);
-						while (line_in[k]!=' ')		/* upward */
-							k++;
-						while (line_in[k]==' ')		/* blank */
-							k++;
-						sscanf(&line_in[k],"%f",&sixs_tables->T_r[i]);
-					}
-					if (!strncmp(line_in,"*      water   \"     \"    :",27)) {
-						k=27;
-						while (line_in[k]==' ')
-							k++;
-						while (line_in[k]!=' ')		/* downward */
-							k++;
-						while (line_in[k]==' ')		/* blank */
-							k++;
-						while (line_in[k]!=' ')		/* upward */
-							k++;
-						while (line_in[k]==' ')		/* blank */
-							k++;
-						sscanf(&line_in[k],"%f",&sixs_tables->T_g_wv[i]);
-					}
-					if (!strncmp(line_in,"*      ozone   \"     \"    :",27)) {
-						k=27;
-						while (line_in[k]==' ')
-							k++;
-						while (line_in[k]!=' ')		/* downward */
-							k++;
-						while (line_in[k]==' ')		/* blank */
-							k++;
-						while (line_in[k]!=' ')		/* upward */
-							k++;
-						while (line_in[k]==' ')		/* blank */
-							k++;
-						sscanf(&line_in[k],"%f",&tgoz);
-					}
-					if (!strncmp(line_in,"*      co2     \"     \"    :",27)) {
-						k=27;
-						while (line_in[k]==' ')
-							k++;
-						while (line_in[k]!=' ')		/* downward */
-							k++;
-						while (line_in[k]==' ')		/* blank */
-							k++;
-						while (line_in[k]!=' ')		/* upward */
-							k++;
-						while (line_in[k]==' ')		/* blank */
-							k++;
-						sscanf(&line_in[k],"%f",&tgco2);
-					}
-					if (!strncmp(line_in,"*      oxyg    \"     \"    :",27)) {
-						k=27;
-						while (line_in[k]==' ')
-							k++;
-						while (line_in[k]!=' ')		/* downward */
-							k++;
-						while (line_in[k]==' ')		/* blank */
-							k++;
-						while (line_in[k]!=' ')		/* upward */
-							k++;
-						while (line_in[k]==' ')		/* blank */
-							k++;
-						sscanf(&line_in[k],"%f",&tgo2);
-					}
-					if (!strncmp(line_in,"*      no2     \"     \"    :",27)) {
-						k=27;
-						while (line_in[k]==' ')
-							k++;
-						while (line_in[k]!=' ')		/* downward */
-							k++;
-						while (line_in[k]==' ')		/* blank */
-							k++;
-						while (line_in[k]!=' ')		/* upward */
-							k++;
-						while (line_in[k]==' ')		/* blank */
-							k++;
-						sscanf(&line_in[k],"%f",&tgno2);
-					}
-					if (!strncmp(line_in,"*      ch4     \"     \"    :",27)) {
-						k=27;
-						while (line_in[k]==' ')
-							k++;
-						while (line_in[k]!=' ')		/* downward */
-							k++;
-						while (line_in[k]==' ')		/* blank */
-							k++;
-						while (line_in[k]!=' ')		/* upward */
-							k++;
-						while (line_in[k]==' ')		/* blank */
-							k++;
-						sscanf(&line_in[k],"%f",&tgch4);
-					}
-					if (!strncmp(line_in,"*      co      \"     \"    :",27)) {
-						k=27;
-						while (line_in[k]==' ')
-							k++;
-						while (line_in[k]!=' ')		/* downward */
-							k++;
-						while (line_in[k]==' ')		/* blank */
-							k++;
-						while (line_in[k]!=' ')		/* upward */
-							k++;
-						while (line_in[k]==' ')		/* blank */
-							k++;
-						sscanf(&line_in[k],"%f",&tgco);
-					}
-					sixs_tables->T_g_og[i]=tgoz*tgco2*tgo2*tgno2*tgno2*tgch4*tgco;
-				}
-				if (!strncmp(line_in,"*      spherical albedo   :",27)) {
-					k=27;
-					while (line_in[k]==' ')			/* blank */
-						k++;
-					if (j==0)
-						sscanf(&line_in[k],"%f",&sixs_tables->S_r[i]);
-					while (line_in[k]!=' ')			/* Rayleigh */
-						k++;
-					while (line_in[k]==' ')			/* blank */
-						k++;
-					while (line_in[k]!=' ')			/* Aerosol */
-						k++;
-					while (line_in[k]==' ')			/* blank */
-						k++;
-					sscanf(&line_in[k],"%f",&sixs_tables->S_ra[i][j]);
-				}
-				if (!strncmp(line_in,"*      optical depth total:",27)) {
-					k=27;
-					while (line_in[k]==' ')			/* blank */
-						k++;
-					while (line_in[k]!=' ')			/* Rayleigh */
-						k++;
-					while (line_in[k]==' ')			/* blank */
-						k++;
-					sscanf(&line_in[k],"%f",&sixs_tables->aot_wavelength[i][j]);
-				}
-				if (!strncmp(line_in,"*      aeros. sca.   \"    :",27)) {
-					k=27;
-					while (line_in[k]==' ')
-						k++;
-					sscanf(&line_in[k],"%f",&sixs_tables->T_a_down[i][j]);
-					while (line_in[k]!=' ')		/* downward */
-						k++;
-					while (line_in[k]==' ')		/* blank */
-						k++;
-					sscanf(&line_in[k],"%f",&sixs_tables->T_a_up[i][j]);
-					while (line_in[k]!=' ')		/* upward */
-						k++;
-					while (line_in[k]==' ')		/* blank */
-						k++;
-					sscanf(&line_in[k],"%f",&sixs_tables->T_a[i][j]);
-				}
-				if (!strncmp(line_in,"*      total  sca.   \"    :",27)) {
-					k=27;
-					while (line_in[k]==' ')
-						k++;
-					sscanf(&line_in[k],"%f",&sixs_tables->T_ra_down[i][j]);
-					while (line_in[k]!=' ')		/* downward */
-						k++;
-					while (line_in[k]==' ')		/* blank */
-						k++;
-					sscanf(&line_in[k],"%f",&sixs_tables->T_ra_up[i][j]);
-					while (line_in[k]!=' ')		/* upward */
-						k++;
-					while (line_in[k]==' ')		/* blank */
-						k++;
-					sscanf(&line_in[k],"%f",&sixs_tables->T_ra[i][j]);
-				}
-				if (!strncmp(line_in,"*      reflectance I      :",27)) {
-					k=27;
-					while (line_in[k]==' ')		/* blank */
-						k++;
-					if (j==0)
-						sscanf(&line_in[k],"%f",&sixs_tables->rho_r[i]);
-					while (line_in[k]!=' ')		/* rayleigh */
-						k++;
-					while (line_in[k]==' ')		/* blank */
-						k++;
-					sscanf(&line_in[k],"%f",&sixs_tables->rho_a[i][j]);
-					while (line_in[k]!=' ')		/* aerosols */
-						k++;
-					while (line_in[k]==' ')		/* blank */
-						k++;
-					sscanf(&line_in[k],"%f",&sixs_tables->rho_ra[i][j]);
-				}
-				if (!strncmp(line_in,"*       apparent reflectance",28)) { 
-					k=28;
-					while (line_in[k]==' ')		/* blank */
-						k++;
-					sscanf(&line_in[k],"%f",&sixs_tables->rho_toa[i][j]);
-				}
-			}
-			fclose(fd);
+			fprintf(fd,"0 (no polarized surface)\n");
 		}
 	}
-	unlink(sixs_cmd_filename);
-	unlink(sixs_out_filename);
+	fclose(fd);
+
+	ncases=SIXS_NB_BANDS*SIXS_NB_AOT;
+	if ((results=(sixs_results_t *)malloc(ncases*sizeof(sixs_results_t)))==NULL) {
+		fprintf(stderr,"ERROR: allocating the 6S results\n");
+		exit(-1);
+	}
+	printf("Processing 6s for %d cases\n",ncases);
+	if (run_6S_batch(sixs_deck_filename,ncases,results)) {
+		fprintf(stderr,"ERROR: Can't run 6S \n");
+		exit(-1);
+	}
+	for (i=0;i<SIXS_NB_BANDS;i++)
+		for (j=0;j<SIXS_NB_AOT;j++) {
+			store_6S_results(sixs_tables,i,j,&results[i*SIXS_NB_AOT+j]);
+			sixs_tables->rho_toa[i][j]=results[i*SIXS_NB_AOT+j].app_refl;
+		}
+	free(results);
+	unlink(sixs_deck_filename);
 	return 0;
 }
 
 /* This function is not actually used in lndsr processing */
 int compute_atmos_params_6S(sixs_atmos_params_t *sixs_atmos_params) {
-	char cmd[128],sixs_cmd_filename[128],sixs_out_filename[128],line_in[256];
-	int k;
-	float tgoz,tgco2,tgo2,tgno2,tgch4,tgco;
+	char sixs_deck_filename[128];
+	int deck_fd;
 	int tm_band[SIXS_NB_BANDS]={25,26,27,28,29,30};
-    char *tmpstr;
 	FILE *fd;
+	sixs_results_t results;
 	printf ("DEBUG: in compute_atmos_params_6S -- shouldn't be here!\n");
 	
-	if ((tmpstr = tmpnam(sixs_cmd_filename)) == NULL) {
-      fprintf(stderr,"ERROR: creating temporary file %s\n",sixs_cmd_filename);
-      exit(-1);
-    }
-	if ((tmpstr = tmpnam(sixs_out_filename)) == NULL) {
-      fprintf(stderr,"ERROR: creating temporary file %s\n",sixs_out_filename);
-      exit(-1);
-    }
-
-	if ((fd=fopen(sixs_cmd_filename,"w"))==NULL) {
-		fprintf(stderr,"ERROR: creating temporary file %s\n",sixs_cmd_filename);
+	strcpy(sixs_deck_filename,"sixs_deck_XXXXXX");
+	if ((deck_fd=mkstemp(sixs_deck_filename))<0 ||
+	    (fd=fdopen(deck_fd,"w"))==NULL) {
+		fprintf(stderr,"ERROR: creating temporary file %s\n",sixs_deck_filename);
 		exit(-1);
 	}
-	fprintf(fd,"%s <<+ >%s\n",get_sixs_path(),sixs_out_filename);
 	fprintf(fd,"0\n");
 	fprintf(fd,"%.2f %.2f %.2f %.2f %d %d\n",sixs_atmos_params->sza,sixs_atmos_params->phi,sixs_atmos_params->vza,0.,sixs_atmos_params->month,sixs_atmos_params->day);
 	fprintf(fd,"8\n");
@@ -704,217 +459,53 @@ int compute_atmos_params_6S(sixs_atmos_params_t *sixs_atmos_params) {
 	fprintf(fd,"%.3f\n",sixs_atmos_params->srefl);
 	fprintf(fd,"-1\n");
 	fprintf(fd,"0\n");
-	fprintf(fd,"+\n");
 	fclose(fd);
 	
-	sprintf(cmd,"bash %s",sixs_cmd_filename);
-	if (system(cmd)) {
+	if (run_6S_batch(sixs_deck_filename,1,&results)) {
 		fprintf(stderr,"ERROR: Can't run 6S \n");
 		exit(-1);
 	}
+	sixs_atmos_params->S_r=results.sph_alb[0];
+	sixs_atmos_params->T_r_down=results.t_ray[0];
+	sixs_atmos_params->T_r_up=results.t_ray[1];
+	sixs_atmos_params->T_a_down=results.t_aer[0];
+	sixs_atmos_params->T_a_up=results.t_aer[1];
+	sixs_atmos_params->rho_r=results.refl[0];
+	sixs_atmos_params->rho_a=results.refl[1];
+	sixs_atmos_params->T_g_wv=results.tg_wv[2];
+	sixs_atmos_params->T_g_og=results.tg_oz[2]*results.tg_co2[2]*
+	  results.tg_o2[2]*results.tg_no2[2]*results.tg_no2[2]*results.tg_ch4[2]*
+	  results.tg_co[2];
 	
-	if ((fd=fopen(sixs_out_filename,"r"))==NULL) {
-		fprintf(stderr,"ERROR: reading temporary file %s\n",sixs_out_filename);
-		exit(-1);
-	}
-	while (fgets(line_in,256,fd)) {
-		line_in[strlen(line_in)-1]='\0';
-		if (!strncmp(line_in,"*      spherical albedo   :",27)) {
-			k=27;
-			while (line_in[k]==' ')
-				k++;
-			sscanf(&line_in[k],"%f",&sixs_atmos_params->S_r);
-		}
-		if (!strncmp(line_in,"*      rayl.  sca. trans. :",27)) {
-			k=27;
-			while (line_in[k]==' ')
-				k++;
-			sscanf(&line_in[k],"%f",&sixs_atmos_params->T_r_down);
-			while (line_in[k]!=' ')		/* downward */
-				k++;
-			while (line_in[k]==' ')		/* blank */
-				k++;
-			sscanf(&line_in[k],"%f",&sixs_atmos_params->T_r_up);
-		}
-		if (!strncmp(line_in,"*      aeros. sca.   \"    :",27)) {
-			k=27;
-			while (line_in[k]==' ')
-				k++;
-			sscanf(&line_in[k],"%f",&sixs_atmos_params->T_a_down);
-			while (line_in[k]!=' ')		/* downward */
-				k++;
-			while (line_in[k]==' ')		/* blank */
-				k++;
-			sscanf(&line_in[k],"%f",&sixs_atmos_params->T_a_up);
-		}
-		if (!strncmp(line_in,"*      reflectance I      :",27)) {
-			k=27;
-			while (line_in[k]==' ')		/* blank */
-				k++;
-			sscanf(&line_in[k],"%f",&sixs_atmos_params->rho_r);
-			while (line_in[k]!=' ')		/* rayleigh */
-				k++;
-			while (line_in[k]==' ')		/* blank */
-				k++;
-			sscanf(&line_in[k],"%f",&sixs_atmos_params->rho_a);
-		}
-		if (!strncmp(line_in,"*      water   \"     \"    :",27)) {
-			k=27;
-			while (line_in[k]==' ')
-				k++;
-			while (line_in[k]!=' ')		/* downward */
-				k++;
-			while (line_in[k]==' ')		/* blank */
-				k++;
-			while (line_in[k]!=' ')		/* upward */
-				k++;
-			while (line_in[k]==' ')		/* blank */
-				k++;
-			sscanf(&line_in[k],"%f",&sixs_atmos_params->T_g_wv);
-		}
-		if (!strncmp(line_in,"*      ozone   \"     \"    :",27)) {
-			k=27;
-			while (line_in[k]==' ')
-				k++;
-			while (line_in[k]!=' ')		/* downward */
-				k++;
-			while (line_in[k]==' ')		/* blank */
-				k++;
-			while (line_in[k]!=' ')		/* upward */
-				k++;
-			while (line_in[k]==' ')		/* blank */
-				k++;
-			sscanf(&line_in[k],"%f",&tgoz);
-		}
-		if (!strncmp(line_in,"*      co2     \"     \"    :",27)) {
-			k=27;
-			while (line_in[k]==' ')
-				k++;
-			while (line_in[k]!=' ')		/* downward */
-				k++;
-			while (line_in[k]==' ')		/* blank */
-				k++;
-			while (line_in[k]!=' ')		/* upward */
-				k++;
-			while (line_in[k]==' ')		/* blank */
-				k++;
-			sscanf(&line_in[k],"%f",&tgco2);
-		}
-		if (!strncmp(line_in,"*      oxyg    \"     \"    :",27)) {
-			k=27;
-			while (line_in[k]==' ')
-				k++;
-			while (line_in[k]!=' ')		/* downward */
-				k++;
-			while (line_in[k]==' ')		/* blank */
-				k++;
-			while (line_in[k]!=' ')		/* upward */
-				k++;
-			while (line_in[k]==' ')		/* blank */
-				k++;
-			sscanf(&line_in[k],"%f",&tgo2);
-		}
-		if (!strncmp(line_in,"*      no2     \"     \"    :",27)) {
-			k=27;
-			while (line_in[k]==' ')
-				k++;
-			while (line_in[k]!=' ')		/* downward */
-				k++;
-			while (line_in[k]==' ')		/* blank */
-				k++;
-			while (line_in[k]!=' ')		/* upward */
-				k++;
-			while (line_in[k]==' ')		/* blank */
-				k++;
-			sscanf(&line_in[k],"%f",&tgno2);
-		}
-		if (!strncmp(line_in,"*      ch4     \"     \"    :",27)) {
-			k=27;
-			while (line_in[k]==' ')
-				k++;
-			while (line_in[k]!=' ')		/* downward */
-				k++;
-			while (line_in[k]==' ')		/* blank */
-				k++;
-			while (line_in[k]!=' ')		/* upward */
-				k++;
-			while (line_in[k]==' ')		/* blank */
-				k++;
-			sscanf(&line_in[k],"%f",&tgch4);
-		}
-		if (!strncmp(line_in,"*      co      \"     \"    :",27)) {
-			k=27;
-			while (line_in[k]==' ')
-				k++;
-			while (line_in[k]!=' ')		/* downward */
-				k++;
-			while (line_in[k]==' ')		/* blank */
-				k++;
-			while (line_in[k]!=' ')		/* upward */
-				k++;
-			while (line_in[k]==' ')		/* blank */
-				k++;
-			sscanf(&line_in[k],"%f",&tgco);
-		}
-	}
-	fclose(fd);
-	sixs_atmos_params->T_g_og=tgoz*tgco2*tgo2*tgno2*tgno2*tgch4*tgco;
-	
-	unlink(sixs_cmd_filename);
-	unlink(sixs_out_filename);
+	unlink(sixs_deck_filename);
 	return 0;
 }
 
-#ifdef SAVE_6S_RESULTS
-int read_6S_results_from_file(char *filename,sixs_tables_t *sixs_tables) {
+/* Run the ncases 6S parameter sets of deck_filename through a single 6S
+   process in batch mode, reading its binary records through a pipe.
+   Returns 0 when every case was run, -1 otherwise. */
+static int run_6S_batch(const char *deck_filename, int ncases,
+                        sixs_results_t *results) {
+	char *cmd;
 	FILE *fd;
-	int run_sixs,i,j;
+	sixs_record_t record;
+	int n,status;
 
-	if ((fd=fopen(filename,"r"))==NULL)
-		return 1;
-	run_sixs=0;
-	if (fscanf(fd,"%d %d",&sixs_tables->month,&sixs_tables->day) != 2)
-		run_sixs=1;
-	if (fscanf(fd,"%f",&sixs_tables->srefl)!=1)
-		run_sixs=1;
-	if (fscanf(fd,"%f %f %f",&sixs_tables->sza,&sixs_tables->vza,&sixs_tables->phi)!=3)
-		run_sixs=1;
-	if (fscanf(fd,"%f %f %f",&sixs_tables->uwv,&sixs_tables->uoz,&sixs_tables->target_alt)!=3)
-		run_sixs=1;
-	for (i=0;i<SIXS_NB_AOT;i++)
-		if (fscanf(fd,"%f ",&sixs_tables->aot[i])!=1)
-			run_sixs=1;
-	for (i=0;i<SIXS_NB_BANDS;i++) {
-		if (fscanf(fd,"%f %f %f %f %f %f %f",&sixs_tables->S_r[i],&sixs_tables->T_r_up[i],&sixs_tables->T_r_down[i],&sixs_tables->T_r[i],&sixs_tables->T_g_wv[i],&sixs_tables->T_g_og[i],&sixs_tables->rho_r[i])!=7)
-			run_sixs=1;
-		for (j=0;j<SIXS_NB_AOT;j++)
-			if (fscanf(fd,"%f %f %f %f %f %f %f %f %f %f %f",&sixs_tables->aot_wavelength[i][j],&sixs_tables->T_a_up[i][j],&sixs_tables->T_a_down[i][j],&sixs_tables->T_a[i][j],&sixs_tables->rho_ra[i][j],&sixs_tables->rho_a[i][j],&sixs_tables->S_ra[i][j],&sixs_tables->T_ra_up[i][j],&sixs_tables->T_ra_down[i][j],&sixs_tables->T_ra[i][j],&sixs_tables->rho_toa[i][j])!=11)
-				run_sixs=1;
-	}
-	fclose(fd);
-	return run_sixs;
-	
-}
-
-int write_6S_results_to_file(char *filename,sixs_tables_t *sixs_tables) {
-	FILE *fd;
-	int i,j;
-
-	if ((fd=fopen(filename,"w"))==NULL)
+	cmd=(char *)malloc(strlen(get_sixs_path())+strlen(deck_filename)+32);
+	if (cmd==NULL)
+		return -1;
+	sprintf(cmd,"%s -batch -binary < %s",get_sixs_path(),deck_filename);
+	if ((fd=popen(cmd,"r"))==NULL) {
+		free(cmd);
 		return -1;
-	fprintf(fd,"%02d %03d\n",sixs_tables->month,sixs_tables->day);
-	fprintf(fd,"%010.6f\n",sixs_tables->srefl);
-	fprintf(fd,"%010.6f %010.6f %010.6f\n",sixs_tables->sza,sixs_tables->vza,sixs_tables->phi);
-	fprintf(fd,"%010.6f %010.6f %010.2f\n",sixs_tables->uwv,sixs_tables->uoz,sixs_tables->target_alt);
-	for (i=0;i<SIXS_NB_AOT;i++)
-		fprintf(fd,"%07.4f ",sixs_tables->aot[i]);
-	fprintf(fd,"\n");
-	for (i=0;i<SIXS_NB_BANDS;i++) {
-		fprintf(fd,"%010.6f %010.6f %010.6f %010.6f %010.6f %010.6f %010.6f\n",sixs_tables->S_r[i],sixs_tables->T_r_up[i],sixs_tables->T_r_down[i],sixs_tables->T_r[i],sixs_tables->T_g_wv[i],sixs_tables->T_g_og[i],sixs_tables->rho_r[i]);
-			for (j=0;j<SIXS_NB_AOT;j++)
-				fprintf(fd,"%07.4f %010.6f %010.6f %010.6f %010.6f %010.6f %010.6f %010.6f %010.6f %010.6f %010.6f\n",sixs_tables->aot_wavelength[i][j],sixs_tables->T_a_up[i][j],sixs_tables->T_a_down[i][j],sixs_tables->T_a[i][j],sixs_tables->rho_ra[i][j],sixs_tables->rho_a[i][j],sixs_tables->S_ra[i][j],sixs_tables->T_ra_up[i][j],sixs_tables->T_ra_down[i][j],sixs_tables->T_ra[i][j],sixs_tables->rho_toa[i][j]);
 	}
-	fclose(fd);
-	return 0;
+	for (n=0;n<ncases;n++) {
+		if (fread(&record,sizeof(record),1,fd)!=1 || record.icase!=n+1 ||
+		    record.ierr)
+			break;
+		sixs_unpack_results(record.res,&results[n]);
+	}
+	status=pclose(fd);
+	free(cmd);
+	return (n==ncases && status==0)?0:-1;
 }
-#endif
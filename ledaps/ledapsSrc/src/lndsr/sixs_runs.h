@@ -5,6 +5,9 @@
 #define SIXS_NB_AOT 15
 #define SIXS_NB_BANDS 6
 
+/* Round x to a multiple of q, as printf did for the 6S command cards */
+#define SIXS_QUANT(x,q) ((float)(floor((x)/(q)+0.5)*(q)))
+
 typedef enum {
   SIXS_INST_NULL = -1,
   SIXS_INST_MSS = 0, 
@@ -53,7 +56,9 @@ typedef struct {
 	float rho_a;  /* aerosol reflectance */
 } sixs_atmos_params_t;
 
-int create_6S_tables(sixs_tables_t *sixs_tables, Input_meta_t *meta);
+int create_6S_tables(sixs_tables_t *sixs_tables, int nworkers);
+int create_6S_tables_naot(sixs_tables_t *sixs_tables, int naot,
+                          int nworkers);
 int compute_atmos_params_6S(sixs_atmos_params_t *sixs_atmos_params);
 
 #endif
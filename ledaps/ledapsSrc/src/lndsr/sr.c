@@ -15,80 +15,283 @@
 extern atmos_t atmos_coef;
 int SrInterpAtmCoef(Lut_t *lut, Img_coord_int_t *input_loc, atmos_t *atmos_coef,atmos_t *interpol_atmos_coef); 
 
-bool Sr(Lut_t *lut, int nsamp, int il, int16 **line_in, int16 **line_out,
-        Sr_stats_t *sr_stats) 
+static void SrLine(Lut_t *lut, Sr_interp_t *interp, int ib, int nsamp,
+                   int16 *line_in, int16 *line_out, Sr_stats_t *sr_stats)
+/* 
+  Corrects one band of a line.  The loop has no branches, so that the
+  compiler can vectorize it (see VECT_OPTIONS in the Makefile): every
+  pixel is corrected, and fill and saturated pixels are then replaced by
+  their output values.  As before, a pixel is left out of the statistics
+  once it is fill or saturated in a band.
+ */
 {
   int is;
-  bool is_fill;      /* is the pixel fill */
-  bool is_satu;      /* is the pixel saturated */
-  int ib;
-  Img_coord_int_t loc;
-  float rho,tmpflt;
-  atmos_t interpol_atmos_coef;
-
-  allocate_mem_atmos_coeff(1,&interpol_atmos_coef);
-  loc.l = il;
+  int in, out, is_fill, is_satu, is_low, is_high, is_valid;
+  int sr_min, sr_max;
+  long nfill, nsatu, nout_range, nvalid;
+  float rho, tmpflt;
+  const float *tgOG = interp->tgOG[ib];
+  const float *tgH2O = interp->tgH2O[ib];
+  const float *td_ra = interp->td_ra[ib];
+  const float *tu_ra = interp->tu_ra[ib];
+  const float *rho_ra = interp->rho_ra[ib];
+  const float *S_ra = interp->S_ra[ib];
+  uint8 *skip = interp->skip;
+  const int in_fill = lut->in_fill, in_satu = lut->in_satu;
+  const int output_fill = lut->output_fill, output_satu = lut->output_satu;
+  const int min_valid_sr = lut->min_valid_sr;
+  const int max_valid_sr = lut->max_valid_sr;
+
+  nfill = nsatu = nout_range = nvalid = 0;
+  sr_min = 32767;
+  sr_max = -32768;
 
   for (is = 0; is < nsamp; is++) {
-    loc.s = is;
-    is_fill = false;
-    is_satu = false;
+    in = line_in[is];
+    is_fill = (in == in_fill);
+    is_satu = (in == in_satu) & !is_fill;
+
+    rho=(float)in/10000.;
+    rho=(rho/tgOG[is]-rho_ra[is]);
+    tmpflt=(tgH2O[is]*td_ra[is]*tu_ra[is]);
+    rho /= tmpflt;
+    rho /= (1.+S_ra[is]*rho);
+
+    out = (int16)(rho*10000.);  /* scale for output */
+    is_low = (out < min_valid_sr);
+    out = is_low ? min_valid_sr : out;
+    is_high = (out > max_valid_sr);
+    out = is_high ? max_valid_sr : out;
+    out = is_satu ? output_satu : out;
+    out = is_fill ? output_fill : out;
+    out = (int16)out;
+    line_out[is] = out;
+
+    nfill += is_fill;
+    nsatu += is_satu;
+    nout_range += (is_low + is_high) & !(is_fill | is_satu);
+
+    skip[is] |= (is_fill | is_satu);
+    is_valid = !skip[is];
+    nvalid += is_valid;
+    in = out + (1 - is_valid) * 65536;   /* out of the int16 range */
+    sr_min = (in < sr_min) ? in : sr_min;
+    in = out - (1 - is_valid) * 65536;
+    sr_max = (in > sr_max) ? in : sr_max;
+  }
+
+  sr_stats->nfill[ib] += nfill;
+  sr_stats->nsatu[ib] += nsatu;
+  sr_stats->nout_range[ib] += nout_range;
+  if (nvalid == 0) return;
+  if (sr_stats->first[ib]) {
+    sr_stats->sr_min[ib] = sr_min;
+    sr_stats->sr_max[ib] = sr_max;
+    sr_stats->first[ib] = false;
+  } else {
+    if (sr_min < sr_stats->sr_min[ib])
+      sr_stats->sr_min[ib] = sr_min;
+    if (sr_max > sr_stats->sr_max[ib])
+      sr_stats->sr_max[ib] = sr_max;
+  }
+}
+
+
+bool Sr(Lut_t *lut, Sr_interp_t *interp, int nsamp, int il, int16 **line_in,
+        int16 **line_out, Sr_stats_t *sr_stats) 
+{
+  int is;
+  int ib;
 
 /*
 NAZMI 6/2/04 : correct even cloudy pixels
 
 */
-	 SrInterpAtmCoef(lut, &loc, &atmos_coef,&interpol_atmos_coef);
-
-    for (ib = 0; ib < lut->nband; ib++) {
-      if (line_in[ib][is] == lut->in_fill) {
-        /* fill pixel */
-        is_fill = true;
-        line_out[ib][is] = lut->output_fill;
-        sr_stats->nfill[ib]++;
-      }
-      else if (line_in[ib][is] == lut->in_satu) {
-        /* saturated pixel */
-        is_satu = true;
-        line_out[ib][is] = lut->output_satu;
-        sr_stats->nsatu[ib]++;
-      }
-      else {
-        rho=(float)line_in[ib][is]/10000.;
-        rho=(rho/interpol_atmos_coef.tgOG[ib][0]-interpol_atmos_coef.rho_ra[ib][0]);
-        tmpflt=(interpol_atmos_coef.tgH2O[ib][0]*interpol_atmos_coef.td_ra[ib][0]*interpol_atmos_coef.tu_ra[ib][0]);
-        rho /= tmpflt;
-        rho /= (1.+interpol_atmos_coef.S_ra[ib][0]*rho);
-
-        line_out[ib][is] = (short)(rho*10000.);  /* scale for output */
-
-        if (line_out[ib][is] < lut->min_valid_sr) {
-          sr_stats->nout_range[ib]++;
-          line_out[ib][is] = lut->min_valid_sr;
-        }
-        if (line_out[ib][is] > lut->max_valid_sr) {
-          sr_stats->nout_range[ib]++;
-          line_out[ib][is] = lut->max_valid_sr;
-        }
-      }
+  if (!SrInterpLine(lut, il, &atmos_coef, interp))
+    RETURN_ERROR("interpolating the atmospheric coefficients", "Sr", false);
+
+  for (is = 0; is < nsamp; is++)
+    interp->skip[is] = 0;
+  for (ib = 0; ib < lut->nband; ib++)
+    SrLine(lut, interp, ib, nsamp, line_in[ib], line_out[ib], sr_stats);
+
+  return true;
+}
+
+bool SrInterpInit(Lut_t *lut, int nsamp, Sr_interp_t *interp)
+/* 
+  Sets the grid columns and sample weights of every sample for
+  SrInterpLine.  They are computed as in SrInterpAtmCoef, so both give
+  the same coefficients.
+ */
+{
+  int is, ib, i, s0, s1, half_s;
+  float *buf;
+
+  interp->nsamp = nsamp;
+  interp->seg_start = (int *)calloc((size_t)(3 * (nsamp + 1)), sizeof(int));
+  interp->ws0 = (double *)calloc((size_t)(7 * nsamp), sizeof(double));
+  interp->buf = (float *)calloc((size_t)(6 * NBAND_REFL_MAX * nsamp),
+    sizeof(float));
+  interp->skip = (uint8 *)calloc((size_t)nsamp, sizeof(uint8));
+  if (interp->seg_start == NULL  ||  interp->ws0 == NULL  ||
+      interp->buf == NULL  ||  interp->skip == NULL) {
+    SrInterpFree(interp);
+    RETURN_ERROR("allocating interpolation buffers", "SrInterpInit", false);
+  }
+  interp->seg_s0 = interp->seg_start + nsamp + 1;
+  interp->seg_s1 = interp->seg_s0 + nsamp + 1;
+  interp->ws1 = interp->ws0 + nsamp;
+  for (i = 0; i < 4; i++)
+    interp->w[i] = interp->ws1 + (i + 1) * nsamp;
+  interp->sum_w = interp->w[3] + nsamp;
+
+  buf = interp->buf;
+  for (ib = 0; ib < NBAND_REFL_MAX; ib++) {
+    interp->tgOG[ib] = buf;   buf += nsamp;
+    interp->tgH2O[ib] = buf;  buf += nsamp;
+    interp->td_ra[ib] = buf;  buf += nsamp;
+    interp->tu_ra[ib] = buf;  buf += nsamp;
+    interp->rho_ra[ib] = buf; buf += nsamp;
+    interp->S_ra[ib] = buf;   buf += nsamp;
+  }
+
+  half_s = (lut->ar_region_size.s + 1) / 2;
+  interp->nseg = 0;
+  for (is = 0; is < nsamp; is++) {
+    s0 = (is - half_s) / lut->ar_region_size.s;
+    s1 = s0 + 1;
+    if (s1 >= lut->ar_size.s) {
+      s1 = lut->ar_size.s - 1;
+      if (s0 > 0) s0--;
+    }
+    interp->ws0[is] = 1.0 - fabs((double)((is - half_s) - 
+      (s0 * lut->ar_region_size.s))) / lut->ar_region_size.s;
+    interp->ws1[is] = 1.0 - fabs((double)((is - half_s) - 
+      (s1 * lut->ar_region_size.s))) / lut->ar_region_size.s;
+
+    if (interp->nseg == 0  ||  s0 != interp->seg_s0[interp->nseg - 1]  ||
+        s1 != interp->seg_s1[interp->nseg - 1]) {
+      interp->seg_start[interp->nseg] = is;
+      interp->seg_s0[interp->nseg] = s0;
+      interp->seg_s1[interp->nseg] = s1;
+      interp->nseg++;
+    }
+  }
+  interp->seg_start[interp->nseg] = nsamp;
+
+  return true;
+}
+
+
+void SrInterpFree(Sr_interp_t *interp)
+{
+  free(interp->seg_start);
+  free(interp->ws0);
+  free(interp->buf);
+  free(interp->skip);
+  interp->seg_start = NULL;
+  interp->ws0 = NULL;
+  interp->buf = NULL;
+  interp->skip = NULL;
+}
+
+
+bool SrInterpLine(Lut_t *lut, int il, atmos_t *atmos_coef,
+                  Sr_interp_t *interp)
+/* 
+  Interpolates tgOG, tgH2O, td_ra, tu_ra, rho_ra and S_ra for every sample
+  of line il.  The weights and the sums are the ones of SrInterpAtmCoef,
+  taken in the same order.  Where none of the corners is computed a sample
+  keeps the values of the previous one, or no correction at the start of
+  the line.
+
+  Point order:
 
-      if (is_fill || is_satu) continue;
+    0 ---- 1    +--> sample
+    |      |    |
+    |      |    v
+    2 ---- 3   line
 
-      if (sr_stats->first[ib]) {
-        sr_stats->sr_min[ib] = sr_stats->sr_max[ib] = line_out[ib][is];
-        sr_stats->first[ib] = false;
-      } else {
-        if (line_out[ib][is] < sr_stats->sr_min[ib])
-          sr_stats->sr_min[ib] = line_out[ib][is];
+ */
+{
+  int pl[4], ps[4], ipt[4];
+  int half_l, iseg, is, is0, is1, i, n, ib, ic;
+  double wl[4], *ws[4], *w, sum;
+  float c[4];
+  float **coef_in[6], **coef_out[6];
+  static const float no_corr[6] = {1.0, 1.0, 1.0, 1.0, 0.0, 0.0};
+
+  coef_in[0] = atmos_coef->tgOG;    coef_out[0] = interp->tgOG;
+  coef_in[1] = atmos_coef->tgH2O;   coef_out[1] = interp->tgH2O;
+  coef_in[2] = atmos_coef->td_ra;   coef_out[2] = interp->td_ra;
+  coef_in[3] = atmos_coef->tu_ra;   coef_out[3] = interp->tu_ra;
+  coef_in[4] = atmos_coef->rho_ra;  coef_out[4] = interp->rho_ra;
+  coef_in[5] = atmos_coef->S_ra;    coef_out[5] = interp->S_ra;
+
+  /* Grid lines and line weights */
+  half_l = (lut->ar_region_size.l + 1) / 2;
+  pl[0] = (il - half_l) / lut->ar_region_size.l;
+  pl[2] = pl[0] + 1;
+  if (pl[2] >= lut->ar_size.l) {
+    pl[2] = lut->ar_size.l - 1;
+    if (pl[0] > 0) pl[0]--;
+  }
+  pl[1] = pl[0];
+  pl[3] = pl[2];
+  for (i = 0; i < 4; i++)
+    wl[i] = 1.0 - fabs((double)((il - half_l) - 
+      (pl[i] * lut->ar_region_size.l))) / lut->ar_region_size.l;
+
+  for (iseg = 0; iseg < interp->nseg; iseg++) {
+    is0 = interp->seg_start[iseg];
+    is1 = interp->seg_start[iseg + 1];
+    ps[0] = ps[2] = interp->seg_s0[iseg];
+    ps[1] = ps[3] = interp->seg_s1[iseg];
+
+    /* Computed corners of the cell and their weights */
+    n = 0;
+    for (i = 0; i < 4; i++) {
+      if (pl[i] == -1  ||  ps[i] == -1) continue;
+      ipt[n] = pl[i] * lut->ar_size.s + ps[i];
+      if (!(atmos_coef->computed[ipt[n]])) continue;
+      ws[n] = (i == 0  ||  i == 2) ? interp->ws0 : interp->ws1;
+      w = interp->w[n];
+      for (is = is0; is < is1; is++)
+        w[is] = wl[i] * ws[n][is];
+      n++;
+    }
+
+    if (n == 0) {
+      for (ic = 0; ic < 6; ic++)
+        for (ib = 0; ib < lut->nband; ib++)
+          for (is = is0; is < is1; is++)
+            coef_out[ic][ib][is] = (is > 0) ? coef_out[ic][ib][is - 1] : 
+              no_corr[ic];
+      continue;
+    }
 
-        if (line_out[ib][is] > sr_stats->sr_max[ib])
-          sr_stats->sr_max[ib] = line_out[ib][is];
-      } 
-    }  /* end for */
+    for (is = is0; is < is1; is++) {
+      sum = 0.0;
+      for (i = 0; i < n; i++)
+        sum += interp->w[i][is];
+      interp->sum_w[is] = sum;
+    }
 
+    for (ic = 0; ic < 6; ic++) {
+      for (ib = 0; ib < lut->nband; ib++) {
+        for (i = 0; i < n; i++)
+          c[i] = coef_in[ic][ib][ipt[i]];
+        for (is = is0; is < is1; is++) {
+          sum = 0.0;
+          for (i = 0; i < n; i++)
+            sum += (c[i] * interp->w[i][is]);
+          coef_out[ic][ib][is] = sum / interp->sum_w[is];
+        }
+      }
+    }
   }
 
-  free_mem_atmos_coeff(&interpol_atmos_coef);
   return true;
 }
 
@@ -15,7 +15,35 @@ typedef struct {
   long nout_range[NBAND_SR_MAX];
 } Sr_stats_t;
 
+/* Atmospheric coefficients interpolated for a whole line.  The aerosol
+   grid cell of a sample and its sample weights don't depend on the line,
+   so they are set once by SrInterpInit; SrInterpLine then only computes
+   the line weights and the corners of each run of samples sharing a
+   cell. */
+typedef struct {
+  int nsamp;           /* Number of samples in a line */
+  int nseg;            /* Number of runs of samples in the same grid cell */
+  int *seg_start;      /* First sample of each run (nseg + 1 values) */
+  int *seg_s0;         /* Left and right grid columns of each run */
+  int *seg_s1;
+  double *ws0;         /* Sample weights of the left and right columns */
+  double *ws1;
+  double *w[4];        /* Weights of the four corners for the line */
+  double *sum_w;       /* Sum of the weights of the computed corners */
+  float *tgOG[NBAND_REFL_MAX];   /* Interpolated coefficients; nsamp values */
+  float *tgH2O[NBAND_REFL_MAX];  /*   per band */
+  float *td_ra[NBAND_REFL_MAX];
+  float *tu_ra[NBAND_REFL_MAX];
+  float *rho_ra[NBAND_REFL_MAX];
+  float *S_ra[NBAND_REFL_MAX];
+  float *buf;          /* Buffer for the interpolated coefficients */
+  uint8 *skip;         /* Pixel is fill or saturated in a band so far */
+} Sr_interp_t;
 
-bool Sr(Lut_t *lut, int nsamp, int il, int16 **line_in, int16 **line_out,
-        Sr_stats_t *sr_stats);
+bool SrInterpInit(Lut_t *lut, int nsamp, Sr_interp_t *interp);
+bool SrInterpLine(Lut_t *lut, int il, atmos_t *atmos_coef,
+                  Sr_interp_t *interp);
+void SrInterpFree(Sr_interp_t *interp);
+bool Sr(Lut_t *lut, Sr_interp_t *interp, int nsamp, int il, int16 **line_in,
+        int16 **line_out, Sr_stats_t *sr_stats);
 #endif
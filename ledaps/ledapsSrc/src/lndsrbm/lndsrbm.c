@@ -28,6 +28,7 @@ NOTES:
 #include "espa_metadata.h"
 #include "parse_metadata.h"
 #include "raw_binary_io.h"
+#include "dilate.h"
 
 typedef signed short int16;
 typedef unsigned char uint8;
@@ -243,6 +244,8 @@ int main (int argc, char **argv)
     uint8 *tmpbit_qa = NULL;      /* temporary bit for QA data */
     uint8 QA_OFF = 0;        /* value for QA turned off */
     uint8 QA_ON = 255;       /* value for QA turned on */
+    dilate_t dil;            /* cloud and cloud shadow dilation */
+    const uint8 *dmask;      /* dilated line, 1 where covered */
     int16 *band1 = NULL;     /* band 1 data */
     int16 *band2 = NULL;     /* band 2 data */
     int16 *band3 = NULL;     /* band 3 data */
@@ -257,7 +260,7 @@ int main (int argc, char **argv)
     int ib;             /* looping variable for bands */
     int i;              /* looping variable for pixels */
     int il, is;         /* looping variables for lines and samples */
-    int j, k;           /* looping variables for 3x3 and 5x5 blocks */
+    int j, k;           /* line and sample of the cloud shadow */
     int pix;            /* location of current pixel */
     long nbcloud;       /* count of the cloud pixels */
     long nbclear;       /* count of the clear (non-cloud) pixels */
@@ -702,42 +705,34 @@ int main (int argc, char **argv)
     if (pclear > 5.0)
         tclear = mclear;
              
-    /* Update the adjacent cloud bit; only set for non-fill pixels */
+    /* Update the adjacent cloud bit; only set for non-fill pixels.  The
+       cloud pixels are dilated by 5 pixels (11x11 window) */
     printf ("Updating adjacent cloud bit ...\n");
-    for (il = 0; il < bmeta->nlines; il++)
+    if (allocate_dilate (&dil, bmeta->nsamps, 5, 5, 5, 5) != 0)
     {
-        for (is = 0; is < bmeta->nsamps; is++)
+        strcpy (errmsg, "Allocating the dilation buffers.");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    for (i = 0; i < bmeta->nlines + dil.up; i++)
+    {
+        /* Push the next cloud line; this completes line il */
+        dmask = dilate_push (&dil, i < bmeta->nlines ?
+            &cloud_qa[i * bmeta->nsamps] : NULL, QA_ON);
+        il = i - dil.up;
+        if (il < 0)
+            continue;
+
+        pix = il * bmeta->nsamps;
+        for (is = 0; is < bmeta->nsamps; is++, pix++)
         {
-            /* Look for adjacent clouds of cloud pixels */
-            pix = il * bmeta->nsamps + is;
-            if (cloud_qa[pix] == QA_ON)
-            {
-                /* Look at the adjacent 5x5 block for adjacent clouds */
-                for (j = il-5; j <= il+5; j++)
-                {
-                    /* Make sure the current line is within the bounds of the
-                       image */
-                    if (j >= 0 && j < bmeta->nlines)
-                    {
-                        pix = j * bmeta->nsamps + (is-5);
-                        for (k = is-5; k <= is+5; k++, pix++)
-                        {
-                            /* Make sure the current sample is within the
-                               bounds of the image */
-                            if (k >= 0 && k < bmeta->nsamps)
-                            {
-                                /* If this pixel is not cloud or fill then set
-                                   it to adjacent cloud */
-                                if (cloud_qa[pix] != QA_ON &&
-                                    fill_qa[pix] != QA_ON)
-                                    cloud_adja_qa[pix] = QA_ON;
-                            }
-                        }  /* end for k */
-                    }
-                }  /* end for j */
-            }
-        }  /* end for is */
-    }  /* end for il */
+            /* If this pixel is not cloud or fill then set it to adjacent
+               cloud */
+            if (dmask[is] && cloud_qa[pix] != QA_ON && fill_qa[pix] != QA_ON)
+                cloud_adja_qa[pix] = QA_ON;
+        }
+    }
+    free_dilate (&dil);
        
     /* Compute the cloud shadow (using temp in degrees Celsius) */
     mband5 = 9999;
@@ -810,45 +805,38 @@ int main (int argc, char **argv)
         }  /* end for is */
     }  /* end for il */
 
-    /* Dilate the cloud shadow */
+    /* Dilate the cloud shadow; a shadow pixel covers lines il-3..il+2 and
+       samples is-3..is+2 */
     printf ("Dilating cloud shadow ...\n");
-    for (il = 0; il < bmeta->nlines; il++)
+    if (allocate_dilate (&dil, bmeta->nsamps, 3, 2, 3, 2) != 0)
     {
-        for (is = 0; is < bmeta->nsamps; is++)
+        strcpy (errmsg, "Allocating the dilation buffers.");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    for (i = 0; i < bmeta->nlines + dil.up; i++)
+    {
+        /* Push the next cloud shadow line; this completes line il */
+        dmask = dilate_push (&dil, i < bmeta->nlines ?
+            &cloud_shad_qa[i * bmeta->nsamps] : NULL, QA_ON);
+        il = i - dil.up;
+        if (il < 0)
+            continue;
+
+        pix = il * bmeta->nsamps;
+        for (is = 0; is < bmeta->nsamps; is++, pix++)
         {
-            /* Look for cloud shadows of cloud pixels */
-            pix = il * bmeta->nsamps + is;
-            if (cloud_shad_qa[pix] == QA_ON)
-            {
-                /* Look at the adjacent 3x3 block for adjacent clouds */
-                for (j = il-3; j < il+3; j++)
-                {
-                    /* Make sure the current line is within the bounds of the
-                       image */
-                    if (j >= 0 && j < bmeta->nlines)
-                    {
-                        pix = j * bmeta->nsamps + (is-3);
-                        for (k = is-3; k < is+3; k++, pix++)
-                        {
-                            /* Make sure the current pixel is within the bounds
-                               of the image */
-                            if (k >= 0 && k < bmeta->nsamps)
-                            {
-                                /* If this pixel is not cloud, adjacent cloud,
-                                   cloud shadow, or fill then set the tmpbit
-                                   to on */
-                                if ((cloud_adja_qa[pix] != QA_ON) &&
-                                    (cloud_qa[pix] != QA_ON) &&
-                                    (cloud_shad_qa[pix] != QA_ON) &&
-                                    (fill_qa[pix] != QA_ON))
-                                    tmpbit_qa[pix] = QA_ON;
-                            }
-                        }  /* end for k */
-                    }
-                }  /* end for j */
-            }
-        }  /* end for is */
-    }  /* end for il */
+            /* If this pixel is not cloud, adjacent cloud, cloud shadow, or
+               fill then set the tmpbit to on */
+            if (dmask[is] &&
+                (cloud_adja_qa[pix] != QA_ON) &&
+                (cloud_qa[pix] != QA_ON) &&
+                (cloud_shad_qa[pix] != QA_ON) &&
+                (fill_qa[pix] != QA_ON))
+                tmpbit_qa[pix] = QA_ON;
+        }
+    }
+    free_dilate (&dil);
 
     /* Update the cloud shadow and clear QA for fill pixels */
     printf ("Updating cloud shadow ...\n");
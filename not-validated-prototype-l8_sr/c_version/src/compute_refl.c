@@ -1,5 +1,7 @@
+#include <unistd.h>
 #include "l8_sr.h"
 #include "time.h"
+#include "../../../ledaps/ledapsSrc/src/lndsr/dilate.h"
 
 /******************************************************************************
 MODULE:  compute_toa_refl
@@ -31,17 +33,22 @@ Date          Programmer       Reason
 NOTES:
   1. These TOA and BT algorithms match those as published by the USGS Landsat
      team in http://landsat.usgs.gov/Landsat8_Using_Product.php
+  2. Only the lines line0 to line0+nlines-1 are calibrated, so the scene can
+     be processed in stripes of lines.  The bands without an output array
+     (NULL) are skipped.
 ******************************************************************************/
 int compute_toa_refl
 (
     Input_t *input,     /* I: input structure for the Landsat product */
-    uint16 *qaband,     /* I: QA band for the input image, nlines x nsamps */
-    int nlines,         /* I: number of lines in reflectance, thermal bands */
+    uint16 *qaband,     /* I: QA band of the lines, nlines x nsamps */
+    int line0,          /* I: first line to calibrate */
+    int nlines,         /* I: number of lines to calibrate */
     int nsamps,         /* I: number of samps in reflectance, thermal bands */
     float xmus,         /* I: cosine of solar zenith angle */
     char *instrument,   /* I: instrument to be processed (OLI, TIRS) */
     int16 **sband       /* O: output TOA reflectance and brightness temp
-                              values (scaled) */
+                              values (scaled) of the lines, nlines x nsamps,
+                              NULL for the bands to skip */
 )
 {
     char errmsg[STR_SIZE];                   /* error message */
@@ -60,8 +67,8 @@ int compute_toa_refl
     float k1b11;         /* K1 temperature constant for band 11 */
     float k2b10;         /* K2 temperature constant for band 10 */
     float k2b11;         /* K2 temperature constant for band 11 */
-    uint16 *uband = NULL;  /* array for input image data for a single band,
-                              nlines x nsamps */
+    uint16 *uband = NULL;  /* array for input image data of the lines for a
+                              single band, nlines x nsamps */
 
     /* Allocate space for band data */
     uband = calloc (nlines*nsamps, sizeof (uint16));
@@ -76,10 +83,9 @@ int compute_toa_refl
        reflectance and at-sensor brightness temp */
     for (ib = DN_BAND1; ib <= DN_BAND11; ib++)
     {
-        /* Don't process the pan band */
-        if (ib == DN_BAND8)
+        /* Don't process the pan band or the bands that aren't needed */
+        if (ib == DN_BAND8 || sband[ib < DN_BAND8 ? ib : ib - 1] == NULL)
             continue;
-        printf ("%d ... ", ib+1);
 
         /* Read the current band and calibrate bands 1-9 (except pan) to
            obtain TOA reflectance. Bands are corrected for the sun angle at
@@ -97,7 +103,7 @@ int compute_toa_refl
                 sband_ib = ib - 1;
             }
 
-            if (get_input_refl_lines (input, iband, 0, nlines, uband) !=
+            if (get_input_refl_lines (input, iband, line0, nlines, uband) !=
                 SUCCESS)
             {
                 sprintf (errmsg, "Reading band %d", ib+1);
@@ -140,7 +146,7 @@ int compute_toa_refl
            for OLI-only scenes. */
         else if (ib == DN_BAND10 && strcmp (instrument, "OLI"))
         {
-            if (get_input_th_lines (input, 0, 0, nlines, uband) != SUCCESS)
+            if (get_input_th_lines (input, 0, line0, nlines, uband) != SUCCESS)
             {
                 sprintf (errmsg, "Reading band %d", ib+1);
                 error_handler (true, FUNC_NAME, errmsg);
@@ -166,78 +172,1106 @@ int compute_toa_refl
                     /* Compute the TOA spectral radiance */
                     tmpf = xcals * uband[i] + xcalo;
 
-                    /* Compute the at-satellite brightness temp (K) and
-                       scale for output */
-                    tmpf = k2b10 / log (k1b10 / tmpf + 1.0);
-                    tmpf = tmpf * MULT_FACTOR_TH;  /* scale the value */
+                    /* Compute the at-satellite brightness temp (K) and
+                       scale for output */
+                    tmpf = k2b10 / log (k1b10 / tmpf + 1.0);
+                    tmpf = tmpf * MULT_FACTOR_TH;  /* scale the value */
+
+                    /* Make sure the brightness temp falls within the specified
+                       range */
+                    if (tmpf < MIN_VALID_TH)
+                        sband[SR_BAND10][i] = MIN_VALID_TH;
+                    else if (tmpf > MAX_VALID_TH)
+                        sband[SR_BAND10][i] = MAX_VALID_TH;
+                    else
+                        sband[SR_BAND10][i] = (int) (round (tmpf));
+                }
+                else
+                    sband[SR_BAND10][i] = FILL_VALUE;
+            }
+        }  /* end if band 10 */
+
+        else if (ib == DN_BAND11 && strcmp (instrument, "OLI"))
+        {
+            if (get_input_th_lines (input, 1, line0, nlines, uband) != SUCCESS)
+            {
+                sprintf (errmsg, "Reading band %d", ib+1);
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+
+            /* Get brightness temp coefficients for this band from XML file */
+            xcals = input->meta.gain_th[1];
+            xcalo = input->meta.bias_th[1];
+            k1b11 = input->meta.k1_const[1];
+            k2b11 = input->meta.k2_const[1];
+
+            /* Compute brightness temp for band 11.  Make sure it falls
+               within the min/max range for the thermal bands. */
+#ifdef _OPENMP
+            #pragma omp parallel for private (i, tmpf)
+#endif
+            for (i = 0; i < nlines*nsamps; i++)
+            {
+                /* If this pixel is not fill */
+                if (qaband[i] != 1)
+                {
+                    /* Compute the TOA spectral radiance */
+                    tmpf = xcals * uband[i] + xcalo;
+
+                    /* Compute the at-satellite brightness temp (K) and
+                       scale for output */
+                    tmpf = k2b11 / log (k1b11 / tmpf + 1.0);
+                    tmpf = tmpf * MULT_FACTOR_TH;  /* scale the value */
+
+                    /* Make sure the brightness temp falls within the specified
+                       range */
+                    if (tmpf < MIN_VALID_TH)
+                        sband[SR_BAND11][i] = MIN_VALID_TH;
+                    else if (tmpf > MAX_VALID_TH)
+                        sband[SR_BAND11][i] = MAX_VALID_TH;
+                    else
+                        sband[SR_BAND11][i] = (int) (round (tmpf));
+                }
+                else
+                    sband[SR_BAND11][i] = FILL_VALUE;
+            }
+        }  /* end if band 11 */
+    }  /* end for ib */
+
+    /* The input data has been read and calibrated. The memory can be freed. */
+    free (uband);
+
+    /* Successful completion */
+    return (SUCCESS);
+}
+
+
+/* The aerosol interpolation runs on a grid of AOT_TILE x AOT_TILE pixel
+   tiles; the window half-widths are multiples of it */
+#define AOT_TILE 5
+
+/* Aerosol grid of a scene.  The clear pixels with a positive residual are
+   summed per tile as their cloud mask is completed, and the interpolation
+   assigns an aerosol value to the tiles from the windows around them, for
+   the pixels whose inversion failed. */
+typedef struct
+{
+    int nlines;         /* number of tile lines */
+    int nsamps;         /* number of tile samples */
+    uint8 *nclear;      /* clear pixels with a positive residual */
+    uint8 *nfill;       /* clear pixels to be filled by the interpolation */
+    float *saot;        /* sum of the aerosol / residual of the clear
+                           pixels */
+    float *sresi;       /* sum of the 1 / residual of the clear pixels */
+    bool *filled;       /* has the tile been given an aerosol value? */
+    float *aot;         /* aerosol value of the pixels to be filled */
+} Aot_grid_t;
+
+/* Bytes of a tile of the aerosol grid */
+#define AOT_TILE_BYTES (2 * sizeof (uint8) + 3 * sizeof (float) + \
+    sizeof (bool))
+
+
+/******************************************************************************
+MODULE:  allocate_aot_grid
+
+PURPOSE:  Allocates the aerosol grid of a scene, with empty tiles.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error allocating the grid
+SUCCESS         No errors encountered
+
+NOTES:
+******************************************************************************/
+static int allocate_aot_grid
+(
+    int nlines,         /* I: number of lines in the scene */
+    int nsamps,         /* I: number of samples in the scene */
+    Aot_grid_t *grid    /* O: aerosol grid */
+)
+{
+    char errmsg[STR_SIZE];                   /* error message */
+    char FUNC_NAME[] = "allocate_aot_grid";  /* function name */
+    size_t ntiles;      /* number of tiles */
+
+    grid->nlines = (nlines + AOT_TILE - 1) / AOT_TILE;
+    grid->nsamps = (nsamps + AOT_TILE - 1) / AOT_TILE;
+    ntiles = (size_t) grid->nlines * grid->nsamps;
+    grid->nclear = calloc (ntiles, sizeof (uint8));
+    grid->nfill = calloc (ntiles, sizeof (uint8));
+    grid->saot = calloc (ntiles, sizeof (float));
+    grid->sresi = calloc (ntiles, sizeof (float));
+    grid->filled = calloc (ntiles, sizeof (bool));
+    grid->aot = calloc (ntiles, sizeof (float));
+    if (grid->nclear == NULL || grid->nfill == NULL || grid->saot == NULL ||
+        grid->sresi == NULL || grid->filled == NULL || grid->aot == NULL)
+    {
+        sprintf (errmsg, "Error allocating memory for the aerosol grid");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  free_aot_grid
+
+PURPOSE:  Frees the aerosol grid of a scene.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+static void free_aot_grid
+(
+    Aot_grid_t *grid    /* I/O: aerosol grid */
+)
+{
+    free (grid->nclear);  grid->nclear = NULL;
+    free (grid->nfill);   grid->nfill = NULL;
+    free (grid->saot);    grid->saot = NULL;
+    free (grid->sresi);   grid->sresi = NULL;
+    free (grid->filled);  grid->filled = NULL;
+    free (grid->aot);     grid->aot = NULL;
+}
+
+
+/******************************************************************************
+MODULE:  add_aot_line
+
+PURPOSE:  Adds a line of pixels, whose cloud mask is complete, to the tiles
+of the aerosol grid.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. The clear pixels with a positive residual are the ones the aerosol
+     interpolation averages.  The clear pixels whose inversion failed
+     (negative residual) are counted as well: once filled they are averaged
+     by the next passes of the interpolation.
+******************************************************************************/
+static void add_aot_line
+(
+    Aot_grid_t *grid,   /* I/O: aerosol grid */
+    int line,           /* I: line of the pixels */
+    int nsamps,         /* I: number of samples in the scene */
+    uint8 *cloud,       /* I: cloud bits of the line */
+    float *tresi,       /* I: residuals of the line */
+    float *taero        /* I: aerosols of the line */
+)
+{
+    int j;              /* looping variable for the samples */
+    int tile;           /* tile of the current pixel */
+
+    for (j = 0; j < nsamps; j++)
+    {
+        if (cloud[j] != 0)
+            continue;
+
+        tile = (line / AOT_TILE) * grid->nsamps + j / AOT_TILE;
+        if (tresi[j] > 0)
+        {
+            grid->nclear[tile]++;
+            grid->saot[tile] += taero[j] / tresi[j];
+            grid->sresi[tile] += 1.0 / tresi[j];
+        }
+        else if (tresi[j] < 0)
+            grid->nfill[tile]++;
+    }
+}
+
+
+/******************************************************************************
+MODULE:  interpolate_aot_grid
+
+PURPOSE:  Assigns an aerosol value to the tiles of the aerosol grid, for the
+pixels whose inversion failed, from the clear pixels of the windows around
+them.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. The windows of a pass are step x step pixels, centered on multiples of
+     step, so they are blocks of tiles.  The tiles of a window are given the
+     average aerosol of its clear pixels weighted by 1 / residual, unless an
+     earlier pass gave them one.  Their clear pixels to be filled then count
+     as clear pixels of aerosol value with a residual of 1.0.
+  2. The step doubles from 10 pixels until no window is without clear
+     pixels, or the step reaches 1000 pixels.
+  3. The windows of a pass don't overlap, so they don't depend on the order
+     they are visited in.
+******************************************************************************/
+static void interpolate_aot_grid
+(
+    Aot_grid_t *grid,   /* I/O: aerosol grid */
+    int nlines,         /* I: number of lines in the scene */
+    int nsamps          /* I: number of samples in the scene */
+)
+{
+    int i, j;           /* center line and sample of the window */
+    int k, l;           /* looping variables for the tiles of a window */
+    int k0, k1, l0, l1; /* tiles of the window, clipped to the grid */
+    int half;           /* half-width of a window (tiles) */
+    int tile;           /* current tile */
+    int nbaot;          /* number of clear pixels of the window */
+    double aaot;        /* average of AOT */
+    double sresi;       /* sum of 1 / residuals */
+    int step;           /* step value for aerosol interpolation */
+    bool hole;          /* is this a hole in the aerosol retrieval area? */
+
+    hole = true;
+    step = 10;
+    while (hole && (step < 1000))
+    {
+        hole = false;
+        half = step / 2 / AOT_TILE;
+        for (i = 0; i < nlines; i += step)
+        {
+            k0 = (i / AOT_TILE - half < 0) ? 0 : i / AOT_TILE - half;
+            k1 = (i / AOT_TILE + half > grid->nlines) ?
+                grid->nlines : i / AOT_TILE + half;
+            for (j = 0; j < nsamps; j += step)
+            {
+                l0 = (j / AOT_TILE - half < 0) ? 0 : j / AOT_TILE - half;
+                l1 = (j / AOT_TILE + half > grid->nsamps) ?
+                    grid->nsamps : j / AOT_TILE + half;
+
+                nbaot = 0;
+                aaot = 0.0;
+                sresi = 0.0;
+                for (k = k0; k < k1; k++)
+                {
+                    tile = k * grid->nsamps + l0;
+                    for (l = l0; l < l1; l++, tile++)
+                    {
+                        nbaot += grid->nclear[tile];
+                        aaot += grid->saot[tile];
+                        sresi += grid->sresi[tile];
+                    }
+                }
+
+                /* If no pixels were found, this is a hole */
+                if (nbaot == 0)
+                {
+                    hole = true;
+                    continue;
+                }
+                aaot /= sresi;
+
+                for (k = k0; k < k1; k++)
+                {
+                    tile = k * grid->nsamps + l0;
+                    for (l = l0; l < l1; l++, tile++)
+                    {
+                        if (grid->filled[tile])
+                            continue;
+                        grid->filled[tile] = true;
+                        grid->aot[tile] = aaot;
+                        grid->nclear[tile] += grid->nfill[tile];
+                        grid->saot[tile] += grid->nfill[tile] * aaot;
+                        grid->sresi[tile] += grid->nfill[tile];
+                        grid->nfill[tile] = 0;
+                    }
+                }
+            }  /* end for j */
+        }  /* end for i */
+
+        /* Modify the step value */
+        step *= 2;
+    }  /* end while */
+}
+
+
+/* The land/water window looks LW_HALO lines above and below the current
+   line */
+#define LW_HALO 8
+
+/******************************************************************************
+MODULE:  stripe_lines
+
+PURPOSE:  Determines the number of lines of the stripes a stage processes the
+scene in, from the memory budget of the application.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+>0              Number of lines of a stripe
+
+NOTES:
+  1. Without a budget the stripes are PROC_NLINES lines.
+  2. The stage needs fixed bytes whatever the size of its stripes: the
+     look-up tables, the CMG window, the aerosol grid and the lines read
+     around the stripes.  The rest of the budget is split into stripe lines.
+  3. If the budget can't hold a stripe of one line, a warning is printed and
+     the stripes are one line, as the stage can't do with less.
+******************************************************************************/
+int stripe_lines
+(
+    int nlines,         /* I: number of lines in the scene */
+    long budget,        /* I: memory budget of the application (bytes), 0
+                              for no budget */
+    size_t fixed,       /* I: bytes of the stage that don't depend on the
+                              stripe size */
+    size_t line_bytes,  /* I: bytes of a line of the stripes */
+    char *stage         /* I: name of the stage, for the warning */
+)
+{
+    char errmsg[STR_SIZE];                   /* error message */
+    char FUNC_NAME[] = "stripe_lines";       /* function name */
+    size_t nstripe;     /* number of lines of a stripe */
+
+    if (budget <= 0)
+        return (PROC_NLINES < nlines ? PROC_NLINES : nlines);
+
+    if ((size_t) budget < fixed + line_bytes)
+    {
+        sprintf (errmsg, "The memory budget of %ld MB is too small for the "
+            "%s, which needs %ld MB.  Processing stripes of one line.",
+            budget / 1048576L, stage,
+            (long) ((fixed + line_bytes + 1048575L) / 1048576L));
+        error_handler (false, FUNC_NAME, errmsg);
+        return (1);
+    }
+
+    nstripe = (budget - fixed) / line_bytes;
+    return (nstripe < (size_t) nlines ? (int) nstripe : nlines);
+}
+
+
+/******************************************************************************
+MODULE:  alloc_stripe
+
+PURPOSE:  Allocates a work array of a stripe of lines, set to zero.
+
+RETURN VALUE:
+Type = void *
+Value           Description
+-----           -----------
+NULL            Error allocating the array
+non-NULL        Allocated array
+
+NOTES:
+******************************************************************************/
+static void *alloc_stripe
+(
+    int nlines,         /* I: number of lines of the array */
+    int nsamps,         /* I: number of samples of the array */
+    size_t size,        /* I: bytes of a pixel */
+    char *name          /* I: name of the array, for the error message */
+)
+{
+    char errmsg[STR_SIZE];                   /* error message */
+    char FUNC_NAME[] = "alloc_stripe";       /* function name */
+    void *array = NULL; /* allocated array */
+
+    array = calloc ((size_t) nlines * nsamps, size);
+    if (array == NULL)
+    {
+        sprintf (errmsg, "Error allocating memory for %s", name);
+        error_handler (true, FUNC_NAME, errmsg);
+    }
+
+    return (array);
+}
+
+
+/******************************************************************************
+MODULE:  open_scratch
+
+PURPOSE:  Opens a scratch file for the per-pixel values kept between the
+passes over the scene.
+
+RETURN VALUE:
+Type = FILE *
+Value           Description
+-----           -----------
+NULL            Error creating the scratch file
+non-NULL        Scratch file, open for reading and writing
+
+NOTES:
+  1. The file is created in the current directory, next to the output
+     products, and unlinked right away, so it goes away when it is closed or
+     the application exits.
+******************************************************************************/
+static FILE *open_scratch (void)
+{
+    char errmsg[STR_SIZE];                   /* error message */
+    char FUNC_NAME[] = "open_scratch";       /* function name */
+    char name[] = "l8_sr_scratch_XXXXXX";    /* scratch file name */
+    int fd;             /* descriptor of the scratch file */
+    FILE *fp = NULL;    /* scratch file */
+
+    fd = mkstemp (name);
+    if (fd != -1)
+    {
+        unlink (name);
+        fp = fdopen (fd, "w+b");
+        if (fp == NULL)
+            close (fd);
+    }
+
+    if (fp == NULL)
+    {
+        sprintf (errmsg, "Creating a scratch file in the current directory");
+        error_handler (true, FUNC_NAME, errmsg);
+    }
+
+    return (fp);
+}
+
+
+/******************************************************************************
+MODULE:  scratch_lines
+
+PURPOSE:  Writes or reads lines of per-pixel values to or from a scratch
+file.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error writing or reading the lines
+SUCCESS         No errors encountered
+
+NOTES:
+  1. A scratch file holds one value per pixel of the scene, line after line.
+******************************************************************************/
+static int scratch_lines
+(
+    FILE *fp,           /* I: scratch file */
+    bool write_lines,   /* I: write the lines (true) or read them (false) */
+    int line0,          /* I: first line */
+    int nlines,         /* I: number of lines */
+    int nsamps,         /* I: number of samples of a line */
+    int nbytes,         /* I: number of bytes per pixel */
+    void *buf           /* I/O: lines to write, or lines read */
+)
+{
+    char errmsg[STR_SIZE];                   /* error message */
+    char FUNC_NAME[] = "scratch_lines";      /* function name */
+    long loc;           /* location of the first line in the file */
+    size_t npix;        /* number of pixels of the lines */
+    size_t ndone;       /* number of pixels written or read */
+
+    loc = (long) line0 * nsamps * nbytes;
+    npix = (size_t) nlines * nsamps;
+    if (fseek (fp, loc, SEEK_SET))
+    {
+        sprintf (errmsg, "Seeking to line %d in the scratch file", line0);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (write_lines)
+        ndone = fwrite (buf, nbytes, npix, fp);
+    else
+        ndone = fread (buf, nbytes, npix, fp);
+    if (ndone != npix)
+    {
+        sprintf (errmsg, "%s %d lines of the scratch file starting at line "
+            "%d", write_lines ? "Writing" : "Reading", nlines, line0);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  climatology_refl
+
+PURPOSE:  Corrects the TOA reflectance of a band to surface reflectance with
+the atmospheric parameters of the climatology.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+  1. The fill pixels are left as they are.
+******************************************************************************/
+static void climatology_refl
+(
+    int npix,           /* I: number of pixels */
+    uint16 *qaband,     /* I: QA band of the pixels */
+    float tgo,          /* I: other gaseous transmittance of the band */
+    float roatm,        /* I: atmospheric reflectance of the band */
+    float ttatmg,       /* I: total atmospheric transmission of the band */
+    float satm,         /* I: atmosphere spherical albedo of the band */
+    int16 *band         /* I/O: scaled TOA reflectance in, scaled surface
+                                reflectance out */
+)
+{
+    int i;              /* looping variable for the pixels */
+    float rotoa;        /* top of atmosphere reflectance */
+    float roslamb;      /* lambertian surface reflectance */
+
+#ifdef _OPENMP
+    #pragma omp parallel for private (i, rotoa, roslamb)
+#endif
+    for (i = 0; i < npix; i++)
+    {
+        /* If this pixel is not fill.  Otherwise fill pixels have already
+           been marked in the TOA calculations. */
+        if (qaband[i] != 1)
+        {
+            rotoa = band[i] * SCALE_FACTOR;
+            roslamb = rotoa / tgo;
+            roslamb = roslamb - roatm;
+            roslamb = roslamb / ttatmg;
+            roslamb = roslamb / (1.0 + satm * roslamb);
+            band[i] = (int) (roslamb * MULT_FACTOR);
+        }
+    }
+}
+
+
+/* The CMG window of a scene is found from points of the scene boundary
+   CMG_WIN_STEP pixels apart, and extended by CMG_WIN_MARGIN cells on each
+   side (plus the line+1/sample+1 cells of the interpolation) to cover the
+   cells the boundary may bulge into between the points. */
+#define CMG_WIN_STEP 100
+#define CMG_WIN_MARGIN 2
+
+/* Bands calibrated by the passes of compute_sr_refl: the reflectance,
+   cirrus and thermal bands for the aerosol inversion, the bands of the
+   cloud and cloud shadow tests for the cloud mask, and the reflectance
+   bands for the atmospheric correction */
+#define NINV_BANDS 9
+static const int inv_bands[NINV_BANDS] = {SR_BAND1, SR_BAND2, SR_BAND3,
+    SR_BAND4, SR_BAND5, SR_BAND6, SR_BAND7, SR_BAND9, SR_BAND10};
+#define NCLD_BANDS 5
+static const int cld_bands[NCLD_BANDS] = {SR_BAND2, SR_BAND3, SR_BAND4,
+    SR_BAND6, SR_BAND10};
+#define NCOR_BANDS 7
+static const int cor_bands[NCOR_BANDS] = {SR_BAND1, SR_BAND2, SR_BAND3,
+    SR_BAND4, SR_BAND5, SR_BAND6, SR_BAND7};
+
+/* Bytes per pixel of a stripe of nbands calibrated bands: the bands, the QA
+   band and the DN read by compute_toa_refl */
+#define TOA_PIX_BYTES(nbands) (2 * sizeof (uint16) + \
+    (nbands) * sizeof (int16))
+
+/* Bytes per pixel of the cloud window: the cloud bits, residual, aerosol,
+   band 6 and band 10 */
+#define RING_PIX_BYTES (sizeof (uint8) + 2 * sizeof (float) + \
+    2 * sizeof (int16))
+
+/******************************************************************************
+MODULE:  alloc_toa_stripe
+
+PURPOSE:  Allocates the QA band and the calibrated bands of a stripe of
+lines.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error allocating the arrays
+SUCCESS         No errors encountered
+
+NOTES:
+  1. The bands not listed are set to NULL, so compute_toa_refl skips them.
+******************************************************************************/
+static int alloc_toa_stripe
+(
+    int nlines,         /* I: number of lines of the stripe */
+    int nsamps,         /* I: number of samples of the stripe */
+    int nbands,         /* I: number of bands to allocate */
+    const int *bands,   /* I: bands to allocate (SR_BAND*) */
+    uint16 **qaband,    /* O: QA band of the stripe */
+    int16 **sband       /* O: bands of the stripe, NULL for the others */
+)
+{
+    int ib;             /* looping variable for the bands */
+
+    for (ib = 0; ib < NBAND_TTL_OUT-1; ib++)
+        sband[ib] = NULL;
+
+    *qaband = alloc_stripe (nlines, nsamps, sizeof (uint16), "the QA band");
+    if (*qaband == NULL)
+        return (ERROR);
+
+    for (ib = 0; ib < nbands; ib++)
+    {
+        sband[bands[ib]] = alloc_stripe (nlines, nsamps, sizeof (int16),
+            "the reflectance and thermal bands");
+        if (sband[bands[ib]] == NULL)
+            return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  free_toa_stripe
+
+PURPOSE:  Frees the QA band and the calibrated bands of a stripe of lines.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+static void free_toa_stripe
+(
+    uint16 **qaband,    /* I/O: QA band of the stripe */
+    int16 **sband       /* I/O: bands of the stripe */
+)
+{
+    int ib;             /* looping variable for the bands */
+
+    free (*qaband);
+    *qaband = NULL;
+    for (ib = 0; ib < NBAND_TTL_OUT-1; ib++)
+    {
+        free (sband[ib]);
+        sband[ib] = NULL;
+    }
+}
+
+
+/******************************************************************************
+MODULE:  read_toa_stripe
+
+PURPOSE:  Reads the QA band of a stripe of lines and computes the TOA
+reflectance and brightness temperature of its allocated bands.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error reading or calibrating the stripe
+SUCCESS         No errors encountered
+
+NOTES:
+******************************************************************************/
+static int read_toa_stripe
+(
+    Input_t *input,     /* I: input structure for the Landsat product */
+    char *instrument,   /* I: instrument to be processed (OLI, TIRS) */
+    int line0,          /* I: first line of the stripe */
+    int nlines,         /* I: number of lines of the stripe */
+    int nsamps,         /* I: number of samples of the stripe */
+    float xmus,         /* I: cosine of solar zenith angle */
+    uint16 *qaband,     /* O: QA band of the stripe */
+    int16 **sband       /* O: TOA reflectance and brightness temp of the
+                              stripe, for the bands that aren't NULL */
+)
+{
+    char errmsg[STR_SIZE];                   /* error message */
+    char FUNC_NAME[] = "read_toa_stripe";    /* function name */
+
+    if (get_input_qa_lines (input, 0, line0, nlines, qaband) != SUCCESS)
+    {
+        sprintf (errmsg, "Reading QA band");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    if (compute_toa_refl (input, qaband, line0, nlines, nsamps, xmus,
+        instrument, sband) != SUCCESS)
+    {
+        sprintf (errmsg, "Computing TOA reflectance and at-sensor "
+            "brightness temperatures.");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  cmg_window_offset
+
+PURPOSE:  Converts a CMG line (sample) to a line (sample) of the CMG window,
+wrapping around the pole (dateline) like the window does.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+-1              The CMG line (sample) isn't in the window
+>=0             Line (sample) of the window
+
+NOTES:
+******************************************************************************/
+static inline int cmg_window_offset
+(
+    int cmg,            /* I: CMG line (sample) */
+    int first,          /* I: first CMG line (sample) of the window */
+    int count,          /* I: number of lines (samples) of the window */
+    int size            /* I: number of lines (samples) of the CMG grid */
+)
+{
+    int offset = cmg - first;   /* offset in the window */
+
+    if (offset < 0)
+        offset += size;
+    return (offset < count ? offset : -1);
+}
+
+
+/******************************************************************************
+MODULE:  cmg_scene_window
+
+PURPOSE:  Determines the window of the CMG grids covering the scene, so only
+that window of the global CMG grids needs to be read.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error mapping the scene boundary to the CMG
+SUCCESS         No errors encountered
+
+NOTES:
+  1. The samples of the window are the shortest run of samples, around the
+     dateline if needed, holding the samples of the boundary points.  If
+     that run is more than half the grid, the scene surrounds a pole: the
+     window spans all the samples and the lines up to that pole.
+  2. The lines and samples are computed as in interpolate_aux, which checks
+     that the CMG cells it reads are in the window.
+******************************************************************************/
+static int cmg_scene_window
+(
+    Geoloc_t *space,    /* I: structure for geolocation information */
+    int nlines,         /* I: number of lines in reflectance, thermal bands */
+    int nsamps,         /* I: number of samps in reflectance, thermal bands */
+    Cmg_window_t *cmg_win   /* O: window of the CMG grids */
+)
+{
+    char errmsg[STR_SIZE];                   /* error message */
+    char FUNC_NAME[] = "cmg_scene_window";   /* function name */
+    Img_coord_float_t img;   /* coordinate in line/sample space */
+    Geo_coord_t geo;         /* coordinate in lat/long space */
+    bool *cmg_samp = NULL;   /* is the CMG sample crossed by the boundary? */
+    int nlstep, nsstep;      /* number of boundary steps along the lines and
+                                samples */
+    int npts;                /* number of boundary points */
+    int k;                   /* looping variable for the boundary points */
+    int lcmg, scmg;          /* line/sample index for the CMG */
+    int lmin, lmax;          /* range of the CMG lines */
+    int gap, max_gap;        /* current and longest run of CMG samples not
+                                crossed */
+    int gap_end;             /* sample ending the longest run */
+
+    cmg_samp = calloc (CMG_NBLON, sizeof (bool));
+    if (cmg_samp == NULL)
+    {
+        sprintf (errmsg, "Error allocating memory for the CMG samples");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Walk the boundary of the scene, going clockwise from the upper left
+       corner */
+    nlstep = (nlines + CMG_WIN_STEP - 1) / CMG_WIN_STEP;
+    nsstep = (nsamps + CMG_WIN_STEP - 1) / CMG_WIN_STEP;
+    npts = 2 * (nlstep + nsstep);
+    lmin = CMG_NBLAT;
+    lmax = -1;
+    img.is_fill = false;
+    for (k = 0; k < npts; k++)
+    {
+        if (k < nsstep)
+        {   /* top */
+            img.l = -0.5;
+            img.s = (float) nsamps * k / nsstep;
+        }
+        else if (k < nsstep + nlstep)
+        {   /* right */
+            img.l = (float) nlines * (k - nsstep) / nlstep - 0.5;
+            img.s = nsamps;
+        }
+        else if (k < 2 * nsstep + nlstep)
+        {   /* bottom */
+            img.l = nlines - 0.5;
+            img.s = nsamps - (float) nsamps * (k - nsstep - nlstep) / nsstep;
+        }
+        else
+        {   /* left */
+            img.l = nlines - (float) nlines * (k - 2 * nsstep - nlstep) /
+                nlstep - 0.5;
+            img.s = 0.0;
+        }
+
+        if (!from_space (space, &img, &geo))
+        {
+            sprintf (errmsg, "Mapping line/sample (%f, %f) to geolocation "
+                "coords", img.l, img.s);
+            error_handler (true, FUNC_NAME, errmsg);
+            free (cmg_samp);
+            return (ERROR);
+        }
+
+        lcmg = (int) ((89.975 - geo.lat * RAD2DEG) * 20.0);   /* vs / 0.05 */
+        scmg = (int) ((179.975 + geo.lon * RAD2DEG) * 20.0);  /* vs / 0.05 */
+        if (lcmg < 0)
+            lcmg = 0;
+        else if (lcmg >= CMG_NBLAT)
+            lcmg = CMG_NBLAT - 1;
+        if (scmg < 0)
+            scmg = 0;
+        else if (scmg >= CMG_NBLON)
+            scmg = CMG_NBLON - 1;
+
+        if (lcmg < lmin)
+            lmin = lcmg;
+        if (lcmg > lmax)
+            lmax = lcmg;
+        cmg_samp[scmg] = true;
+    }
+
+    /* Find the longest run of samples not crossed by the boundary, going
+       around the dateline, starting after a crossed sample */
+    for (scmg = 0; !cmg_samp[scmg]; scmg++)
+        ;
+    max_gap = 0;
+    gap_end = scmg;
+    gap = 0;
+    for (k = 1; k <= CMG_NBLON; k++)
+    {
+        if (!cmg_samp[(scmg + k) % CMG_NBLON])
+            gap++;
+        else
+        {
+            if (gap > max_gap)
+            {
+                max_gap = gap;
+                gap_end = (scmg + k) % CMG_NBLON;
+            }
+            gap = 0;
+        }
+    }
+    free (cmg_samp);
+
+    /* The window is the rest of the samples, plus the margins */
+    cmg_win->samp0 = gap_end - CMG_WIN_MARGIN;
+    cmg_win->nsamps = CMG_NBLON - max_gap + 2 * CMG_WIN_MARGIN + 1;
+    if (CMG_NBLON - max_gap > CMG_NBLON / 2)
+    {   /* the scene surrounds a pole */
+        cmg_win->nsamps = CMG_NBLON;
+        if (lmin + lmax < CMG_NBLAT)
+            lmin = 0;
+        else
+            lmax = CMG_NBLAT - 1;
+    }
+    if (cmg_win->nsamps >= CMG_NBLON)
+    {
+        cmg_win->samp0 = 0;
+        cmg_win->nsamps = CMG_NBLON;
+    }
+    else if (cmg_win->samp0 < 0)
+        cmg_win->samp0 += CMG_NBLON;
+
+    cmg_win->line0 = lmin - CMG_WIN_MARGIN;
+    cmg_win->nlines = lmax - lmin + 2 * CMG_WIN_MARGIN + 2;
+    if (cmg_win->nlines >= CMG_NBLAT)
+    {
+        cmg_win->line0 = 0;
+        cmg_win->nlines = CMG_NBLAT;
+    }
+    else if (cmg_win->line0 < 0)
+        cmg_win->line0 += CMG_NBLAT;
+
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  interpolate_aux
+
+PURPOSE:  Interpolates the water vapor, ozone and surface pressure at the
+center of a pixel from the CMG tables, and returns the cell of the CMG
+window of the pixel for the other CMG-based tables.
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           Error mapping the pixel to the CMG
+SUCCESS         No errors encountered
+
+NOTES:
+  1. The CMG data wraps around the dateline and the poles for the
+     interpolation.
+  2. The CMG tables hold the CMG window of the scene.  The CMG cells are
+     converted to cells of the window, which must hold them.
+******************************************************************************/
+static int interpolate_aux
+(
+    Geoloc_t *space,    /* I: structure for geolocation information */
+    Cmg_window_t *cmg_win,  /* I: window of the CMG tables */
+    uint16 **wv,        /* I: water vapor values [CMG window] */
+    uint8 **oz,         /* I: ozone values [CMG window] */
+    int16 **dem,        /* I: CMG DEM data array [CMG window] */
+    int line,           /* I: line of the pixel (0-based) */
+    int samp,           /* I: sample of the pixel (0-based) */
+    int *lcmg,          /* O: line of the cell in the CMG window */
+    int *scmg,          /* O: sample of the cell in the CMG window */
+    float *twv,         /* O: interpolated water vapor */
+    float *toz,         /* O: interpolated ozone */
+    float *tpres        /* O: interpolated surface pressure */
+)
+{
+    char errmsg[STR_SIZE];                   /* error message */
+    char FUNC_NAME[] = "interpolate_aux";    /* function name */
+    Img_coord_float_t img;        /* coordinate in line/sample space */
+    Geo_coord_t geo;              /* coordinate in lat/long space */
+    float lat, lon;       /* pixel lat, long location */
+    int lcmg1, scmg1;     /* line+1/sample+1 index for the CMG */
+    float u, v;           /* line/sample index for the CMG */
+    float xcmg, ycmg;     /* x/y location for CMG */
+    int uoz11, uoz21, uoz12, uoz22;  /* ozone at line,samp; line, samp+1;
+                           line+1, samp; and line+1, samp+1 */
+    float pres11, pres12, pres21, pres22;  /* pressure at line,samp;
+                           line, samp+1; line+1, samp; and line+1, samp+1 */
+
+    /* Get the lat/long for the current pixel, for the center of the
+       pixel */
+    img.l = line - 0.5;
+    img.s = samp + 0.5;
+    img.is_fill = false;
+    if (!from_space (space, &img, &geo))
+    {
+        sprintf (errmsg, "Mapping line/sample (%d, %d) to geolocation "
+            "coords", line, samp);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    lat = geo.lat * RAD2DEG;
+    lon = geo.lon * RAD2DEG;
+
+    /* Use that lat/long to determine the line/sample in the CMG-related
+       lookup tables, using the center of the UL pixel. Note, we are
+       basically making sure the line/sample combination falls within -90,
+       90 and -180, 180 global climate data boundaries.  However, the source
+       code below uses lcmg+1 and scmg+1, which for some scenes may wrap
+       around the dateline or the poles.  Thus we need to wrap the CMG data
+       around to the beginning of the array. */
+    /* Each CMG pixel is 0.05 x 0.05 degrees.  Use the center of the pixel
+       for each calculation. */
+    ycmg = (89.975 - lat) * 20.0;   /* vs / 0.05 */
+    xcmg = (179.975 + lon) * 20.0;  /* vs / 0.05 */
+    *lcmg = (int) (ycmg);
+    *scmg = (int) (xcmg);
+    if ((*lcmg < 0 || *lcmg >= CMG_NBLAT) ||
+        (*scmg < 0 || *scmg >= CMG_NBLON))
+    {
+        sprintf (errmsg, "Invalid line/sample combination for the "
+            "CMG-related lookup tables - line %d, sample %d (0-based). "
+            "CMG-based tables are %d lines x %d samples.", *lcmg, *scmg,
+            CMG_NBLAT, CMG_NBLON);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
 
-                    /* Make sure the brightness temp falls within the specified
-                       range */
-                    if (tmpf < MIN_VALID_TH)
-                        sband[SR_BAND10][i] = MIN_VALID_TH;
-                    else if (tmpf > MAX_VALID_TH)
-                        sband[SR_BAND10][i] = MAX_VALID_TH;
-                    else
-                        sband[SR_BAND10][i] = (int) (round (tmpf));
-                }
-                else
-                    sband[SR_BAND10][i] = FILL_VALUE;
-            }
-        }  /* end if band 10 */
+    /* If the current CMG pixel is at the edge of the CMG array, then allow
+       the next pixel for interpolation to wrap around the array */
+    if (*scmg >= CMG_NBLON-1)  /* 180 degrees so wrap around */
+        scmg1 = 0;
+    else
+        scmg1 = *scmg + 1;
 
-        else if (ib == DN_BAND11 && strcmp (instrument, "OLI"))
-        {
-            if (get_input_th_lines (input, 1, 0, nlines, uband) != SUCCESS)
-            {
-                sprintf (errmsg, "Reading band %d", ib+1);
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
+    if (*lcmg >= CMG_NBLAT-1)  /* -90 degrees so wrap around */
+        lcmg1 = 0;
+    else
+        lcmg1 = *lcmg + 1;
+
+    /* Determine the fractional difference between the integer location and
+       floating point pixel location */
+    u = (ycmg - *lcmg);
+    v = (xcmg - *scmg);
+
+    /* Convert the cells to cells of the CMG window */
+    *lcmg = cmg_window_offset (*lcmg, cmg_win->line0, cmg_win->nlines,
+        CMG_NBLAT);
+    lcmg1 = cmg_window_offset (lcmg1, cmg_win->line0, cmg_win->nlines,
+        CMG_NBLAT);
+    *scmg = cmg_window_offset (*scmg, cmg_win->samp0, cmg_win->nsamps,
+        CMG_NBLON);
+    scmg1 = cmg_window_offset (scmg1, cmg_win->samp0, cmg_win->nsamps,
+        CMG_NBLON);
+    if (*lcmg < 0 || lcmg1 < 0 || *scmg < 0 || scmg1 < 0)
+    {
+        sprintf (errmsg, "CMG cells of line/sample (%d, %d) are outside the "
+            "CMG window of the scene", line, samp);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
 
-            /* Get brightness temp coefficients for this band from XML file */
-            xcals = input->meta.gain_th[1];
-            xcalo = input->meta.bias_th[1];
-            k1b11 = input->meta.k1_const[1];
-            k2b11 = input->meta.k2_const[1];
+    /* Interpolate water vapor.  If the water vapor value is fill (=0), then
+       use it as-is. */
+    *twv = wv[*lcmg][*scmg] * (1.0 - u) * (1.0 - v) +
+           wv[*lcmg][scmg1] * (1.0 - u) * v +
+           wv[lcmg1][*scmg] * u * (1.0 - v) +
+           wv[lcmg1][scmg1] * u * v;
+    *twv = *twv * 0.01;   /* vs / 100 */
+
+    /* Interpolate ozone.  If the ozone value is fill (=0), then use a
+       default value of 120. */
+    uoz11 = oz[*lcmg][*scmg];
+    if (uoz11 == 0)
+        uoz11 = 120;
+
+    uoz12 = oz[*lcmg][scmg1];
+    if (uoz12 == 0)
+        uoz12 = 120;
+
+    uoz21 = oz[lcmg1][*scmg];
+    if (uoz21 == 0)
+        uoz21 = 120;
+
+    uoz22 = oz[lcmg1][scmg1];
+    if (uoz22 == 0)
+        uoz22 = 120;
+
+    *toz = uoz11 * (1.0 - u) * (1.0 - v) +
+           uoz12 * (1.0 - u) * v +
+           uoz21 * u * (1.0 - v) +
+           uoz22 * u * v;
+    *toz = *toz * 0.0025;   /* vs / 400 */
+
+    /* Get the surface pressure from the global DEM.  Set to 1013.0 (sea
+       level) if the DEM is fill (= -9999), which is likely ocean. */
+    if (dem[*lcmg][*scmg] != -9999)
+        pres11 = 1013.0 * exp (-dem[*lcmg][*scmg] * ONE_DIV_8500);
+    else
+        pres11 = 1013.0;
 
-            /* Compute brightness temp for band 11.  Make sure it falls
-               within the min/max range for the thermal bands. */
-#ifdef _OPENMP
-            #pragma omp parallel for private (i, tmpf)
-#endif
-            for (i = 0; i < nlines*nsamps; i++)
-            {
-                /* If this pixel is not fill */
-                if (qaband[i] != 1)
-                {
-                    /* Compute the TOA spectral radiance */
-                    tmpf = xcals * uband[i] + xcalo;
+    if (dem[*lcmg][scmg1] != -9999)
+        pres12 = 1013.0 * exp (-dem[*lcmg][scmg1] * ONE_DIV_8500);
+    else
+        pres12 = 1013.0;
 
-                    /* Compute the at-satellite brightness temp (K) and
-                       scale for output */
-                    tmpf = k2b11 / log (k1b11 / tmpf + 1.0);
-                    tmpf = tmpf * MULT_FACTOR_TH;  /* scale the value */
+    if (dem[lcmg1][*scmg] != -9999)
+        pres21 = 1013.0 * exp (-dem[lcmg1][*scmg] * ONE_DIV_8500);
+    else
+        pres21 = 1013.0;
 
-                    /* Make sure the brightness temp falls within the specified
-                       range */
-                    if (tmpf < MIN_VALID_TH)
-                        sband[SR_BAND11][i] = MIN_VALID_TH;
-                    else if (tmpf > MAX_VALID_TH)
-                        sband[SR_BAND11][i] = MAX_VALID_TH;
-                    else
-                        sband[SR_BAND11][i] = (int) (round (tmpf));
-                }
-                else
-                    sband[SR_BAND11][i] = FILL_VALUE;
-            }
-        }  /* end if band 11 */
-    }  /* end for ib */
-    printf ("\n");
+    if (dem[lcmg1][scmg1] != -9999)
+        pres22 = 1013.0 * exp (-dem[lcmg1][scmg1] * ONE_DIV_8500);
+    else
+        pres22 = 1013.0;
 
-    /* The input data has been read and calibrated. The memory can be freed. */
-    free (uband);
+    *tpres = pres11 * (1.0 - u) * (1.0 - v) +
+             pres12 * (1.0 - u) * v +
+             pres21 * u * (1.0 - v) +
+             pres22 * u * v;
 
-    /* Successful completion */
     return (SUCCESS);
 }
 
@@ -286,10 +1320,31 @@ NOTES:
 1. Initializes the variables and data arrays from the lookup table and
    auxiliary files.
 2. The tauray array was originally read in from a static ASCII file, but it is
-   now hardcoded to save time from reading the file each time.  This file was
-   generated (like many of the other auxiliary input tables) by running 6S and
-   storing the coefficients.
+   now hardcoded (in readluts) to save time from reading the file each time.
+   This file was generated (like many of the other auxiliary input tables) by
+   running 6S and storing the coefficients.
 3. Aerosol retrieval is not done for pixels over water or cloudy/cirrus pixels.
+4. The scene is processed in three passes over stripes of lines, sized so
+   the application fits the memory budget (see stripe_lines): the aerosol
+   inversion, the cloud mask and cloud shadows, and the atmospheric
+   correction.  The bands are calibrated again from the DN for each pass,
+   and the cloud, residual and aerosol values of the pixels are kept
+   between the passes in scratch files.  Only the scene-wide statistics
+   and the aerosol grid are kept for the whole scene.
+5. The cloud shadows are cast over a window of lines, sized from the
+   coldest cloud and the sun angles, which slides down the scene with the
+   cloud mask pass.  A line is done once all the clouds that may cast a
+   shadow on it have been seen.
+6. The aerosol interpolation works on a grid of AOT_TILE x AOT_TILE tiles
+   (see interpolate_aot_grid), so its windows are blocks of tiles.
+7. Only the window of the global CMG grids (DEM, ratio maps, ozone and water
+   vapor) covering the scene is read, and the CMG cells are indexed relative
+   to that window (see cmg_scene_window).
+8. The sun and view angles are constant over the scene, so by default the
+   atmospheric correction interpolates a look-up table of the scene in
+   pressure and AOT (see init_scene_lut).  full_lut keeps the full
+   interpolation of the LUTs as the reference, and compare_lut reports how
+   far the scene table is from it.
 ******************************************************************************/
 int compute_sr_refl
 (
@@ -297,11 +1352,9 @@ int compute_sr_refl
     Espa_internal_meta_t *xml_metadata,
                         /* I: XML metadata structure */
     char *xml_infile,   /* I: input XML filename */
-    uint16 *qaband,     /* I: QA band for the input image, nlines x nsamps */
     int nlines,         /* I: number of lines in reflectance, thermal bands */
     int nsamps,         /* I: number of samps in reflectance, thermal bands */
     float pixsize,      /* I: pixel size for the reflectance bands */
-    int16 **sband,      /* I/O: input TOA and output surface reflectance */
     float xts,          /* I: solar zenith angle (deg) */
     float xfs,          /* I: solar azimuth angle (deg) */
     float xmus,         /* I: cosine of solar zenith angle */
@@ -309,9 +1362,17 @@ int compute_sr_refl
     char *intrefnm,     /* I: intrinsic reflectance filename */
     char *transmnm,     /* I: transmission filename */
     char *spheranm,     /* I: spherical albedo filename */
+    char *lutcache,     /* I: binary look-up table filename, NULL to read
+                              the look-up table files */
     char *cmgdemnm,     /* I: climate modeling grid DEM filename */
     char *rationm,      /* I: ratio averages filename */
-    char *auxnm         /* I: auxiliary filename for ozone and water vapor */
+    char *auxnm,        /* I: auxiliary filename for ozone and water vapor */
+    int stripe_memory,  /* I: memory budget of the processing (MB), 0 for
+                              no budget */
+    bool full_lut,      /* I: interpolate the LUTs for each pixel instead of
+                              the look-up table of the scene */
+    bool compare_lut    /* I: report the deviation of the look-up table of
+                              the scene from the full interpolation */
 )
 {
     char errmsg[STR_SIZE];                   /* error message */
@@ -346,6 +1407,7 @@ int compute_sr_refl
                            aerosol) */
     long nbclear;       /* count of the clear (non-cloud) pixels */
     long nbval;         /* count of the non-fill pixels */
+    long ncloud;        /* count of the pixels that may be cloud */
     double anom;        /* band 3 and 5 combination */
     double mall;        /* average/mean temp of all the pixels */
     double mclear;      /* average/mean temp of the clear pixels */
@@ -356,58 +1418,86 @@ int compute_sr_refl
     int icldh;          /* looping variable for cloud height */
     int mband5, mband5k, mband5l;    /* band 6 value and k,l locations */
     float tcloud;       /* temperature of the current pixel */
+    float tcloud_min;   /* temperature of the coldest pixel that may be
+                           cloud */
 
     float cfac = 6.0;     /* cloud factor */
-    double aaot;          /* average of AOT */
-    double sresi;         /* sum of 1 / residuals */
+    dilate_t dil_adj;     /* cloud dilation for the adjacent cloud bit */
+    dilate_t dil_shd;     /* cloud shadow dilation for the expansion */
+    const uint8 *dmask;   /* dilated line, 1 where covered */
     float fndvi;          /* NDVI value */
-    int nbaot;            /* number of AOT pixels (non-cloud/water) for
-                             aerosol interpolation */
-    int step;             /* step value for aerosol interpolation */
-    bool hole;            /* is this a hole in the aerosol retrieval area? */
+    Aot_grid_t aot_grid;  /* aerosol grid of the scene */
+    int tile;             /* tile of the current pixel in the aerosol grid */
     float ros4, ros5;     /* surface reflectance for band 4 and band 5 */
     int tmp_percent;      /* current percentage for printing status */
 #ifndef _OPENMP
     int curr_tmp_percent; /* percentage for current line */
 #endif
 
-    float lat, lon;       /* pixel lat, long location */
     int lcmg, scmg;       /* line/sample index for the CMG */
-    int lcmg1, scmg1;     /* line+1/sample+1 index for the CMG */
-    float u, v;           /* line/sample index for the CMG */
     float th1, th2;       /* values for NDWI calculations */
-    float xcmg, ycmg;     /* x/y location for CMG */
     float xndwi;          /* calculated NDWI value */
-    int uoz11, uoz21, uoz12, uoz22;  /* ozone at line,samp; line, samp+1;
-                           line+1, samp; and line+1, samp+1 */
-    float pres11, pres12, pres21, pres22;  /* pressure at line,samp;
-                           line, samp+1; line+1, samp; and line+1, samp+1 */
+    float twv, toz, tpix; /* interpolated water vapor, ozone and surface
+                             pressure of the current pixel */
+
+    long budget;          /* memory budget of the processing (bytes) */
+    size_t fixed;         /* memory of the look-up tables, the CMG window
+                             and the aerosol grid (bytes) */
+    int nstripe;          /* number of lines of a stripe */
+    int line0, line1;     /* first line and line past the end of the
+                             current stripe */
+    int npix;             /* number of pixels of the current stripe */
+    int lw_line0, lw_line1;  /* lines of the land/water mask read for the
+                             stripe, including its halo */
+    int lw_pix0;          /* first pixel of the land/water mask read */
+    int stripe_pix;       /* current pixel in the stripe arrays */
+    int shadow_nlines;    /* lines the cloud shadows may be cast across */
+    int shadow_ahead;     /* lines the cloud shadows may be cast ahead of
+                             their cloud, down the scene */
+    int nring;            /* number of lines of the cloud window */
+    int ring_pix;         /* current pixel in the cloud window */
+    int pass_line;        /* line at the head of the cloud mask pass */
+    int shd_line;         /* line being cast or expanded */
+    FILE *cloud_fp = NULL;   /* scratch file of the cloud bits */
+    FILE *tresi_fp = NULL;   /* scratch file of the residuals */
+    FILE *taero_fp = NULL;   /* scratch file of the aerosols */
+    uint16 *qaband = NULL;   /* QA band of a stripe, nstripe x nsamps */
+    int16 *sband[NBAND_TTL_OUT-1];  /* TOA and surface reflectance of a
+                             stripe for the bands used by the pass,
+                             nstripe x nsamps, NULL for the other bands */
     uint8 *cloud = NULL;  /* bit-packed value that represent clouds,
-                             nlines x nsamps */
+                             nstripe x nsamps */
     float *twvi = NULL;   /* interpolated water vapor value,
-                             nlines x nsamps */
-    float *tozi = NULL;   /* interpolated ozone value, nlines x nsamps */
-    float *tp = NULL;     /* interpolated pressure value, nlines x nsamps */
-    float *tresi = NULL;  /* residuals for each pixel, nlines x nsamps;
+                             nstripe x nsamps */
+    float *tozi = NULL;   /* interpolated ozone value, nstripe x nsamps */
+    float *tp = NULL;     /* interpolated pressure value, nstripe x nsamps */
+    float *tresi = NULL;  /* residuals for each pixel, nstripe x nsamps;
                              tresi < 0.0 flags water pixels and pixels with
                              high residuals */
-    float *taero = NULL;  /* aerosol values for each pixel, nlines x nsamps */
+    float *taero = NULL;  /* aerosol values for each pixel,
+                             nstripe x nsamps */
     int16 *aerob1 = NULL; /* atmospherically corrected band 1 data
-                             (TOA refl), nlines x nsamps */
+                             (TOA refl), nstripe x nsamps */
     int16 *aerob2 = NULL; /* atmospherically corrected band 2 data
-                             (TOA refl), nlines x nsamps */
+                             (TOA refl), nstripe x nsamps */
     int16 *aerob4 = NULL; /* atmospherically corrected band 4 data
-                             (TOA refl), nlines x nsamps */
+                             (TOA refl), nstripe x nsamps */
     int16 *aerob5 = NULL; /* atmospherically corrected band 5 data
-                             (TOA refl), nlines x nsamps */
+                             (TOA refl), nstripe x nsamps */
     int16 *aerob7 = NULL; /* atmospherically corrected band 7 data
-                             (TOA refl), nlines x nsamps */
+                             (TOA refl), nstripe x nsamps */
+    uint8 *rcloud = NULL; /* cloud bits of the cloud window, nring x nsamps */
+    float *rtresi = NULL; /* residuals of the cloud window, nring x nsamps */
+    float *rtaero = NULL; /* aerosols of the cloud window, nring x nsamps */
+    int16 *rb6 = NULL;    /* band 6 of the cloud window where it may be
+                             cloud shadow, 9999 elsewhere, nring x nsamps */
+    int16 *rb10 = NULL;   /* band 10 of the cloud window, nring x nsamps */
 
     /* Vars for forward/inverse mapping space */
     Geoloc_t *space = NULL;       /* structure for geolocation information */
     Space_def_t space_def;        /* structure to define the space mapping */
-    Img_coord_float_t img;        /* coordinate in line/sample space */
-    Geo_coord_t geo;              /* coordinate in lat/long space */
+    Cmg_window_t cmg_win;         /* window of the CMG grids covering the
+                                     scene */
 
     /* Lookup table variables */
     float xtv;           /* observation zenith angle (deg) -- NOTE: set to 0.0
@@ -416,49 +1506,35 @@ int compute_sr_refl
     float xfi;           /* azimuthal difference between the sun and
                             observation angle (deg) */
     float cosxfi;        /* cosine of azimuthal difference */
-    float xtsstep;       /* solar zenith step value */
-    float xtsmin;        /* minimum solar zenith value */
-    float xtvstep;       /* observation step value */
-    float xtvmin;        /* minimum observation value */
-    float ****rolutt = NULL;    /* intrinsic reflectance table
-                                   [NSR_BANDS][7][22][8000] */
-    float ****transt = NULL;    /* transmission table
-                                   [NSR_BANDS][7][22][22] */
-    float ***sphalbt = NULL;    /* spherical albedo table [NSR_BANDS][7][22] */
-    float ***normext = NULL;    /* aerosol extinction coefficient at the
-                                   current wavelength (normalized at 550nm)
-                                   [NSR_BANDS][7][22] */
-    float **tsmax = NULL;       /* maximum scattering angle table [20][22] */
-    float **tsmin = NULL;       /* minimum scattering angle table [20][22] */
-    float **nbfi = NULL;        /* number of azimuth angles [20][22] */
-    float **nbfic = NULL;       /* communitive number of azimuth angles
-                                   [20][22] */
-    float **ttv = NULL;         /* view angle table [20][22] */
-    float tts[22];              /* sun angle table */
-    int32 indts[22];
+    Lut_t *lut = NULL;   /* look-up tables and table constants */
+    bool lut_mapped;     /* were the look-up tables mapped from lutcache? */
+    Scene_lut_t scene_lut;    /* look-up table of the scene */
+    Scene_lut_t *slut = NULL; /* look-up table of the scene used for the
+                                 corrections, NULL for the full LUTs */
 
     /* Auxiliary file variables */
-    int16 **dem = NULL;       /* CMG DEM data array [DEM_NBLAT][DEM_NBLON] */
-    int16 **andwi = NULL;     /* avg NDWI [RATIO_NBLAT][RATIO_NBLON] */
-    int16 **sndwi = NULL;     /* standard NDWI [RATIO_NBLAT][RATIO_NBLON] */
-    int16 **ratiob1 = NULL;   /* mean band1 ratio [RATIO_NBLAT][RATIO_NBLON] */
-    int16 **ratiob2 = NULL;   /* mean band2 ratio [RATIO_NBLAT][RATIO_NBLON] */
-    int16 **ratiob7 = NULL;   /* mean band7 ratio [RATIO_NBLAT][RATIO_NBLON] */
+    int16 **dem = NULL;       /* CMG DEM data array [CMG window] */
+    int16 **andwi = NULL;     /* avg NDWI [CMG window] */
+    int16 **sndwi = NULL;     /* standard NDWI [CMG window] */
+    int16 **ratiob1 = NULL;   /* mean band1 ratio [CMG window] */
+    int16 **ratiob2 = NULL;   /* mean band2 ratio [CMG window] */
+    int16 **ratiob7 = NULL;   /* mean band7 ratio [CMG window] */
     int16 **intratiob1 = NULL;   /* ??? band1 ratio
-                                    [RATIO_NBLAT][RATIO_NBLON] */
+                                    [CMG window] */
     int16 **intratiob2 = NULL;   /* ??? band2 ratio
-                                    [RATIO_NBLAT][RATIO_NBLON] */
+                                    [CMG window] */
     int16 **intratiob7 = NULL;   /* ??? band7 ratio
-                                    [RATIO_NBLAT][RATIO_NBLON] */
+                                    [CMG window] */
     int16 **slpratiob1 = NULL;   /* slope band1 ratio
-                                    [RATIO_NBLAT][RATIO_NBLON] */
+                                    [CMG window] */
     int16 **slpratiob2 = NULL;   /* slope band2 ratio
-                                    [RATIO_NBLAT][RATIO_NBLON] */
+                                    [CMG window] */
     int16 **slpratiob7 = NULL;   /* slope band7 ratio
-                                    [RATIO_NBLAT][RATIO_NBLON] */
-    uint16 **wv = NULL;       /* water vapor values [CMG_NBLAT][CMG_NBLON] */
-    uint8 **oz = NULL;        /* ozone values [CMG_NBLAT][CMG_NBLON] */
-    uint8 *lw_mask = NULL;    /* land/water mask, nlines x nsamps */
+                                    [CMG window] */
+    uint16 **wv = NULL;       /* water vapor values [CMG window] */
+    uint8 **oz = NULL;        /* ozone values [CMG window] */
+    uint8 *lw_mask = NULL;    /* land/water mask of a stripe and its halo,
+                                 (nstripe + 2 * LW_HALO) x nsamps */
     float raot550nm;    /* nearest input value of AOT */
     float uoz;          /* total column ozone */
     float uwv;          /* total column water vapor (precipital water vapor) */
@@ -471,54 +1547,6 @@ int compute_sr_refl
     char envi_file[STR_SIZE];    /* ENVI filename */
     char *cptr = NULL;       /* pointer to the file extension */
 
-    /* Table constants */
-    float aot550nm[22] =  /* AOT look-up table */
-        {0.01, 0.05, 0.10, 0.15, 0.20, 0.30, 0.40, 0.60, 0.80, 1.00, 1.20,
-         1.40, 1.60, 1.80, 2.00, 2.30, 2.60, 3.00, 3.50, 4.00, 4.50, 5.00};
-    float tpres[7] =      /* surface pressure table */
-        {1050.0, 1013.0, 900.0, 800.0, 700.0, 600.0, 500.0};
-
-    /* Atmospheric correction variables */
-    /* Look up table for atmospheric and geometric quantities */
-    float tauray[NSR_BANDS] =  /* molecular optical thickness coefficients --
-        produced by running 6S */
-        {0.23638, 0.16933, 0.09070, 0.04827, 0.01563, 0.00129, 0.00037,
-         0.07984};
-    double oztransa[NSR_BANDS] =   /* ozone transmission coeff */
-        {-0.00255649, -0.0177861, -0.0969872, -0.0611428, 0.0001, 0.0001,
-          0.0001, -0.0834061};
-    double wvtransa[NSR_BANDS] =   /* water vapor transmission coeff */
-        {2.29849e-27, 2.29849e-27, 0.00194772, 0.00404159, 0.000729136,
-         0.00067324, 0.0177533, 0.00279738};
-    double wvtransb[NSR_BANDS] =   /* water vapor transmission coeff */
-        {0.999742, 0.999742, 0.775024, 0.774482, 0.893085, 0.939669, 0.65094,
-         0.759952};
-    double ogtransa1[NSR_BANDS] =  /* other gases transmission coeff */
-        {4.91586e-20, 4.91586e-20, 4.91586e-20, 1.04801e-05, 1.35216e-05,
-         0.0205425, 0.0256526, 0.000214329};
-    double ogtransb0[NSR_BANDS] =  /* other gases transmission coeff */
-        {0.000197019, 0.000197019, 0.000197019, 0.640215, -0.195998, 0.326577,
-         0.243961, 0.396322};
-    double ogtransb1[NSR_BANDS] =  /* other gases transmission coeff */
-        {9.57011e-16, 9.57011e-16, 9.57011e-16, -0.348785, 0.275239, 0.0117192,
-         0.0616101, 0.04728};
-
-    /* Allocate memory for the many arrays needed to do the surface reflectance
-       computations */
-    retval = memory_allocation_sr (nlines, nsamps, &aerob1, &aerob2, &aerob4,
-        &aerob5, &aerob7, &cloud, &twvi, &tozi, &tp, &tresi, &taero, &lw_mask,
-        &dem, &andwi, &sndwi, &ratiob1, &ratiob2, &ratiob7, &intratiob1,
-        &intratiob2, &intratiob7, &slpratiob1, &slpratiob2, &slpratiob7, &wv,
-        &oz, &rolutt, &transt, &sphalbt, &normext, &tsmax, &tsmin, &nbfic,
-        &nbfi, &ttv);
-    if (retval != SUCCESS)
-    {
-        sprintf (errmsg, "Error allocating memory for the data arrays needed "
-            "for surface reflectance calculations.");
-        error_handler (false, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
-
     /* Initialize the geolocation space applications */
     if (!get_geoloc_info (xml_metadata, &space_def))
     {
@@ -535,14 +1563,62 @@ int compute_sr_refl
         exit (ERROR);
     }
 
+    /* Determine the window of the CMG grids covering the scene */
+    if (cmg_scene_window (space, nlines, nsamps, &cmg_win) != SUCCESS)
+    {
+        sprintf (errmsg, "Determining the CMG window of the scene");
+        error_handler (true, FUNC_NAME, errmsg);
+        exit (ERROR);
+    }
+    printf ("Reading CMG window of %d lines x %d samples from line %d, "
+        "sample %d ...\n", cmg_win.nlines, cmg_win.nsamps, cmg_win.line0,
+        cmg_win.samp0);
+
+    /* Allocate memory for the CMG window and the aerosol grid.  The
+       per-pixel arrays are allocated by each pass for its stripes. */
+    retval = memory_allocation_sr (cmg_win.nlines, cmg_win.nsamps, &dem,
+        &andwi, &sndwi, &ratiob1, &ratiob2, &ratiob7, &intratiob1,
+        &intratiob2, &intratiob7, &slpratiob1, &slpratiob2, &slpratiob7, &wv,
+        &oz);
+    if (retval != SUCCESS)
+    {
+        sprintf (errmsg, "Error allocating memory for the data arrays needed "
+            "for surface reflectance calculations.");
+        error_handler (false, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+    if (allocate_aot_grid (nlines, nsamps, &aot_grid) != SUCCESS)
+    {
+        sprintf (errmsg, "Error allocating the aerosol grid.");
+        error_handler (false, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* The stripes of the passes get the part of the budget left by the
+       look-up tables, the CMG window and the aerosol grid */
+    budget = stripe_memory * 1048576L;
+    fixed = sizeof (Lut_t) + sizeof (Scene_lut_t) +
+        (size_t) cmg_win.nlines * cmg_win.nsamps *
+        (12 * sizeof (int16) + sizeof (uint16) + sizeof (uint8)) +
+        (size_t) aot_grid.nlines * aot_grid.nsamps * AOT_TILE_BYTES;
+
+    /* Open the scratch files of the values kept between the passes */
+    cloud_fp = open_scratch ();
+    tresi_fp = open_scratch ();
+    taero_fp = open_scratch ();
+    if (cloud_fp == NULL || tresi_fp == NULL || taero_fp == NULL)
+    {
+        sprintf (errmsg, "Error opening the scratch files.");
+        error_handler (false, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
     /* Initialize the look up tables and atmospheric correction variables */
     retval = init_sr_refl (nlines, nsamps, input, space, anglehdf, intrefnm,
-        transmnm, spheranm, cmgdemnm, rationm, auxnm, &xtv, &xmuv, &xfi,
-        &cosxfi, &raot550nm, &pres, &uoz, &uwv, &xtsstep, &xtsmin, &xtvstep,
-        &xtvmin, tsmax, tsmin, tts, ttv, indts, rolutt, transt, sphalbt,
-        normext, nbfic, nbfi, dem, andwi, sndwi, ratiob1, ratiob2, ratiob7,
-        intratiob1, intratiob2, intratiob7, slpratiob1, slpratiob2, slpratiob7,
-        wv, oz);
+        transmnm, spheranm, lutcache, cmgdemnm, rationm, auxnm, &cmg_win,
+        &xtv, &xmuv, &xfi, &cosxfi, &raot550nm, &pres, &uoz, &uwv, &lut,
+        &lut_mapped, dem, andwi, sndwi, ratiob1, ratiob2, ratiob7, intratiob1,
+        intratiob2, intratiob7, slpratiob1, slpratiob2, slpratiob7, wv, oz);
     if (retval != SUCCESS)
     {
         sprintf (errmsg, "Error initializing the lookup tables and "
@@ -551,16 +1627,40 @@ int compute_sr_refl
         return (ERROR);
     }
 
-    /* Read the land/water mask */
-    if (get_input_lw_lines (input, 0, nlines, lw_mask) != SUCCESS)
+    /* Compute the look-up table of the scene for its sun and view angles,
+       unless the LUTs are to be interpolated for each pixel */
+    if (!full_lut || compare_lut)
     {
-        sprintf (errmsg, "Reading land/water mask");
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
+        retval = init_scene_lut (xts, xtv, xmus, xmuv, xfi, cosxfi, lut,
+            &scene_lut);
+        if (retval != SUCCESS)
+        {
+            sprintf (errmsg, "Computing the look-up table of the scene.");
+            error_handler (false, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+
+        if (compare_lut)
+        {
+            retval = compare_scene_lut (xts, xtv, xmus, xmuv, xfi, cosxfi,
+                lut, &scene_lut);
+            if (retval != SUCCESS)
+            {
+                sprintf (errmsg, "Comparing the look-up table of the scene "
+                    "with the full LUTs.");
+                error_handler (false, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+        }
+
+        if (!full_lut)
+            slut = &scene_lut;
     }
+    printf ("The atmospheric correction interpolates the %s.\n",
+        slut != NULL ? "look-up table of the scene" : "full LUTs");
 
-    /* Loop through all the reflectance bands and perform atmospheric
-       corrections based on climatology */
+    /* Get the parameters for the atmospheric correction of each of the
+       reflectance bands based on climatology */
     printf ("Performing atmospheric corrections for each reflectance "
         "band ...");
     for (ib = 0; ib <= SR_BAND7; ib++)
@@ -572,12 +1672,9 @@ int compute_sr_refl
            roslamb value is not valid upon output. Just set it to 0.0 to
            be consistent. */
         rotoa = 0.0;
-        retval = atmcorlamb2 (xts, xtv, xmus, xmuv, xfi, cosxfi,
-            raot550nm, ib, pres, tpres, aot550nm, rolutt, transt, xtsstep,
-            xtsmin, xtvstep, xtvmin, sphalbt, normext, tsmax, tsmin, nbfic,
-            nbfi, tts, indts, ttv, uoz, uwv, tauray, ogtransa1, ogtransb0,
-            ogtransb1, wvtransa, wvtransb, oztransa, rotoa, &roslamb,
-            &tgo, &roatm, &ttatmg, &satm, &xrorayp, &next);
+        retval = atmcorlamb2 (xts, xtv, xmus, xmuv, xfi, cosxfi, raot550nm, ib,
+            pres, lut, slut, uoz, uwv, rotoa, &roslamb, &tgo, &roatm, &ttatmg,
+            &satm, &xrorayp, &next);
         if (retval != SUCCESS)
         {
             sprintf (errmsg, "Performing lambertian atmospheric correction "
@@ -591,40 +1688,6 @@ int compute_sr_refl
         broatm[ib] = roatm;
         bttatmg[ib] = ttatmg;
         bsatm[ib] = satm;
-
-        /* Perform atmospheric corrections for bands 1-7 */
-#ifdef _OPENMP
-        #pragma omp parallel for private (i, rotoa, roslamb)
-#endif
-        for (i = 0; i < nlines*nsamps; i++)
-        {
-            /* If this pixel is not fill.  Otherwise fill pixels have
-               already been marked in the TOA calculations. */
-            if (qaband[i] != 1)
-            {
-                /* Store the TOA scaled TOA reflectance values for later use
-                   before completing atmospheric corrections */
-                if (ib == DN_BAND1)
-                    aerob1[i] = sband[ib][i];
-                else if (ib == DN_BAND2)
-                    aerob2[i] = sband[ib][i];
-                else if (ib == DN_BAND4)
-                    aerob4[i] = sband[ib][i];
-                else if (ib == DN_BAND5)
-                    aerob5[i] = sband[ib][i];
-                else if (ib == DN_BAND7)
-                    aerob7[i] = sband[ib][i];
-
-                /* Apply the atmospheric corrections, and store the scaled
-                   value for further corrections */
-                rotoa = sband[ib][i] * SCALE_FACTOR;
-                roslamb = rotoa / tgo;
-                roslamb = roslamb - roatm;
-                roslamb = roslamb / ttatmg;
-                roslamb = roslamb / (1.0 + satm * roslamb);
-                sband[ib][i] = (int) (roslamb * MULT_FACTOR);
-            }
-        }  /* end for i */
     }  /* for ib */
     printf ("\n");
 
@@ -635,341 +1698,365 @@ int compute_sr_refl
         troatm[ib] = 0.0;
     }
 
-    /* Interpolate the auxiliary data for each pixel location */
-    printf ("Interpolating the auxiliary data ...\n");
+    /* Invert the aerosols one stripe of lines at a time.  Apart from the
+       land/water window this only looks at the current pixel, so a stripe
+       only needs its bands and the land/water mask of its lines and halo.
+       The cloud, residual and aerosol values go to the scratch files, and
+       the temperatures are summed for the cloud mask. */
+    nstripe = stripe_lines (nlines, budget,
+        fixed + 2 * LW_HALO * (size_t) nsamps, (size_t) nsamps *
+        (TOA_PIX_BYTES (NINV_BANDS) + 5 * sizeof (int16) +
+        2 * sizeof (uint8) + 2 * sizeof (float)), "aerosol inversion");
+    printf ("Interpolating the auxiliary data and inverting the "
+        "aerosols in stripes of %d lines ...\n", nstripe);
+    if (alloc_toa_stripe (nstripe, nsamps, NINV_BANDS, inv_bands, &qaband,
+        sband) != SUCCESS ||
+        (aerob1 = alloc_stripe (nstripe, nsamps, sizeof (int16),
+            "aerob1")) == NULL ||
+        (aerob2 = alloc_stripe (nstripe, nsamps, sizeof (int16),
+            "aerob2")) == NULL ||
+        (aerob4 = alloc_stripe (nstripe, nsamps, sizeof (int16),
+            "aerob4")) == NULL ||
+        (aerob5 = alloc_stripe (nstripe, nsamps, sizeof (int16),
+            "aerob5")) == NULL ||
+        (aerob7 = alloc_stripe (nstripe, nsamps, sizeof (int16),
+            "aerob7")) == NULL ||
+        (cloud = alloc_stripe (nstripe, nsamps, sizeof (uint8),
+            "cloud")) == NULL ||
+        (tresi = alloc_stripe (nstripe, nsamps, sizeof (float),
+            "tresi")) == NULL ||
+        (taero = alloc_stripe (nstripe, nsamps, sizeof (float),
+            "taero")) == NULL ||
+        (lw_mask = alloc_stripe (nstripe + 2 * LW_HALO, nsamps,
+            sizeof (uint8), "lw_mask")) == NULL)
+    {
+        sprintf (errmsg, "Error allocating memory for the stripes of the "
+            "aerosol inversion.");
+        error_handler (false, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    nbval = 0;
+    nbclear = 0;
+    ncloud = 0;
+    mclear = 0.0;
+    mall = 0.0;
+    tcloud_min = 0.0;
     tmp_percent = 0;
-#ifdef _OPENMP
-    #pragma omp parallel for private (i, j, curr_pix, img, geo, lat, lon, xcmg, ycmg, lcmg, scmg, lcmg1, scmg1, u, v, uoz11, uoz12, uoz21, uoz22, pres11, pres12, pres21, pres22, xndwi, th1, th2, fndvi, iband, iband1, iband3, retval, corf, raot, residual, next, rotoa, raot550nm, roslamb, tgo, roatm, ttatmg, satm, xrorayp, ros5, ros4) firstprivate(erelc, troatm)
-#endif
-    for (i = 0; i < nlines; i++)
+    for (line0 = 0; line0 < nlines; line0 += nstripe)
     {
-#ifndef _OPENMP
-        /* update status, but not if multi-threaded */
-        curr_tmp_percent = 100 * i / nlines;
-        if (curr_tmp_percent > tmp_percent)
+        line1 = (line0 + nstripe < nlines) ? line0 + nstripe : nlines;
+        npix = (line1 - line0) * nsamps;
+
+        /* Calibrate the bands of the stripe */
+        if (read_toa_stripe (input, xml_metadata->global.instrument, line0,
+            line1 - line0, nsamps, xmus, qaband, sband) != SUCCESS)
         {
-            tmp_percent = curr_tmp_percent;
-            if (tmp_percent % 10 == 0)
-            {
-                printf ("%d%% ", tmp_percent);
-                fflush (stdout);
-            }
+            sprintf (errmsg, "Calibrating lines %d to %d", line0, line1 - 1);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
         }
-#endif
 
-        curr_pix = i * nsamps;
-        for (j = 0; j < nsamps; j++, curr_pix++)
+        /* Read the land/water mask of the stripe and its halo */
+        lw_line0 = (line0 - LW_HALO > 0) ? line0 - LW_HALO : 0;
+        lw_line1 = (line1 + LW_HALO < nlines) ? line1 + LW_HALO : nlines;
+        lw_pix0 = lw_line0 * nsamps;
+        if (get_input_lw_lines (input, lw_line0, lw_line1 - lw_line0,
+            lw_mask) != SUCCESS)
         {
-            /* If this pixel is fill, then don't process */
-            if (qaband[curr_pix] == 1)
-                continue;
-
-            /* Get the lat/long for the current pixel, for the center of
-               the pixel */
-            img.l = i - 0.5;
-            img.s = j + 0.5;
-            img.is_fill = false;
-            if (!from_space (space, &img, &geo))
-            {
-                sprintf (errmsg, "Mapping line/sample (%d, %d) to "
-                    "geolocation coords", i, j);
-                error_handler (true, FUNC_NAME, errmsg);
-                exit (ERROR);
-            }
-            lat = geo.lat * RAD2DEG;
-            lon = geo.lon * RAD2DEG;
-
-            /* Use that lat/long to determine the line/sample in the
-               CMG-related lookup tables, using the center of the UL
-               pixel. Note, we are basically making sure the line/sample
-               combination falls within -90, 90 and -180, 180 global climate
-               data boundaries.  However, the source code below uses lcmg+1
-               and scmg+1, which for some scenes may wrap around the dateline
-               or the poles.  Thus we need to wrap the CMG data around to the
-               beginning of the array. */
-            /* Each CMG pixel is 0.05 x 0.05 degrees.  Use the center of the
-               pixel for each calculation. */
-            ycmg = (89.975 - lat) * 20.0;   /* vs / 0.05 */
-            xcmg = (179.975 + lon) * 20.0;  /* vs / 0.05 */
-            lcmg = (int) (ycmg);
-            scmg = (int) (xcmg);
-            if ((lcmg < 0 || lcmg >= CMG_NBLAT) ||
-                (scmg < 0 || scmg >= CMG_NBLON))
+            sprintf (errmsg, "Reading land/water mask");
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+
+        /* Store the scaled TOA reflectance values used by the inversion,
+           then perform atmospheric corrections for bands 1-7 */
+        memcpy (aerob1, sband[SR_BAND1], npix * sizeof (int16));
+        memcpy (aerob2, sband[SR_BAND2], npix * sizeof (int16));
+        memcpy (aerob4, sband[SR_BAND4], npix * sizeof (int16));
+        memcpy (aerob5, sband[SR_BAND5], npix * sizeof (int16));
+        memcpy (aerob7, sband[SR_BAND7], npix * sizeof (int16));
+        for (ib = 0; ib <= SR_BAND7; ib++)
+            climatology_refl (npix, qaband, btgo[ib], broatm[ib],
+                bttatmg[ib], bsatm[ib], sband[ib]);
+
+        memset (cloud, 0, npix * sizeof (uint8));
+        memset (tresi, 0, npix * sizeof (float));
+        memset (taero, 0, npix * sizeof (float));
+
+        /* Interpolate the auxiliary data for each pixel location and
+           invert the aerosols */
+#ifdef _OPENMP
+        #pragma omp parallel for private (i, j, curr_pix, stripe_pix, win, lcmg, scmg, twv, toz, tpix, xndwi, th1, th2, fndvi, iband, iband1, iband3, retval, corf, raot, residual, next, rotoa, raot550nm, roslamb, tgo, roatm, ttatmg, satm, xrorayp, ros5, ros4) firstprivate(erelc, troatm)
+#endif
+        for (i = line0; i < line1; i++)
+        {
+#ifndef _OPENMP
+            /* update status, but not if multi-threaded */
+            curr_tmp_percent = 100 * i / nlines;
+            if (curr_tmp_percent > tmp_percent)
             {
-                sprintf (errmsg, "Invalid line/sample combination for the "
-                    "CMG-related lookup tables - line %d, sample %d "
-                    "(0-based). CMG-based tables are %d lines x %d "
-                    "samples.", lcmg, scmg, CMG_NBLAT, CMG_NBLON);
-                error_handler (true, FUNC_NAME, errmsg);
-                exit (ERROR);
+                tmp_percent = curr_tmp_percent;
+                if (tmp_percent % 10 == 0)
+                {
+                    printf ("%d%% ", tmp_percent);
+                    fflush (stdout);
+                }
             }
+#endif
 
-            /* If the current CMG pixel is at the edge of the CMG array,
-               then allow the next pixel for interpolation to wrap around
-               the array */
-            if (scmg >= CMG_NBLON-1)  /* 180 degrees so wrap around */
-                scmg1 = 0;
-            else
-                scmg1 = scmg + 1;
-
-            if (lcmg >= CMG_NBLAT-1)  /* -90 degrees so wrap around */
-                lcmg1 = 0;
-            else
-                lcmg1 = lcmg + 1;
-
-            /* Determine the fractional difference between the integer location
-               and floating point pixel location */
-            u = (ycmg - lcmg);
-            v = (xcmg - scmg);
-
-            /* Interpolate water vapor.  If the water vapor value is fill (=0),
-               then use it as-is. */
-            twvi[curr_pix] = wv[lcmg][scmg] * (1.0 - u) * (1.0 - v) +
-                             wv[lcmg][scmg1] * (1.0 - u) * v +
-                             wv[lcmg1][scmg] * u * (1.0 - v) +
-                             wv[lcmg1][scmg1] * u * v;
-            twvi[curr_pix] = twvi[curr_pix] * 0.01;   /* vs / 100 */
-
-            /* Interpolate ozone.  If the ozone value is fill (=0), then use a
-               default value of 120. */
-            uoz11 = oz[lcmg][scmg];
-            if (uoz11 == 0)
-                uoz11 = 120;
-
-            uoz12 = oz[lcmg][scmg1];
-            if (uoz12 == 0)
-                uoz12 = 120;
-
-            uoz21 = oz[lcmg1][scmg];
-            if (uoz21 == 0)
-                uoz21 = 120;
-
-            uoz22 = oz[lcmg1][scmg1];
-            if (uoz22 == 0)
-                uoz22 = 120;
-
-            tozi[curr_pix] = uoz11 * (1.0 - u) * (1.0 - v) +
-                             uoz12 * (1.0 - u) * v +
-                             uoz21 * u * (1.0 - v) +
-                             uoz22 * u * v;
-            tozi[curr_pix] = tozi[curr_pix] * 0.0025;   /* vs / 400 */
-
-            /* If this pixel is water, then set the water bit.  If we are
-               on the edges of the scene, just use the current pixel.  OW
-               test the current pixel and the surrounding window pixels, as the
-               land/water mask isn't perfect.  A water test using the NDVI
-               will be applied later to make sure. */
-            for (win = 0; win < 9; win++)
-            {  /* Check 9x9 window */
-                if (i < win || i >= nlines-win-1 ||
-                    j < win || j >= nsamps-win-1)
+            curr_pix = i * nsamps;
+            stripe_pix = (i - line0) * nsamps;
+            for (j = 0; j < nsamps; j++, curr_pix++, stripe_pix++)
+            {
+                /* If this pixel is fill, then don't process */
+                if (qaband[stripe_pix] == 1)
+                    continue;
+
+                /* Interpolate the water vapor, ozone and surface pressure
+                   of the pixel */
+                if (interpolate_aux (space, &cmg_win, wv, oz, dem, i, j,
+                    &lcmg, &scmg, &twv, &toz, &tpix) != SUCCESS)
                 {
-                    if (lw_mask[curr_pix] == 0)
+                    sprintf (errmsg, "Interpolating the auxiliary data");
+                    error_handler (true, FUNC_NAME, errmsg);
+                    exit (ERROR);
+                }
+
+                /* If this pixel is water, then set the water bit.  If we
+                   are on the edges of the scene, just use the current
+                   pixel.  OW test the current pixel and the surrounding
+                   window pixels, as the land/water mask isn't perfect.  A
+                   water test using the NDVI will be applied later to make
+                   sure. */
+                for (win = 0; win < 9; win++)
+                {  /* Check 9x9 window */
+                    if (i < win || i >= nlines-win-1 ||
+                        j < win || j >= nsamps-win-1)
+                    {
+                        if (lw_mask[curr_pix - lw_pix0] == 0)
+                        {
+                            cloud[stripe_pix] = 128;    /* set water bit */
+                            tresi[stripe_pix] = -1.0;
+                            break;
+                        }
+                    }
+                    else if
+                        (lw_mask[(i-win)*nsamps + j-win - lw_pix0] == 0 ||
+                         lw_mask[(i-win)*nsamps + j - lw_pix0] == 0 ||
+                         lw_mask[(i-win)*nsamps + j+win - lw_pix0] == 0 ||
+                         lw_mask[curr_pix-win - lw_pix0] == 0 ||
+                         lw_mask[curr_pix - lw_pix0] == 0 ||
+                         lw_mask[curr_pix+win - lw_pix0] == 0 ||
+                         lw_mask[(i+win)*nsamps + j-win - lw_pix0] == 0 ||
+                         lw_mask[(i+win)*nsamps + j - lw_pix0] == 0 ||
+                         lw_mask[(i+win)*nsamps + j+win - lw_pix0] == 0)
                     {
-                        cloud[curr_pix] = 128;    /* set water bit */
-                        tresi[curr_pix] = -1.0;
+                        cloud[stripe_pix] = 128;    /* set water bit */
+                        tresi[stripe_pix] = -1.0;
                         break;
                     }
                 }
-                else if
-                    (lw_mask[(i-win)*nsamps + j-win] == 0 ||
-                     lw_mask[(i-win)*nsamps + j] == 0 ||
-                     lw_mask[(i-win)*nsamps + j+win] == 0 ||
-                     lw_mask[curr_pix-win] == 0 ||
-                     lw_mask[curr_pix] == 0 ||
-                     lw_mask[curr_pix+win] == 0 ||
-                     lw_mask[(i+win)*nsamps + j-win] == 0 ||
-                     lw_mask[(i+win)*nsamps + j] == 0 ||
-                     lw_mask[(i+win)*nsamps + j+win] == 0)
-                {
-                    cloud[curr_pix] = 128;    /* set water bit */
-                    tresi[curr_pix] = -1.0;
-                    break;
-                }
-            }
-
-            /* Get the surface pressure from the global DEM.  Set to 1013.0
-               (sea level) if the DEM is fill (= -9999), which is likely
-               ocean. */
-            if (dem[lcmg][scmg] != -9999)
-                pres11 = 1013.0 * exp (-dem[lcmg][scmg] * ONE_DIV_8500);
-            else
-                pres11 = 1013.0;
-
-            if (dem[lcmg][scmg1] != -9999)
-                pres12 = 1013.0 * exp (-dem[lcmg][scmg1] * ONE_DIV_8500);
-            else
-                pres12 = 1013.0;
-
-            if (dem[lcmg1][scmg] != -9999)
-                pres21 = 1013.0 * exp (-dem[lcmg1][scmg] * ONE_DIV_8500);
-            else
-                pres21 = 1013.0;
 
-            if (dem[lcmg1][scmg1] != -9999)
-                pres22 = 1013.0 * exp (-dem[lcmg1][scmg1] * ONE_DIV_8500);
-            else
-                pres22 = 1013.0;
-
-            tp[curr_pix] = pres11 * (1.0 - u) * (1.0 - v) +
-                           pres12 * (1.0 - u) * v +
-                           pres21 * u * (1.0 - v) +
-                           pres22 * u * v;
-
-            /* Inverting aerosols */
-            /* Filter cirrus pixels */
-            if (sband[SR_BAND9][curr_pix] >
-                (100.0 / (tp[curr_pix] * ONE_DIV_1013)))
-            {  /* Set cirrus bit */
-                cloud[curr_pix]++;
-            }
-            else
-            {
-                /* Determine the band ratios */
-                if (ratiob1[lcmg][scmg] == 0)
-                {
-                    /* Average the valid ratio around the location */
-                    erelc[DN_BAND1] = 0.4817;
-                    erelc[DN_BAND2] = erelc[DN_BAND1] / 0.844239;
-                    erelc[DN_BAND4] = 1.0;
-                    erelc[DN_BAND7] = 1.79;
+                /* Inverting aerosols */
+                /* Filter cirrus pixels */
+                if (sband[SR_BAND9][stripe_pix] >
+                    (100.0 / (tpix * ONE_DIV_1013)))
+                {  /* Set cirrus bit */
+                    cloud[stripe_pix]++;
                 }
                 else
                 {
-                    /* Use a version of NDWI to calculate the band ratio */
-                    xndwi = ((double) sband[SR_BAND5][curr_pix] -
-                             (double) (sband[SR_BAND7][curr_pix] * 0.5)) /
-                            ((double) sband[SR_BAND5][curr_pix] +
-                             (double) (sband[SR_BAND7][curr_pix] * 0.5));
-
-                    th1 = (andwi[lcmg][scmg] + 2.0 * sndwi[lcmg][scmg]) *
-                        0.001;
-                    th2 = (andwi[lcmg][scmg] - 2.0 * sndwi[lcmg][scmg]) *
-                        0.001;
-                    if (xndwi > th1)
-                        xndwi = th1;
-                    if (xndwi < th2)
-                        xndwi = th2;
-
-                    erelc[DN_BAND1] = (xndwi * slpratiob1[lcmg][scmg] +
-                        intratiob1[lcmg][scmg]) * 0.001;
-                    erelc[DN_BAND2] = (xndwi * slpratiob2[lcmg][scmg] +
-                        intratiob2[lcmg][scmg]) * 0.001;
-                    erelc[DN_BAND4] = 1.0;
-                    erelc[DN_BAND7] = (xndwi * slpratiob7[lcmg][scmg] +
-                        intratiob7[lcmg][scmg]) * 0.001;
-                }
-
-                /* Retrieve the TOA reflectance values for the current pixel */
-                troatm[DN_BAND1] = aerob1[curr_pix] * SCALE_FACTOR;
-                troatm[DN_BAND2] = aerob2[curr_pix] * SCALE_FACTOR;
-                troatm[DN_BAND4] = aerob4[curr_pix] * SCALE_FACTOR;
-                troatm[DN_BAND7] = aerob7[curr_pix] * SCALE_FACTOR;
-
-                /* If this is water ... */
-                if (btest (cloud[curr_pix], WAT_QA))
-                {
-                    /* Check the NDVI to validate if this is water */
-                    fndvi = ((double) sband[SR_BAND5][curr_pix] -
-                             (double) sband[SR_BAND4][curr_pix]) /
-                            ((double) sband[SR_BAND5][curr_pix] +
-                             (double) sband[SR_BAND4][curr_pix]);
-                    if (fndvi < 0.1)
-                    {  /* skip the rest of the processing */
-                        taero[curr_pix] = 0.0;
-                        tresi[curr_pix] = -0.01;
-                        continue;
+                    /* Determine the band ratios */
+                    if (ratiob1[lcmg][scmg] == 0)
+                    {
+                        /* Average the valid ratio around the location */
+                        erelc[DN_BAND1] = 0.4817;
+                        erelc[DN_BAND2] = erelc[DN_BAND1] / 0.844239;
+                        erelc[DN_BAND4] = 1.0;
+                        erelc[DN_BAND7] = 1.79;
                     }
                     else
                     {
-                        /* Remove the preliminary water designation */
-                        cloud[curr_pix] -= 128;
+                        /* Use a version of NDWI to calculate the band ratio */
+                        xndwi = ((double) sband[SR_BAND5][stripe_pix] -
+                                 (double) (sband[SR_BAND7][stripe_pix] * 0.5)) /
+                                ((double) sband[SR_BAND5][stripe_pix] +
+                                 (double) (sband[SR_BAND7][stripe_pix] * 0.5));
+
+                        th1 = (andwi[lcmg][scmg] + 2.0 * sndwi[lcmg][scmg]) *
+                            0.001;
+                        th2 = (andwi[lcmg][scmg] - 2.0 * sndwi[lcmg][scmg]) *
+                            0.001;
+                        if (xndwi > th1)
+                            xndwi = th1;
+                        if (xndwi < th2)
+                            xndwi = th2;
+
+                        erelc[DN_BAND1] = (xndwi * slpratiob1[lcmg][scmg] +
+                            intratiob1[lcmg][scmg]) * 0.001;
+                        erelc[DN_BAND2] = (xndwi * slpratiob2[lcmg][scmg] +
+                            intratiob2[lcmg][scmg]) * 0.001;
+                        erelc[DN_BAND4] = 1.0;
+                        erelc[DN_BAND7] = (xndwi * slpratiob7[lcmg][scmg] +
+                            intratiob7[lcmg][scmg]) * 0.001;
                     }
-                }
-       
-                /* Retrieve the aerosol information */
-                iband1 = DN_BAND4;
-                iband3 = DN_BAND1;
-                retval = subaeroret (iband1, iband3, xts, xtv, xmus, xmuv,
-                    xfi, cosxfi, pres, uoz, uwv, erelc, troatm, tpres,
-                    aot550nm, rolutt, transt, xtsstep, xtsmin, xtvstep,
-                    xtvmin, sphalbt, normext, tsmax, tsmin, nbfic, nbfi,
-                    tts, indts, ttv, tauray, ogtransa1, ogtransb0,
-                    ogtransb1, wvtransa, wvtransb, oztransa, &raot,
-                    &residual, &next);
-                if (retval != SUCCESS)
-                {
-                    sprintf (errmsg, "Performing atmospheric correction.");
-                    error_handler (true, FUNC_NAME, errmsg);
-                    exit (ERROR);
-                }
-                corf = raot / xmus;
 
-                /* Check the model residual.  Corf represents aerosol impact.
-                   Test the quality of the aerosol inversion. */
-                if (residual < (0.015 + 0.005 * corf))
-                {
-                    /* Test if band 5 makes sense */
-                    iband = DN_BAND5;
-                    rotoa = aerob5[curr_pix] * SCALE_FACTOR;
-                    raot550nm = raot;
-                    retval = atmcorlamb2 (xts, xtv, xmus, xmuv, xfi, cosxfi,
-                        raot550nm, iband, pres, tpres, aot550nm, rolutt,
-                        transt, xtsstep, xtsmin, xtvstep, xtvmin, sphalbt,
-                        normext, tsmax, tsmin, nbfic, nbfi, tts, indts,
-                        ttv, uoz, uwv, tauray, ogtransa1, ogtransb0,
-                        ogtransb1, wvtransa, wvtransb, oztransa, rotoa,
-                        &roslamb, &tgo, &roatm, &ttatmg, &satm, &xrorayp,
-                        &next);
-                    if (retval != SUCCESS)
+                    /* Retrieve the TOA reflectance values for the current
+                       pixel */
+                    troatm[DN_BAND1] = aerob1[stripe_pix] * SCALE_FACTOR;
+                    troatm[DN_BAND2] = aerob2[stripe_pix] * SCALE_FACTOR;
+                    troatm[DN_BAND4] = aerob4[stripe_pix] * SCALE_FACTOR;
+                    troatm[DN_BAND7] = aerob7[stripe_pix] * SCALE_FACTOR;
+
+                    /* If this is water ... */
+                    if (btest (cloud[stripe_pix], WAT_QA))
                     {
-                        sprintf (errmsg, "Performing lambertian "
-                            "atmospheric correction type 2.");
-                        error_handler (true, FUNC_NAME, errmsg);
-                        exit (ERROR);
+                        /* Check the NDVI to validate if this is water */
+                        fndvi = ((double) sband[SR_BAND5][stripe_pix] -
+                                 (double) sband[SR_BAND4][stripe_pix]) /
+                                ((double) sband[SR_BAND5][stripe_pix] +
+                                 (double) sband[SR_BAND4][stripe_pix]);
+                        if (fndvi < 0.1)
+                        {  /* skip the rest of the processing */
+                            taero[stripe_pix] = 0.0;
+                            tresi[stripe_pix] = -0.01;
+                            continue;
+                        }
+                        else
+                        {
+                            /* Remove the preliminary water designation */
+                            cloud[stripe_pix] -= 128;
+                        }
                     }
-                    ros5 = roslamb;
-
-                    /* Test if band 4 makes sense */
-                    iband = DN_BAND4;
-                    rotoa = aerob4[curr_pix] * SCALE_FACTOR;
-                    raot550nm = raot;
-                    retval = atmcorlamb2 (xts, xtv, xmus, xmuv, xfi, cosxfi,
-                        raot550nm, iband, pres, tpres, aot550nm, rolutt,
-                        transt, xtsstep, xtsmin, xtvstep, xtvmin, sphalbt,
-                        normext, tsmax, tsmin, nbfic, nbfi, tts, indts,
-                        ttv, uoz, uwv, tauray, ogtransa1, ogtransb0,
-                        ogtransb1, wvtransa, wvtransb, oztransa, rotoa,
-                        &roslamb, &tgo, &roatm, &ttatmg, &satm, &xrorayp,
-                        &next);
+       
+                    /* Retrieve the aerosol information */
+                    iband1 = DN_BAND4;
+                    iband3 = DN_BAND1;
+                    retval = subaeroret (iband1, iband3, xts, xtv, xmus, xmuv,
+                        xfi, cosxfi, pres, uoz, uwv, erelc, troatm, lut, slut,
+                        &raot, &residual, &next);
                     if (retval != SUCCESS)
                     {
-                        sprintf (errmsg, "Performing lambertian "
-                            "atmospheric correction type 2.");
+                        sprintf (errmsg, "Performing atmospheric correction.");
                         error_handler (true, FUNC_NAME, errmsg);
                         exit (ERROR);
                     }
-                    ros4 = roslamb;
+                    corf = raot / xmus;
 
-                    if ((ros5 > 0.1) && ((ros5 - ros4) / (ros5 + ros4) > 0))
+                    /* Check the model residual.  Corf represents aerosol
+                       impact.  Test the quality of the aerosol inversion. */
+                    if (residual < (0.015 + 0.005 * corf))
                     {
-                        taero[curr_pix] = raot;
-                        tresi[curr_pix] = residual;
+                        /* Test if band 5 makes sense */
+                        iband = DN_BAND5;
+                        rotoa = aerob5[stripe_pix] * SCALE_FACTOR;
+                        raot550nm = raot;
+                        retval = atmcorlamb2 (xts, xtv, xmus, xmuv, xfi,
+                            cosxfi, raot550nm, iband, pres, lut, slut, uoz, uwv,
+                            rotoa, &roslamb, &tgo, &roatm, &ttatmg, &satm,
+                            &xrorayp, &next);
+                        if (retval != SUCCESS)
+                        {
+                            sprintf (errmsg, "Performing lambertian "
+                                "atmospheric correction type 2.");
+                            error_handler (true, FUNC_NAME, errmsg);
+                            exit (ERROR);
+                        }
+                        ros5 = roslamb;
+
+                        /* Test if band 4 makes sense */
+                        iband = DN_BAND4;
+                        rotoa = aerob4[stripe_pix] * SCALE_FACTOR;
+                        raot550nm = raot;
+                        retval = atmcorlamb2 (xts, xtv, xmus, xmuv, xfi,
+                            cosxfi, raot550nm, iband, pres, lut, slut, uoz, uwv,
+                            rotoa, &roslamb, &tgo, &roatm, &ttatmg, &satm,
+                            &xrorayp, &next);
+                        if (retval != SUCCESS)
+                        {
+                            sprintf (errmsg, "Performing lambertian "
+                                "atmospheric correction type 2.");
+                            error_handler (true, FUNC_NAME, errmsg);
+                            exit (ERROR);
+                        }
+                        ros4 = roslamb;
+
+                        if ((ros5 > 0.1) &&
+                            ((ros5 - ros4) / (ros5 + ros4) > 0))
+                        {
+                            taero[stripe_pix] = raot;
+                            tresi[stripe_pix] = residual;
+                        }
+                        else
+                        {
+                            taero[stripe_pix] = 0.0;
+                            tresi[stripe_pix] = -0.01;
+                        }
                     }
                     else
                     {
-                        taero[curr_pix] = 0.0;
-                        tresi[curr_pix] = -0.01;
+                        taero[stripe_pix] = 0.0;
+                        tresi[stripe_pix] = -0.01;
+                    }
+                }  /* end if cirrus */
+            }  /* end for j */
+        }  /* end for i */
+
+        /* Compute the average temperature of the clear, non-water,
+           non-filled pixels, and find the coldest pixel that may be cloud
+           for the reach of the cloud shadows */
+        for (i = 0; i < npix; i++)
+        {
+            /* If this pixel is fill, then don't process */
+            if (qaband[i] != 1)
+            {
+                /* Keep track of the number of total (non-fill) pixels in
+                   addition to the sum of the unscaled thermal values */
+                nbval++;
+                mall += sband[SR_BAND10][i] * SCALE_FACTOR_TH;
+
+                /* Check for clear pixels */
+                if ((!btest (cloud[i], CIR_QA)) && (sband[SR_BAND5][i] > 300))
+                {
+                    /* Check to see if this is a clear pixel */
+                    anom = sband[SR_BAND2][i] - sband[SR_BAND4][i] * 0.5;
+                    if (anom < 300)
+                    {
+                        /* Keep track of the number of clear pixels in
+                           addition to the sum of the unscaled thermal
+                           values */
+                        nbclear++;
+                        mclear += sband[SR_BAND10][i] * SCALE_FACTOR_TH;
                     }
                 }
-                else
+
+                /* Cirrus, or snow or cloud if cold enough */
+                if (btest (cloud[i], CIR_QA) || (tresi[i] < 0.0 &&
+                    (sband[SR_BAND2][i] - sband[SR_BAND4][i] * 0.5) > 500))
                 {
-                    taero[curr_pix] = 0.0;
-                    tresi[curr_pix] = -0.01;
+                    tcloud = sband[SR_BAND10][i] * SCALE_FACTOR_TH;
+                    if (ncloud == 0 || tcloud < tcloud_min)
+                        tcloud_min = tcloud;
+                    ncloud++;
                 }
-            }  /* end if cirrus */
-        }  /* end for j */
-    }  /* end for i */
+            }
+        }  /* end for i */
+
+        /* Keep the cloud, residual and aerosol values of the stripe */
+        if (scratch_lines (cloud_fp, true, line0, line1 - line0, nsamps,
+            sizeof (uint8), cloud) != SUCCESS ||
+            scratch_lines (tresi_fp, true, line0, line1 - line0, nsamps,
+            sizeof (float), tresi) != SUCCESS ||
+            scratch_lines (taero_fp, true, line0, line1 - line0, nsamps,
+            sizeof (float), taero) != SUCCESS)
+        {
+            sprintf (errmsg, "Saving the aerosol inversion of lines %d to %d",
+                line0, line1 - 1);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+    }  /* end for line0 */
 
 #ifndef _OPENMP
     /* update status */
@@ -977,53 +2064,18 @@ int compute_sr_refl
     fflush (stdout);
 #endif
 
-    /* Done with the aerob* arrays and land/water mask */
+    /* Done with the arrays of the aerosol inversion */
+    free_toa_stripe (&qaband, sband);
     free (aerob1);  aerob1 = NULL;
     free (aerob2);  aerob2 = NULL;
     free (aerob4);  aerob4 = NULL;
     free (aerob5);  aerob5 = NULL;
     free (aerob7);  aerob7 = NULL;
+    free (cloud);   cloud = NULL;
+    free (tresi);   tresi = NULL;
+    free (taero);   taero = NULL;
     free (lw_mask); lw_mask = NULL;
 
-    /* Done with the DEM array */
-    for (i = 0; i < DEM_NBLAT; i++)
-        free (dem[i]);
-    free (dem);  dem = NULL;
-
-    /* Refine the cloud mask */
-    /* Compute the average temperature of the clear, non-water, non-filled
-       pixels */
-    printf ("Refining the cloud mask ...\n");
-    nbval = 0;
-    nbclear = 0;
-    mclear = 0.0;
-    mall = 0.0;
-    for (i = 0; i < nlines*nsamps; i++)
-    {
-        /* If this pixel is fill, then don't process */
-        if (qaband[i] != 1)
-        {
-            /* Keep track of the number of total (non-fill) pixels in addition
-               to the sum of the unscaled thermal values */
-            nbval++;
-            mall += sband[SR_BAND10][i] * SCALE_FACTOR_TH;
-
-            /* Check for clear pixels */
-            if ((!btest (cloud[i], CIR_QA)) && (sband[SR_BAND5][i] > 300))
-            {
-                /* Check to see if this is a clear pixel */
-                anom = sband[SR_BAND2][i] - sband[SR_BAND4][i] * 0.5;
-                if (anom < 300)
-                {
-                    /* Keep track of the number of clear pixels in addition to
-                       the sum of the unscaled thermal values */
-                    nbclear++;
-                    mclear += sband[SR_BAND10][i] * SCALE_FACTOR_TH;
-                }
-            }
-        }
-    }  /* end for i */
-
     /* Compute the average/mean temperature of the clear pixels, otherwise set
        to 275 Kelvin */
     if (nbclear > 0)
@@ -1039,413 +2091,529 @@ int compute_sr_refl
         nbclear * 100.0 / (nlines * nsamps));
     printf ("Average temperature %f Kelvin %ld total pixels\n", mall, nbval);
 
-    /* Determine the cloud mask */
-    for (i = 0; i < nlines*nsamps; i++)
+    /* Refine the cloud mask, set the adjacent cloud bit, and compute and
+       expand the cloud shadows in one pass down the scene.  The lines are
+       kept in a window which holds the lines the cloud shadows of the
+       current line may fall on, plus the lines of the dilations.  The
+       cloud shadow of a pixel is cast at most shadow_nlines lines away,
+       as the clouds are no colder than the coldest pixel that may be
+       cloud. */
+    facl = cosf(xfs * DEG2RAD) * tanf(xts * DEG2RAD) / pixsize;  /* lines */
+    fack = sinf(xfs * DEG2RAD) * tanf(xts * DEG2RAD) / pixsize;  /* samps */
+    shadow_nlines = 0;
+    if (ncloud > 0)
     {
-        if (tresi[i] < 0.0)
-        {
-            if (((sband[SR_BAND2][i] - sband[SR_BAND4][i] * 0.5) > 500) &&
-                ((sband[SR_BAND10][i] * SCALE_FACTOR_TH) < (mclear - 2.0)))
-            {  /* Snow or cloud for now */
-                cloud[i] += 2;
-            }
-        }
+        cldh = (mclear - tcloud_min) * 1000.0 / cfac;
+        if (cldh < 0.0)
+            cldh = 0.0;
+        shadow_nlines = (int) ceil (fabs (facl) * (cldh + 1000.0)) + 2;
     }
-
-    /* Set up the adjacent to something bad (snow or cloud) bit */
-    printf ("Setting up the adjacent to something bit ...\n");
-    for (i = 0; i < nlines; i++)
+    shadow_ahead = (facl >= 0.0) ? shadow_nlines : 0;
+
+    nstripe = stripe_lines (nlines, budget, fixed + (size_t) nsamps *
+        ((shadow_nlines + 6) * RING_PIX_BYTES + 11 + 13 +
+        2 * (1 + sizeof (int))), (size_t) nsamps *
+        (TOA_PIX_BYTES (NCLD_BANDS) + RING_PIX_BYTES), "cloud mask");
+    nring = shadow_nlines + 6 + nstripe;
+    printf ("Refining the cloud mask and determining cloud shadow in "
+        "stripes of %d lines, with a window of %d lines ...\n", nstripe,
+        nring);
+    if (alloc_toa_stripe (nstripe, nsamps, NCLD_BANDS, cld_bands, &qaband,
+        sband) != SUCCESS ||
+        (rcloud = alloc_stripe (nring, nsamps, sizeof (uint8),
+            "the cloud window")) == NULL ||
+        (rtresi = alloc_stripe (nring, nsamps, sizeof (float),
+            "the cloud window")) == NULL ||
+        (rtaero = alloc_stripe (nring, nsamps, sizeof (float),
+            "the cloud window")) == NULL ||
+        (rb6 = alloc_stripe (nring, nsamps, sizeof (int16),
+            "the cloud window")) == NULL ||
+        (rb10 = alloc_stripe (nring, nsamps, sizeof (int16),
+            "the cloud window")) == NULL)
     {
-        curr_pix = i * nsamps;
-        for (j = 0; j < nsamps; j++, curr_pix++)
-        {
-            if (btest (cloud[curr_pix], CLD_QA) ||
-                btest (cloud[curr_pix], CIR_QA))
-            {
-                /* Check the 5x5 window around the current pixel */
-                for (k = i-5; k <= i+5; k++)
-                {
-                    /* Make sure the line is valid */
-                    if (k < 0 || k >= nlines)
-                        continue;
+        sprintf (errmsg, "Error allocating memory for the cloud window.");
+        error_handler (false, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
 
-                    win_pix = k * nsamps + j-5;
-                    for (l = j-5; l <= j+5; l++, win_pix++)
-                    {
-                        /* Make sure the sample is valid */
-                        if (l < 0 || l >= nsamps)
-                            continue;
+    /* The cloud and cirrus pixels are dilated by 5 pixels (11x11 window)
+       for the adjacent cloud bit, the cloud shadow pixels by 6 pixels
+       (13x13 window) for the expansion */
+    if (allocate_dilate (&dil_adj, nsamps, 5, 5, 5, 5) != 0 ||
+        allocate_dilate (&dil_shd, nsamps, 6, 6, 6, 6) != 0)
+    {
+        sprintf (errmsg, "Allocating the dilation buffers.");
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
 
-                        if (!btest (cloud[win_pix], CLD_QA) &&
-                            !btest (cloud[win_pix], CIR_QA) &&
-                            !btest (cloud[win_pix], CLDA_QA))
-                        {  /* Set the adjacent cloud bit */
-                            cloud[win_pix] += 4;
-                        }
-                    }  /* for l */
-                }  /* for k */
-            }  /* if btest */
-        }  /* for j */
-    }  /* for i */
-
-    /* Compute the cloud shadow */
-    printf ("Determining cloud shadow ...\n");
-    facl = cosf(xfs * DEG2RAD) * tanf(xts * DEG2RAD) / pixsize;  /* lines */
-    fack = sinf(xfs * DEG2RAD) * tanf(xts * DEG2RAD) / pixsize;  /* samps */
-    for (i = 0; i < nlines; i++)
+    line1 = 0;
+    for (pass_line = 0; pass_line < nlines + shadow_nlines + dil_shd.up;
+         pass_line++)
     {
-        curr_pix = i * nsamps;
-        for (j = 0; j < nsamps; j++, curr_pix++)
+        /* Read the next stripe into the window once its first line is
+           needed */
+        if (pass_line == line1 && line1 < nlines)
         {
-            if (btest (cloud[curr_pix], CLD_QA) ||
-                btest (cloud[curr_pix], CIR_QA))
+            line0 = line1;
+            line1 = (line0 + nstripe < nlines) ? line0 + nstripe : nlines;
+            npix = (line1 - line0) * nsamps;
+            if (read_toa_stripe (input, xml_metadata->global.instrument,
+                line0, line1 - line0, nsamps, xmus, qaband, sband) != SUCCESS)
+            {
+                sprintf (errmsg, "Calibrating lines %d to %d", line0,
+                    line1 - 1);
+                error_handler (true, FUNC_NAME, errmsg);
+                return (ERROR);
+            }
+            for (ib = 0; ib <= SR_BAND7; ib++)
+            {
+                if (sband[ib] != NULL)
+                    climatology_refl (npix, qaband, btgo[ib], broatm[ib],
+                        bttatmg[ib], bsatm[ib], sband[ib]);
+            }
+
+            for (i = line0; i < line1; i++)
             {
-                tcloud = sband[SR_BAND10][curr_pix] * SCALE_FACTOR_TH;
-                cldh = (mclear - tcloud) * 1000.0 / cfac;
-                if (cldh < 0.0)
-                    cldh = 0.0;
-                cldhmin = cldh - 1000.0;
-                cldhmax = cldh + 1000.0;
-                mband5 = 9999;
-                mband5k = -9999;
-                mband5l = -9999;
-                if (cldhmin < 0)
-                    cldhmin = 0.0;
-                for (icldh = cldhmin * 0.1; icldh <= cldhmax * 0.1; icldh++)
+                ring_pix = (i % nring) * nsamps;
+                if (scratch_lines (cloud_fp, false, i, 1, nsamps,
+                    sizeof (uint8), &rcloud[ring_pix]) != SUCCESS ||
+                    scratch_lines (tresi_fp, false, i, 1, nsamps,
+                    sizeof (float), &rtresi[ring_pix]) != SUCCESS ||
+                    scratch_lines (taero_fp, false, i, 1, nsamps,
+                    sizeof (float), &rtaero[ring_pix]) != SUCCESS)
+                {
+                    sprintf (errmsg, "Reading the aerosol inversion of line "
+                        "%d", i);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    return (ERROR);
+                }
+
+                /* Determine the cloud mask, and keep band 6 of the pixels
+                   that may be cloud shadow and band 10 of the clouds */
+                stripe_pix = (i - line0) * nsamps;
+                for (j = 0; j < nsamps; j++, ring_pix++, stripe_pix++)
                 {
-                    cldh = icldh * 10.0;
-                    k = i + facl * cldh;  /* lines */
-                    l = j - fack * cldh;  /* samps */
-                    /* Make sure the line and sample is valid */
-                    if (k < 0 || k >= nlines || l < 0 || l >= nsamps)
-                        continue;
-
-                    win_pix = k * nsamps + l;
-                    if ((sband[SR_BAND6][win_pix] < 800) &&
-                        ((sband[SR_BAND3][win_pix] -
-                          sband[SR_BAND4][win_pix]) < 100))
+                    if (rtresi[ring_pix] < 0.0)
                     {
-                        if (btest (cloud[win_pix], CLD_QA) ||
-                            btest (cloud[win_pix], CIR_QA) ||
-                            btest (cloud[win_pix], CLDS_QA))
-                        {
-                            continue;
-                        }
-                        else
-                        { /* store the value of band6 as well as the
-                             l and k value */
-                            if (sband[SR_BAND6][win_pix] < mband5)
-                            {
-                                 mband5 = sband[SR_BAND6][win_pix];
-                                 mband5k = k;
-                                 mband5l = l;
-                            }
+                        if (((sband[SR_BAND2][stripe_pix] -
+                              sband[SR_BAND4][stripe_pix] * 0.5) > 500) &&
+                            ((sband[SR_BAND10][stripe_pix] * SCALE_FACTOR_TH)
+                             < (mclear - 2.0)))
+                        {  /* Snow or cloud for now */
+                            rcloud[ring_pix] += 2;
                         }
                     }
-                }  /* for icldh */
 
-                /* Set the cloud shadow bit */
-                if (mband5 < 9999)
-                    cloud[mband5k*nsamps + mband5l] += 8;
-            }  /* end if btest */
-        }  /* end for j */
-    }  /* end for i */
+                    if ((sband[SR_BAND6][stripe_pix] < 800) &&
+                        ((sband[SR_BAND3][stripe_pix] -
+                          sband[SR_BAND4][stripe_pix]) < 100))
+                        rb6[ring_pix] = sband[SR_BAND6][stripe_pix];
+                    else
+                        rb6[ring_pix] = 9999;
+                    rb10[ring_pix] = sband[SR_BAND10][stripe_pix];
+                }  /* end for j */
+            }  /* end for i */
+        }
 
-    /* Expand the cloud shadow using the residual */
-    printf ("Expanding cloud shadow ...\n");
-#ifdef _OPENMP
-    #pragma omp parallel for private (i, j, curr_pix, k, l, win_pix)
-#endif
-    for (i = 0; i < nlines; i++)
-    {
-        curr_pix = i * nsamps;
-        for (j = 0; j < nsamps; j++, curr_pix++)
+        /* Set up the adjacent to something bad (snow or cloud) bit.  Push
+           the next line; this completes line i. */
+        if (pass_line < nlines + dil_adj.up)
         {
-            /* If this is a cloud shadow pixel */
-            if (btest (cloud[curr_pix], CLDS_QA))
+            dmask = dilate_push (&dil_adj, pass_line < nlines ?
+                &rcloud[(pass_line % nring) * nsamps] : NULL,
+                (1 << CLD_QA) | (1 << CIR_QA));
+            i = pass_line - dil_adj.up;
+            if (i >= 0)
             {
-                /* Check the 6x6 window around the current pixel */
-                for (k = i-6; k <= i+6; k++)
+                ring_pix = (i % nring) * nsamps;
+                for (j = 0; j < nsamps; j++, ring_pix++)
                 {
-                    /* Make sure the line is valid */
-                    if (k < 0 || k >= nlines)
-                        continue;
+                    if (dmask[j] &&
+                        !btest (rcloud[ring_pix], CLD_QA) &&
+                        !btest (rcloud[ring_pix], CIR_QA) &&
+                        !btest (rcloud[ring_pix], CLDA_QA))
+                    {  /* Set the adjacent cloud bit */
+                        rcloud[ring_pix] += 4;
+                    }
+                }  /* for j */
+            }
+        }
 
-                    win_pix = k * nsamps + j-6;
-                    for (l = j-6; l <= j+6; l++, win_pix++)
+        /* Compute the cloud shadow of line i, once the lines its shadows
+           may fall on are in the window */
+        i = pass_line - shadow_ahead;
+        if (i >= 0 && i < nlines)
+        {
+            ring_pix = (i % nring) * nsamps;
+            for (j = 0; j < nsamps; j++, ring_pix++)
+            {
+                if (btest (rcloud[ring_pix], CLD_QA) ||
+                    btest (rcloud[ring_pix], CIR_QA))
+                {
+                    tcloud = rb10[ring_pix] * SCALE_FACTOR_TH;
+                    cldh = (mclear - tcloud) * 1000.0 / cfac;
+                    if (cldh < 0.0)
+                        cldh = 0.0;
+                    cldhmin = cldh - 1000.0;
+                    cldhmax = cldh + 1000.0;
+                    mband5 = 9999;
+                    mband5k = -9999;
+                    mband5l = -9999;
+                    if (cldhmin < 0)
+                        cldhmin = 0.0;
+                    for (icldh = cldhmin * 0.1; icldh <= cldhmax * 0.1;
+                         icldh++)
                     {
-                        /* Make sure the sample is valid */
-                        if (l < 0 || l >= nsamps)
+                        cldh = icldh * 10.0;
+                        k = i + facl * cldh;  /* lines */
+                        l = j - fack * cldh;  /* samps */
+                        /* Make sure the line and sample is valid */
+                        if (k < 0 || k >= nlines || l < 0 || l >= nsamps)
                             continue;
 
-                        if (btest (cloud[win_pix], CLD_QA) ||
-                            btest (cloud[win_pix], CLDS_QA))
-                            continue;
-                        else
+                        win_pix = (k % nring) * nsamps + l;
+                        if (rb6[win_pix] < 800)
                         {
-                            if (btest (cloud[win_pix], CLDT_QA))
+                            if (btest (rcloud[win_pix], CLD_QA) ||
+                                btest (rcloud[win_pix], CIR_QA) ||
+                                btest (rcloud[win_pix], CLDS_QA))
+                            {
                                 continue;
+                            }
                             else
-                            {
-                                /* Set the temporary bit */
-                                if (tresi[win_pix] < 0)
-                                    cloud[win_pix] += 16;
+                            { /* store the value of band6 as well as the
+                                 l and k value */
+                                if (rb6[win_pix] < mband5)
+                                {
+                                     mband5 = rb6[win_pix];
+                                     mband5k = k;
+                                     mband5l = l;
+                                }
                             }
                         }
-                    }  /* end for l */
-                }  /* end for k */
-            }  /* end if btest */
-        }  /* end for j */
-    }  /* end for i */
+                    }  /* for icldh */
 
-    /* Update the cloud shadow */
-    printf ("Updating cloud shadow ...\n");
-    for (i = 0; i < nlines*nsamps; i++)
-    {
-        /* If the temporary bit was set in the above loop */
-        if (btest (cloud[i], CLDT_QA))
+                    /* Set the cloud shadow bit */
+                    if (mband5 < 9999)
+                        rcloud[(mband5k % nring) * nsamps + mband5l] += 8;
+                }  /* end if btest */
+            }  /* end for j */
+        }
+
+        /* Expand the cloud shadow using the residual, once no more cloud
+           shadow can be cast on the line pushed.  Each line is only changed
+           once its source lines have been pushed, so the expansion doesn't
+           feed on itself.  This completes line i. */
+        shd_line = pass_line - shadow_nlines;
+        if (shd_line < 0)
+            continue;
+        dmask = dilate_push (&dil_shd, shd_line < nlines ?
+            &rcloud[(shd_line % nring) * nsamps] : NULL, 1 << CLDS_QA);
+        i = shd_line - dil_shd.up;
+        if (i < 0)
+            continue;
+
+        ring_pix = (i % nring) * nsamps;
+        for (j = 0; j < nsamps; j++, ring_pix++)
         {
-            /* Remove the temporary bit and set the cloud shadow bit */
+            /* Set the temporary bit of the pixels near a cloud shadow that
+               aren't cloud or cloud shadow */
+            if (dmask[j] &&
+                !btest (rcloud[ring_pix], CLD_QA) &&
+                !btest (rcloud[ring_pix], CLDS_QA) &&
+                !btest (rcloud[ring_pix], CLDT_QA) &&
+                rtresi[ring_pix] < 0)
+                rcloud[ring_pix] += 16;
+
+            /* Update the cloud shadow: if the temporary bit was set,
+               remove it and set the cloud shadow bit */
             /* ==> cloud[i] += 8; cloud[i] -= 16; */
-            cloud[i] -= 8;
+            if (btest (rcloud[ring_pix], CLDT_QA))
+                rcloud[ring_pix] -= 8;
+        }  /* end for j */
+
+        /* The cloud mask of the line is final: add its clear pixels to the
+           aerosol grid and keep it */
+        ring_pix = (i % nring) * nsamps;
+        add_aot_line (&aot_grid, i, nsamps, &rcloud[ring_pix],
+            &rtresi[ring_pix], &rtaero[ring_pix]);
+        if (scratch_lines (cloud_fp, true, i, 1, nsamps, sizeof (uint8),
+            &rcloud[ring_pix]) != SUCCESS)
+        {
+            sprintf (errmsg, "Saving the cloud mask of line %d", i);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
         }
-    }  /* end for i */
-
-/* GAIL -- This is the potential problem area with the blockiness; consider
-   printing tresi to see where the residual is negative. */
-/*printf ("WRITING intermediate cloud mask\n");
-FILE *tmpfile = NULL;
-tmpfile = fopen ("gail_cloud.img", "w");
-if (fwrite (cloud, sizeof (uint8), nlines*nsamps, tmpfile) != nlines*nsamps)
-    printf ("ERROR: GAIL can't write the cloud array!!!!\n");
-fclose (tmpfile);
-
-printf ("WRITING tresi\n");
-tmpfile = fopen ("gail_tresi.img", "w");
-if (fwrite (tresi, sizeof (float), nlines*nsamps, tmpfile) != nlines*nsamps)
-    printf ("ERROR: GAIL can't write the cloud array!!!!\n");
-fclose (tmpfile);
-*/
+    }  /* end for pass_line */
+
+    /* Done with the cloud window */
+    free_dilate (&dil_adj);
+    free_dilate (&dil_shd);
+    free_toa_stripe (&qaband, sband);
+    free (rcloud);  rcloud = NULL;
+    free (rtresi);  rtresi = NULL;
+    free (rtaero);  rtaero = NULL;
+    free (rb6);     rb6 = NULL;
+    free (rb10);    rb10 = NULL;
 
     /* Aerosol interpolation. Does not use water, cloud, or cirrus pixels. */
     printf ("Performing aerosol interpolation ...\n");
-    hole = true;
-    step = 10;
-    while (hole && (step < 1000))
+    interpolate_aot_grid (&aot_grid, nlines, nsamps);
+
+    /* Perform the second level of atmospheric correction for the aerosols.
+       This is not applied to water, cirrus, or cloud pixels. */
+    nstripe = stripe_lines (nlines, budget, fixed, (size_t) nsamps *
+        (TOA_PIX_BYTES (NCOR_BANDS) + sizeof (uint8) + 5 * sizeof (float)),
+        "atmospheric correction");
+    printf ("Performing atmospheric correction in stripes of %d lines ...\n",
+        nstripe);
+    if (alloc_toa_stripe (nstripe, nsamps, NCOR_BANDS, cor_bands, &qaband,
+        sband) != SUCCESS ||
+        (cloud = alloc_stripe (nstripe, nsamps, sizeof (uint8),
+            "cloud")) == NULL ||
+        (tresi = alloc_stripe (nstripe, nsamps, sizeof (float),
+            "tresi")) == NULL ||
+        (taero = alloc_stripe (nstripe, nsamps, sizeof (float),
+            "taero")) == NULL ||
+        (twvi = alloc_stripe (nstripe, nsamps, sizeof (float),
+            "twvi")) == NULL ||
+        (tozi = alloc_stripe (nstripe, nsamps, sizeof (float),
+            "tozi")) == NULL ||
+        (tp = alloc_stripe (nstripe, nsamps, sizeof (float), "tp")) == NULL)
     {
-        hole = false;
-        for (i = 0; i < nlines; i += step)
+        sprintf (errmsg, "Error allocating memory for the stripes of the "
+            "atmospheric correction.");
+        error_handler (false, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
+
+    /* Open the output file */
+    sr_output = open_output (xml_metadata, input, false /*surf refl*/);
+    if (sr_output == NULL)
+    {   /* error message already printed */
+        error_handler (true, FUNC_NAME, errmsg);
+        exit (ERROR);
+    }
+
+    for (line0 = 0; line0 < nlines; line0 += nstripe)
+    {
+        line1 = (line0 + nstripe < nlines) ? line0 + nstripe : nlines;
+        npix = (line1 - line0) * nsamps;
+
+        /* Calibrate the bands of the stripe, and read its cloud mask,
+           residuals and aerosols */
+        if (read_toa_stripe (input, xml_metadata->global.instrument, line0,
+            line1 - line0, nsamps, xmus, qaband, sband) != SUCCESS)
         {
-            for (j = 0; j < nsamps; j += step)
+            sprintf (errmsg, "Calibrating lines %d to %d", line0, line1 - 1);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+        for (ib = 0; ib <= SR_BAND7; ib++)
+            climatology_refl (npix, qaband, btgo[ib], broatm[ib],
+                bttatmg[ib], bsatm[ib], sband[ib]);
+
+        if (scratch_lines (cloud_fp, false, line0, line1 - line0, nsamps,
+            sizeof (uint8), cloud) != SUCCESS ||
+            scratch_lines (tresi_fp, false, line0, line1 - line0, nsamps,
+            sizeof (float), tresi) != SUCCESS ||
+            scratch_lines (taero_fp, false, line0, line1 - line0, nsamps,
+            sizeof (float), taero) != SUCCESS)
+        {
+            sprintf (errmsg, "Reading the cloud mask of lines %d to %d",
+                line0, line1 - 1);
+            error_handler (true, FUNC_NAME, errmsg);
+            return (ERROR);
+        }
+
+        /* Fill the aerosols of the pixels whose inversion failed from the
+           aerosol grid, and interpolate the auxiliary data of the pixels
+           that get corrected */
+#ifdef _OPENMP
+        #pragma omp parallel for private (i, j, stripe_pix, tile, lcmg, scmg)
+#endif
+        for (i = line0; i < line1; i++)
+        {
+            stripe_pix = (i - line0) * nsamps;
+            for (j = 0; j < nsamps; j++, stripe_pix++)
             {
-                nbaot = 0;
-                aaot = 0.0;
-                sresi = 0.0;
+                if (qaband[stripe_pix] == 1)
+                    continue;
 
-                /* Check the step x step window around the current pixel */
-                for (k = i - step*0.5; k <= i + step*0.5; k++)
+                if ((tresi[stripe_pix] < 0) &&
+                    (!btest (cloud[stripe_pix], CIR_QA)) &&
+                    (!btest (cloud[stripe_pix], CLD_QA)) &&
+                    (!btest (cloud[stripe_pix], WAT_QA)))
                 {
-                    /* Make sure the line is valid */
-                    if (k < 0 || k >= nlines)
-                        continue;
-
-                    win_pix = k * nsamps + j - step*0.5;
-                    for (l = j - step*0.5; l <= j + step*0.5; l++, win_pix++)
+                    tile = (i / AOT_TILE) * aot_grid.nsamps + j / AOT_TILE;
+                    if (aot_grid.filled[tile])
                     {
-                        /* Make sure the sample is valid */
-                        if (l < 0 || l >= nsamps)
-                            continue;
-
-                        /* Check for clear pixels with positive residuals */
-                        if ((tresi[win_pix] > 0) && (cloud[win_pix] == 0))
-                        {
-                            nbaot++;
-                            aaot += taero[win_pix] / tresi[win_pix];
-                            sresi += 1.0 / tresi[win_pix];
-                        }
+                        taero[stripe_pix] = aot_grid.aot[tile];
+                        tresi[stripe_pix] = 1.0;
                     }
                 }
 
-                /* If pixels were found */
-                if (nbaot != 0)
+                if (tresi[stripe_pix] > 0.0 &&
+                    !btest (cloud[stripe_pix], CIR_QA) &&
+                    !btest (cloud[stripe_pix], CLD_QA))
                 {
-                    aaot /= sresi;
-
-                    /* Check the step x step window around the current pixel */
-                    for (k = i - step*0.5; k <= i + step*0.5; k++)
+                    if (interpolate_aux (space, &cmg_win, wv, oz, dem, i, j,
+                        &lcmg, &scmg, &twvi[stripe_pix], &tozi[stripe_pix],
+                        &tp[stripe_pix]) != SUCCESS)
                     {
-                        /* Make sure the line is valid */
-                        if (k < 0 || k >= nlines)
-                            continue;
-
-                        win_pix = k * nsamps + j - step*0.5;
-                        for (l = j - step*0.5; l <= j + step*0.5;
-                             l++, win_pix++)
-                        {
-                            /* Make sure the sample is valid */
-                            if (l < 0 || l >= nsamps)
-                                continue;
-
-                            if ((tresi[win_pix] < 0) &&
-                                (!btest (cloud[win_pix], CIR_QA)) &&
-                                (!btest (cloud[win_pix], CLD_QA)) &&
-                                (!btest (cloud[win_pix], WAT_QA)))
-                            {
-                                taero[win_pix] = aaot;
-                                tresi[win_pix] = 1.0;
-                            }
-                        }  /* for l */
-                    }  /* for k */
-                }
-                else
-                {  /* this is a hole */
-                    hole = true;
+                        sprintf (errmsg, "Interpolating the auxiliary "
+                            "data");
+                        error_handler (true, FUNC_NAME, errmsg);
+                        exit (ERROR);
+                    }
                 }
             }  /* end for j */
         }  /* end for i */
 
-        /* Modify the step value */
-        step *= 2;
-    }  /* end while */
-
-    /* Perform the second level of atmospheric correction for the aerosols.
-       This is not applied to water, cirrus, or cloud pixels. */
-    printf ("Performing atmospheric correction ...\n");
-    /* 0 .. DN_BAND7 is the same as 0 .. SR_BAND7 here, since the pan band
-       isn't spanned */
-    for (ib = 0; ib <= DN_BAND7; ib++)
-    {
-        printf ("  Band %d\n", ib+1);
+        /* 0 .. DN_BAND7 is the same as 0 .. SR_BAND7 here, since the pan
+           band isn't spanned */
+        for (ib = 0; ib <= DN_BAND7; ib++)
+        {
 #ifdef _OPENMP
-        #pragma omp parallel for private (i, rsurf, rotoa, raot550nm, pres, uwv, uoz, retval, roslamb, tgo, roatm, ttatmg, satm, xrorayp, next)
+            #pragma omp parallel for private (i, rsurf, rotoa, raot550nm, pres, uwv, uoz, retval, roslamb, tgo, roatm, ttatmg, satm, xrorayp, next)
 #endif
-        for (i = 0; i < nlines * nsamps; i++)
-        {
-            /* If this pixel is fill, then don't process. Otherwise the
-               fill pixels have already been marked in the TOA process. */
-            if (qaband[i] != 1)
+            for (i = 0; i < npix; i++)
             {
-                /* If not water or some other high aerosol pixel (tresi > 0)
-                   and this isn't a cirrus or cloud pixel */
-                if (tresi[i] > 0.0 &&
-                    !btest (cloud[i], CIR_QA) &&
-                    !btest (cloud[i], CLD_QA))
+                /* If this pixel is fill, then don't process. Otherwise the
+                   fill pixels have already been marked in the TOA process. */
+                if (qaband[i] != 1)
                 {
-                    rsurf = sband[ib][i] * SCALE_FACTOR;
-                    rotoa = (rsurf * bttatmg[ib] / (1.0 - bsatm[ib] * rsurf)
-                        + broatm[ib]) * btgo[ib];
-                    raot550nm = taero[i];
-                    pres = tp[i];
-                    uwv = twvi[i];
-                    uoz = tozi[i];
-                    retval = atmcorlamb2 (xts, xtv, xmus, xmuv, xfi, cosxfi,
-                        raot550nm, ib, pres, tpres, aot550nm, rolutt,
-                        transt, xtsstep, xtsmin, xtvstep, xtvmin, sphalbt,
-                        normext, tsmax, tsmin, nbfic, nbfi, tts, indts,
-                        ttv, uoz, uwv, tauray, ogtransa1, ogtransb0,
-                        ogtransb1, wvtransa, wvtransb, oztransa, rotoa,
-                        &roslamb, &tgo, &roatm, &ttatmg, &satm, &xrorayp,
-                        &next);
-                    if (retval != SUCCESS)
+                    /* If not water or some other high aerosol pixel
+                       (tresi > 0) and this isn't a cirrus or cloud pixel */
+                    if (tresi[i] > 0.0 &&
+                        !btest (cloud[i], CIR_QA) &&
+                        !btest (cloud[i], CLD_QA))
                     {
-                        sprintf (errmsg, "Performing lambertian "
-                            "atmospheric correction type 2.");
-                        error_handler (true, FUNC_NAME, errmsg);
-                        exit (ERROR);
-                    }
+                        rsurf = sband[ib][i] * SCALE_FACTOR;
+                        rotoa = (rsurf * bttatmg[ib] /
+                            (1.0 - bsatm[ib] * rsurf) + broatm[ib]) * btgo[ib];
+                        raot550nm = taero[i];
+                        pres = tp[i];
+                        uwv = twvi[i];
+                        uoz = tozi[i];
+                        retval = atmcorlamb2 (xts, xtv, xmus, xmuv, xfi,
+                            cosxfi, raot550nm, ib, pres, lut, slut, uoz, uwv,
+                            rotoa, &roslamb, &tgo, &roatm, &ttatmg, &satm,
+                            &xrorayp, &next);
+                        if (retval != SUCCESS)
+                        {
+                            sprintf (errmsg, "Performing lambertian "
+                                "atmospheric correction type 2.");
+                            error_handler (true, FUNC_NAME, errmsg);
+                            exit (ERROR);
+                        }
 
-                    /* If this is the coastal aerosol band then set the
-                       aerosol bits in the QA band */
-                    if (ib == DN_BAND1)
-                    {
-                        /* Recompute based on predefined taero value */
-                        if (roslamb < -0.005)
+                        /* If this is the coastal aerosol band then set the
+                           aerosol bits in the QA band */
+                        if (ib == DN_BAND1)
                         {
-                            taero[i] = 0.05;
-                            raot550nm = 0.05;
-                            retval = atmcorlamb2 (xts, xtv, xmus, xmuv,
-                                xfi, cosxfi, raot550nm, ib, pres, tpres,
-                                aot550nm, rolutt, transt, xtsstep, xtsmin,
-                                xtvstep, xtvmin, sphalbt, normext, tsmax,
-                                tsmin, nbfic, nbfi, tts, indts, ttv, uoz,
-                                uwv, tauray, ogtransa1, ogtransb0,
-                                ogtransb1, wvtransa, wvtransb, oztransa,
-                                rotoa, &roslamb, &tgo, &roatm, &ttatmg,
-                                &satm, &xrorayp, &next);
-                            if (retval != SUCCESS)
+                            /* Recompute based on predefined taero value */
+                            if (roslamb < -0.005)
                             {
-                                sprintf (errmsg, "Performing lambertian "
-                                    "atmospheric correction type 2.");
-                                error_handler (true, FUNC_NAME, errmsg);
-                                exit (ERROR);
-                            }
-                        }
-                        else
-                        {  /* Set up aerosol QA bits */
-                            if (fabs (rsurf - roslamb) <= 0.015)
-                            {  /* Set the first aerosol bit (low aerosols) */
-                                cloud[i] += 16;
+                                taero[i] = 0.05;
+                                raot550nm = 0.05;
+                                retval = atmcorlamb2 (xts, xtv, xmus, xmuv,
+                                    xfi, cosxfi, raot550nm, ib, pres, lut,
+                                    slut, uoz, uwv, rotoa, &roslamb, &tgo,
+                                    &roatm, &ttatmg, &satm, &xrorayp, &next);
+                                if (retval != SUCCESS)
+                                {
+                                    sprintf (errmsg, "Performing lambertian "
+                                        "atmospheric correction type 2.");
+                                    error_handler (true, FUNC_NAME, errmsg);
+                                    exit (ERROR);
+                                }
                             }
                             else
-                            {
-                                if (fabs (rsurf - roslamb) < 0.03)
-                                {  /* Set the second aerosol bit (average
+                            {  /* Set up aerosol QA bits */
+                                if (fabs (rsurf - roslamb) <= 0.015)
+                                {  /* Set the first aerosol bit (low
                                       aerosols) */
-                                    cloud[i] += 32;
+                                    cloud[i] += 16;
                                 }
                                 else
-                                {  /* Set both aerosol bits (high aerosols) */
-                                    cloud[i] += 48;
+                                {
+                                    if (fabs (rsurf - roslamb) < 0.03)
+                                    {  /* Set the second aerosol bit (average
+                                          aerosols) */
+                                        cloud[i] += 32;
+                                    }
+                                    else
+                                    {  /* Set both aerosol bits (high
+                                          aerosols) */
+                                        cloud[i] += 48;
+                                    }
                                 }
-                            }
-                        }  /* end if/else roslamb */
-                    }  /* end if ib */
-
-                    /* Save the scaled surface reflectance value, but make
-                       sure it falls within the defined valid range. */
-                    roslamb = roslamb * MULT_FACTOR;  /* scale the value */
-                    if (roslamb < MIN_VALID)
-                        sband[ib][i] = MIN_VALID;
-                    else if (roslamb > MAX_VALID)
-                        sband[ib][i] = MAX_VALID;
-                    else
-                        sband[ib][i] = (int) (round (roslamb));
-                }  /* end if */
-            }  /* end if qaband */
-        }  /* end for i */
-    }  /* end for ib */
+                            }  /* end if/else roslamb */
+                        }  /* end if ib */
+
+                        /* Save the scaled surface reflectance value, but make
+                           sure it falls within the defined valid range. */
+                        roslamb = roslamb * MULT_FACTOR;  /* scale the value */
+                        if (roslamb < MIN_VALID)
+                            sband[ib][i] = MIN_VALID;
+                        else if (roslamb > MAX_VALID)
+                            sband[ib][i] = MAX_VALID;
+                        else
+                            sband[ib][i] = (int) (round (roslamb));
+                    }  /* end if */
+                }  /* end if qaband */
+            }  /* end for i */
+        }  /* end for ib */
+
+        /* Write the surface reflectance and the cloud mask of the stripe */
+        for (ib = 0; ib <= DN_BAND7; ib++)
+        {
+            if (put_output_lines (sr_output, sband[ib], ib, line0,
+                line1 - line0, sizeof (int16)) != SUCCESS)
+            {
+                sprintf (errmsg, "Writing output data for band %d", ib);
+                error_handler (true, FUNC_NAME, errmsg);
+                exit (ERROR);
+            }
+        }
+        if (put_output_lines (sr_output, cloud, SR_CLOUD, line0,
+            line1 - line0, sizeof (uint8)) != SUCCESS)
+        {
+            sprintf (errmsg, "Writing cloud mask output data");
+            error_handler (true, FUNC_NAME, errmsg);
+            exit (ERROR);
+        }
+    }  /* end for line0 */
 
     /* Free memory for band data */
+    free_toa_stripe (&qaband, sband);
+    free (cloud);
     free (twvi);
     free (tozi);
     free (tp);
     free (tresi);
     free (taero);
- 
-    /* Write the data to the output file */
+    free_aot_grid (&aot_grid);
+    fclose (cloud_fp);
+    fclose (tresi_fp);
+    fclose (taero_fp);
+
+    /* Done with the DEM array */
+    for (i = 0; i < cmg_win.nlines; i++)
+        free (dem[i]);
+    free (dem);  dem = NULL;
+
+    /* Write the headers of the output files */
     printf ("Writing surface reflectance corrected data to the output "
         "files ...\n");
 
-    /* Open the output file */
-    sr_output = open_output (xml_metadata, input, false /*surf refl*/);
-    if (sr_output == NULL)
-    {   /* error message already printed */
-        error_handler (true, FUNC_NAME, errmsg);
-        exit (ERROR);
-    }
-
-    /* Loop through the reflectance bands and write the data */
+    /* Loop through the reflectance bands */
     for (ib = 0; ib <= DN_BAND7; ib++)
     {
         printf ("  Band %d: %s\n", ib+1,
             sr_output->metadata.band[ib].file_name);
-        if (put_output_lines (sr_output, sband[ib], ib, 0, nlines,
-            sizeof (int16)) != SUCCESS)
-        {
-            sprintf (errmsg, "Writing output data for band %d", ib);
-            error_handler (true, FUNC_NAME, errmsg);
-            exit (ERROR);
-        }
 
         /* Create the ENVI header file this band */
         if (create_envi_struct (&sr_output->metadata.band[ib],
@@ -1478,19 +2646,9 @@ fclose (tmpfile);
         exit (ERROR);
     }
 
-    /* Write the cloud mask band */
+    /* The cloud mask band */
     printf ("  Band %d: %s\n", SR_CLOUD+1,
             sr_output->metadata.band[SR_CLOUD].file_name);
-    if (put_output_lines (sr_output, cloud, SR_CLOUD, 0, nlines,
-        sizeof (uint8)) != SUCCESS)
-    {
-        sprintf (errmsg, "Writing cloud mask output data");
-        error_handler (true, FUNC_NAME, errmsg);
-        exit (ERROR);
-    }
-
-    /* Free memory for cloud data */
-    free (cloud);
 
     /* Create the ENVI header for the cloud mask band */
     if (create_envi_struct (&sr_output->metadata.band[SR_CLOUD],
@@ -1529,7 +2687,7 @@ fclose (tmpfile);
     free (space);
 
     /* Done with the ratiob* arrays */
-    for (i = 0; i < RATIO_NBLAT; i++)
+    for (i = 0; i < cmg_win.nlines; i++)
     {
         free (andwi[i]);
         free (sndwi[i]);
@@ -1556,7 +2714,7 @@ fclose (tmpfile);
     free (slpratiob7);  slpratiob7 = NULL;
 
     /* Free the data arrays */
-    for (i = 0; i < CMG_NBLAT; i++)
+    for (i = 0; i < cmg_win.nlines; i++)
     {
         free (wv[i]);
         free (oz[i]);
@@ -1564,42 +2722,10 @@ fclose (tmpfile);
     free (wv);
     free (oz);
 
-    for (i = 0; i < NSR_BANDS; i++)
-    {
-        for (j = 0; j < 7; j++)
-        {
-            for (k = 0; k < 22; k++)
-            {
-                free (rolutt[i][j][k]);
-                free (transt[i][j][k]);
-            }
-            free (rolutt[i][j]);
-            free (transt[i][j]);
-            free (sphalbt[i][j]);
-        }
-        free (rolutt[i]);
-        free (transt[i]);
-        free (sphalbt[i]);
-    }
-    free (rolutt);
-    free (transt);
-    free (sphalbt);
-
-    /* tsmax[20][22] and float tsmin[20][22] and float nbfic[20][22] and
-       nbfi[20][22] and float ttv[20][22] */
-    for (i = 0; i < 20; i++)
-    {
-        free (tsmax[i]);
-        free (tsmin[i]);
-        free (nbfic[i]);
-        free (nbfi[i]);
-        free (ttv[i]);
-    }
-    free (tsmax);
-    free (tsmin);
-    free (nbfic);
-    free (nbfi);
-    free (ttv);
+    if (lut_mapped)
+        unmap_lut_file (lut);
+    else
+        free (lut);
 
     /* Successful completion */
     return (SUCCESS);
@@ -1632,6 +2758,9 @@ Date          Programmer       Reason
 NOTES:
 1. The view angle is set to 0.0 and this never changes.
 2. The DEM is used to calculate the surface pressure.
+3. The look-up tables are mapped from the binary look-up table file if one
+   is specified and it is valid and up to date with the look-up table files.
+   Otherwise they are read from the look-up table files.
 ******************************************************************************/
 int init_sr_refl
 (
@@ -1643,9 +2772,12 @@ int init_sr_refl
     char *intrefnm,     /* I: intrinsic reflectance filename */
     char *transmnm,     /* I: transmission filename */
     char *spheranm,     /* I: spherical albedo filename */
+    char *lutcache,     /* I: binary look-up table filename, NULL to read
+                              the look-up table files */
     char *cmgdemnm,     /* I: climate modeling grid DEM filename */
     char *rationm,      /* I: ratio averages filename */
     char *auxnm,        /* I: auxiliary filename for ozone and water vapor */
+    Cmg_window_t *cmg_win,  /* I: window of the CMG grids to be read */
     float *xtv,         /* O: observation zenith angle (deg) */
     float *xmuv,        /* O: cosine of observation zenith angle */
     float *xfi,         /* O: azimuthal difference between sun and
@@ -1656,38 +2788,24 @@ int init_sr_refl
     float *uoz,         /* O: total column ozone */
     float *uwv,         /* O: total column water vapor (precipital water
                               vapor) */
-    float *xtsstep,     /* O: solar zenith step value */
-    float *xtsmin,      /* O: minimum solar zenith value */
-    float *xtvstep,     /* O: observation step value */
-    float *xtvmin,      /* O: minimum observation value */
-    float **tsmax,      /* O: maximum scattering angle table [20][22] */
-    float **tsmin,      /* O: minimum scattering angle table [20][22] */
-    float tts[22],      /* O: sun angle table */
-    float **ttv,        /* O: view angle table [20][22] */
-    int32 indts[22],    /* O: index for the sun angle table */
-    float ****rolutt,   /* O: intrinsic reflectance table
-                              [NSR_BANDS][7][22][8000] */
-    float ****transt,   /* O: transmission table [NSR_BANDS][7][22][22] */
-    float ***sphalbt,   /* O: spherical albedo table [NSR_BANDS][7][22] */
-    float ***normext,   /* O: aerosol extinction coefficient at the current
-                              wavelength (normalized at 550nm)
-                              [NSR_BANDS][7][22] */
-    float **nbfic,      /* O: communitive number of azimuth angles [20][22] */
-    float **nbfi,       /* O: number of azimuth angles [20][22] */
-    int16 **dem,        /* O: CMG DEM data array [DEM_NBLAT][DEM_NBLON] */
-    int16 **andwi,      /* O: avg NDWI [RATIO_NBLAT][RATIO_NBLON] */
-    int16 **sndwi,      /* O: standard NDWI [RATIO_NBLAT][RATIO_NBLON] */
-    int16 **ratiob1,    /* O: mean band1 ratio [RATIO_NBLAT][RATIO_NBLON] */
-    int16 **ratiob2,    /* O: mean band2 ratio [RATIO_NBLAT][RATIO_NBLON] */
-    int16 **ratiob7,    /* O: mean band7 ratio [RATIO_NBLAT][RATIO_NBLON] */
-    int16 **intratiob1, /* O: integer band1 ratio [RATIO_NBLAT][RATIO_NBLON] */
-    int16 **intratiob2, /* O: integer band2 ratio [RATIO_NBLAT][RATIO_NBLON] */
-    int16 **intratiob7, /* O: integer band7 ratio [RATIO_NBLAT][RATIO_NBLON] */
-    int16 **slpratiob1, /* O: slope band1 ratio [RATIO_NBLAT][RATIO_NBLON] */
-    int16 **slpratiob2, /* O: slope band2 ratio [RATIO_NBLAT][RATIO_NBLON] */
-    int16 **slpratiob7, /* O: slope band7 ratio [RATIO_NBLAT][RATIO_NBLON] */
-    uint16 **wv,        /* O: water vapor values [CMG_NBLAT][CMG_NBLON] */
-    uint8 **oz          /* O: ozone values [CMG_NBLAT][CMG_NBLON] */
+    Lut_t **lut,        /* O: look-up tables, allocated or mapped */
+    bool *lut_mapped,   /* O: were the look-up tables mapped from lutcache?
+                              (release them with unmap_lut_file, otherwise
+                              free them) */
+    int16 **dem,        /* O: CMG DEM data array [CMG window] */
+    int16 **andwi,      /* O: avg NDWI [CMG window] */
+    int16 **sndwi,      /* O: standard NDWI [CMG window] */
+    int16 **ratiob1,    /* O: mean band1 ratio [CMG window] */
+    int16 **ratiob2,    /* O: mean band2 ratio [CMG window] */
+    int16 **ratiob7,    /* O: mean band7 ratio [CMG window] */
+    int16 **intratiob1, /* O: integer band1 ratio [CMG window] */
+    int16 **intratiob2, /* O: integer band2 ratio [CMG window] */
+    int16 **intratiob7, /* O: integer band7 ratio [CMG window] */
+    int16 **slpratiob1, /* O: slope band1 ratio [CMG window] */
+    int16 **slpratiob2, /* O: slope band2 ratio [CMG window] */
+    int16 **slpratiob7, /* O: slope band7 ratio [CMG window] */
+    uint16 **wv,        /* O: water vapor values [CMG window] */
+    uint8 **oz          /* O: ozone values [CMG window] */
 )
 {
     char errmsg[STR_SIZE];                   /* error message */
@@ -1706,27 +2824,44 @@ int init_sr_refl
     *xmuv = cos (*xtv * DEG2RAD);
     *xfi = 0.0;
     *cosxfi = cos (*xfi * DEG2RAD);
-    *xtsmin = 0;
-    *xtsstep = 4.0;
-    *xtvmin = 2.84090;
-    *xtvstep = 6.52107 - *xtvmin;
-    retval = readluts (tsmax, tsmin, ttv, tts, nbfi, nbfic, indts, rolutt,
-        transt, sphalbt, normext, *xtsstep, *xtsmin, anglehdf, intrefnm,
-        transmnm, spheranm);
-    if (retval != SUCCESS)
+    *lut_mapped = false;
+    if (lutcache != NULL)
     {
-        sprintf (errmsg, "Reading the LUTs");
-        error_handler (true, FUNC_NAME, errmsg);
-        exit (ERROR);
+        if (map_lut_file (lutcache, anglehdf, intrefnm, transmnm, spheranm,
+            lut) == SUCCESS)
+            *lut_mapped = true;
+        else
+            printf ("Falling back on the LUT files.\n");
+    }
+
+    if (!*lut_mapped)
+    {
+        *lut = calloc (1, sizeof (Lut_t));
+        if (*lut == NULL)
+        {
+            sprintf (errmsg, "Error allocating memory for the look-up "
+                "tables");
+            error_handler (true, FUNC_NAME, errmsg);
+            exit (ERROR);
+        }
+
+        retval = readluts (*lut, anglehdf, intrefnm, transmnm, spheranm);
+        if (retval != SUCCESS)
+        {
+            sprintf (errmsg, "Reading the LUTs");
+            error_handler (true, FUNC_NAME, errmsg);
+            exit (ERROR);
+        }
     }
-    printf ("The LUTs for urban clean case v2.0 have been read.  We can "
-        "now perform atmospheric correction.\n");
+    printf ("The LUTs for urban clean case v2.0 have been %s.  We can "
+        "now perform atmospheric correction.\n",
+        *lut_mapped ? "mapped from the LUT cache" : "read");
 
     /* Read the auxiliary data files used as input to the reflectance
        calculations */
     retval = read_auxiliary_files (anglehdf, intrefnm, transmnm, spheranm,
-        cmgdemnm, rationm, auxnm, dem, andwi, sndwi, ratiob1, ratiob2,
-        ratiob7, intratiob1, intratiob2, intratiob7, slpratiob1,
+        cmgdemnm, rationm, auxnm, cmg_win, dem, andwi, sndwi, ratiob1,
+        ratiob2, ratiob7, intratiob1, intratiob2, intratiob7, slpratiob1,
         slpratiob2, slpratiob7, wv, oz);
     if (retval != SUCCESS)
     {
@@ -1774,6 +2909,19 @@ int init_sr_refl
         exit (ERROR);
     }
 
+    /* Convert the cell to a cell of the CMG window */
+    lcmg = cmg_window_offset (lcmg, cmg_win->line0, cmg_win->nlines,
+        CMG_NBLAT);
+    scmg = cmg_window_offset (scmg, cmg_win->samp0, cmg_win->nsamps,
+        CMG_NBLON);
+    if (lcmg < 0 || scmg < 0)
+    {
+        sprintf (errmsg, "CMG cell of the scene center is outside the CMG "
+            "window of the scene");
+        error_handler (true, FUNC_NAME, errmsg);
+        exit (ERROR);
+    }
+
     if (wv[lcmg][scmg] != 0)
         *uwv = wv[lcmg][scmg] / 200.0;
     else
@@ -0,0 +1,181 @@
+#include <getopt.h>
+#include "lut_subr.h"
+
+void create_l8_lut_usage ();
+
+/******************************************************************************
+MODULE:  create_l8_lut
+
+PURPOSE:  Reads the look-up tables of the L8 surface reflectance from the
+LDCMLUT files and writes them to a binary LUT file, which l8_sr maps directly
+instead of reading the LDCMLUT files (see the --lut_cache option of l8_sr).
+
+RETURN VALUE:
+Type = int
+Value           Description
+-----           -----------
+ERROR           An error occurred reading the LUTs or writing the LUT file
+SUCCESS         Processing was successful
+
+PROJECT:  Land Satellites Data System Science Research and Development (LSRD)
+at the USGS EROS
+
+NOTES:
+1. The LDCMLUT files are read from the L8_AUX_DIR directory, as in l8_sr.
+2. The LUT file is stamped with the size and modification time of the
+   LDCMLUT files, so l8_sr can tell when it is stale and must be created
+   again.  It is specific to the machine architecture it is created on.
+******************************************************************************/
+int main (int argc, char *argv[])
+{
+    char FUNC_NAME[] = "main"; /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    char *aux_path = NULL;   /* path for Landsat auxiliary data */
+    char *lutfile = NULL;    /* output binary LUT filename */
+    char anglehdf[STR_SIZE]; /* angle HDF filename */
+    char intrefnm[STR_SIZE]; /* intrinsic reflectance filename */
+    char transmnm[STR_SIZE]; /* transmission filename */
+    char spheranm[STR_SIZE]; /* spherical albedo filename */
+    int c;                   /* current argument index */
+    int option_index;        /* index for the command-line option */
+    static int verbose_flag = 0;   /* verbose flag */
+    static struct option long_options[] =
+    {
+        {"verbose", no_argument, &verbose_flag, 1},
+        {"output", required_argument, 0, 'o'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+    Lut_t *lut = NULL;       /* look-up tables */
+
+    /* Read the command-line arguments */
+    opterr = 0;   /* turn off getopt_long error msgs as we'll print our own */
+    while (1)
+    {
+        c = getopt_long (argc, argv, "", long_options, &option_index);
+        if (c == -1)
+        {   /* Out of cmd-line options */
+            break;
+        }
+
+        switch (c)
+        {
+            case 0:
+                /* If this option set a flag, do nothing else now. */
+                if (long_options[option_index].flag != 0)
+                    break;
+
+            case 'h':  /* help */
+                create_l8_lut_usage ();
+                exit (ERROR);
+                break;
+
+            case 'o':  /* output LUT file */
+                lutfile = strdup (optarg);
+                break;
+
+            case '?':
+            default:
+                sprintf (errmsg, "Unknown option %s", argv[optind-1]);
+                error_handler (true, FUNC_NAME, errmsg);
+                create_l8_lut_usage ();
+                exit (ERROR);
+                break;
+        }
+    }
+
+    if (lutfile == NULL)
+    {
+        sprintf (errmsg, "Output LUT file is a required argument");
+        error_handler (true, FUNC_NAME, errmsg);
+        create_l8_lut_usage ();
+        exit (ERROR);
+    }
+
+    /* Get the path for the auxiliary products from the L8_AUX_DIR
+       environment variable.  If it isn't defined, then assume the products
+       are in the local directory. */
+    aux_path = getenv ("L8_AUX_DIR");
+    if (aux_path == NULL)
+    {
+        aux_path = ".";
+        sprintf (errmsg, "L8_AUX_DIR environment variable isn't defined. "
+            "It is assumed the auxiliary products will be available from "
+            "the local directory.");
+        error_handler (false, FUNC_NAME, errmsg);
+    }
+    lut_filenames (aux_path, anglehdf, intrefnm, transmnm, spheranm);
+
+    if (verbose_flag)
+    {
+        printf ("  Angle HDF file: %s\n", anglehdf);
+        printf ("  Intrinsic reflectance file: %s\n", intrefnm);
+        printf ("  Transmission file: %s\n", transmnm);
+        printf ("  Spherical albedo file: %s\n", spheranm);
+        printf ("  Output LUT file: %s\n", lutfile);
+    }
+
+    /* Read the LUTs and write them to the LUT file */
+    lut = calloc (1, sizeof (Lut_t));
+    if (lut == NULL)
+    {
+        sprintf (errmsg, "Error allocating memory for the look-up tables");
+        error_handler (true, FUNC_NAME, errmsg);
+        exit (ERROR);
+    }
+
+    if (readluts (lut, anglehdf, intrefnm, transmnm, spheranm) != SUCCESS)
+    {
+        sprintf (errmsg, "Reading the LUTs");
+        error_handler (true, FUNC_NAME, errmsg);
+        exit (ERROR);
+    }
+
+    if (write_lut_file (lutfile, anglehdf, intrefnm, transmnm, spheranm, lut)
+        != SUCCESS)
+    {
+        snprintf (errmsg, sizeof (errmsg), "Writing the LUT file: %s",
+            lutfile);
+        error_handler (true, FUNC_NAME, errmsg);
+        exit (ERROR);
+    }
+
+    printf ("The LUTs have been written to %s (%ld bytes).\n", lutfile,
+        (long) sizeof (Lut_t));
+
+    free (lut);
+    free (lutfile);
+    exit (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  create_l8_lut_usage
+
+PURPOSE:  Prints the usage information for this application.
+
+RETURN VALUE:
+Type = None
+
+NOTES:
+******************************************************************************/
+void create_l8_lut_usage ()
+{
+    printf ("create_l8_lut reads the look-up tables of the L8 surface "
+            "reflectance from the $L8_AUX_DIR/LDCMLUT files and writes them "
+            "to a binary LUT file, which l8_sr loads with its --lut_cache "
+            "option.\n\n");
+    printf ("usage: create_l8_lut "
+            "--output=output_lut_filename [--verbose]\n");
+
+    printf ("\nwhere the following parameters are required:\n");
+    printf ("    -output: name of the binary LUT file to be written\n");
+
+    printf ("\nwhere the following parameters are optional:\n");
+    printf ("    -verbose: should intermediate messages be printed? (default "
+            "is false)\n");
+
+    printf ("\ncreate_l8_lut --help will print the usage statement\n");
+    printf ("\nExample: create_l8_lut --output=$L8_AUX_DIR/LDCMLUT/L8SR_LUT.bin"
+            "\n");
+}
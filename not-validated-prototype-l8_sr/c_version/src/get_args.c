@@ -37,6 +37,12 @@ int get_args
                                 water vapor and ozone */
     bool *process_sr,     /* O: process the surface reflectance products */
     bool *write_toa,      /* O: write intermediate TOA products flag */
+    int *stripe_memory,   /* O: memory budget of the processing (MB), 0 for
+                                no budget */
+    char **lut_cache,     /* O: address of the binary look-up table file,
+                                NULL if not specified */
+    bool *full_lut,       /* O: interpolate the full LUTs for each pixel */
+    bool *compare_lut,    /* O: report the deviation of the scene LUT */
     bool *verbose         /* O: verbose flag */
 )
 {
@@ -44,15 +50,21 @@ int get_args
     int option_index;                /* index for the command-line option */
     static int verbose_flag=0;       /* verbose flag */
     static int write_toa_flag=0;     /* write TOA flag */
+    static int full_lut_flag=0;      /* full LUT interpolation flag */
+    static int compare_lut_flag=0;   /* scene LUT comparison flag */
     char errmsg[STR_SIZE];           /* error message */
     char FUNC_NAME[] = "get_args";   /* function name */
     static struct option long_options[] =
     {
         {"verbose", no_argument, &verbose_flag, 1},
         {"write_toa", no_argument, &write_toa_flag, 1},
+        {"full_lut", no_argument, &full_lut_flag, 1},
+        {"compare_lut", no_argument, &compare_lut_flag, 1},
         {"xml", required_argument, 0, 'i'},
         {"aux", required_argument, 0, 'a'},
         {"process_sr", required_argument, 0, 'p'},
+        {"stripe_memory", required_argument, 0, 'm'},
+        {"lut_cache", required_argument, 0, 'l'},
         {"help", no_argument, 0, 'h'},
         {0, 0, 0, 0}
     };
@@ -60,7 +72,11 @@ int get_args
     /* Initialize the flags to false */
     *verbose = false;
     *write_toa = false;
+    *full_lut = false;     /* default is to use the LUT of the scene */
+    *compare_lut = false;
     *process_sr = true;    /* default is to process SR products */
+    *stripe_memory = 0;    /* default is no memory budget */
+    *lut_cache = NULL;     /* default is to read the LUT files */
 
     /* Loop through all the cmd-line options */
     opterr = 0;   /* turn off getopt_long error msgs as we'll print our own */
@@ -108,7 +124,23 @@ int get_args
                     return (ERROR);
                 }
                 break;
-     
+
+            case 'm':  /* memory budget of the processing */
+                *stripe_memory = atoi (optarg);
+                if (*stripe_memory <= 0)
+                {
+                    sprintf (errmsg, "Invalid value for stripe_memory: %s",
+                        optarg);
+                    error_handler (true, FUNC_NAME, errmsg);
+                    usage ();
+                    return (ERROR);
+                }
+                break;
+
+            case 'l':  /* binary look-up table file */
+                *lut_cache = strdup (optarg);
+                break;
+
             case '?':
             default:
                 sprintf (errmsg, "Unknown option %s", argv[optind-1]);
@@ -143,6 +175,10 @@ int get_args
         *verbose = true;
     if (write_toa_flag)
         *write_toa = true;
+    if (full_lut_flag)
+        *full_lut = true;
+    if (compare_lut_flag)
+        *compare_lut = true;
 
     return (SUCCESS);
 }
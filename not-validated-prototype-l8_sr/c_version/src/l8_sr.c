@@ -90,6 +90,8 @@ int main (int argc, char *argv[])
     char envi_file[STR_SIZE];/* ENVI filename */
     char *aux_path = NULL;   /* path for Landsat auxiliary data */
     char *xml_infile = NULL; /* input XML filename */
+    char *lut_cache = NULL;  /* binary look-up table filename, NULL to read
+                                the look-up table files */
     char *aux_infile = NULL; /* input auxiliary filename for water vapor
                                 and ozone*/
     char *cptr = NULL;       /* pointer to the file extension */
@@ -106,9 +108,10 @@ int main (int argc, char *argv[])
     Envi_header_t envi_hdr;      /* output ENVI header information */
     struct stat statbuf;      /* buffer for the file stat function */
 
-    uint16 *qaband = NULL;    /* QA band for the input image, nlines x nsamps */
-    int16 **sband = NULL;     /* output surface reflectance and brightness
-                                 temp bands, qa band is separate as a uint16 */
+    uint16 *qaband = NULL;    /* QA band of a stripe, nstripe x nsamps */
+    int16 **sband = NULL;     /* output TOA reflectance and brightness temp
+                                 bands of a stripe, qa band is separate as a
+                                 uint16 */
     float xts;           /* solar zenith angle (deg) */
     float xfs;           /* solar azimuth angle (deg) */
     float xmus;          /* cosine of solar zenith angle */
@@ -120,6 +123,15 @@ int main (int argc, char *argv[])
                                 done */
     bool write_toa = false;  /* this is set to true if the user specifies
                                 TOA products should be output for delivery */
+    bool full_lut = false;   /* interpolate the full LUTs for each pixel
+                                instead of the LUT of the scene */
+    bool compare_lut = false;  /* report the deviation of the LUT of the
+                                  scene from the full LUT interpolation */
+    int stripe_memory;  /* memory budget of the processing (MB), 0 for no
+                           budget */
+    int nstripe;        /* number of lines of a stripe */
+    int line0, line1;   /* first line and line past the end of the current
+                           stripe */
     float pixsize;      /* pixel size for the reflectance bands */
     int nlines, nsamps; /* number of lines and samples in the reflectance and
                            thermal bands */
@@ -141,7 +153,8 @@ int main (int argc, char *argv[])
 
     /* Read the command-line arguments */
     retval = get_args (argc, argv, &xml_infile, &aux_infile, &process_sr,
-        &write_toa, &verbose);
+        &write_toa, &stripe_memory, &lut_cache, &full_lut, &compare_lut,
+        &verbose);
     if (retval != SUCCESS)
     {   /* get_args already printed the error message */
         exit (ERROR);
@@ -152,6 +165,8 @@ int main (int argc, char *argv[])
     {
         printf ("  XML input file: %s\n", xml_infile);
         printf ("  AUX input file: %s\n", aux_infile);
+        if (lut_cache != NULL)
+            printf ("  LUT cache file: %s\n", lut_cache);
         if (!process_sr)
         {
             printf ("    **Surface reflectance corrections will not be "
@@ -256,26 +271,6 @@ int main (int argc, char *argv[])
         exit (ERROR);
     }
 
-    /* Allocate memory for all the data arrays */
-    if (verbose)
-        printf ("Allocating memory for the data arrays ...\n");
-    retval = memory_allocation_main (nlines, nsamps, &qaband, &sband);
-    if (retval != SUCCESS)
-    {   /* get_args already printed the error message */
-        sprintf (errmsg, "Error allocating memory for the data arrays from "
-            "the main application.");
-        error_handler (false, FUNC_NAME, errmsg);
-        exit (ERROR);
-    }
-
-    /* Read the QA band */
-    if (get_input_qa_lines (input, 0, 0, nlines, qaband) != SUCCESS)
-    {
-        sprintf (errmsg, "Reading QA band");
-        error_handler (true, FUNC_NAME, errmsg);
-        exit (ERROR);
-    }
-
     /* Get the L8 auxiliary directory and the full pathname of the auxiliary
        files to be read if processing surface reflectance */
     if (process_sr)
@@ -299,13 +294,7 @@ int main (int argc, char *argv[])
         aux_year[4] = '\0';
 
         /* Set up the look-up table files and make sure they exist */
-        sprintf (anglehdf, "%s/LDCMLUT/ANGLE_NEW.hdf", aux_path);
-        sprintf (intrefnm, "%s/LDCMLUT/RES_LUT_V3.0-URBANCLEAN-V2.0.hdf",
-            aux_path);
-        sprintf (transmnm, "%s/LDCMLUT/TRANS_LUT_V3.0-URBANCLEAN-V2.0.ASCII",
-            aux_path);
-        sprintf (spheranm, "%s/LDCMLUT/AERO_LUT_V3.0-URBANCLEAN-V2.0.ASCII",
-            aux_path);
+        lut_filenames (aux_path, anglehdf, intrefnm, transmnm, spheranm);
         sprintf (cmgdemnm, "%s/CMGDEM.hdf", aux_path);
         sprintf (rationm, "%s/ratiomapndwiexp.hdf", aux_path);
         sprintf (auxnm, "%s/LADS/%s/%s", aux_path, aux_year, aux_infile);
@@ -367,17 +356,30 @@ int main (int argc, char *argv[])
         }
     }
 
-    /* Compute the TOA reflectance and at-sensor brightness temp */
-    printf ("Calculating TOA reflectance and at-sensor brightness temps...");
-    retval = compute_toa_refl (input, qaband, nlines, nsamps, xmus,
-        gmeta->instrument, sband);
+    /* Allocate memory for the data arrays of a stripe of lines.  The TOA
+       reflectance bands 1-7 are only needed if they are written, since the
+       surface reflectance corrections calibrate the bands again. */
+    nstripe = stripe_lines (nlines, stripe_memory * 1048576L, 0,
+        (size_t) nsamps * (2 * sizeof (uint16) +
+        (NBAND_TTL_OUT-1) * sizeof (int16)), "TOA reflectance");
+    if (verbose)
+        printf ("Allocating memory for the data arrays ...\n");
+    retval = memory_allocation_bands (nstripe, nsamps, &qaband, &sband);
     if (retval != SUCCESS)
-    {
-        sprintf (errmsg, "Error computing TOA reflectance and at-sensor "
-            "brightness temperatures.");
-        error_handler (true, FUNC_NAME, errmsg);
+    {   /* get_args already printed the error message */
+        sprintf (errmsg, "Error allocating memory for the data arrays from "
+            "the main application.");
+        error_handler (false, FUNC_NAME, errmsg);
         exit (ERROR);
     }
+    if (process_sr && !write_toa)
+    {
+        for (ib = SR_BAND1; ib <= SR_BAND7; ib++)
+        {
+            free (sband[ib]);
+            sband[ib] = NULL;
+        }
+    }
 
     /* Open the TOA output file, and set up the bands according to whether
        the TOA reflectance bands will be written. */
@@ -387,24 +389,62 @@ int main (int argc, char *argv[])
         error_handler (true, FUNC_NAME, errmsg);
         exit (ERROR);
     }
+
+    /* Compute the TOA reflectance and at-sensor brightness temp, and write
+       them, one stripe of lines at a time.  Bands 1-7 are written if the
+       user specified TOA to be written or if the surface reflectance
+       processing will not be completed. */
+    printf ("Calculating TOA reflectance and at-sensor brightness temps in "
+        "stripes of %d lines ...\n", nstripe);
+    for (line0 = 0; line0 < nlines; line0 += nstripe)
+    {
+        line1 = (line0 + nstripe < nlines) ? line0 + nstripe : nlines;
+
+        /* Read the QA band */
+        if (get_input_qa_lines (input, 0, line0, line1 - line0, qaband) !=
+            SUCCESS)
+        {
+            sprintf (errmsg, "Reading QA band");
+            error_handler (true, FUNC_NAME, errmsg);
+            exit (ERROR);
+        }
+
+        retval = compute_toa_refl (input, qaband, line0, line1 - line0,
+            nsamps, xmus, gmeta->instrument, sband);
+        if (retval != SUCCESS)
+        {
+            sprintf (errmsg, "Error computing TOA reflectance and at-sensor "
+                "brightness temperatures.");
+            error_handler (true, FUNC_NAME, errmsg);
+            exit (ERROR);
+        }
+
+        for (ib = SR_BAND1; ib <= SR_BAND11; ib++)
+        {
+            /* If processing OLI-only, then bands 10 and 11 don't exist */
+            if (sband[ib] == NULL || (!strcmp (gmeta->instrument, "OLI") &&
+                (ib == SR_BAND10 || ib == SR_BAND11)))
+                continue;
+
+            if (put_output_lines (toa_output, sband[ib], ib, line0,
+                line1 - line0, sizeof (int16)) != SUCCESS)
+            {
+                sprintf (errmsg, "Writing output TOA data for band %d",
+                    ib < SR_BAND9 ? ib+1 : ib+2);
+                error_handler (true, FUNC_NAME, errmsg);
+                exit (ERROR);
+            }
+        }
+    }  /* end for line0 */
     printf ("Writing TOA reflectance corrected data to the output files ...\n");
 
-    /* If we are writing the TOA data, do so now for bands 1-7.  This will
-       occur if the user specified TOA to be written or if the surface
-       reflectance processing will not be completed. */
+    /* Write the ENVI headers of the TOA bands 1-7, if they were written */
     if (write_toa || !process_sr)
     {
         for (ib = SR_BAND1; ib <= SR_BAND7; ib++)
         {
             printf ("  Band %d: %s\n", ib+1,
                 toa_output->metadata.band[ib].file_name);
-            if (put_output_lines (toa_output, sband[ib], ib, 0, nlines,
-                sizeof (int16)) != SUCCESS)
-            {
-                sprintf (errmsg, "Writing output TOA data for band %d", ib+1);
-                error_handler (true, FUNC_NAME, errmsg);
-                exit (ERROR);
-            }
 
             /* Create the ENVI header file this band */
             if (create_envi_struct (&toa_output->metadata.band[ib],
@@ -437,8 +477,8 @@ int main (int argc, char *argv[])
         }
     }
 
-    /* Write bands 9-11 (cirrus and thermals), which don't get any further
-       processing. */
+    /* Write the ENVI headers of bands 9-11 (cirrus and thermals), which
+       don't get any further processing. */
     for (ib = SR_BAND9; ib <= SR_BAND11; ib++)
     {
         /* If processing OLI-only, then bands 10 and 11 don't exist */
@@ -448,13 +488,6 @@ int main (int argc, char *argv[])
         
         printf ("  Band %d: %s\n", ib+2,
             toa_output->metadata.band[ib].file_name);
-        if (put_output_lines (toa_output, sband[ib], ib, 0, nlines,
-            sizeof (int16)) != SUCCESS)
-        {
-            sprintf (errmsg, "Writing output TOA data for band %d", ib+2);
-            error_handler (true, FUNC_NAME, errmsg);
-            exit (ERROR);
-        }
 
         /* Create the ENVI header file this band */
         if (create_envi_struct (&toa_output->metadata.band[ib],
@@ -497,6 +530,12 @@ int main (int argc, char *argv[])
     }
     free_output (toa_output);
 
+    /* Free memory for band data */
+    free (qaband);
+    for (i = 0; i < NBAND_TTL_OUT-1; i++)
+        free (sband[i]);
+    free (sband);
+
     /* Only continue with the surface reflectance corrections if SR processing
        has been requested and is possible due to the solar zenith angle */
     if (process_sr)
@@ -505,9 +544,10 @@ int main (int argc, char *argv[])
            the data to the SR output file */
         printf ("Performing atmospheric corrections for each reflectance "
             "band ...\n");
-        retval = compute_sr_refl (input, &xml_metadata, xml_infile, qaband,
-            nlines, nsamps, pixsize, sband, xts, xfs, xmus, anglehdf,
-            intrefnm, transmnm, spheranm, cmgdemnm, rationm, auxnm);
+        retval = compute_sr_refl (input, &xml_metadata, xml_infile, nlines,
+            nsamps, pixsize, xts, xfs, xmus, anglehdf,
+            intrefnm, transmnm, spheranm, lut_cache, cmgdemnm, rationm, auxnm,
+            stripe_memory, full_lut, compare_lut);
         if (retval != SUCCESS)
         {
             sprintf (errmsg, "Error computing surface reflectance");
@@ -527,12 +567,7 @@ int main (int argc, char *argv[])
     /* Free the filename pointers */
     free (xml_infile);
     free (aux_infile);
-
-    /* Free memory for band data */
-    free (qaband);
-    for (i = 0; i < NBAND_TTL_OUT-1; i++)
-        free (sband[i]);
-    free (sband);
+    free (lut_cache);
 
     /* Indicate successful completion of processing */
     printf ("Surface reflectance processing complete!\n");
@@ -570,7 +605,9 @@ void usage ()
     printf ("usage: l8_sr "
             "--xml=input_xml_filename "
             "--aux=input_auxiliary_filename "
-            "--process_sr=true:false --write_toa [--verbose]\n");
+            "--process_sr=true:false --write_toa [--stripe_memory=MB] "
+            "[--lut_cache=input_lut_cache_filename] [--full_lut] "
+            "[--compare_lut] [--verbose]\n");
 
     printf ("\nwhere the following parameters are required:\n");
     printf ("    -xml: name of the input XML file to be processed\n");
@@ -586,6 +623,27 @@ void usage ()
             "done.\n");
     printf ("    -write_toa: the intermediate TOA reflectance products "
             "for bands 1-7 are written to the output file\n");
+    printf ("    -stripe_memory: memory budget in MB of the application.  "
+            "The scene is processed in stripes of lines sized to fit it next "
+            "to the LUTs, the CMG window, the aerosol grid and the window of "
+            "lines the cloud shadows are cast across.  The cloud, residual "
+            "and aerosol values of the scene are kept in scratch files in "
+            "the current directory between the passes.  (default is "
+            "stripes of %d lines)\n", PROC_NLINES);
+    printf ("    -lut_cache: name of the binary LUT file written by "
+            "create_l8_lut from the $L8_AUX_DIR/LDCMLUT files.  The LUTs are "
+            "mapped from it instead of being read from the LDCMLUT files.  "
+            "If it is missing, corrupt or older than the LDCMLUT files, then "
+            "the LDCMLUT files are read.  (default is to read the LDCMLUT "
+            "files)\n");
+    printf ("    -full_lut: interpolate the LUTs over the sun and view angles "
+            "for each pixel, which is the reference computation.  (default "
+            "is to compute the atmospheric reflectance and transmissions of "
+            "the scene once at the pressure and AOT nodes of the LUTs, and "
+            "interpolate them for each pixel)\n");
+    printf ("    -compare_lut: report the maximum and mean deviation of the "
+            "scene LUT from the full LUT interpolation for each band "
+            "(default is false)\n");
     printf ("    -verbose: should intermediate messages be printed? (default "
             "is false)\n");
 
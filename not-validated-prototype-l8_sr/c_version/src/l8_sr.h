@@ -29,6 +29,12 @@ int get_args
                                 water vapor and ozone */
     bool *process_sr,     /* O: process the surface reflectance products */
     bool *write_toa,      /* O: write intermediate TOA products flag */
+    int *stripe_memory,   /* O: memory budget of the processing (MB), 0 for
+                                no budget */
+    char **lut_cache,     /* O: address of the binary look-up table file,
+                                NULL if not specified */
+    bool *full_lut,       /* O: interpolate the full LUTs for each pixel */
+    bool *compare_lut,    /* O: report the deviation of the scene LUT */
     bool *verbose         /* O: verbose flag */
 );
 
@@ -43,13 +49,26 @@ bool btest
 int compute_toa_refl
 (
     Input_t *input,     /* I: input structure for the Landsat product */
-    uint16 *qaband,     /* I: QA band for the input image, nlines x nsamps */
-    int nlines,         /* I: number of lines in reflectance, thermal bands */
+    uint16 *qaband,     /* I: QA band of the lines, nlines x nsamps */
+    int line0,          /* I: first line to calibrate */
+    int nlines,         /* I: number of lines to calibrate */
     int nsamps,         /* I: number of samps in reflectance, thermal bands */
     float xmus,         /* I: cosine of solar zenith angle */
     char *instrument,   /* I: instrument to be processed (OLI, TIRS) */
-    int16 **sband       /* O: output surface reflectance and brightness
-                              temp bands */
+    int16 **sband       /* O: output TOA reflectance and brightness temp
+                              values (scaled) of the lines, nlines x nsamps,
+                              NULL for the bands to skip */
+);
+
+int stripe_lines
+(
+    int nlines,         /* I: number of lines in the scene */
+    long budget,        /* I: memory budget of the application (bytes), 0
+                              for no budget */
+    size_t fixed,       /* I: bytes of the stage that don't depend on the
+                              stripe size */
+    size_t line_bytes,  /* I: bytes of a line of the stripes */
+    char *stage         /* I: name of the stage, for the warning */
 );
 
 int compute_sr_refl
@@ -58,11 +77,9 @@ int compute_sr_refl
     Espa_internal_meta_t *xml_metadata,
                         /* I: XML metadata structure */
     char *xml_infile,   /* I: input XML filename */
-    uint16 *qaband,     /* I: QA band for the input image, nlines x nsamps */
     int nlines,         /* I: number of lines in reflectance, thermal bands */
     int nsamps,         /* I: number of samps in reflectance, thermal bands */
     float pixsize,      /* I: pixel size for the reflectance bands */
-    int16 **sband,      /* I/O: input TOA and output surface reflectance */
     float xts,          /* I: solar zenith angle (deg) */
     float xfs,          /* I: solar azimuth angle (deg) */
     float xmus,         /* I: cosine of solar zenith angle */
@@ -70,9 +87,17 @@ int compute_sr_refl
     char *intrefnm,     /* I: intrinsic reflectance filename */
     char *transmnm,     /* I: transmission filename */
     char *spheranm,     /* I: spherical albedo filename */
+    char *lutcache,     /* I: binary look-up table filename, NULL to read
+                              the look-up table files */
     char *cmgdemnm,     /* I: climate modeling grid DEM filename */
     char *rationm,      /* I: ratio averages filename */
-    char *auxnm         /* I: auxiliary filename for ozone and water vapor */
+    char *auxnm,        /* I: auxiliary filename for ozone and water vapor */
+    int stripe_memory,  /* I: memory budget of the processing (MB), 0 for
+                              no budget */
+    bool full_lut,      /* I: interpolate the LUTs for each pixel instead of
+                              the look-up table of the scene */
+    bool compare_lut    /* I: report the deviation of the look-up table of
+                              the scene from the full interpolation */
 );
 
 int init_sr_refl
@@ -85,9 +110,12 @@ int init_sr_refl
     char *intrefnm,     /* I: intrinsic reflectance filename */
     char *transmnm,     /* I: transmission filename */
     char *spheranm,     /* I: spherical albedo filename */
+    char *lutcache,     /* I: binary look-up table filename, NULL to read
+                              the look-up table files */
     char *cmgdemnm,     /* I: climate modeling grid DEM filename */
     char *rationm,      /* I: ratio averages filename */
     char *auxnm,        /* I: auxiliary filename for ozone and water vapor */
+    Cmg_window_t *cmg_win,  /* I: window of the CMG grids to be read */
     float *xtv,         /* O: observation zenith angle (deg) */
     float *xmuv,        /* O: cosine of observation zenith angle */
     float *xfi,         /* O: azimuthal difference between sun and
@@ -98,38 +126,24 @@ int init_sr_refl
     float *uoz,         /* O: total column ozone */
     float *uwv,         /* O: total column water vapor (precipital water
                               vapor) */
-    float *xtsstep,     /* O: solar zenith step value */
-    float *xtsmin,      /* O: minimum solar zenith value */
-    float *xtvstep,     /* O: observation step value */
-    float *xtvmin,      /* O: minimum observation value */
-    float **tsmax,      /* O: maximum scattering angle table [20][22] */
-    float **tsmin,      /* O: minimum scattering angle table [20][22] */
-    float tts[22],      /* O: sun angle table */
-    float **ttv,        /* O: view angle table [20][22] */
-    int32 indts[22],    /* O: index for the sun angle table */
-    float ****rolutt,   /* O: intrinsic reflectance table
-                              [NSR_BANDS][7][22][8000] */
-    float ****transt,   /* O: transmission table [NSR_BANDS][7][22][22] */
-    float ***sphalbt,   /* O: spherical albedo table [NSR_BANDS][7][22] */
-    float ***normext,   /* O: aerosol extinction coefficient at the current
-                              wavelength (normalized at 550nm)
-                              [NSR_BANDS][7][22] */
-    float **nbfic,      /* O: communitive number of azimuth angles [20][22] */
-    float **nbfi,       /* O: number of azimuth angles [20][22] */
-    int16 **dem,        /* O: CMG DEM data array [DEM_NBLAT][DEM_NBLON] */
-    int16 **andwi,      /* O: avg NDWI [RATIO_NBLAT][RATIO_NBLON] */
-    int16 **sndwi,      /* O: standard NDWI [RATIO_NBLAT][RATIO_NBLON] */
-    int16 **ratiob1,    /* O: mean band1 ratio [RATIO_NBLAT][RATIO_NBLON] */
-    int16 **ratiob2,    /* O: mean band2 ratio [RATIO_NBLAT][RATIO_NBLON] */
-    int16 **ratiob7,    /* O: mean band7 ratio [RATIO_NBLAT][RATIO_NBLON] */
-    int16 **intratiob1, /* O: integer band1 ratio [RATIO_NBLAT][RATIO_NBLON] */
-    int16 **intratiob2, /* O: integer band2 ratio [RATIO_NBLAT][RATIO_NBLON] */
-    int16 **intratiob7, /* O: integer band7 ratio [RATIO_NBLAT][RATIO_NBLON] */
-    int16 **slpratiob1, /* O: slope band1 ratio [RATIO_NBLAT][RATIO_NBLON] */
-    int16 **slpratiob2, /* O: slope band2 ratio [RATIO_NBLAT][RATIO_NBLON] */
-    int16 **slpratiob7, /* O: slope band7 ratio [RATIO_NBLAT][RATIO_NBLON] */
-    uint16 **wv,        /* O: water vapor values [CMG_NBLAT][CMG_NBLON] */
-    uint8 **oz          /* O: ozone values [CMG_NBLAT][CMG_NBLON] */
+    Lut_t **lut,        /* O: look-up tables, allocated or mapped */
+    bool *lut_mapped,   /* O: were the look-up tables mapped from lutcache?
+                              (release them with unmap_lut_file, otherwise
+                              free them) */
+    int16 **dem,        /* O: CMG DEM data array [CMG window] */
+    int16 **andwi,      /* O: avg NDWI [CMG window] */
+    int16 **sndwi,      /* O: standard NDWI [CMG window] */
+    int16 **ratiob1,    /* O: mean band1 ratio [CMG window] */
+    int16 **ratiob2,    /* O: mean band2 ratio [CMG window] */
+    int16 **ratiob7,    /* O: mean band7 ratio [CMG window] */
+    int16 **intratiob1, /* O: integer band1 ratio [CMG window] */
+    int16 **intratiob2, /* O: integer band2 ratio [CMG window] */
+    int16 **intratiob7, /* O: integer band7 ratio [CMG window] */
+    int16 **slpratiob1, /* O: slope band1 ratio [CMG window] */
+    int16 **slpratiob2, /* O: slope band2 ratio [CMG window] */
+    int16 **slpratiob7, /* O: slope band7 ratio [CMG window] */
+    uint16 **wv,        /* O: water vapor values [CMG window] */
+    uint8 **oz          /* O: ozone values [CMG window] */
 );
 
 #endif
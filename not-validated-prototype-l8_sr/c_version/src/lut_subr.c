@@ -48,10 +48,88 @@ Date         Programmer       Reason
 
 NOTES:
 *****************************************************************************/
+#include <stddef.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "lut_subr.h"
 #include "hdf.h"
 #include "mfhdf.h"
 
+/* Log of the AOT look-up table, for the interpolation of the atmospheric
+   reflectance as log of tau */
+static const float logaot550nm[NAOT_VALS] =
+    {-4.605170186, -2.995732274, -2.302585093,
+     -1.897119985, -1.609437912, -1.203972804,
+     -0.916290732, -0.510825624, -0.223143551,
+      0.000000000, 0.182321557, 0.336472237,
+      0.470003629, 0.587786665, 0.693157181,
+      0.832909123, 0.955511445, 1.098612289,
+      1.252762969, 1.386294361, 1.504077397,
+      1.609437912};
+
+
+/******************************************************************************
+MODULE:  interp_scene_lut
+
+PURPOSE:  Interpolates the atmospheric reflectance and the transmittances of
+the scene look-up table in surface pressure and AOT.
+
+RETURN VALUE:
+Type = N/A
+
+NOTES:
+  1. The interpolation is the one comproatm (as log of tau) and comptrans
+     (linear in AOT) apply to their own values at the pressure and AOT
+     nodes, so it gives the same results as the full interpolation.
+******************************************************************************/
+static void interp_scene_lut
+(
+    int ip1,            /* I: index variable for surface pressure */
+    int ip2,            /* I: index variable for surface pressure */
+    int iaot1,          /* I: index variable for AOT */
+    int iaot2,          /* I: index variable for AOT */
+    float raot550nm,    /* I: nearest value of AOT */
+    int iband,          /* I: band index (0-based) */
+    float pres,         /* I: surface pressure */
+    Lut_t *lut,         /* I: look-up tables */
+    Scene_lut_t *slut,  /* I: look-up table of the scene */
+    float *roatm,       /* O: atmospheric reflectance */
+    float *xtts,        /* O: downward transmittance */
+    float *xttv         /* O: upward transmittance */
+)
+{
+    float (*tab)[NAOT_VALS];        /* table of the current band */
+    float xtp1, xtp2;               /* table value at p1 and p2 */
+    float dpres;                    /* pressure ratio */
+    float deltaaot;                 /* AOT ratio */
+
+    dpres = (pres - lut->tpres[ip1]) / (lut->tpres[ip2] - lut->tpres[ip1]);
+
+    /* Interpolate the atmospheric reflectance as log of tau */
+    deltaaot = logaot550nm[iaot2] - logaot550nm[iaot1];
+    deltaaot = (log (raot550nm) - logaot550nm[iaot1]) / deltaaot;
+    tab = slut->roatm[iband];
+    xtp1 = tab[ip1][iaot1] + (tab[ip1][iaot2] - tab[ip1][iaot1]) * deltaaot;
+    xtp2 = tab[ip2][iaot1] + (tab[ip2][iaot2] - tab[ip2][iaot1]) * deltaaot;
+    *roatm = xtp1 + (xtp2 - xtp1) * dpres;
+
+    /* Interpolate the transmittances linearly in AOT */
+    deltaaot = raot550nm - lut->aot550nm[iaot1];
+    deltaaot /= lut->aot550nm[iaot2] - lut->aot550nm[iaot1];
+    tab = slut->xtts[iband];
+    xtp1 = tab[ip1][iaot1] + (tab[ip1][iaot2] - tab[ip1][iaot1]) * deltaaot;
+    xtp2 = tab[ip2][iaot1] + (tab[ip2][iaot2] - tab[ip2][iaot1]) * deltaaot;
+    *xtts = xtp1 + (xtp2 - xtp1) * dpres;
+
+    tab = slut->xttv[iband];
+    xtp1 = tab[ip1][iaot1] + (tab[ip1][iaot2] - tab[ip1][iaot1]) * deltaaot;
+    xtp2 = tab[ip2][iaot1] + (tab[ip2][iaot2] - tab[ip2][iaot1]) * deltaaot;
+    *xttv = xtp1 + (xtp2 - xtp1) * dpres;
+}
+
+
 /******************************************************************************
 MODULE:  atmcorlamb2
 
@@ -72,6 +150,12 @@ Date         Programmer       Reason
 
 NOTES:
     1. Standard sea level pressure is 1013 millibars.
+    2. If the look-up table of the scene is provided, the atmospheric
+       reflectance, the transmissions and the molecular reflectance are
+       interpolated from it in pressure and AOT, instead of being
+       interpolated from the LUTs over the sun and view angles.  Passing
+       NULL runs the full interpolation, which is the reference for the
+       scene look-up table (see compare_scene_lut).
 ******************************************************************************/
 int atmcorlamb2
 (
@@ -85,41 +169,12 @@ int atmcorlamb2
     float raot550nm,                 /* I: nearest value of AOT */
     int iband,                       /* I: band index (0-based) */
     float pres,                      /* I: surface pressure */
-    float tpres[7],                  /* I: surface pressure table */
-    float aot550nm[22],              /* I: AOT look-up table */
-    float ****rolutt,                /* I: intrinsic reflectance table
-                                           [NSR_BANDS][7][22][8000] */
-    float ****transt,                /* I: transmission table
-                                           [NSR_BANDS][7][22][22] */
-    float xtsstep,                   /* I: solar zenith step value */
-    float xtsmin,                    /* I: minimum solar zenith value */
-    float xtvstep,                   /* I: observation step value */
-    float xtvmin,                    /* I: minimum observation value */
-    float ***sphalbt,                /* I: spherical albedo table
-                                           [NSR_BANDS][7][22] */
-    float ***normext,                /* I: aerosol extinction coefficient at
-                                           the current wavelength (normalized
-                                           at 550nm) [NSR_BANDS][7][22] */
-    float **tsmax,                   /* I: maximum scattering angle table
-                                           [20][22] */
-    float **tsmin,                   /* I: minimum scattering angle table
-                                           [20][22] */
-    float **nbfic,                   /* I: communitive number of azimuth angles
-                                           [20][22] */
-    float **nbfi,                    /* I: number of azimuth angles [20][22] */
-    float tts[22],                   /* I: sun angle table */
-    int32 indts[22],
-    float **ttv,                     /* I: view angle table [20][22] */
+    Lut_t *lut,                      /* I: look-up tables */
+    Scene_lut_t *slut,               /* I: look-up table of the scene, NULL
+                                           to interpolate the LUTs */
     float uoz,                       /* I: total column ozone */
     float uwv,                       /* I: total column water vapor (precipital
                                            water vapor) */
-    float tauray[NSR_BANDS],         /* I: molecular optical thickness coeff */
-    double ogtransa1[NSR_BANDS],     /* I: other gases transmission coeff */
-    double ogtransb0[NSR_BANDS],     /* I: other gases transmission coeff */
-    double ogtransb1[NSR_BANDS],     /* I: other gases transmission coeff */
-    double wvtransa[NSR_BANDS],      /* I: water vapor transmission coeff */
-    double wvtransb[NSR_BANDS],      /* I: water vapor transmission coeff */
-    double oztransa[NSR_BANDS],      /* I: ozone transmission coeff */
     float rotoa,                     /* I: top of atmosphere reflectance */
     float *roslamb,                  /* O: lambertian surface reflectance */
     float *tgo,                      /* O: other gaseous transmittance */
@@ -148,6 +203,9 @@ int atmcorlamb2
                            arrays */
     int its;            /* index for the sun angle table */
     int itv;            /* index for the view angle table */
+    int irp;            /* index in the pressure grid of the molecular
+                           reflectance */
+    float drp;          /* pressure ratio in the molecular reflectance grid */
 
     /* Get the pressure and AOT related values for the current surface pressure
        and AOT.  These indices are passed into several functions. */
@@ -157,7 +215,7 @@ int atmcorlamb2
     ip1 = 0;
     for (ip = 0; ip < 6; ip++)  /* 7 elements in the array, stop one short */
     {
-        if (pres < tpres[ip])
+        if (pres < lut->tpres[ip])
             ip1 = ip;
     }
     ip2 = ip1 + 1;
@@ -168,22 +226,22 @@ int atmcorlamb2
     iaot1 = 0;
     for (iaot = 0; iaot < 21; iaot++) /* 22 elements in table, stop one short */
     {
-        if (raot550nm > aot550nm[iaot])
+        if (raot550nm > lut->aot550nm[iaot])
             iaot1 = iaot;
     }
     iaot2 = iaot1 + 1;
 
     /* Determine the index in the view angle table */
-    if (xtv <= xtvmin)
+    if (xtv <= lut->xtvmin)
         itv = 0;
     else
-        itv = (int) ((xtv - xtvmin) / xtvstep + 1.0);
+        itv = (int) ((xtv - lut->xtvmin) / lut->xtvstep + 1.0);
 
     /* Determine the index in the sun angle table */
-    if (xts <= xtsmin) 
+    if (xts <= lut->xtsmin) 
         its = 0;
     else
-        its = (int) ((xts - xtsmin) / xtsstep);
+        its = (int) ((xts - lut->xtsmin) / lut->xtsstep);
     if (its > 19)
     {
         sprintf (errmsg, "Solar zenith (xts) is too large: %f", xts);
@@ -191,36 +249,54 @@ int atmcorlamb2
         return (ERROR);
     }
 
-    /* This routine returns variables for calculating roslamb */
-    comproatm (ip1, ip2, iaot1, iaot2, xts, xtv, xmus, xmuv, cosxfi,
-        raot550nm, iband, pres, tpres, aot550nm, rolutt, tsmax, tsmin, nbfic,
-        nbfi, tts, indts, ttv, xtsstep, xtsmin, xtvstep, xtvmin, its, itv,
-        roatm);
+    if (slut != NULL)
+    {
+        /* Interpolate the scene look-up table in pressure and AOT */
+        interp_scene_lut (ip1, ip2, iaot1, iaot2, raot550nm, iband, pres, lut,
+            slut, roatm, &xtts, &xttv);
+    }
+    else
+    {
+        /* This routine returns variables for calculating roslamb */
+        comproatm (ip1, ip2, iaot1, iaot2, xts, xtv, xmus, xmuv, cosxfi,
+            raot550nm, iband, pres, lut, its, itv, roatm);
 
-    /* Compute the transmission for the solar zenith angle */
-    comptrans (ip1, ip2, iaot1, iaot2, xts, raot550nm, iband, pres, tpres,
-        aot550nm, transt, xtsstep, xtsmin, tts, &xtts);
+        /* Compute the transmission for the solar zenith angle */
+        comptrans (ip1, ip2, iaot1, iaot2, xts, raot550nm, iband, pres, lut,
+            lut->xtsstep, lut->xtsmin, &xtts);
 
-    /* Compute the transmission for the observation zenith angle */
-    comptrans (ip1, ip2, iaot1, iaot2, xtv, raot550nm, iband, pres, tpres,
-        aot550nm, transt, xtvstep, xtvmin, tts, &xttv);
+        /* Compute the transmission for the observation zenith angle */
+        comptrans (ip1, ip2, iaot1, iaot2, xtv, raot550nm, iband, pres, lut,
+            lut->xtvstep, lut->xtvmin, &xttv);
+    }
 
     /* Compute total transmission (product downward by  upward) */
     ttatm = xtts * xttv;
     
     /* Compute spherical albedo */
-    compsalb (ip1, ip2, iaot1, iaot2, raot550nm, iband, pres, tpres, aot550nm,
-        sphalbt, normext, satm, next);
+    compsalb (ip1, ip2, iaot1, iaot2, raot550nm, iband, pres, lut, satm, next);
 
     atm_pres = pres * ONE_DIV_1013;
-    comptg (iband, xts, xtv, xmus, xmuv, uoz, uwv, atm_pres, ogtransa1,
-        ogtransb0, ogtransb1, wvtransa, wvtransb, oztransa, &tgoz, &tgwv,
-        &tgwvhalf, &tgog);
+    comptg (iband, xts, xtv, xmus, xmuv, uoz, uwv, atm_pres, lut->ogtransa1,
+        lut->ogtransb0, lut->ogtransb1, lut->wvtransa, lut->wvtransb,
+        lut->oztransa, &tgoz, &tgwv, &tgwvhalf, &tgog);
 
     /* Compute rayleigh component (intrinsic reflectance, at p=pres).
-       Pressure in the atmosphere is pres / 1013. */
-    xtaur = tauray[iband] * atm_pres;
-    local_chand (xfi, xmuv, xmus, xtaur, xrorayp);
+       Pressure in the atmosphere is pres / 1013.  Interpolate it from the
+       scene look-up table if the pressure is within its grid. */
+    drp = (pres - RAY_PRES_MIN) / RAY_PRES_STEP;
+    if (slut != NULL && drp >= 0.0 && drp < NRAY_PRES - 1)
+    {
+        irp = (int) drp;
+        drp -= irp;
+        *xrorayp = slut->xrorayp[iband][irp] +
+            (slut->xrorayp[iband][irp+1] - slut->xrorayp[iband][irp]) * drp;
+    }
+    else
+    {
+        xtaur = lut->tauray[iband] * atm_pres;
+        local_chand (xfi, xmuv, xmus, xtaur, xrorayp);
+    }
 
     /* Perform atmospheric correction */
     *roslamb = rotoa / (tgog * tgoz);
@@ -449,12 +525,7 @@ void compsalb
     float raot550nm,    /* I: nearest value of AOT */
     int iband,          /* I: band index (0-based) */
     float pres,         /* I: surface pressure */
-    float tpres[7],     /* I: surface pressure table */
-    float aot550nm[22], /* I: AOT look-up table */
-    float ***sphalbt,   /* I: spherical albedo table [NSR_BANDS][7][22] */
-    float ***normext,   /* I: aerosol extinction coefficient at the current
-                              wavelength (normalized at 550nm)
-                              [NSR_BANDS][7][22] */
+    Lut_t *lut,         /* I: look-up tables */
     float *satm,        /* O: spherical albedo */
     float *next         /* O: */
 )
@@ -466,31 +537,31 @@ void compsalb
     float deltaaot;                 /* AOT ratio */
 
     /* Compute the delta AOT */
-    deltaaot = raot550nm - aot550nm[iaot1];
-    deltaaot /= aot550nm[iaot2] - aot550nm[iaot1];
+    deltaaot = raot550nm - lut->aot550nm[iaot1];
+    deltaaot /= lut->aot550nm[iaot2] - lut->aot550nm[iaot1];
 
     /* Compute the spherical albedo */
-    xtiaot1 = sphalbt[iband][ip1][iaot1];
-    xtiaot2 = sphalbt[iband][ip1][iaot2];
+    xtiaot1 = lut->sphalbt[iband][ip1][iaot1];
+    xtiaot2 = lut->sphalbt[iband][ip1][iaot2];
     satm1 = xtiaot1 + (xtiaot2 - xtiaot1) * deltaaot;
 
-    xtiaot1 = sphalbt[iband][ip2][iaot1];
-    xtiaot2 = sphalbt[iband][ip2][iaot2];
+    xtiaot1 = lut->sphalbt[iband][ip2][iaot1];
+    xtiaot2 = lut->sphalbt[iband][ip2][iaot2];
     satm2 = xtiaot1 + (xtiaot2 - xtiaot1) * deltaaot;
 
-    dpres = (pres - tpres[ip1]) / (tpres[ip2] - tpres[ip1]);
+    dpres = (pres - lut->tpres[ip1]) / (lut->tpres[ip2] - lut->tpres[ip1]);
     *satm = satm1 + (satm2 - satm1) * dpres;
 
     /* Compute the normalized?? spherical albedo */
-    xtiaot1 = normext[iband][ip1][iaot1];
-    xtiaot2 = normext[iband][ip1][iaot2];
+    xtiaot1 = lut->normext[iband][ip1][iaot1];
+    xtiaot2 = lut->normext[iband][ip1][iaot2];
     next1 = xtiaot1 + (xtiaot2 - xtiaot1) * deltaaot;
 
-    xtiaot1 = normext[iband][ip2][iaot1];
-    xtiaot2 = normext[iband][ip2][iaot2];
+    xtiaot1 = lut->normext[iband][ip2][iaot1];
+    xtiaot2 = lut->normext[iband][ip2][iaot2];
     next2 = xtiaot1 + (xtiaot2 - xtiaot1) * deltaaot;
 
-    dpres = (pres - tpres[ip1]) / (tpres[ip2] - tpres[ip1]);
+    dpres = (pres - lut->tpres[ip1]) / (lut->tpres[ip2] - lut->tpres[ip1]);
     *next = next1 + (next2 - next1) * dpres;
 }
 
@@ -531,13 +602,9 @@ void comptrans
     float raot550nm,    /* I: nearest value of AOT */
     int iband,          /* I: band index (0-based) */
     float pres,         /* I: surface pressure */
-    float tpres[7],     /* I: surface pressure table */
-    float aot550nm[22], /* I: AOT look-up table */
-    float ****transt,   /* I: transmission table
-                              [NSR_BANDS][7][22][22] */
+    Lut_t *lut,         /* I: look-up tables */
     float xtsstep,      /* I: zenith angle step value */
     float xtsmin,       /* I: minimum zenith angle value */
-    float tts[22],      /* I: sun angle table */
     float *xtts         /* O: downward transmittance */
 )
 {
@@ -562,25 +629,29 @@ void comptrans
         return;
     }
 
-    xmts = (xts - tts[its]) * 0.25;
-    xtranst = transt[iband][ip1][iaot1][its];
-    xtiaot1 = xtranst + (transt[iband][ip1][iaot1][its+1] - xtranst) * xmts;
+    xmts = (xts - lut->tts[its]) * 0.25;
+    xtranst = lut->transt[iband][ip1][iaot1][its];
+    xtiaot1 = xtranst + (lut->transt[iband][ip1][iaot1][its+1] - xtranst) *
+        xmts;
 
-    xtranst = transt[iband][ip1][iaot2][its];
-    xtiaot2 = xtranst + (transt[iband][ip1][iaot2][its+1] - xtranst) * xmts;
+    xtranst = lut->transt[iband][ip1][iaot2][its];
+    xtiaot2 = xtranst + (lut->transt[iband][ip1][iaot2][its+1] - xtranst) *
+        xmts;
 
-    deltaaot = raot550nm - aot550nm[iaot1];
-    deltaaot /= aot550nm[iaot2] - aot550nm[iaot1];
+    deltaaot = raot550nm - lut->aot550nm[iaot1];
+    deltaaot /= lut->aot550nm[iaot2] - lut->aot550nm[iaot1];
     xtts1 = xtiaot1 + (xtiaot2 - xtiaot1) * deltaaot;
 
-    xtranst = transt[iband][ip2][iaot1][its];
-    xtiaot1 = xtranst + (transt[iband][ip2][iaot1][its+1] - xtranst) * xmts;
+    xtranst = lut->transt[iband][ip2][iaot1][its];
+    xtiaot1 = xtranst + (lut->transt[iband][ip2][iaot1][its+1] - xtranst) *
+        xmts;
 
-    xtranst = transt[iband][ip2][iaot2][its];
-    xtiaot2 = xtranst + (transt[iband][ip2][iaot2][its+1] - xtranst) * xmts;
+    xtranst = lut->transt[iband][ip2][iaot2][its];
+    xtiaot2 = xtranst + (lut->transt[iband][ip2][iaot2][its+1] - xtranst) *
+        xmts;
     xtts2 = xtiaot1 + (xtiaot2 - xtiaot1) * deltaaot;
 
-    dpres = (pres - tpres[ip1]) / (tpres[ip2] - tpres[ip1]);
+    dpres = (pres - lut->tpres[ip1]) / (lut->tpres[ip2] - lut->tpres[ip1]);
     *xtts = xtts1 + (xtts2 - xtts1) * dpres;
 }
 
@@ -629,21 +700,7 @@ void comproatm
     float raot550nm,    /* I: nearest value of AOT */
     int iband,          /* I: band index (0-based) */
     float pres,         /* I: surface pressure */
-    float tpres[7],     /* I: surface pressure table */
-    float aot550nm[22], /* I: AOT look-up table */
-    float ****rolutt,   /* I: intrinsic reflectance table
-                              [NSR_BANDS][7][22][8000] */
-    float **tsmax,      /* I: maximum scattering angle table [20][22] */
-    float **tsmin,      /* I: minimum scattering angle table [20][22] */
-    float **nbfic,      /* I: communitive number of azimuth angles [20][22] */
-    float **nbfi,       /* I: number of azimuth angles [20][22] */
-    float tts[22],      /* I: sun angle table */
-    int32 indts[22],
-    float **ttv,        /* I: view angle table [20][22] */
-    float xtsstep,      /* I: solar zenith step value */
-    float xtsmin,       /* I: minimum solar zenith value */
-    float xtvstep,      /* I: observation step value */
-    float xtvmin,       /* I: minimum observation value */
+    Lut_t *lut,         /* I: look-up tables */
     int its,            /* I: index for the sun angle table */
     int itv,            /* I: index for the view angle table */
     float *roatm        /* O: atmospheric reflectance */
@@ -666,32 +723,23 @@ void comproatm
     float ro1, ro2, ro3, ro4;
     float roiaot1, roiaot2;
     float t, u;
-    float logaot550nm[22] =
-        {-4.605170186, -2.995732274, -2.302585093,
-         -1.897119985, -1.609437912, -1.203972804,
-         -0.916290732, -0.510825624, -0.223143551,
-          0.000000000, 0.182321557, 0.336472237,
-          0.470003629, 0.587786665, 0.693157181,
-          0.832909123, 0.955511445, 1.098612289,
-          1.252762969, 1.386294361, 1.504077397,
-          1.609437912};
 
     cscaa = -xmus * xmuv - cosxfi * sqrt(1.0 - xmus * xmus) *
         sqrt(1.0 - xmuv * xmuv);
     scaa = acos(cscaa) * RAD2DEG;    /* vs / DEG2RAD */
 
-    nbfic1 = nbfic[itv][its];
-    nbfi1 = nbfi[itv][its];
-    nbfic2 = nbfic[itv][its+1];
-    nbfi2 = nbfi[itv][its+1];
-    nbfic3 = nbfic[itv+1][its];
-    nbfi3 = nbfi[itv+1][its];
-    nbfic4 = nbfic[itv+1][its+1];
-    nbfi4 = nbfi[itv+1][its+1];
+    nbfic1 = lut->nbfic[itv][its];
+    nbfi1 = lut->nbfi[itv][its];
+    nbfic2 = lut->nbfic[itv][its+1];
+    nbfi2 = lut->nbfi[itv][its+1];
+    nbfic3 = lut->nbfic[itv+1][its];
+    nbfi3 = lut->nbfi[itv+1][its];
+    nbfic4 = lut->nbfic[itv+1][its+1];
+    nbfi4 = lut->nbfi[itv+1][its+1];
 
     /* Compute for ip1, iaot1 */
     /* Interpolate point 1 (its,itv) vs scattering angle */
-    xtsmax = tsmax[itv][its];
+    xtsmax = lut->tsmax[itv][its];
     if ((its != 0) && (itv != 0))
     {
         isca = (int) ((xtsmax - scaa) * 0.25 + 1);   /* * 0.25 vs / 4.0 */
@@ -706,26 +754,26 @@ void comproatm
         {
             isca = nbfi1 - 1;
             sca1 = xtsmax - (isca - 1) * 4.0;
-            sca2 = tsmin[itv][its];
+            sca2 = lut->tsmin[itv][its];
         }
 
-        iindex = indts[its] + nbfic1 - nbfi1 + isca - 1;
-        roinf = rolutt[iband][ip1][iaot1][iindex];
-        rosup = rolutt[iband][ip1][iaot1][iindex+1];
+        iindex = lut->indts[its] + nbfic1 - nbfi1 + isca - 1;
+        roinf = lut->rolutt[iband][ip1][iaot1][iindex];
+        rosup = lut->rolutt[iband][ip1][iaot1][iindex+1];
         ro1 = roinf + (rosup - roinf) * (scaa - sca1) / (sca2 - sca1);
     }
     else
     {
         sca1 = xtsmax;
         sca2 = xtsmax;
-        iindex = indts[its] + nbfic1 - nbfi1;
-        roinf = rolutt[iband][ip1][iaot1][iindex];
+        iindex = lut->indts[its] + nbfic1 - nbfi1;
+        roinf = lut->rolutt[iband][ip1][iaot1][iindex];
         rosup = roinf;
         ro1 = roinf;
     }
 
     /* Interpolate point 2 (its+1,itv) vs scattering angle */
-    xtsmax = tsmax[itv][its+1];
+    xtsmax = lut->tsmax[itv][its+1];
     if (itv != 0)
     {
         isca = (int) ((xtsmax - scaa) * 0.25 + 1);   /* * 0.25 vs / 4.0 */
@@ -740,26 +788,26 @@ void comproatm
         {
             isca = nbfi2 - 1;
             sca1 = xtsmax - (isca - 1) * 4.0;
-            sca2 = tsmin[itv][its+1];
+            sca2 = lut->tsmin[itv][its+1];
         }
 
-        iindex = indts[its+1] + nbfic2 - nbfi2 + isca - 1;
-        roinf = rolutt[iband][ip1][iaot1][iindex];
-        rosup = rolutt[iband][ip1][iaot1][iindex+1];
+        iindex = lut->indts[its+1] + nbfic2 - nbfi2 + isca - 1;
+        roinf = lut->rolutt[iband][ip1][iaot1][iindex];
+        rosup = lut->rolutt[iband][ip1][iaot1][iindex+1];
         ro2 = roinf + (rosup - roinf) * (scaa - sca1) / (sca2 - sca1);
     }
     else
     {
         sca1 = xtsmax;
         sca2 = xtsmax;
-        iindex = indts[its+1] + nbfic2 - nbfi2;
-        roinf = rolutt[iband][ip1][iaot1][iindex];
+        iindex = lut->indts[its+1] + nbfic2 - nbfi2;
+        roinf = lut->rolutt[iband][ip1][iaot1][iindex];
         rosup = roinf;
         ro2 = roinf;
     }
 
     /* Interpolate point 3 (its,itv+1) vs scattering angle */
-    xtsmax = tsmax[itv+1][its];
+    xtsmax = lut->tsmax[itv+1][its];
     if (its != 0)
     {
         isca = (int) ((xtsmax - scaa) * 0.25 + 1);   /* * 0.25 vs / 4.0 */
@@ -774,26 +822,26 @@ void comproatm
         {
             isca = nbfi3 - 1;
             sca1 = xtsmax - (isca - 1) * 4.0;
-            sca2 = tsmin[itv+1][its];
+            sca2 = lut->tsmin[itv+1][its];
         }
 
-        iindex = indts[its] + nbfic3 - nbfi3 + isca - 1;
-        roinf = rolutt[iband][ip1][iaot1][iindex];
-        rosup = rolutt[iband][ip1][iaot1][iindex+1];
+        iindex = lut->indts[its] + nbfic3 - nbfi3 + isca - 1;
+        roinf = lut->rolutt[iband][ip1][iaot1][iindex];
+        rosup = lut->rolutt[iband][ip1][iaot1][iindex+1];
         ro3 = roinf + (rosup - roinf) * (scaa - sca1) / (sca2 - sca1);
     }
     else
     {
         sca1 = xtsmax;
         sca2 = xtsmax;
-        iindex = indts[its] + nbfic3 - nbfi3;
-        roinf = rolutt[iband][ip1][iaot1][iindex];
+        iindex = lut->indts[its] + nbfic3 - nbfi3;
+        roinf = lut->rolutt[iband][ip1][iaot1][iindex];
         rosup = roinf;
         ro3 = roinf;
     }
 
     /* Interpolate point 4 (its+1,itv+1) vs scattering angle */
-    xtsmax = tsmax[itv+1][its+1];
+    xtsmax = lut->tsmax[itv+1][its+1];
     isca = (int) ((xtsmax - scaa) * 0.25 + 1);   /* * 0.25 vs / 4.0 */
     if (isca <= 0)
         isca = 1;
@@ -806,23 +854,24 @@ void comproatm
     {
         isca = nbfi4 - 1;
         sca1 = xtsmax - (isca - 1) * 4.0;
-        sca2 = tsmin[itv+1][its+1];
+        sca2 = lut->tsmin[itv+1][its+1];
     }
 
-    iindex = indts[its+1] + nbfic4 - nbfi4 + isca - 1;
-    roinf = rolutt[iband][ip1][iaot1][iindex];
-    rosup = rolutt[iband][ip1][iaot1][iindex+1];
+    iindex = lut->indts[its+1] + nbfic4 - nbfi4 + isca - 1;
+    roinf = lut->rolutt[iband][ip1][iaot1][iindex];
+    rosup = lut->rolutt[iband][ip1][iaot1][iindex+1];
     ro4 = roinf + (rosup - roinf) * (scaa - sca1) / (sca2 - sca1);
 
     /* Note: t and u are used elsewhere through this function */
-    t = (tts[its+1] - xts) / (tts[its+1] - tts[its]);
-    u = (ttv[itv+1][its] - xtv) / (ttv[itv+1][its] - ttv[itv][its]);
+    t = (lut->tts[its+1] - xts) / (lut->tts[its+1] - lut->tts[its]);
+    u = (lut->ttv[itv+1][its] - xtv) /
+        (lut->ttv[itv+1][its] - lut->ttv[itv][its]);
     roiaot1 = ro1 * t * u + ro2 * u * (1.0 - t) + ro3 * (1.0 - u) * t +
         ro4 * (1.0 - u) * (1.0 - t);
 
     /* Compute for ip1, iaot2 */
     /* Interpolate point 1 (its,itv) vs scattering angle */
-    xtsmax = tsmax[itv][its];
+    xtsmax = lut->tsmax[itv][its];
     if ((its != 0) && (itv != 0))
     {
         isca = (int) ((xtsmax - scaa) * 0.25 + 1);   /* * 0.25 vs / 4.0 */
@@ -837,26 +886,26 @@ void comproatm
         {
             isca = nbfi1 - 1;
             sca1 = xtsmax - (isca - 1) * 4.0;
-            sca2 = tsmin[itv][its];
+            sca2 = lut->tsmin[itv][its];
         }
 
-        iindex = indts[its] + nbfic1 - nbfi1 + isca - 1;
-        roinf = rolutt[iband][ip1][iaot2][iindex];
-        rosup = rolutt[iband][ip1][iaot2][iindex+1];
+        iindex = lut->indts[its] + nbfic1 - nbfi1 + isca - 1;
+        roinf = lut->rolutt[iband][ip1][iaot2][iindex];
+        rosup = lut->rolutt[iband][ip1][iaot2][iindex+1];
         ro1 = roinf + (rosup - roinf) * (scaa - sca1) / (sca2 - sca1);
     }
     else
     {
         sca1 = xtsmax;
         sca2 = xtsmax;
-        iindex = indts[its] + nbfic1 - nbfi1;
-        roinf = rolutt[iband][ip1][iaot2][iindex];
+        iindex = lut->indts[its] + nbfic1 - nbfi1;
+        roinf = lut->rolutt[iband][ip1][iaot2][iindex];
         rosup = roinf;
         ro1 = roinf;
     }
 
     /* Interpolate point 2 (its+1,itv) vs scattering angle */
-    xtsmax = tsmax[itv][its+1];
+    xtsmax = lut->tsmax[itv][its+1];
     if (itv != 0)
     {
         isca = (int) ((xtsmax - scaa) * 0.25 + 1);   /* * 0.25 vs / 4.0 */
@@ -871,26 +920,26 @@ void comproatm
         {
             isca = nbfi2 - 1;
             sca1 = xtsmax - (isca - 1) * 4.0;
-            sca2 = tsmin[itv][its+1];
+            sca2 = lut->tsmin[itv][its+1];
         }
 
-        iindex = indts[its+1] + nbfic2 - nbfi2 + isca - 1;
-        roinf = rolutt[iband][ip1][iaot2][iindex];
-        rosup = rolutt[iband][ip1][iaot2][iindex+1];
+        iindex = lut->indts[its+1] + nbfic2 - nbfi2 + isca - 1;
+        roinf = lut->rolutt[iband][ip1][iaot2][iindex];
+        rosup = lut->rolutt[iband][ip1][iaot2][iindex+1];
         ro2 = roinf + (rosup - roinf) * (scaa - sca1) / (sca2 - sca1);
     }
     else
     {
         sca1 = xtsmax;
         sca2 = xtsmax;
-        iindex = indts[its+1] + nbfic2 - nbfi2;
-        roinf = rolutt[iband][ip1][iaot2][iindex];
+        iindex = lut->indts[its+1] + nbfic2 - nbfi2;
+        roinf = lut->rolutt[iband][ip1][iaot2][iindex];
         rosup = roinf;
         ro2 = roinf;
     }
 
     /* Interpolate point 3 (its,itv+1) vs scattering angle */
-    xtsmax = tsmax[itv+1][its];
+    xtsmax = lut->tsmax[itv+1][its];
     if (its != 0)
     {
         isca = (int) ((xtsmax - scaa) * 0.25 + 1);   /* * 0.25 vs / 4.0 */
@@ -905,26 +954,26 @@ void comproatm
         {
             isca = nbfi3 - 1;
             sca1 = xtsmax - (isca - 1) * 4.0;
-            sca2 = tsmin[itv+1][its];
+            sca2 = lut->tsmin[itv+1][its];
         }
 
-        iindex = indts[its] + nbfic3 - nbfi3 + isca - 1;
-        roinf = rolutt[iband][ip1][iaot2][iindex];
-        rosup = rolutt[iband][ip1][iaot2][iindex+1];
+        iindex = lut->indts[its] + nbfic3 - nbfi3 + isca - 1;
+        roinf = lut->rolutt[iband][ip1][iaot2][iindex];
+        rosup = lut->rolutt[iband][ip1][iaot2][iindex+1];
         ro3 = roinf + (rosup - roinf) * (scaa - sca1) / (sca2 - sca1);
     }
     else
     {
         sca1 = xtsmax;
         sca2 = xtsmax;
-        iindex = indts[its] + nbfic3 - nbfi3;
-        roinf = rolutt[iband][ip1][iaot2][iindex];
+        iindex = lut->indts[its] + nbfic3 - nbfi3;
+        roinf = lut->rolutt[iband][ip1][iaot2][iindex];
         rosup = roinf;
         ro3 = roinf;
     }
 
     /* Interpolate point 4 (its+1,itv+1) vs scattering angle */
-    xtsmax = tsmax[itv+1][its+1];
+    xtsmax = lut->tsmax[itv+1][its+1];
     isca = (int) ((xtsmax - scaa) * 0.25 + 1);   /* * 0.25 vs / 4.0 */
     if (isca <= 0)
         isca = 1;
@@ -937,12 +986,12 @@ void comproatm
     {
         isca = nbfi4 - 1;
         sca1 = xtsmax - (isca - 1) * 4.0;
-        sca2 = tsmin[itv+1][its+1];
+        sca2 = lut->tsmin[itv+1][its+1];
     }
 
-    iindex = indts[its+1] + nbfic4 - nbfi4 + isca - 1;
-    roinf = rolutt[iband][ip1][iaot2][iindex];
-    rosup = rolutt[iband][ip1][iaot2][iindex+1];
+    iindex = lut->indts[its+1] + nbfic4 - nbfi4 + isca - 1;
+    roinf = lut->rolutt[iband][ip1][iaot2][iindex];
+    rosup = lut->rolutt[iband][ip1][iaot2][iindex+1];
     ro4 = roinf + (rosup - roinf) * (scaa - sca1) / (sca2 - sca1);
 
     roiaot2 = ro1 * t * u + ro2 * u * (1.0 - t) + ro3 * (1.0 - u) * t +
@@ -957,7 +1006,7 @@ void comproatm
 
     /* Compute for ip2, iaot1 */
     /* Interpolate point 1 (its,itv) vs scattering angle */
-    xtsmax = tsmax[itv][its];
+    xtsmax = lut->tsmax[itv][its];
     if ((its != 0) && (itv != 0))
     {
         isca = (int) ((xtsmax - scaa) * 0.25 + 1);   /* * 0.25 vs / 4.0 */
@@ -972,26 +1021,26 @@ void comproatm
         {
             isca = nbfi1 - 1;
             sca1 = xtsmax - (isca - 1) * 4.0;
-            sca2 = tsmin[itv][its];
+            sca2 = lut->tsmin[itv][its];
         }
 
-        iindex = indts[its] + nbfic1 - nbfi1 + isca - 1;
-        roinf = rolutt[iband][ip2][iaot1][iindex];
-        rosup = rolutt[iband][ip2][iaot1][iindex+1];
+        iindex = lut->indts[its] + nbfic1 - nbfi1 + isca - 1;
+        roinf = lut->rolutt[iband][ip2][iaot1][iindex];
+        rosup = lut->rolutt[iband][ip2][iaot1][iindex+1];
         ro1 = roinf + (rosup - roinf) * (scaa - sca1) / (sca2 - sca1);
     }
     else
     {
         sca1 = xtsmax;
         sca2 = xtsmax;
-        iindex = indts[its] + nbfic1 - nbfi1;
-        roinf = rolutt[iband][ip2][iaot1][iindex];
+        iindex = lut->indts[its] + nbfic1 - nbfi1;
+        roinf = lut->rolutt[iband][ip2][iaot1][iindex];
         rosup = roinf;
         ro1 = roinf;
     }
 
     /* Interpolate point 2 (its+1,itv) vs scattering angle */
-    xtsmax = tsmax[itv][its+1];
+    xtsmax = lut->tsmax[itv][its+1];
     if (itv != 0)
     {
         isca = (int) ((xtsmax - scaa) * 0.25 + 1);   /* * 0.25 vs / 4.0 */
@@ -1006,26 +1055,26 @@ void comproatm
         {
             isca = nbfi2 - 1;
             sca1 = xtsmax - (isca - 1) * 4.0;
-            sca2 = tsmin[itv][its+1];
+            sca2 = lut->tsmin[itv][its+1];
         }
 
-        iindex = indts[its+1] + nbfic2 - nbfi2 + isca - 1;
-        roinf = rolutt[iband][ip2][iaot1][iindex];
-        rosup = rolutt[iband][ip2][iaot1][iindex+1];
+        iindex = lut->indts[its+1] + nbfic2 - nbfi2 + isca - 1;
+        roinf = lut->rolutt[iband][ip2][iaot1][iindex];
+        rosup = lut->rolutt[iband][ip2][iaot1][iindex+1];
         ro2 = roinf + (rosup - roinf) * (scaa - sca1) / (sca2 - sca1);
     }
     else
     {
         sca1 = xtsmax;
         sca2 = xtsmax;
-        iindex = indts[its+1] + nbfic2 - nbfi2;
-        roinf = rolutt[iband][ip2][iaot1][iindex];
+        iindex = lut->indts[its+1] + nbfic2 - nbfi2;
+        roinf = lut->rolutt[iband][ip2][iaot1][iindex];
         rosup = roinf;
         ro2 = roinf;
     }
 
     /* Interpolate point 3 (its,itv+1) vs scattering angle */
-    xtsmax = tsmax[itv+1][its];
+    xtsmax = lut->tsmax[itv+1][its];
     if (its != 0)
     {
         isca = (int) ((xtsmax - scaa) * 0.25 + 1);   /* * 0.25 vs / 4.0 */
@@ -1040,26 +1089,26 @@ void comproatm
         {
             isca = nbfi3 - 1;
             sca1 = xtsmax - (isca - 1) * 4.0;
-            sca2 = tsmin[itv+1][its];
+            sca2 = lut->tsmin[itv+1][its];
         }
 
-        iindex = indts[its] + nbfic3 - nbfi3 + isca - 1;
-        roinf = rolutt[iband][ip2][iaot1][iindex];
-        rosup = rolutt[iband][ip2][iaot1][iindex+1];
+        iindex = lut->indts[its] + nbfic3 - nbfi3 + isca - 1;
+        roinf = lut->rolutt[iband][ip2][iaot1][iindex];
+        rosup = lut->rolutt[iband][ip2][iaot1][iindex+1];
         ro3 = roinf + (rosup - roinf) * (scaa - sca1) / (sca2 - sca1);
     }
     else
     {
         sca1 = xtsmax;
         sca2 = xtsmax;
-        iindex = indts[its] + nbfic3 - nbfi3;
-        roinf = rolutt[iband][ip2][iaot1][iindex];
+        iindex = lut->indts[its] + nbfic3 - nbfi3;
+        roinf = lut->rolutt[iband][ip2][iaot1][iindex];
         rosup = roinf;
         ro3 = roinf;
     }
 
     /* Interpolate point 4 (its+1,itv+1) vs scattering angle */
-    xtsmax = tsmax[itv+1][its+1];
+    xtsmax = lut->tsmax[itv+1][its+1];
     isca = (int) ((xtsmax - scaa) * 0.25 + 1);   /* * 0.25 vs / 4.0 */
     if (isca <= 0)
         isca = 1;
@@ -1072,12 +1121,12 @@ void comproatm
     {
         isca = nbfi4 - 1;
         sca1 = xtsmax - (isca - 1) * 4.0;
-        sca2 = tsmin[itv+1][its+1];
+        sca2 = lut->tsmin[itv+1][its+1];
     }
 
-    iindex = indts[its+1] + nbfic4 - nbfi4 + isca - 1;
-    roinf = rolutt[iband][ip2][iaot1][iindex];
-    rosup = rolutt[iband][ip2][iaot1][iindex+1];
+    iindex = lut->indts[its+1] + nbfic4 - nbfi4 + isca - 1;
+    roinf = lut->rolutt[iband][ip2][iaot1][iindex];
+    rosup = lut->rolutt[iband][ip2][iaot1][iindex+1];
     ro4 = roinf + (rosup - roinf) * (scaa - sca1) / (sca2 - sca1);
 
     roiaot1 = ro1 * t * u + ro2 * u * (1.0 - t) + ro3 * (1.0 - u) * t +
@@ -1085,7 +1134,7 @@ void comproatm
 
     /* Compute for ip2, iaot2 */
     /* Interpolate point 1 (its,itv) vs scattering angle */
-    xtsmax = tsmax[itv][its];
+    xtsmax = lut->tsmax[itv][its];
     if ((its != 0) && (itv != 0))
     {
         isca = (int) ((xtsmax - scaa) * 0.25 + 1);   /* * 0.25 vs / 4.0 */
@@ -1100,26 +1149,26 @@ void comproatm
         {
             isca = nbfi1 - 1;
             sca1 = xtsmax - (isca - 1) * 4.0;
-            sca2 = tsmin[itv][its];
+            sca2 = lut->tsmin[itv][its];
         }
 
-        iindex = indts[its] + nbfic1 - nbfi1 + isca - 1;
-        roinf = rolutt[iband][ip2][iaot2][iindex];
-        rosup = rolutt[iband][ip2][iaot2][iindex+1];
+        iindex = lut->indts[its] + nbfic1 - nbfi1 + isca - 1;
+        roinf = lut->rolutt[iband][ip2][iaot2][iindex];
+        rosup = lut->rolutt[iband][ip2][iaot2][iindex+1];
         ro1 = roinf + (rosup - roinf) * (scaa - sca1) / (sca2 - sca1);
     }
     else
     {
         sca1 = xtsmax;
         sca2 = xtsmax;
-        iindex = indts[its] + nbfic1 - nbfi1;
-        roinf = rolutt[iband][ip2][iaot2][iindex];
+        iindex = lut->indts[its] + nbfic1 - nbfi1;
+        roinf = lut->rolutt[iband][ip2][iaot2][iindex];
         rosup = roinf;
         ro1 = roinf;
     }
 
     /* Interpolate point 2 (its+1,itv) vs scattering angle */
-    xtsmax = tsmax[itv][its+1];
+    xtsmax = lut->tsmax[itv][its+1];
     if (itv != 0)
     {
         isca = (int) ((xtsmax - scaa) * 0.25 + 1);   /* * 0.25 vs / 4.0 */
@@ -1134,26 +1183,26 @@ void comproatm
         {
             isca = nbfi2 - 1;
             sca1 = xtsmax - (isca - 1) * 4.0;
-            sca2 = tsmin[itv][its+1];
+            sca2 = lut->tsmin[itv][its+1];
         }
 
-        iindex = indts[its+1] + nbfic2 - nbfi2 + isca - 1;
-        roinf = rolutt[iband][ip2][iaot2][iindex];
-        rosup = rolutt[iband][ip2][iaot2][iindex+1];
+        iindex = lut->indts[its+1] + nbfic2 - nbfi2 + isca - 1;
+        roinf = lut->rolutt[iband][ip2][iaot2][iindex];
+        rosup = lut->rolutt[iband][ip2][iaot2][iindex+1];
         ro2 = roinf + (rosup - roinf) * (scaa - sca1) / (sca2 - sca1);
     }
     else
     {
         sca1 = xtsmax;
         sca2 = xtsmax;
-        iindex = indts[its+1] + nbfic2 - nbfi2;
-        roinf = rolutt[iband][ip2][iaot2][iindex];
+        iindex = lut->indts[its+1] + nbfic2 - nbfi2;
+        roinf = lut->rolutt[iband][ip2][iaot2][iindex];
         rosup = roinf;
         ro2 = roinf;
     }
 
     /* Interpolate point 3 (its,itv+1) vs scattering angle */
-    xtsmax = tsmax[itv+1][its];
+    xtsmax = lut->tsmax[itv+1][its];
     if (its != 0)
     {
         isca = (int) ((xtsmax - scaa) * 0.25 + 1);   /* * 0.25 vs / 4.0 */
@@ -1168,26 +1217,26 @@ void comproatm
         {
             isca = nbfi3 - 1;
             sca1 = xtsmax - (isca - 1) * 4.0;
-            sca2 = tsmin[itv+1][its];
+            sca2 = lut->tsmin[itv+1][its];
         }
 
-        iindex = indts[its] + nbfic3 - nbfi3 + isca - 1;
-        roinf = rolutt[iband][ip2][iaot2][iindex];
-        rosup = rolutt[iband][ip2][iaot2][iindex+1];
+        iindex = lut->indts[its] + nbfic3 - nbfi3 + isca - 1;
+        roinf = lut->rolutt[iband][ip2][iaot2][iindex];
+        rosup = lut->rolutt[iband][ip2][iaot2][iindex+1];
         ro3 = roinf + (rosup - roinf) * (scaa - sca1) / (sca2 - sca1);
     }
     else
     {
         sca1 = xtsmax;
         sca2 = xtsmax;
-        iindex = indts[its] + nbfic3 - nbfi3;
-        roinf = rolutt[iband][ip2][iaot2][iindex];
+        iindex = lut->indts[its] + nbfic3 - nbfi3;
+        roinf = lut->rolutt[iband][ip2][iaot2][iindex];
         rosup = roinf;
         ro3 = roinf;
     }
 
     /* Interpolate point 4 (its+1,itv+1) vs scattering angle */
-    xtsmax = tsmax[itv+1][its+1];
+    xtsmax = lut->tsmax[itv+1][its+1];
     isca = (int) ((xtsmax - scaa) * 0.25 + 1);   /* * 0.25 vs / 4.0 */
     if (isca <= 0)
         isca = 1;
@@ -1200,12 +1249,12 @@ void comproatm
     {
         isca = nbfi4 - 1;
         sca1 = xtsmax - (isca - 1) * 4.0;
-        sca2 = tsmin[itv+1][its+1];
+        sca2 = lut->tsmin[itv+1][its+1];
     }
 
-    iindex = indts[its+1] + nbfic4 - nbfi4 + isca - 1;
-    roinf = rolutt[iband][ip2][iaot2][iindex];
-    rosup = rolutt[iband][ip2][iaot2][iindex+1];
+    iindex = lut->indts[its+1] + nbfic4 - nbfi4 + isca - 1;
+    roinf = lut->rolutt[iband][ip2][iaot2][iindex];
+    rosup = lut->rolutt[iband][ip2][iaot2][iindex+1];
     ro4 = roinf + (rosup - roinf) * (scaa - sca1) / (sca2 - sca1);
 
     roiaot2 = ro1 * t * u + ro2 * u * (1.0 - t) + ro3 * (1.0 - u) * t +
@@ -1215,7 +1264,7 @@ void comproatm
     ro = roiaot1 + (roiaot2 - roiaot1) * deltaaot;
     rop2 = ro;
 
-    dpres = (pres - tpres[ip1]) / (tpres[ip2] - tpres[ip1]);
+    dpres = (pres - lut->tpres[ip1]) / (lut->tpres[ip2] - lut->tpres[ip1]);
     *roatm = rop1 + (rop2 - rop1) * dpres;
 }
 
@@ -1247,28 +1296,18 @@ Date         Programmer       Reason
 8/14/2014    Gail Schmidt     Updated for v1.3 delivered by Eric Vermote
 
 NOTES:
+1. The tables and the table constants (which used to be defined in the main
+   routine) are stored in a single Lut_t structure, so they can be written
+   to and mapped from a binary file.
+2. TTS and INDTS are read through buffers sized for the [20][22] edges, so
+   the reads can't overrun the tables that follow them in the structure.
+3. The NBFI SDS is stored in the nbfic table and the NBFIC SDS in the nbfi
+   table.  The main routine always passed these two tables to readluts in
+   swapped order, and comproatm has been validated with that pairing.
 ******************************************************************************/
 int readluts
 (
-    float **tsmax,              /* O: maximum scattering angle table [20][22] */
-    float **tsmin,              /* O: minimum scattering angle table [20][22] */
-    float **ttv,                /* O: view angle table [20][22] */
-    float tts[22],              /* O: sun angle table */
-    float **nbfic,              /* O: communitive number of azimuth angles
-                                      [20][22] */
-    float **nbfi,               /* O: number of azimuth angles [20][22] */
-    int32 indts[22],            /* O: */
-    float ****rolutt,           /* O: intrinsic reflectance table
-                                      [NSR_BANDS][7][22][8000] */
-    float ****transt,           /* O: transmission table
-                                      [NSR_BANDS][7][22][22] */
-    float ***sphalbt,           /* O: spherical albedo table
-                                      [NSR_BANDS][7][22] */
-    float ***normext,           /* O: aerosol extinction coefficient at the
-                                      current wavelength (normalized at 550nm)
-                                      [NSR_BANDS][7][22] */
-    float xtsstep,              /* I: solar zenith step value */
-    float xtsmin,               /* I: minimum solar zenith value */
+    Lut_t *lut,                 /* O: look-up tables */
     char anglehdf[STR_SIZE],    /* I: angle HDF filename */
     char intrefnm[STR_SIZE],    /* I: intrinsic reflectance filename */
     char transmnm[STR_SIZE],    /* I: transmission filename */
@@ -1290,6 +1329,8 @@ int readluts
     char fname[STR_SIZE];   /* filename to be read */
     float *rolut = NULL;    /* intrinsic reflectance read from HDF file
                                [8000*22*7] */
+    float ttsbuf[20*22];    /* TTS read from the HDF file */
+    int32 indtsbuf[20*22];  /* INDTS read from the HDF file */
     float ttsr[22];        /* GAIL - should this be 21 instead?? */
     float xx;               /* temporary float values, not used */
     int sd_id;              /* file ID for the HDF file */
@@ -1297,15 +1338,60 @@ int readluts
     int sds_index;          /* index for the current SDS */
     FILE *fp = NULL;        /* file pointer for reading ascii files */
 
+    /* Table constants */
+    float aot550nm[NAOT_VALS] =  /* AOT look-up table */
+        {0.01, 0.05, 0.10, 0.15, 0.20, 0.30, 0.40, 0.60, 0.80, 1.00, 1.20,
+         1.40, 1.60, 1.80, 2.00, 2.30, 2.60, 3.00, 3.50, 4.00, 4.50, 5.00};
+    float tpres[NPRES_VALS] =    /* surface pressure table */
+        {1050.0, 1013.0, 900.0, 800.0, 700.0, 600.0, 500.0};
+
+    /* Atmospheric correction variables */
+    /* Look up table for atmospheric and geometric quantities */
+    float tauray[NSR_BANDS] =  /* molecular optical thickness coefficients --
+        produced by running 6S */
+        {0.23638, 0.16933, 0.09070, 0.04827, 0.01563, 0.00129, 0.00037,
+         0.07984};
+    double oztransa[NSR_BANDS] =   /* ozone transmission coeff */
+        {-0.00255649, -0.0177861, -0.0969872, -0.0611428, 0.0001, 0.0001,
+          0.0001, -0.0834061};
+    double wvtransa[NSR_BANDS] =   /* water vapor transmission coeff */
+        {2.29849e-27, 2.29849e-27, 0.00194772, 0.00404159, 0.000729136,
+         0.00067324, 0.0177533, 0.00279738};
+    double wvtransb[NSR_BANDS] =   /* water vapor transmission coeff */
+        {0.999742, 0.999742, 0.775024, 0.774482, 0.893085, 0.939669, 0.65094,
+         0.759952};
+    double ogtransa1[NSR_BANDS] =  /* other gases transmission coeff */
+        {4.91586e-20, 4.91586e-20, 4.91586e-20, 1.04801e-05, 1.35216e-05,
+         0.0205425, 0.0256526, 0.000214329};
+    double ogtransb0[NSR_BANDS] =  /* other gases transmission coeff */
+        {0.000197019, 0.000197019, 0.000197019, 0.640215, -0.195998, 0.326577,
+         0.243961, 0.396322};
+    double ogtransb1[NSR_BANDS] =  /* other gases transmission coeff */
+        {9.57011e-16, 9.57011e-16, 9.57011e-16, -0.348785, 0.275239, 0.0117192,
+         0.0616101, 0.04728};
+
+    /* Identify the tables and store the table constants */
+    memset (lut, 0, sizeof (Lut_t));
+    strcpy (lut->magic, LUT_MAGIC);
+    lut->version = LUT_VERSION;
+    lut->size = sizeof (Lut_t);
+    memcpy (lut->aot550nm, aot550nm, sizeof (aot550nm));
+    memcpy (lut->tpres, tpres, sizeof (tpres));
+    memcpy (lut->tauray, tauray, sizeof (tauray));
+    memcpy (lut->oztransa, oztransa, sizeof (oztransa));
+    memcpy (lut->wvtransa, wvtransa, sizeof (wvtransa));
+    memcpy (lut->wvtransb, wvtransb, sizeof (wvtransb));
+    memcpy (lut->ogtransa1, ogtransa1, sizeof (ogtransa1));
+    memcpy (lut->ogtransb0, ogtransb0, sizeof (ogtransb0));
+    memcpy (lut->ogtransb1, ogtransb1, sizeof (ogtransb1));
+    lut->xtsmin = 0;
+    lut->xtsstep = 4.0;
+    lut->xtvmin = 2.84090;
+    lut->xtvstep = 6.52107 - lut->xtvmin;
+
     /* Initialize some variables */
-    for (i = 0; i < 20; i++)
-    {
-        for (j = 0; j < 22; j++)
-        {
-            nbfic[i][j] = 0.0;
-            tts[j] = xtsmin + xtsstep * j;
-        }
-    }
+    for (j = 0; j < NSOLAR_ZEN_VALS; j++)
+        lut->tts[j] = lut->xtsmin + lut->xtsstep * j;
 
     /* Open as HDF file for reading */
     sd_id = SDstart (anglehdf, DFACC_RDONLY);
@@ -1344,7 +1430,7 @@ int readluts
     for (i = 0; i < 20; i++)
     {
         start[0] = i;   /* lines */
-        status = SDreaddata (sds_id, start, NULL, edges, tsmax[i]);
+        status = SDreaddata (sds_id, start, NULL, edges, lut->tsmax[i]);
         if (status == -1)
         {
             sprintf (errmsg, "Reading data from the TSMAX SDS");
@@ -1384,7 +1470,7 @@ int readluts
     for (i = 0; i < 20; i++)
     {
         start[0] = i;   /* lines */
-        status = SDreaddata (sds_id, start, NULL, edges, tsmin[i]);
+        status = SDreaddata (sds_id, start, NULL, edges, lut->tsmin[i]);
         if (status == -1)
         {
             sprintf (errmsg, "Reading data from the TSMIN SDS");
@@ -1424,7 +1510,7 @@ int readluts
     for (i = 0; i < 20; i++)
     {
         start[0] = i;   /* lines */
-        status = SDreaddata (sds_id, start, NULL, edges, ttv[i]);
+        status = SDreaddata (sds_id, start, NULL, edges, lut->ttv[i]);
         if (status == -1)
         {
             sprintf (errmsg, "Reading data from the TTV SDS");
@@ -1442,7 +1528,7 @@ int readluts
         return (ERROR);
     }
 
-    /* Find the NBFI SDS */
+    /* Find the NBFI SDS (stored in nbfic, see the notes) */
     sds_index = SDnametoindex (sd_id, "NBFI");
     if (sds_index == -1)
     {
@@ -1464,7 +1550,7 @@ int readluts
     for (i = 0; i < 20; i++)
     {
         start[0] = i;   /* lines */
-        status = SDreaddata (sds_id, start, NULL, edges, nbfi[i]);
+        status = SDreaddata (sds_id, start, NULL, edges, lut->nbfic[i]);
         if (status == -1)
         {
             sprintf (errmsg, "Reading data from the NBFI SDS");
@@ -1482,7 +1568,7 @@ int readluts
         return (ERROR);
     }
 
-    /* Find the NBFIC SDS */
+    /* Find the NBFIC SDS (stored in nbfi, see the notes) */
     sds_index = SDnametoindex (sd_id, "NBFIC");
     if (sds_index == -1)
     {
@@ -1504,7 +1590,7 @@ int readluts
     for (i = 0; i < 20; i++)
     {
         start[0] = i;   /* lines */
-        status = SDreaddata (sds_id, start, NULL, edges, nbfic[i]);
+        status = SDreaddata (sds_id, start, NULL, edges, lut->nbfi[i]);
         if (status == -1)
         {
             sprintf (errmsg, "Reading data from the NBFIC SDS");
@@ -1544,13 +1630,15 @@ int readluts
     start[1] = 0;   /* samples */
     edges[0] = 20;  /* number of lines */
     edges[1] = 22;  /* number of samples */
-    status = SDreaddata (sds_id, start, NULL, edges, indts);
+    memset (indtsbuf, 0, sizeof (indtsbuf));
+    status = SDreaddata (sds_id, start, NULL, edges, indtsbuf);
     if (status == -1)
     {
         sprintf (errmsg, "Reading data from the INDTS SDS");
         error_handler (true, FUNC_NAME, errmsg);
         return (ERROR);
     }
+    memcpy (lut->indts, indtsbuf, sizeof (lut->indts));
 
     /* Close the HDF SDS */
     status = SDendaccess (sds_id);
@@ -1583,13 +1671,15 @@ int readluts
     start[1] = 0;   /* samples */
     edges[0] = 20;  /* number of lines */
     edges[1] = 22;  /* number of samples */
-    status = SDreaddata (sds_id, start, NULL, edges, tts);
+    memcpy (ttsbuf, lut->tts, sizeof (lut->tts));
+    status = SDreaddata (sds_id, start, NULL, edges, ttsbuf);
     if (status == -1)
     {
         sprintf (errmsg, "Reading data from the TTS SDS");
         error_handler (true, FUNC_NAME, errmsg);
         return (ERROR);
     }
+    memcpy (lut->tts, ttsbuf, sizeof (lut->tts));
 
     /* Close the HDF SDS */
     status = SDendaccess (sds_id);
@@ -1684,7 +1774,7 @@ int readluts
         for (ipres = 0; ipres < 7; ipres++)
             for (itau = 0; itau < 22; itau++)
                 for (ival = 0; ival < 8000; ival++)
-                    rolutt[iband][ipres][itau][ival] =
+                    lut->rolutt[iband][ipres][itau][ival] =
                         rolut[ival*22*7 + itau*7 + ipres];
     }  /* for iband */
 
@@ -1749,7 +1839,7 @@ int readluts
                     return (ERROR);
                 }
 
-                if (fabs (tts[i] - ttsr[i]) > 1.0E-5)
+                if (fabs (lut->tts[i] - ttsr[i]) > 1.0E-5)
                 {
                     sprintf (errmsg, "Problem with transmission LUT: %s",
                         transmnm);
@@ -1762,7 +1852,8 @@ int readluts
                    for reading. */
                 for (iaot = 0; iaot < 22; iaot++)
                 {
-                    if (fscanf (fp, "%f", &transt[iband][ipres][iaot][i]) != 1)
+                    if (fscanf (fp, "%f", &lut->transt[iband][ipres][iaot][i])
+                        != 1)
                     {
                         sprintf (errmsg, "Reading transmission values from "
                             "transmission coefficient file: %s", transmnm);
@@ -1825,8 +1916,9 @@ int readluts
             /* 22 lines of spherical albedo information */
             for (iaot = 0; iaot < 22; iaot++)
             {
-                if (fscanf (fp, "%f %f %f\n", &xx, &sphalbt[iband][ipres][iaot],
-                    &normext[iband][ipres][iaot]) != 3)
+                if (fscanf (fp, "%f %f %f\n", &xx,
+                    &lut->sphalbt[iband][ipres][iaot],
+                    &lut->normext[iband][ipres][iaot]) != 3)
                 {
                     sprintf (errmsg, "Reading spherical albedo values from "
                         "spherical albedo coefficient file: %s", spheranm);
@@ -1846,10 +1938,10 @@ int readluts
 
 
 /******************************************************************************
-MODULE:  memory_allocation_main
+MODULE:  memory_allocation_bands
 
-PURPOSE:  Allocates memory for all the various arrays within the L8 surface
-reflectance application for the main application.
+PURPOSE:  Allocates memory for the QA band and the TOA reflectance and
+brightness temperature bands of a stripe of lines for the main application.
 
 RETURN VALUE:
 Type = int
@@ -1871,16 +1963,16 @@ NOTES:
   2. Each array passed into this function is passed in as the address to that
      1D, 2D, nD array.
 ******************************************************************************/
-int memory_allocation_main
+int memory_allocation_bands
 (
-    int nlines,          /* I: number of lines in the scene */
+    int nlines,          /* I: number of lines of the stripe */
     int nsamps,          /* I: number of samples in the scene */
-    uint16 **qaband,     /* O: QA band for the input image, nlines x nsamps */
-    int16 ***sband       /* O: output surface reflectance and brightness temp
-                               bands */
+    uint16 **qaband,     /* O: QA band of the stripe, nlines x nsamps */
+    int16 ***sband       /* O: output TOA reflectance and brightness temp
+                               bands of the stripe */
 )
 {
-    char FUNC_NAME[] = "memory_allocation_main"; /* function name */
+    char FUNC_NAME[] = "memory_allocation_bands"; /* function name */
     char errmsg[STR_SIZE];   /* error message */
     int i;                   /* looping variables */
 
@@ -1920,8 +2012,8 @@ int memory_allocation_main
 /******************************************************************************
 MODULE:  memory_allocation_sr
 
-PURPOSE:  Allocates memory for all the various arrays needed specifically for
-the L8 surface reflectance corrections.
+PURPOSE:  Allocates memory for the window of the climate modeling grids
+needed specifically for the L8 surface reflectance corrections.
 
 RETURN VALUE:
 Type = int
@@ -1943,170 +2035,44 @@ NOTES:
      calling routine to free this memory.
   2. Each array passed into this function is passed in as the address to that
      1D, 2D, nD array.
+  3. The per-pixel arrays are allocated by compute_sr_refl for the stripes of
+     each of its passes.
 ******************************************************************************/
 int memory_allocation_sr
 (
-    int nlines,          /* I: number of lines in the scene */
-    int nsamps,          /* I: number of samples in the scene */
-    int16 **aerob1,      /* O: atmospherically corrected band 1 data
-                               (TOA refl), nlines x nsamps */
-    int16 **aerob2,      /* O: atmospherically corrected band 2 data
-                               (TOA refl), nlines x nsamps */
-    int16 **aerob4,      /* O: atmospherically corrected band 4 data
-                               (TOA refl), nlines x nsamps */
-    int16 **aerob5,      /* O: atmospherically corrected band 5 data
-                               (TOA refl), nlines x nsamps */
-    int16 **aerob7,      /* O: atmospherically corrected band 7 data
-                               (TOA refl), nlines x nsamps */
-    uint8 **cloud,       /* O: bit-packed value that represent clouds,
-                               nlines x nsamps */
-    float **twvi,        /* O: interpolated water vapor value,
-                               nlines x nsamps */
-    float **tozi,        /* O: interpolated ozone value, nlines x nsamps */
-    float **tp,          /* O: interpolated pressure value, nlines x nsamps */
-    float **tresi,       /* O: residuals for each pixel, nlines x nsamps */
-    float **taero,       /* O: aerosol values for each pixel, nlines x nsamps */
-    uint8 **lw_mask,     /* O: land/water mask data, nlines x nsamps */
-    int16 ***dem,        /* O: CMG DEM data array [DEM_NBLAT][DEM_NBLON] */
-    int16 ***andwi,      /* O: avg NDWI [RATIO_NBLAT][RATIO_NBLON] */
-    int16 ***sndwi,      /* O: standard NDWI [RATIO_NBLAT][RATIO_NBLON] */
-    int16 ***ratiob1,    /* O: mean band1 ratio [RATIO_NBLAT][RATIO_NBLON] */
-    int16 ***ratiob2,    /* O: mean band2 ratio [RATIO_NBLAT][RATIO_NBLON] */
-    int16 ***ratiob7,    /* O: mean band7 ratio [RATIO_NBLAT][RATIO_NBLON] */
-    int16 ***intratiob1, /* O: band1 ratio [RATIO_NBLAT][RATIO_NBLON] */
-    int16 ***intratiob2, /* O: band2 ratio [RATIO_NBLAT][RATIO_NBLON] */
-    int16 ***intratiob7, /* O: band7 ratio [RATIO_NBLAT][RATIO_NBLON] */
-    int16 ***slpratiob1, /* O: slope band1 ratio [RATIO_NBLAT][RATIO_NBLON] */
-    int16 ***slpratiob2, /* O: slope band2 ratio [RATIO_NBLAT][RATIO_NBLON] */
-    int16 ***slpratiob7, /* O: slope band7 ratio [RATIO_NBLAT][RATIO_NBLON] */
-    uint16 ***wv,        /* O: water vapor values [CMG_NBLAT][CMG_NBLON] */
-    uint8 ***oz,         /* O: ozone values [CMG_NBLAT][CMG_NBLON] */
-    float *****rolutt,   /* O: intrinsic reflectance table
-                               [NSR_BANDS][7][22][8000] */
-    float *****transt,   /* O: transmission table
-                               [NSR_BANDS][7][22][22] */
-    float ****sphalbt,   /* O: spherical albedo table [NSR_BANDS][7][22] */
-    float ****normext,   /* O: aerosol extinction coefficient at the current
-                               wavelength (normalized at 550nm)
-                               [NSR_BANDS][7][22] */
-    float ***tsmax,      /* O: maximum scattering angle table [20][22] */
-    float ***tsmin,      /* O: minimum scattering angle table [20][22] */
-    float ***nbfic,      /* O: communitive number of azimuth angles [20][22] */
-    float ***nbfi,       /* O: number of azimuth angles [20][22] */
-    float ***ttv         /* O: view angle table [20][22] */
+    int cmg_nlines,      /* I: number of lines of the CMG window */
+    int cmg_nsamps,      /* I: number of samples of the CMG window */
+    int16 ***dem,        /* O: CMG DEM data array [cmg_nlines][cmg_nsamps] */
+    int16 ***andwi,      /* O: avg NDWI [cmg_nlines][cmg_nsamps] */
+    int16 ***sndwi,      /* O: standard NDWI [cmg_nlines][cmg_nsamps] */
+    int16 ***ratiob1,    /* O: mean band1 ratio [cmg_nlines][cmg_nsamps] */
+    int16 ***ratiob2,    /* O: mean band2 ratio [cmg_nlines][cmg_nsamps] */
+    int16 ***ratiob7,    /* O: mean band7 ratio [cmg_nlines][cmg_nsamps] */
+    int16 ***intratiob1, /* O: band1 ratio [cmg_nlines][cmg_nsamps] */
+    int16 ***intratiob2, /* O: band2 ratio [cmg_nlines][cmg_nsamps] */
+    int16 ***intratiob7, /* O: band7 ratio [cmg_nlines][cmg_nsamps] */
+    int16 ***slpratiob1, /* O: slope band1 ratio [cmg_nlines][cmg_nsamps] */
+    int16 ***slpratiob2, /* O: slope band2 ratio [cmg_nlines][cmg_nsamps] */
+    int16 ***slpratiob7, /* O: slope band7 ratio [cmg_nlines][cmg_nsamps] */
+    uint16 ***wv,        /* O: water vapor values [cmg_nlines][cmg_nsamps] */
+    uint8 ***oz          /* O: ozone values [cmg_nlines][cmg_nsamps] */
 )
 {
     char FUNC_NAME[] = "memory_allocation_sr"; /* function name */
     char errmsg[STR_SIZE];   /* error message */
-    int i, j, k;             /* looping variables */
-
-    *aerob1 = calloc (nlines*nsamps, sizeof (int16));
-    if (*aerob1 == NULL)
-    {
-        sprintf (errmsg, "Error allocating memory for aerob1");
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
-
-    *aerob2 = calloc (nlines*nsamps, sizeof (int16));
-    if (*aerob2 == NULL)
-    {
-        sprintf (errmsg, "Error allocating memory for aerob2");
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
-
-    *aerob4 = calloc (nlines*nsamps, sizeof (int16));
-    if (*aerob4 == NULL)
-    {
-        sprintf (errmsg, "Error allocating memory for aerob4");
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
-
-    *aerob5 = calloc (nlines*nsamps, sizeof (int16));
-    if (*aerob5 == NULL)
-    {
-        sprintf (errmsg, "Error allocating memory for aerob5");
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
-
-    *aerob7 = calloc (nlines*nsamps, sizeof (int16));
-    if (*aerob7 == NULL)
-    {
-        sprintf (errmsg, "Error allocating memory for aerob7");
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
-
-    *twvi = calloc (nlines*nsamps, sizeof (float));
-    if (*twvi == NULL)
-    {
-        sprintf (errmsg, "Error allocating memory for twvi");
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
-
-    *tozi = calloc (nlines*nsamps, sizeof (float));
-    if (*tozi == NULL)
-    {
-        sprintf (errmsg, "Error allocating memory for tozi");
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
-
-    *tp = calloc (nlines*nsamps, sizeof (float));
-    if (*tp == NULL)
-    {
-        sprintf (errmsg, "Error allocating memory for tp");
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
-
-    *tresi = calloc (nlines*nsamps, sizeof (float));
-    if (*tresi == NULL)
-    {
-        sprintf (errmsg, "Error allocating memory for tresi");
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
-
-    *taero = calloc (nlines*nsamps, sizeof (float));
-    if (*taero == NULL)
-    {
-        sprintf (errmsg, "Error allocating memory for taero");
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
-
-    *cloud = calloc (nlines*nsamps, sizeof (uint8));
-    if (*cloud == NULL)
-    {
-        sprintf (errmsg, "Error allocating memory for cloud");
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
-
-    *lw_mask = calloc (nlines*nsamps, sizeof (uint8));
-    if (*lw_mask == NULL)
-    {
-        sprintf (errmsg, "Error allocating memory for lw_mask");
-        error_handler (true, FUNC_NAME, errmsg);
-        return (ERROR);
-    }
+    int i;                   /* looping variables */
 
     /* Allocate memory for all the climate modeling grid files */
-    *dem = calloc (DEM_NBLAT, sizeof (int16*));
+    *dem = calloc (cmg_nlines, sizeof (int16*));
     if (*dem == NULL)
     {
         sprintf (errmsg, "Error allocating memory for the DEM");
         error_handler (true, FUNC_NAME, errmsg);
         return (ERROR);
     }
-    for (i = 0; i < DEM_NBLAT; i++)
+    for (i = 0; i < cmg_nlines; i++)
     {
-        (*dem)[i] = calloc (DEM_NBLON, sizeof (int16));
+        (*dem)[i] = calloc (cmg_nsamps, sizeof (int16));
         if ((*dem)[i] == NULL)
         {
             sprintf (errmsg, "Error allocating memory for the DEM");
@@ -2115,7 +2081,7 @@ int memory_allocation_sr
         }
     }
 
-    *andwi = calloc (RATIO_NBLAT, sizeof (int16*));
+    *andwi = calloc (cmg_nlines, sizeof (int16*));
     if (*andwi == NULL)
     {
         sprintf (errmsg, "Error allocating memory for the andwi");
@@ -2123,7 +2089,7 @@ int memory_allocation_sr
         return (ERROR);
     }
 
-    *sndwi = calloc (RATIO_NBLAT, sizeof (int16*));
+    *sndwi = calloc (cmg_nlines, sizeof (int16*));
     if (*sndwi == NULL)
     {
         sprintf (errmsg, "Error allocating memory for the sndwi");
@@ -2131,7 +2097,7 @@ int memory_allocation_sr
         return (ERROR);
     }
 
-    *ratiob1 = calloc (RATIO_NBLAT, sizeof (int16*));
+    *ratiob1 = calloc (cmg_nlines, sizeof (int16*));
     if (*ratiob1 == NULL)
     {
         sprintf (errmsg, "Error allocating memory for the ratiob1");
@@ -2139,7 +2105,7 @@ int memory_allocation_sr
         return (ERROR);
     }
 
-    *ratiob2 = calloc (RATIO_NBLAT, sizeof (int16*));
+    *ratiob2 = calloc (cmg_nlines, sizeof (int16*));
     if (*ratiob2 == NULL)
     {
         sprintf (errmsg, "Error allocating memory for the ratiob2");
@@ -2147,7 +2113,7 @@ int memory_allocation_sr
         return (ERROR);
     }
 
-    *ratiob7 = calloc (RATIO_NBLAT, sizeof (int16*));
+    *ratiob7 = calloc (cmg_nlines, sizeof (int16*));
     if (*ratiob7 == NULL)
     {
         sprintf (errmsg, "Error allocating memory for the ratiob7");
@@ -2155,7 +2121,7 @@ int memory_allocation_sr
         return (ERROR);
     }
 
-    *intratiob1 = calloc (RATIO_NBLAT, sizeof (int16*));
+    *intratiob1 = calloc (cmg_nlines, sizeof (int16*));
     if (*intratiob1 == NULL)
     {
         sprintf (errmsg, "Error allocating memory for the intratiob1");
@@ -2163,7 +2129,7 @@ int memory_allocation_sr
         return (ERROR);
     }
 
-    *intratiob2 = calloc (RATIO_NBLAT, sizeof (int16*));
+    *intratiob2 = calloc (cmg_nlines, sizeof (int16*));
     if (*intratiob2 == NULL)
     {
         sprintf (errmsg, "Error allocating memory for the intratiob2");
@@ -2171,7 +2137,7 @@ int memory_allocation_sr
         return (ERROR);
     }
 
-    *intratiob7 = calloc (RATIO_NBLAT, sizeof (int16*));
+    *intratiob7 = calloc (cmg_nlines, sizeof (int16*));
     if (*intratiob7 == NULL)
     {
         sprintf (errmsg, "Error allocating memory for the intratiob7");
@@ -2179,7 +2145,7 @@ int memory_allocation_sr
         return (ERROR);
     }
 
-    *slpratiob1 = calloc (RATIO_NBLAT, sizeof (int16*));
+    *slpratiob1 = calloc (cmg_nlines, sizeof (int16*));
     if (*slpratiob1 == NULL)
     {
         sprintf (errmsg, "Error allocating memory for the slpratiob1");
@@ -2187,7 +2153,7 @@ int memory_allocation_sr
         return (ERROR);
     }
 
-    *slpratiob2 = calloc (RATIO_NBLAT, sizeof (int16*));
+    *slpratiob2 = calloc (cmg_nlines, sizeof (int16*));
     if (*slpratiob2 == NULL)
     {
         sprintf (errmsg, "Error allocating memory for the slpratiob2");
@@ -2195,7 +2161,7 @@ int memory_allocation_sr
         return (ERROR);
     }
 
-    *slpratiob7 = calloc (RATIO_NBLAT, sizeof (int16*));
+    *slpratiob7 = calloc (cmg_nlines, sizeof (int16*));
     if (*slpratiob7 == NULL)
     {
         sprintf (errmsg, "Error allocating memory for the slpratiob7");
@@ -2203,9 +2169,9 @@ int memory_allocation_sr
         return (ERROR);
     }
 
-    for (i = 0; i < RATIO_NBLAT; i++)
+    for (i = 0; i < cmg_nlines; i++)
     {
-        (*andwi)[i] = calloc (RATIO_NBLON, sizeof (int16));
+        (*andwi)[i] = calloc (cmg_nsamps, sizeof (int16));
         if ((*andwi)[i] == NULL)
         {
             sprintf (errmsg, "Error allocating memory for the andwi");
@@ -2213,7 +2179,7 @@ int memory_allocation_sr
             return (ERROR);
         }
 
-        (*sndwi)[i] = calloc (RATIO_NBLON, sizeof (int16));
+        (*sndwi)[i] = calloc (cmg_nsamps, sizeof (int16));
         if ((*sndwi)[i] == NULL)
         {
             sprintf (errmsg, "Error allocating memory for the sndwi");
@@ -2221,7 +2187,7 @@ int memory_allocation_sr
             return (ERROR);
         }
 
-        (*ratiob1)[i] = calloc (RATIO_NBLON, sizeof (int16));
+        (*ratiob1)[i] = calloc (cmg_nsamps, sizeof (int16));
         if ((*ratiob1)[i] == NULL)
         {
             sprintf (errmsg, "Error allocating memory for the ratiob1");
@@ -2229,7 +2195,7 @@ int memory_allocation_sr
             return (ERROR);
         }
 
-        (*ratiob2)[i] = calloc (RATIO_NBLON, sizeof (int16));
+        (*ratiob2)[i] = calloc (cmg_nsamps, sizeof (int16));
         if ((*ratiob2)[i] == NULL)
         {
             sprintf (errmsg, "Error allocating memory for the ratiob2");
@@ -2237,7 +2203,7 @@ int memory_allocation_sr
             return (ERROR);
         }
 
-        (*ratiob7)[i] = calloc (RATIO_NBLON, sizeof (int16));
+        (*ratiob7)[i] = calloc (cmg_nsamps, sizeof (int16));
         if ((*ratiob7)[i] == NULL)
         {
             sprintf (errmsg, "Error allocating memory for the ratiob7");
@@ -2245,7 +2211,7 @@ int memory_allocation_sr
             return (ERROR);
         }
 
-        (*intratiob1)[i] = calloc (RATIO_NBLON, sizeof (int16));
+        (*intratiob1)[i] = calloc (cmg_nsamps, sizeof (int16));
         if ((*intratiob1)[i] == NULL)
         {
             sprintf (errmsg, "Error allocating memory for the intratiob1");
@@ -2253,7 +2219,7 @@ int memory_allocation_sr
             return (ERROR);
         }
 
-        (*intratiob2)[i] = calloc (RATIO_NBLON, sizeof (int16));
+        (*intratiob2)[i] = calloc (cmg_nsamps, sizeof (int16));
         if ((*intratiob2)[i] == NULL)
         {
             sprintf (errmsg, "Error allocating memory for the intratiob2");
@@ -2261,7 +2227,7 @@ int memory_allocation_sr
             return (ERROR);
         }
 
-        (*intratiob7)[i] = calloc (RATIO_NBLON, sizeof (int16));
+        (*intratiob7)[i] = calloc (cmg_nsamps, sizeof (int16));
         if ((*intratiob7)[i] == NULL)
         {
             sprintf (errmsg, "Error allocating memory for the intratiob7");
@@ -2269,7 +2235,7 @@ int memory_allocation_sr
             return (ERROR);
         }
 
-        (*slpratiob1)[i] = calloc (RATIO_NBLON, sizeof (int16));
+        (*slpratiob1)[i] = calloc (cmg_nsamps, sizeof (int16));
         if ((*slpratiob1)[i] == NULL)
         {
             sprintf (errmsg, "Error allocating memory for the slpratiob1");
@@ -2277,7 +2243,7 @@ int memory_allocation_sr
             return (ERROR);
         }
 
-        (*slpratiob2)[i] = calloc (RATIO_NBLON, sizeof (int16));
+        (*slpratiob2)[i] = calloc (cmg_nsamps, sizeof (int16));
         if ((*slpratiob2)[i] == NULL)
         {
             sprintf (errmsg, "Error allocating memory for the slpratiob2");
@@ -2285,7 +2251,7 @@ int memory_allocation_sr
             return (ERROR);
         }
 
-        (*slpratiob7)[i] = calloc (RATIO_NBLON, sizeof (int16));
+        (*slpratiob7)[i] = calloc (cmg_nsamps, sizeof (int16));
         if ((*slpratiob7)[i] == NULL)
         {
             sprintf (errmsg, "Error allocating memory for the slpratiob7");
@@ -2294,7 +2260,7 @@ int memory_allocation_sr
         }
     }
 
-    *wv = calloc (CMG_NBLAT, sizeof (int16*));
+    *wv = calloc (cmg_nlines, sizeof (int16*));
     if (*wv == NULL)
     {
         sprintf (errmsg, "Error allocating memory for the wv");
@@ -2302,7 +2268,7 @@ int memory_allocation_sr
         return (ERROR);
     }
 
-    *oz = calloc (CMG_NBLAT, sizeof (uint8*));
+    *oz = calloc (cmg_nlines, sizeof (uint8*));
     if (*oz == NULL)
     {
         sprintf (errmsg, "Error allocating memory for the oz");
@@ -2310,9 +2276,9 @@ int memory_allocation_sr
         return (ERROR);
     }
 
-    for (i = 0; i < CMG_NBLAT; i++)
+    for (i = 0; i < cmg_nlines; i++)
     {
-        (*wv)[i] = calloc (CMG_NBLON, sizeof (int16));
+        (*wv)[i] = calloc (cmg_nsamps, sizeof (int16));
         if ((*wv)[i] == NULL)
         {
             sprintf (errmsg, "Error allocating memory for the wv");
@@ -2320,7 +2286,7 @@ int memory_allocation_sr
             return (ERROR);
         }
 
-        (*oz)[i] = calloc (CMG_NBLON, sizeof (uint8));
+        (*oz)[i] = calloc (cmg_nsamps, sizeof (uint8));
         if ((*oz)[i] == NULL)
         {
             sprintf (errmsg, "Error allocating memory for the oz");
@@ -2329,215 +2295,669 @@ int memory_allocation_sr
         }
     }
 
-    /* rolutt[NSR_BANDS][7][22][8000] and transt[NSR_BANDS][7][22][22] and
-       sphalbt[NSR_BANDS][7][22] and normext[NSR_BANDS][7][22] */
-    *rolutt = calloc (NSR_BANDS, sizeof (float***));
-    if (*rolutt == NULL)
+    /* Successful completion */
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  lut_filenames
+
+PURPOSE:  Builds the names of the look-up table files in the LDCMLUT directory
+of the auxiliary products.
+
+RETURN VALUE:
+Type = N/A
+
+NOTES:
+******************************************************************************/
+void lut_filenames
+(
+    char *aux_path,             /* I: directory of the auxiliary products */
+    char anglehdf[STR_SIZE],    /* O: angle HDF filename */
+    char intrefnm[STR_SIZE],    /* O: intrinsic reflectance filename */
+    char transmnm[STR_SIZE],    /* O: transmission filename */
+    char spheranm[STR_SIZE]     /* O: spherical albedo filename */
+)
+{
+    sprintf (anglehdf, "%s/LDCMLUT/ANGLE_NEW.hdf", aux_path);
+    sprintf (intrefnm, "%s/LDCMLUT/RES_LUT_V3.0-URBANCLEAN-V2.0.hdf",
+        aux_path);
+    sprintf (transmnm, "%s/LDCMLUT/TRANS_LUT_V3.0-URBANCLEAN-V2.0.ASCII",
+        aux_path);
+    sprintf (spheranm, "%s/LDCMLUT/AERO_LUT_V3.0-URBANCLEAN-V2.0.ASCII",
+        aux_path);
+}
+
+
+/******************************************************************************
+MODULE:  lut_checksum
+
+PURPOSE:  Computes the Adler-32 checksum of the tables, from oztransa to the
+end of the look-up table structure.
+
+RETURN VALUE:
+Type = uint32
+Value          Description
+-----          -----------
+checksum       Adler-32 checksum of the tables
+
+NOTES:
+  1. The sums are reduced every 5552 bytes, the most that can be added up
+     in 32 bits without overflowing.
+******************************************************************************/
+static uint32 lut_checksum
+(
+    const Lut_t *lut    /* I: look-up tables */
+)
+{
+    const unsigned char *buf = (const unsigned char *) &lut->oztransa;
+                             /* first byte of the tables */
+    size_t len = sizeof (Lut_t) - offsetof (Lut_t, oztransa);
+                             /* number of bytes left to sum */
+    size_t n;                /* number of bytes summed before reducing */
+    uint32 a = 1;            /* sum of the bytes */
+    uint32 b = 0;            /* sum of the sums */
+
+    while (len > 0)
+    {
+        n = len < 5552 ? len : 5552;
+        len -= n;
+        while (n-- > 0)
+        {
+            a += *buf++;
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+    }
+
+    return ((b << 16) | a);
+}
+
+
+/******************************************************************************
+MODULE:  stat_lut_sources
+
+PURPOSE:  Gets the size and modification time of the look-up table source
+files, which identify the version of the files a binary file was built from.
+
+RETURN VALUE:
+Type = int
+Value          Description
+-----          -----------
+ERROR          One of the source files can't be accessed
+SUCCESS        Successful completion
+
+NOTES:
+******************************************************************************/
+static int stat_lut_sources
+(
+    char *anglehdf,     /* I: angle HDF filename */
+    char *intrefnm,     /* I: intrinsic reflectance filename */
+    char *transmnm,     /* I: transmission filename */
+    char *spheranm,     /* I: spherical albedo filename */
+    off_t src_size[NLUT_FILES],   /* O: size of the source files */
+    time_t src_mtime[NLUT_FILES]  /* O: modification time of the files */
+)
+{
+    char *srcfile[NLUT_FILES];  /* source filenames */
+    struct stat st;             /* file status */
+    int i;                      /* looping variable */
+
+    srcfile[0] = anglehdf;
+    srcfile[1] = intrefnm;
+    srcfile[2] = transmnm;
+    srcfile[3] = spheranm;
+    for (i = 0; i < NLUT_FILES; i++)
+    {
+        if (stat (srcfile[i], &st) != 0)
+            return (ERROR);
+        src_size[i] = st.st_size;
+        src_mtime[i] = st.st_mtime;
+    }
+
+    /* Successful completion */
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  write_lut_file
+
+PURPOSE:  Writes the look-up tables to a binary file, as the contiguous block
+they are stored in, stamped with the source files they were read from and
+checksummed.
+
+RETURN VALUE:
+Type = int
+Value          Description
+-----          -----------
+ERROR          Error occurred writing the file
+SUCCESS        Successful completion
+
+NOTES:
+  1. The file is in the byte order and structure layout of the machine
+     writing it; map_lut_file rejects files that don't match its own layout.
+  2. The file is written under a temporary name and renamed, so a process
+     mapping it never sees a partial file.
+******************************************************************************/
+int write_lut_file
+(
+    char *lutfile,      /* I: name of the binary look-up table file */
+    char *anglehdf,     /* I: angle HDF filename */
+    char *intrefnm,     /* I: intrinsic reflectance filename */
+    char *transmnm,     /* I: transmission filename */
+    char *spheranm,     /* I: spherical albedo filename */
+    Lut_t *lut          /* I/O: look-up tables, the checksum and the source
+                                file stamps are set */
+)
+{
+    char FUNC_NAME[] = "write_lut_file";   /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    char tmpfile[STR_SIZE];  /* temporary name of the binary file */
+    FILE *fp = NULL;         /* file pointer for the binary file */
+
+    if (stat_lut_sources (anglehdf, intrefnm, transmnm, spheranm,
+        lut->src_size, lut->src_mtime) != SUCCESS)
     {
-        sprintf (errmsg, "Error allocating memory for rolutt");
+        sprintf (errmsg, "Getting the status of the look-up table source "
+            "files");
         error_handler (true, FUNC_NAME, errmsg);
         return (ERROR);
     }
+    lut->checksum = lut_checksum (lut);
 
-    *transt = calloc (NSR_BANDS, sizeof (float***));
-    if (*transt == NULL)
+    if (snprintf (tmpfile, STR_SIZE, "%s.%d", lutfile, (int) getpid ())
+        >= STR_SIZE)
     {
-        sprintf (errmsg, "Error allocating memory for transt");
+        sprintf (errmsg, "Look-up table filename is too long");
         error_handler (true, FUNC_NAME, errmsg);
         return (ERROR);
     }
 
-    *sphalbt = calloc (NSR_BANDS, sizeof (float**));
-    if (*sphalbt == NULL)
+    fp = fopen (tmpfile, "wb");
+    if (fp == NULL)
     {
-        sprintf (errmsg, "Error allocating memory for sphalbt");
+        snprintf (errmsg, sizeof (errmsg), "Opening the temporary look-up "
+            "table file of %s for writing", lutfile);
         error_handler (true, FUNC_NAME, errmsg);
         return (ERROR);
     }
 
-    *normext = calloc (NSR_BANDS, sizeof (float**));
-    if (*normext == NULL)
+    if (fwrite (lut, sizeof (Lut_t), 1, fp) != 1)
     {
-        sprintf (errmsg, "Error allocating memory for normext");
+        snprintf (errmsg, sizeof (errmsg), "Writing the look-up tables to "
+            "the temporary file of %s", lutfile);
         error_handler (true, FUNC_NAME, errmsg);
+        fclose (fp);
+        remove (tmpfile);
         return (ERROR);
     }
 
-    for (i = 0; i < NSR_BANDS; i++)
+    if (fclose (fp) != 0)
     {
-        (*rolutt)[i] = calloc (7, sizeof (float**));
-        if ((*rolutt)[i] == NULL)
-        {
-            sprintf (errmsg, "Error allocating memory for rolutt");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
+        snprintf (errmsg, sizeof (errmsg), "Closing the temporary look-up "
+            "table file of %s", lutfile);
+        error_handler (true, FUNC_NAME, errmsg);
+        remove (tmpfile);
+        return (ERROR);
+    }
 
-        (*transt)[i] = calloc (7, sizeof (float**));
-        if ((*transt)[i] == NULL)
-        {
-            sprintf (errmsg, "Error allocating memory for transt");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
+    if (rename (tmpfile, lutfile) != 0)
+    {
+        snprintf (errmsg, sizeof (errmsg), "Renaming the temporary look-up "
+            "table file to %s", lutfile);
+        error_handler (true, FUNC_NAME, errmsg);
+        remove (tmpfile);
+        return (ERROR);
+    }
 
-        (*sphalbt)[i] = calloc (7, sizeof (float*));
-        if ((*sphalbt)[i] == NULL)
-        {
-            sprintf (errmsg, "Error allocating memory for sphalbt");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
+    /* Successful completion */
+    return (SUCCESS);
+}
 
-        (*normext)[i] = calloc (7, sizeof (float*));
-        if ((*normext)[i] == NULL)
-        {
-            sprintf (errmsg, "Error allocating memory for normext");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
 
-        for (j = 0; j < 7; j++)
-        {
-            (*rolutt)[i][j] = calloc (22, sizeof (float*));
-            if ((*rolutt)[i][j] == NULL)
-            {
-                sprintf (errmsg, "Error allocating memory for rolutt");
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
+/******************************************************************************
+MODULE:  map_lut_file
 
-            (*transt)[i][j] = calloc (22, sizeof (float*));
-            if ((*transt)[i][j] == NULL)
-            {
-                sprintf (errmsg, "Error allocating memory for transt");
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
+PURPOSE:  Maps the look-up tables read-only from a binary file written by
+write_lut_file, if it is valid and up to date with the source files.
 
-            (*sphalbt)[i][j] = calloc (22, sizeof (float));
-            if ((*sphalbt)[i][j] == NULL)
-            {
-                sprintf (errmsg, "Error allocating memory for sphalbt");
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
+RETURN VALUE:
+Type = int
+Value          Description
+-----          -----------
+ERROR          The file can't be opened or mapped, isn't a look-up table file
+               of this version and layout, fails its checksum, or was built
+               from other versions of the source files
+SUCCESS        Successful completion
 
-            (*normext)[i][j] = calloc (22, sizeof (float));
-            if ((*normext)[i][j] == NULL)
-            {
-                sprintf (errmsg, "Error allocating memory for normext");
-                error_handler (true, FUNC_NAME, errmsg);
-                return (ERROR);
-            }
+NOTES:
+  1. The tables are used in place from the page cache, so processes running
+     on the same machine share them.  Release them with unmap_lut_file.
+  2. The problems are reported as warnings, since the caller is expected to
+     fall back on reading the source files.
+  3. A source file is assumed to have changed if its size or modification
+     time differ from the ones stamped in the file.
+******************************************************************************/
+int map_lut_file
+(
+    char *lutfile,      /* I: name of the binary look-up table file */
+    char *anglehdf,     /* I: angle HDF filename */
+    char *intrefnm,     /* I: intrinsic reflectance filename */
+    char *transmnm,     /* I: transmission filename */
+    char *spheranm,     /* I: spherical albedo filename */
+    Lut_t **lut         /* O: look-up tables mapped read-only */
+)
+{
+    char FUNC_NAME[] = "map_lut_file";   /* function name */
+    char errmsg[STR_SIZE];   /* error message */
+    int fd;                  /* file descriptor of the binary file */
+    int i;                   /* looping variable */
+    struct stat st;          /* file status, for the file size */
+    off_t src_size[NLUT_FILES];    /* current size of the source files */
+    time_t src_mtime[NLUT_FILES];  /* current modification time of the
+                                      source files */
+    void *addr = NULL;       /* address of the mapping */
+    Lut_t *map = NULL;       /* look-up tables in the mapping */
 
-            for (k = 0; k < 22; k++)
-            {
-                (*rolutt)[i][j][k] = calloc (8000, sizeof (float));
-                if ((*rolutt)[i][j][k] == NULL)
-                {
-                    sprintf (errmsg, "Error allocating memory for rolutt");
-                    error_handler (true, FUNC_NAME, errmsg);
-                    return (ERROR);
-                }
+    *lut = NULL;
+    fd = open (lutfile, O_RDONLY);
+    if (fd < 0)
+    {
+        snprintf (errmsg, sizeof (errmsg), "Opening look-up table file for "
+            "reading: %s", lutfile);
+        error_handler (false, FUNC_NAME, errmsg);
+        return (ERROR);
+    }
 
-                (*transt)[i][j][k] = calloc (22, sizeof (float));
-                if ((*transt)[i][j][k] == NULL)
-                {
-                    sprintf (errmsg, "Error allocating memory for transt");
-                    error_handler (true, FUNC_NAME, errmsg);
-                    return (ERROR);
-                }
-            }  /* for k */
-        }  /* for j */
-    }  /* for i */
+    if (fstat (fd, &st) != 0 || st.st_size != (off_t) sizeof (Lut_t))
+    {
+        snprintf (errmsg, sizeof (errmsg), "Size of look-up table file %s "
+            "doesn't match the look-up table structure", lutfile);
+        error_handler (false, FUNC_NAME, errmsg);
+        close (fd);
+        return (ERROR);
+    }
 
-    /* tsmax[20][22] and float tsmin[20][22] and float nbfic[20][22] and
-       nbfi[20][22] and float ttv[20][22] */
-    *tsmax = calloc (20, sizeof (float*));
-    if (*tsmax == NULL)
+    addr = mmap (NULL, sizeof (Lut_t), PROT_READ, MAP_SHARED, fd, 0);
+    close (fd);
+    if (addr == MAP_FAILED)
     {
-        sprintf (errmsg, "Error allocating memory for tsmax");
-        error_handler (true, FUNC_NAME, errmsg);
+        snprintf (errmsg, sizeof (errmsg), "Mapping look-up table file: %s",
+            lutfile);
+        error_handler (false, FUNC_NAME, errmsg);
         return (ERROR);
     }
 
-    *tsmin = calloc (20, sizeof (float*));
-    if (*tsmin == NULL)
+    map = addr;
+    if (strncmp (map->magic, LUT_MAGIC, sizeof (map->magic)) != 0 ||
+        map->version != LUT_VERSION || map->size != (int32) sizeof (Lut_t))
     {
-        sprintf (errmsg, "Error allocating memory for tsmin");
-        error_handler (true, FUNC_NAME, errmsg);
+        snprintf (errmsg, sizeof (errmsg), "%s isn't a version %d look-up "
+            "table file", lutfile, LUT_VERSION);
+        error_handler (false, FUNC_NAME, errmsg);
+        munmap (addr, sizeof (Lut_t));
         return (ERROR);
     }
 
-    *nbfic = calloc (20, sizeof (float*));
-    if (*nbfic == NULL)
+    /* Make sure the file was built from the current source files */
+    if (stat_lut_sources (anglehdf, intrefnm, transmnm, spheranm, src_size,
+        src_mtime) != SUCCESS)
     {
-        sprintf (errmsg, "Error allocating memory for nbfic");
-        error_handler (true, FUNC_NAME, errmsg);
+        sprintf (errmsg, "Getting the status of the look-up table source "
+            "files");
+        error_handler (false, FUNC_NAME, errmsg);
+        munmap (addr, sizeof (Lut_t));
+        return (ERROR);
+    }
+    for (i = 0; i < NLUT_FILES; i++)
+    {
+        if (map->src_size[i] != src_size[i] ||
+            map->src_mtime[i] != src_mtime[i])
+            break;
+    }
+    if (i < NLUT_FILES)
+    {
+        snprintf (errmsg, sizeof (errmsg), "%s is stale, the look-up table "
+            "source files have changed since it was written", lutfile);
+        error_handler (false, FUNC_NAME, errmsg);
+        munmap (addr, sizeof (Lut_t));
         return (ERROR);
     }
 
-    *nbfi = calloc (20, sizeof (float*));
-    if (*nbfi == NULL)
+    if (map->checksum != lut_checksum (map))
     {
-        sprintf (errmsg, "Error allocating memory for nbfi");
-        error_handler (true, FUNC_NAME, errmsg);
+        snprintf (errmsg, sizeof (errmsg), "Checksum of look-up table file %s "
+            "doesn't match", lutfile);
+        error_handler (false, FUNC_NAME, errmsg);
+        munmap (addr, sizeof (Lut_t));
         return (ERROR);
     }
 
-    *ttv = calloc (20, sizeof (float*));
-    if (*ttv == NULL)
+    *lut = map;
+
+    /* Successful completion */
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  unmap_lut_file
+
+PURPOSE:  Releases the look-up tables mapped by map_lut_file.
+
+RETURN VALUE:
+Type = N/A
+
+NOTES:
+******************************************************************************/
+void unmap_lut_file
+(
+    Lut_t *lut          /* I: look-up tables mapped by map_lut_file */
+)
+{
+    if (lut != NULL)
+        munmap (lut, sizeof (Lut_t));
+}
+
+
+/******************************************************************************
+MODULE:  init_scene_lut
+
+PURPOSE:  Computes the look-up table of a scene: the atmospheric reflectance
+and the transmittances at the pressure and AOT nodes of the LUTs, and the
+molecular reflectance on its pressure grid, for each band and for the sun and
+view angles of the scene.
+
+RETURN VALUE:
+Type = int
+Value          Description
+-----          -----------
+ERROR          The solar zenith angle is outside the LUTs
+SUCCESS        Successful completion
+
+NOTES:
+  1. The node values are computed by comproatm and comptrans at the node
+     itself, pairing it with the next node (the previous one for the last
+     node), which only sets the direction of the null interpolation.
+     comproatm interpolates as log of tau from logaot550nm, which is not
+     exactly the log of aot550nm (the 2.0 entry is off by 1e-5), so it is
+     called at the AOT of the logaot550nm entry.
+  2. The table replaces the interpolation over the angles, which is the
+     bulk of atmcorlamb2, with a bilinear interpolation in pressure and AOT.
+     Its deviation from the full interpolation is reported by
+     compare_scene_lut.
+******************************************************************************/
+int init_scene_lut
+(
+    float xts,          /* I: solar zenith angle (deg) */
+    float xtv,          /* I: observation zenith angle (deg) */
+    float xmus,         /* I: cosine of solar zenith angle */
+    float xmuv,         /* I: cosine of observation zenith angle */
+    float xfi,          /* I: azimuthal difference between sun and
+                              observation (deg) */
+    float cosxfi,       /* I: cosine of azimuthal difference */
+    Lut_t *lut,         /* I: look-up tables */
+    Scene_lut_t *slut   /* O: look-up table of the scene */
+)
+{
+    char FUNC_NAME[] = "init_scene_lut";   /* function name */
+    char errmsg[STR_SIZE];  /* error message */
+    int ib;             /* band looping variable */
+    int ip, ip2;        /* pressure node and its neighbor */
+    int iaot, iaot2;    /* AOT node and its neighbor */
+    int irp;            /* looping variable for the molecular reflectance
+                           pressure grid */
+    int its;            /* index for the sun angle table */
+    int itv;            /* index for the view angle table */
+    float pres;         /* surface pressure */
+    float atm_pres;     /* atmospheric pressure at sea level */
+    float xtaur;        /* rayleigh optical depth for surface pressure */
+
+    /* Determine the index in the view angle table */
+    if (xtv <= lut->xtvmin)
+        itv = 0;
+    else
+        itv = (int) ((xtv - lut->xtvmin) / lut->xtvstep + 1.0);
+
+    /* Determine the index in the sun angle table */
+    if (xts <= lut->xtsmin) 
+        its = 0;
+    else
+        its = (int) ((xts - lut->xtsmin) / lut->xtsstep);
+    if (its > 19)
     {
-        sprintf (errmsg, "Error allocating memory for ttv");
+        sprintf (errmsg, "Solar zenith (xts) is too large: %f", xts);
         error_handler (true, FUNC_NAME, errmsg);
         return (ERROR);
     }
 
-    for (i = 0; i < 20; i++)
+    for (ib = 0; ib < NSR_BANDS; ib++)
     {
-        (*tsmax)[i] = calloc (22, sizeof (float));
-        if ((*tsmax)[i] == NULL)
+        /* Atmospheric reflectance and transmittances at the pressure and
+           AOT nodes */
+        for (ip = 0; ip < NPRES_VALS; ip++)
         {
-            sprintf (errmsg, "Error allocating memory for tsmax");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
+            ip2 = (ip < NPRES_VALS - 1) ? ip + 1 : ip - 1;
+            for (iaot = 0; iaot < NAOT_VALS; iaot++)
+            {
+                iaot2 = (iaot < NAOT_VALS - 1) ? iaot + 1 : iaot - 1;
+                comproatm (ip, ip2, iaot, iaot2, xts, xtv, xmus, xmuv, cosxfi,
+                    exp (logaot550nm[iaot]), ib, lut->tpres[ip], lut, its,
+                    itv, &slut->roatm[ib][ip][iaot]);
+                comptrans (ip, ip2, iaot, iaot2, xts, lut->aot550nm[iaot], ib,
+                    lut->tpres[ip], lut, lut->xtsstep, lut->xtsmin,
+                    &slut->xtts[ib][ip][iaot]);
+                comptrans (ip, ip2, iaot, iaot2, xtv, lut->aot550nm[iaot], ib,
+                    lut->tpres[ip], lut, lut->xtvstep, lut->xtvmin,
+                    &slut->xttv[ib][ip][iaot]);
+            }
         }
 
-        (*tsmin)[i] = calloc (22, sizeof (float));
-        if ((*tsmin)[i] == NULL)
+        /* Molecular reflectance on its pressure grid, as in atmcorlamb2 */
+        for (irp = 0; irp < NRAY_PRES; irp++)
         {
-            sprintf (errmsg, "Error allocating memory for tsmin");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
+            pres = RAY_PRES_MIN + irp * RAY_PRES_STEP;
+            atm_pres = pres * ONE_DIV_1013;
+            xtaur = lut->tauray[ib] * atm_pres;
+            local_chand (xfi, xmuv, xmus, xtaur, &slut->xrorayp[ib][irp]);
         }
+    }
 
-        (*nbfic)[i] = calloc (22, sizeof (float));
-        if ((*nbfic)[i] == NULL)
-        {
-            sprintf (errmsg, "Error allocating memory for nbfic");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
+    /* Successful completion */
+    return (SUCCESS);
+}
 
-        (*nbfi)[i] = calloc (22, sizeof (float));
-        if ((*nbfi)[i] == NULL)
-        {
-            sprintf (errmsg, "Error allocating memory for nbfi");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
+
+/******************************************************************************
+MODULE:  compare_scene_lut
+
+PURPOSE:  Reports the deviation of the scene look-up table from the full
+interpolation of the LUTs, over a sweep of surface pressure, AOT and TOA
+reflectance for each band.
+
+RETURN VALUE:
+Type = int
+Value          Description
+-----          -----------
+ERROR          Error occurred doing the atmospheric corrections
+SUCCESS        Successful completion
+
+NOTES:
+  1. The maximum and mean absolute deviations of the lambertian surface
+     reflectance, the atmospheric reflectance, the total transmission and
+     the molecular reflectance returned by atmcorlamb2 are printed.  The
+     spherical albedo doesn't depend on the scene look-up table.
+  2. The sweep covers the pressures of the molecular reflectance grid and
+     the AOT range of the aerosol retrieval.  The ozone and water vapor are
+     fixed, since the gaseous transmissions are computed the same way by
+     both interpolations.
+******************************************************************************/
+int compare_scene_lut
+(
+    float xts,          /* I: solar zenith angle (deg) */
+    float xtv,          /* I: observation zenith angle (deg) */
+    float xmus,         /* I: cosine of solar zenith angle */
+    float xmuv,         /* I: cosine of observation zenith angle */
+    float xfi,          /* I: azimuthal difference between sun and
+                              observation (deg) */
+    float cosxfi,       /* I: cosine of azimuthal difference */
+    Lut_t *lut,         /* I: look-up tables */
+    Scene_lut_t *slut   /* I: look-up table of the scene */
+)
+{
+    char FUNC_NAME[] = "compare_scene_lut";   /* function name */
+    char errmsg[STR_SIZE];  /* error message */
+    int ib;             /* band looping variable */
+    int ip;             /* pressure looping variable */
+    int iaot;           /* AOT looping variable */
+    int irho;           /* TOA reflectance looping variable */
+    int i;              /* looping variable for the compared values */
+    int retval;         /* return status */
+    long nval;          /* number of compared values for the band */
+    float pres;         /* surface pressure */
+    float raot550nm;    /* AOT */
+    float ref[5];       /* roslamb, roatm, ttatmg, xrorayp and satm of the
+                           full interpolation */
+    float red[5];       /* same values from the scene look-up table */
+    float tgo;          /* other gaseous transmittance */
+    float next;         /* normalized extinction */
+    double diff;        /* absolute deviation */
+    double dmax[4];     /* maximum absolute deviation */
+    double dsum[4];     /* sum of the absolute deviations */
+    const float uoz = 0.3;       /* total column ozone */
+    const float uwv = 2.0;       /* total column water vapor */
+    const float rotoa[3] = {0.05, 0.15, 0.3};   /* TOA reflectances */
+
+    printf ("Deviation of the scene LUT from the full LUT interpolation "
+        "(max / mean absolute):\n");
+    printf ("  band      roslamb              roatm               ttatmg"
+        "              xrorayp\n");
+    for (ib = 0; ib < NSR_BANDS; ib++)
+    {
+        nval = 0;
+        for (i = 0; i < 4; i++)
+            dmax[i] = dsum[i] = 0.0;
+
+        for (ip = 0; ip < NRAY_PRES; ip += 3)
+        {
+            /* Fall between the nodes of the pressure grid */
+            pres = RAY_PRES_MIN + (ip + 0.37) * RAY_PRES_STEP;
+            for (iaot = 0; iaot < 100; iaot++)
+            {
+                raot550nm = 0.01 + iaot * 0.0499;
+                for (irho = 0; irho < 3; irho++)
+                {
+                    retval = atmcorlamb2 (xts, xtv, xmus, xmuv, xfi, cosxfi,
+                        raot550nm, ib, pres, lut, NULL, uoz, uwv,
+                        rotoa[irho], &ref[0], &tgo, &ref[1], &ref[2],
+                        &ref[4], &ref[3], &next);
+                    if (retval == SUCCESS)
+                        retval = atmcorlamb2 (xts, xtv, xmus, xmuv, xfi,
+                            cosxfi, raot550nm, ib, pres, lut, slut, uoz, uwv,
+                            rotoa[irho], &red[0], &tgo, &red[1], &red[2],
+                            &red[4], &red[3], &next);
+                    if (retval != SUCCESS)
+                    {
+                        sprintf (errmsg, "Performing lambertian atmospheric "
+                            "correction type 2.");
+                        error_handler (true, FUNC_NAME, errmsg);
+                        return (ERROR);
+                    }
+
+                    for (i = 0; i < 4; i++)
+                    {
+                        diff = fabs ((double) red[i] - ref[i]);
+                        if (diff > dmax[i])
+                            dmax[i] = diff;
+                        dsum[i] += diff;
+                    }
+                    nval++;
+                }
+            }
         }
 
-        (*ttv)[i] = calloc (22, sizeof (float));
-        if ((*ttv)[i] == NULL)
+        printf ("  %4d", ib + 1);
+        for (i = 0; i < 4; i++)
+            printf ("  %.2e / %.2e", dmax[i], dsum[i] / nval);
+        printf ("\n");
+    }
+
+    /* Successful completion */
+    return (SUCCESS);
+}
+
+
+/******************************************************************************
+MODULE:  read_cmg_window
+
+PURPOSE:  Reads the window of a CMG grid SDS into row arrays.
+
+RETURN VALUE:
+Type = int
+Value          Description
+-----          -----------
+ERROR          Error occurred reading the SDS
+SUCCESS        Successful completion
+
+NOTES:
+  1. The window may wrap around the last sample (dateline) or line (pole) of
+     the grid, in which case it is read as up to four hyperslabs.
+******************************************************************************/
+static int read_cmg_window
+(
+    int sds_id,             /* I: ID of the CMG grid SDS */
+    Cmg_window_t *cmg_win,  /* I: window of the grid to be read */
+    size_t size,            /* I: size of the SDS values (bytes) */
+    void **data             /* O: window of the grid, cmg_win->nlines rows
+                                  of cmg_win->nsamps values */
+)
+{
+    int start[2];            /* starting point to read SDS data */
+    int edges[2];            /* number of values to read in SDS data */
+    int line, samp;          /* first line/sample of the current hyperslab */
+    int wline, wsamp;        /* line/sample of the hyperslab in the window */
+    int k;                   /* looping variable for the hyperslab lines */
+    unsigned char *buf = NULL;   /* values of the current hyperslab */
+
+    buf = malloc ((size_t) cmg_win->nlines * cmg_win->nsamps * size);
+    if (buf == NULL)
+        return (ERROR);
+
+    line = cmg_win->line0;
+    for (wline = 0; wline < cmg_win->nlines; wline += edges[0])
+    {
+        edges[0] = CMG_NBLAT - line;
+        if (edges[0] > cmg_win->nlines - wline)
+            edges[0] = cmg_win->nlines - wline;
+
+        samp = cmg_win->samp0;
+        for (wsamp = 0; wsamp < cmg_win->nsamps; wsamp += edges[1])
         {
-            sprintf (errmsg, "Error allocating memory for ttv");
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
+            edges[1] = CMG_NBLON - samp;
+            if (edges[1] > cmg_win->nsamps - wsamp)
+                edges[1] = cmg_win->nsamps - wsamp;
+
+            start[0] = line;
+            start[1] = samp;
+            if (SDreaddata (sds_id, start, NULL, edges, buf) == -1)
+            {
+                free (buf);
+                return (ERROR);
+            }
+            for (k = 0; k < edges[0]; k++)
+                memcpy ((unsigned char *) data[wline + k] + wsamp * size,
+                    buf + (size_t) k * edges[1] * size, edges[1] * size);
+
+            samp = 0;   /* wrap around the dateline */
         }
+
+        line = 0;   /* wrap around the pole */
     }
 
-    /* Successful completion */
+    free (buf);
     return (SUCCESS);
 }
 
@@ -2562,6 +2982,9 @@ Date         Programmer       Reason
 NOTES:
   1. It is assumed that memory has already been allocated for the input data
      arrays.
+  2. Only the window of the CMG grids covering the scene is read, with the
+     arrays indexed relative to the window.  The DEM and ratio grids are
+     on the CMG grid.
 ******************************************************************************/
 int read_auxiliary_files
 (
@@ -2572,20 +2995,21 @@ int read_auxiliary_files
     char *cmgdemnm,     /* I: climate modeling grid DEM filename */
     char *rationm,      /* I: ratio averages filename */
     char *auxnm,        /* I: auxiliary filename for ozone and water vapor */
-    int16 **dem,        /* O: CMG DEM data array [DEM_NBLAT][DEM_NBLON] */
-    int16 **andwi,      /* O: avg NDWI [RATIO_NBLAT][RATIO_NBLON] */
-    int16 **sndwi,      /* O: standard NDWI [RATIO_NBLAT][RATIO_NBLON] */
-    int16 **ratiob1,    /* O: mean band1 ratio [RATIO_NBLAT][RATIO_NBLON] */
-    int16 **ratiob2,    /* O: mean band2 ratio [RATIO_NBLAT][RATIO_NBLON] */
-    int16 **ratiob7,    /* O: mean band7 ratio [RATIO_NBLAT][RATIO_NBLON] */
-    int16 **intratiob1, /* O: band1 ratio [RATIO_NBLAT][RATIO_NBLON] */
-    int16 **intratiob2, /* O: band2 ratio [RATIO_NBLAT][RATIO_NBLON] */
-    int16 **intratiob7, /* O: band7 ratio [RATIO_NBLAT][RATIO_NBLON] */
-    int16 **slpratiob1, /* O: slope band1 ratio [RATIO_NBLAT][RATIO_NBLON] */
-    int16 **slpratiob2, /* O: slope band2 ratio [RATIO_NBLAT][RATIO_NBLON] */
-    int16 **slpratiob7, /* O: slope band7 ratio [RATIO_NBLAT][RATIO_NBLON] */
-    uint16 **wv,        /* O: water vapor values [CMG_NBLAT][CMG_NBLON] */
-    uint8 **oz          /* O: ozone values [CMG_NBLAT][CMG_NBLON] */
+    Cmg_window_t *cmg_win,  /* I: window of the CMG grids to be read */
+    int16 **dem,        /* O: CMG DEM data array [CMG window] */
+    int16 **andwi,      /* O: avg NDWI [CMG window] */
+    int16 **sndwi,      /* O: standard NDWI [CMG window] */
+    int16 **ratiob1,    /* O: mean band1 ratio [CMG window] */
+    int16 **ratiob2,    /* O: mean band2 ratio [CMG window] */
+    int16 **ratiob7,    /* O: mean band7 ratio [CMG window] */
+    int16 **intratiob1, /* O: band1 ratio [CMG window] */
+    int16 **intratiob2, /* O: band2 ratio [CMG window] */
+    int16 **intratiob7, /* O: band7 ratio [CMG window] */
+    int16 **slpratiob1, /* O: slope band1 ratio [CMG window] */
+    int16 **slpratiob2, /* O: slope band2 ratio [CMG window] */
+    int16 **slpratiob7, /* O: slope band7 ratio [CMG window] */
+    uint16 **wv,        /* O: water vapor values [CMG window] */
+    uint8 **oz          /* O: ozone values [CMG window] */
 )
 {
     char FUNC_NAME[] = "read_auxiliary_files"; /* function name */
@@ -2593,10 +3017,6 @@ int read_auxiliary_files
     char sds_name[STR_SIZE]; /* name of the SDS being read */
     int i, j;            /* looping variables */
     int status;          /* return status of the HDF function */
-    int start[5];        /* starting point to read SDS data; handles up to
-                            4D dataset */
-    int edges[5];        /* number of values to read in SDS data; handles up to
-                            4D dataset */
     int sd_id;           /* file ID for the HDF file */
     int sds_id;          /* ID for the current SDS */
     int sds_index;       /* index for the current SDS */
@@ -2630,20 +3050,14 @@ int read_auxiliary_files
         return (ERROR);
     }
 
-    /* Read the data one line at a time */
-    for (i = 0; i < DEM_NBLAT; i++)
+    /* Read the data of the CMG window */
+    status = read_cmg_window (sds_id, cmg_win, sizeof (int16),
+        (void **) dem);
+    if (status != SUCCESS)
     {
-        start[0] = i;  /* line */
-        start[1] = 0;  /* sample */
-        edges[0] = 1;
-        edges[1] = DEM_NBLON;
-        status = SDreaddata (sds_id, start, NULL, edges, dem[i]);
-        if (status == -1)
-        {
-            sprintf (errmsg, "Reading data from the SDS: %s", sds_name);
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
+        sprintf (errmsg, "Reading data from the SDS: %s", sds_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
     }
 
     /* Close the SDS */
@@ -2692,20 +3106,14 @@ int read_auxiliary_files
         return (ERROR);
     }
 
-    /* Read the data one line at a time */
-    for (i = 0; i < RATIO_NBLAT; i++)
+    /* Read the data of the CMG window */
+    status = read_cmg_window (sds_id, cmg_win, sizeof (int16),
+        (void **) andwi);
+    if (status != SUCCESS)
     {
-        start[0] = i;  /* line */
-        start[1] = 0;  /* sample */
-        edges[0] = 1;
-        edges[1] = RATIO_NBLON;
-        status = SDreaddata (sds_id, start, NULL, edges, andwi[i]);
-        if (status == -1)
-        {
-            sprintf (errmsg, "Reading data from the SDS: %s", sds_name);
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
+        sprintf (errmsg, "Reading data from the SDS: %s", sds_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
     }
 
     /* Close the SDS */
@@ -2736,20 +3144,14 @@ int read_auxiliary_files
         return (ERROR);
     }
 
-    /* Read the data one line at a time */
-    for (i = 0; i < RATIO_NBLAT; i++)
+    /* Read the data of the CMG window */
+    status = read_cmg_window (sds_id, cmg_win, sizeof (int16),
+        (void **) sndwi);
+    if (status != SUCCESS)
     {
-        start[0] = i;  /* line */
-        start[1] = 0;  /* sample */
-        edges[0] = 1;
-        edges[1] = RATIO_NBLON;
-        status = SDreaddata (sds_id, start, NULL, edges, sndwi[i]);
-        if (status == -1)
-        {
-            sprintf (errmsg, "Reading data from the SDS: %s", sds_name);
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
+        sprintf (errmsg, "Reading data from the SDS: %s", sds_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
     }
 
     /* Close the SDS */
@@ -2780,20 +3182,14 @@ int read_auxiliary_files
         return (ERROR);
     }
 
-    /* Read the data one line at a time */
-    for (i = 0; i < RATIO_NBLAT; i++)
+    /* Read the data of the CMG window */
+    status = read_cmg_window (sds_id, cmg_win, sizeof (int16),
+        (void **) slpratiob1);
+    if (status != SUCCESS)
     {
-        start[0] = i;  /* line */
-        start[1] = 0;  /* sample */
-        edges[0] = 1;
-        edges[1] = RATIO_NBLON;
-        status = SDreaddata (sds_id, start, NULL, edges, slpratiob1[i]);
-        if (status == -1)
-        {
-            sprintf (errmsg, "Reading data from the SDS: %s", sds_name);
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
+        sprintf (errmsg, "Reading data from the SDS: %s", sds_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
     }
 
     /* Close the SDS */
@@ -2824,20 +3220,14 @@ int read_auxiliary_files
         return (ERROR);
     }
 
-    /* Read the data one line at a time */
-    for (i = 0; i < RATIO_NBLAT; i++)
+    /* Read the data of the CMG window */
+    status = read_cmg_window (sds_id, cmg_win, sizeof (int16),
+        (void **) intratiob1);
+    if (status != SUCCESS)
     {
-        start[0] = i;  /* line */
-        start[1] = 0;  /* sample */
-        edges[0] = 1;
-        edges[1] = RATIO_NBLON;
-        status = SDreaddata (sds_id, start, NULL, edges, intratiob1[i]);
-        if (status == -1)
-        {
-            sprintf (errmsg, "Reading data from the SDS: %s", sds_name);
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
+        sprintf (errmsg, "Reading data from the SDS: %s", sds_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
     }
 
     /* Close the SDS */
@@ -2868,20 +3258,14 @@ int read_auxiliary_files
         return (ERROR);
     }
 
-    /* Read the data one line at a time */
-    for (i = 0; i < RATIO_NBLAT; i++)
+    /* Read the data of the CMG window */
+    status = read_cmg_window (sds_id, cmg_win, sizeof (int16),
+        (void **) slpratiob2);
+    if (status != SUCCESS)
     {
-        start[0] = i;  /* line */
-        start[1] = 0;  /* sample */
-        edges[0] = 1;
-        edges[1] = RATIO_NBLON;
-        status = SDreaddata (sds_id, start, NULL, edges, slpratiob2[i]);
-        if (status == -1)
-        {
-            sprintf (errmsg, "Reading data from the SDS: %s", sds_name);
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
+        sprintf (errmsg, "Reading data from the SDS: %s", sds_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
     }
 
     /* Close the SDS */
@@ -2912,20 +3296,14 @@ int read_auxiliary_files
         return (ERROR);
     }
 
-    /* Read the data one line at a time */
-    for (i = 0; i < RATIO_NBLAT; i++)
+    /* Read the data of the CMG window */
+    status = read_cmg_window (sds_id, cmg_win, sizeof (int16),
+        (void **) intratiob2);
+    if (status != SUCCESS)
     {
-        start[0] = i;  /* line */
-        start[1] = 0;  /* sample */
-        edges[0] = 1;
-        edges[1] = RATIO_NBLON;
-        status = SDreaddata (sds_id, start, NULL, edges, intratiob2[i]);
-        if (status == -1)
-        {
-            sprintf (errmsg, "Reading data from the SDS: %s", sds_name);
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
+        sprintf (errmsg, "Reading data from the SDS: %s", sds_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
     }
 
     /* Close the SDS */
@@ -2956,20 +3334,14 @@ int read_auxiliary_files
         return (ERROR);
     }
 
-    /* Read the data one line at a time */
-    for (i = 0; i < RATIO_NBLAT; i++)
+    /* Read the data of the CMG window */
+    status = read_cmg_window (sds_id, cmg_win, sizeof (int16),
+        (void **) slpratiob7);
+    if (status != SUCCESS)
     {
-        start[0] = i;  /* line */
-        start[1] = 0;  /* sample */
-        edges[0] = 1;
-        edges[1] = RATIO_NBLON;
-        status = SDreaddata (sds_id, start, NULL, edges, slpratiob7[i]);
-        if (status == -1)
-        {
-            sprintf (errmsg, "Reading data from the SDS: %s", sds_name);
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
+        sprintf (errmsg, "Reading data from the SDS: %s", sds_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
     }
 
     /* Close the SDS */
@@ -3000,20 +3372,14 @@ int read_auxiliary_files
         return (ERROR);
     }
 
-    /* Read the data one line at a time */
-    for (i = 0; i < RATIO_NBLAT; i++)
+    /* Read the data of the CMG window */
+    status = read_cmg_window (sds_id, cmg_win, sizeof (int16),
+        (void **) intratiob7);
+    if (status != SUCCESS)
     {
-        start[0] = i;  /* line */
-        start[1] = 0;  /* sample */
-        edges[0] = 1;
-        edges[1] = RATIO_NBLON;
-        status = SDreaddata (sds_id, start, NULL, edges, intratiob7[i]);
-        if (status == -1)
-        {
-            sprintf (errmsg, "Reading data from the SDS: %s", sds_name);
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
+        sprintf (errmsg, "Reading data from the SDS: %s", sds_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
     }
 
     /* Close the SDS */
@@ -3035,9 +3401,9 @@ int read_auxiliary_files
     }
 
     /* Compute the band ratios based on the averaged NDWI */
-    for (i = 0; i < RATIO_NBLAT; i++)
+    for (i = 0; i < cmg_win->nlines; i++)
     {
-        for (j = 0; j < RATIO_NBLON; j++)
+        for (j = 0; j < cmg_win->nsamps; j++)
         {
             ratiob1[i][j] = (int16) (andwi[i][j] * slpratiob1[i][j] * 0.001 +
                 intratiob1[i][j]);
@@ -3077,20 +3443,14 @@ int read_auxiliary_files
         return (ERROR);
     }
 
-    /* Read the data one line at a time */
-    for (i = 0; i < CMG_NBLAT; i++)
+    /* Read the data of the CMG window */
+    status = read_cmg_window (sds_id, cmg_win, sizeof (uint8),
+        (void **) oz);
+    if (status != SUCCESS)
     {
-        start[0] = i;  /* line */
-        start[1] = 0;  /* sample */
-        edges[0] = 1;
-        edges[1] = CMG_NBLON;
-        status = SDreaddata (sds_id, start, NULL, edges, oz[i]);
-        if (status == -1)
-        {
-            sprintf (errmsg, "Reading data from the SDS: %s", sds_name);
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
+        sprintf (errmsg, "Reading data from the SDS: %s", sds_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
     }
 
     /* Close the SDS */
@@ -3121,20 +3481,14 @@ int read_auxiliary_files
         return (ERROR);
     }
 
-    /* Read the data one line at a time */
-    for (i = 0; i < CMG_NBLAT; i++)
+    /* Read the data of the CMG window */
+    status = read_cmg_window (sds_id, cmg_win, sizeof (uint16),
+        (void **) wv);
+    if (status != SUCCESS)
     {
-        start[0] = i;  /* line */
-        start[1] = 0;  /* sample */
-        edges[0] = 1;
-        edges[1] = CMG_NBLON;
-        status = SDreaddata (sds_id, start, NULL, edges, wv[i]);
-        if (status == -1)
-        {
-            sprintf (errmsg, "Reading data from the SDS: %s", sds_name);
-            error_handler (true, FUNC_NAME, errmsg);
-            return (ERROR);
-        }
+        sprintf (errmsg, "Reading data from the SDS: %s", sds_name);
+        error_handler (true, FUNC_NAME, errmsg);
+        return (ERROR);
     }
 
     /* Close the SDS */
@@ -6,10 +6,117 @@
 #include <string.h>
 #include <math.h>
 #include <stdbool.h>
+#include <sys/types.h>
 #include "common.h"
 #include "espa_metadata.h"
 #include "error_handler.h"
 
+/* Look-up table dimensions */
+#define NPRES_VALS 7         /* surface pressure levels */
+#define NAOT_VALS 22         /* aerosol optical thickness values */
+#define NSOLAR_ZEN_VALS 22   /* solar zenith angles */
+#define NVIEW_ZEN_VALS 20    /* observation zenith angles */
+#define NSCATTER_VALS 8000   /* intrinsic reflectance values of each band,
+                                pressure and AOT */
+
+/* Identification of the look-up tables in a binary file */
+#define LUT_MAGIC "L8SRLUT"
+#define LUT_VERSION 2
+
+/* Source files of the look-up tables (angle HDF, intrinsic reflectance,
+   transmission and spherical albedo files) */
+#define NLUT_FILES 4
+
+/* Look-up tables and table constants of the atmospheric correction.  The
+   tables are fixed-size arrays, so the whole structure is one contiguous
+   block indexed with constant strides: it is written to a binary file as-is
+   and mapped back read-only from it.  The header identifies the file and
+   the source files it was built from, and checksums the tables. */
+typedef struct
+{
+    char magic[8];          /* LUT_MAGIC */
+    int32 version;          /* LUT_VERSION */
+    int32 size;             /* size of the structure (bytes) */
+    uint32 checksum;        /* Adler-32 checksum of the tables, from
+                               oztransa to the end of the structure */
+    off_t src_size[NLUT_FILES];    /* size of the source files (bytes) */
+    time_t src_mtime[NLUT_FILES];  /* modification time of the source
+                                      files */
+
+    double oztransa[NSR_BANDS];   /* ozone transmission coeff */
+    double wvtransa[NSR_BANDS];   /* water vapor transmission coeff */
+    double wvtransb[NSR_BANDS];   /* water vapor transmission coeff */
+    double ogtransa1[NSR_BANDS];  /* other gases transmission coeff */
+    double ogtransb0[NSR_BANDS];  /* other gases transmission coeff */
+    double ogtransb1[NSR_BANDS];  /* other gases transmission coeff */
+    float tauray[NSR_BANDS];      /* molecular optical thickness coeff */
+    float tpres[NPRES_VALS];      /* surface pressure table */
+    float aot550nm[NAOT_VALS];    /* AOT look-up table */
+
+    float xtsstep;          /* solar zenith step value */
+    float xtsmin;           /* minimum solar zenith value */
+    float xtvstep;          /* observation step value */
+    float xtvmin;           /* minimum observation value */
+    float tts[NSOLAR_ZEN_VALS];     /* sun angle table */
+    int32 indts[NSOLAR_ZEN_VALS];   /* index of each sun angle in the
+                                       intrinsic reflectance table */
+    float tsmax[NVIEW_ZEN_VALS][NSOLAR_ZEN_VALS];
+                            /* maximum scattering angle table */
+    float tsmin[NVIEW_ZEN_VALS][NSOLAR_ZEN_VALS];
+                            /* minimum scattering angle table */
+    float ttv[NVIEW_ZEN_VALS][NSOLAR_ZEN_VALS];
+                            /* view angle table */
+    float nbfic[NVIEW_ZEN_VALS][NSOLAR_ZEN_VALS];
+                            /* communitive number of azimuth angles */
+    float nbfi[NVIEW_ZEN_VALS][NSOLAR_ZEN_VALS];
+                            /* number of azimuth angles */
+
+    float sphalbt[NSR_BANDS][NPRES_VALS][NAOT_VALS];
+                            /* spherical albedo table */
+    float normext[NSR_BANDS][NPRES_VALS][NAOT_VALS];
+                            /* aerosol extinction coefficient at the current
+                               wavelength (normalized at 550nm) */
+    float transt[NSR_BANDS][NPRES_VALS][NAOT_VALS][NSOLAR_ZEN_VALS];
+                            /* transmission table */
+    float rolutt[NSR_BANDS][NPRES_VALS][NAOT_VALS][NSCATTER_VALS];
+                            /* intrinsic reflectance table */
+} Lut_t;
+
+/* Window of the CMG grids (DEM, ratio, ozone and water vapor grids) read
+   for a scene.  Like the CMG interpolation, the window wraps around the
+   dateline and the poles, so it may run past the last sample or line of the
+   grids back to the first ones. */
+typedef struct
+{
+    int line0;          /* first CMG line of the window */
+    int samp0;          /* first CMG sample of the window */
+    int nlines;         /* number of lines of the window */
+    int nsamps;         /* number of samples of the window */
+} Cmg_window_t;
+
+/* Pressure grid of the molecular reflectance in the scene look-up table.  The
+   molecular reflectance doesn't depend on the AOT, but it is too curved in
+   pressure to be interpolated between the 7 pressure levels of the LUTs. */
+#define NRAY_PRES 76         /* pressure levels of the molecular reflectance */
+#define RAY_PRES_MIN 350.0   /* first pressure level (millibars) */
+#define RAY_PRES_STEP 10.0   /* pressure step (millibars) */
+
+/* Look-up table of a scene.  The solar and view angles are constant over a
+   scene, so the atmospheric reflectance and the transmissions are computed
+   once per scene at the pressure and AOT nodes of the LUTs, and interpolated
+   in pressure and AOT for each pixel like the LUTs themselves. */
+typedef struct
+{
+    float roatm[NSR_BANDS][NPRES_VALS][NAOT_VALS];
+                            /* atmospheric reflectance */
+    float xtts[NSR_BANDS][NPRES_VALS][NAOT_VALS];
+                            /* downward transmittance */
+    float xttv[NSR_BANDS][NPRES_VALS][NAOT_VALS];
+                            /* upward transmittance */
+    float xrorayp[NSR_BANDS][NRAY_PRES];
+                            /* molecular reflectance */
+} Scene_lut_t;
+
 /* Prototypes */
 int atmcorlamb2
 (
@@ -23,40 +130,12 @@ int atmcorlamb2
     float raot550nm,                 /* I: nearest value of AOT */
     int iband,                       /* I: band index (0-based) */
     float pres,                      /* I: surface pressure */
-    float tpres[7],                  /* I: surface pressure table */
-    float aot550nm[22],              /* I: AOT look-up table */
-    float ****rolutt,                /* I: intrinsic reflectance table
-                                           [NSR_BANDS][7][22][8000] */
-    float ****transt,                /* I: transmission table
-                                           [NSR_BANDS][7][22][22] */
-    float xtsstep,                   /* I: solar zenith step value */
-    float xtsmin,                    /* I: minimum solar zenith value */
-    float xtvstep,                   /* I: observation step value */
-    float xtvmin,                    /* I: minimum observation value */
-    float ***sphalbt,                /* I: spherical albedo table
-                                           [NSR_BANDS][7][22] */
-    float ***normext,                /* I: ?????
-                                           [NSR_BANDS][7][22] */
-    float **tsmax,                   /* I: maximum scattering angle table
-                                           [20][22] */
-    float **tsmin,                   /* I: minimum scattering angle table
-                                           [20][22] */
-    float **nbfic,                   /* I: communitive number of azimuth angles
-                                           [20][22] */
-    float **nbfi,                    /* I: number of azimuth angles [20][22] */
-    float tts[22],                   /* I: sun angle table */
-    int32 indts[22],
-    float **ttv,                     /* I: view angle table [20][22] */
+    Lut_t *lut,                      /* I: look-up tables */
+    Scene_lut_t *slut,               /* I: look-up table of the scene, NULL
+                                           to interpolate the LUTs */
     float uoz,                       /* I: total column ozone */
     float uwv,                       /* I: total column water vapor (precipital
                                            water vapor) */
-    float tauray[NSR_BANDS],         /* I: molecular optical thickness coeff */
-    double ogtransa1[NSR_BANDS],     /* I: other gases transmission coeff */
-    double ogtransb0[NSR_BANDS],     /* I: other gases transmission coeff */
-    double ogtransb1[NSR_BANDS],     /* I: other gases transmission coeff */
-    double wvtransa[NSR_BANDS],      /* I: water vapor transmission coeff */
-    double wvtransb[NSR_BANDS],      /* I: water vapor transmission coeff */
-    double oztransa[NSR_BANDS],      /* I: ozone transmission coeff */
     float rotoa,                     /* I: top of atmosphere reflectance */
     float *roslamb,                  /* O: lambertian surface reflectance */
     float *tgo,                      /* O: other gaseous transmittance */
@@ -109,12 +188,7 @@ void compsalb
     float raot550nm,    /* I: nearest value of AOT */
     int iband,          /* I: band index (0-based) */
     float pres,         /* I: surface pressure */
-    float tpres[7],     /* I: surface pressure table */
-    float aot550nm[22], /* I: AOT look-up table */
-    float ***sphalbt,   /* I: spherical albedo table [NSR_BANDS][7][22] */
-    float ***normext,   /* I: aerosol extinction coefficient at the current
-                              wavelength (normalized at 550nm)
-                              [NSR_BANDS][7][22] */
+    Lut_t *lut,         /* I: look-up tables */
     float *satm,        /* O: spherical albedo */
     float *next         /* O: ????? */
 );
@@ -129,13 +203,9 @@ void comptrans
     float raot550nm,    /* I: nearest value of AOT */
     int iband,          /* I: band index (0-based) */
     float pres,         /* I: surface pressure */
-    float tpres[7],     /* I: surface pressure table */
-    float aot550nm[22], /* I: AOT look-up table */
-    float ****transt,   /* I: transmission table
-                              [NSR_BANDS][7][22][22] */
+    Lut_t *lut,         /* I: look-up tables */
     float xtsstep,      /* I: zenith angle step value */
     float xtsmin,       /* I: minimum zenith angle value */
-    float tts[22],      /* I: sun angle table */
     float *xtts         /* O: downward transmittance */
 );
 
@@ -153,21 +223,7 @@ void comproatm
     float raot550nm,    /* I: nearest value of AOT */
     int iband,          /* I: band index (0-based) */
     float pres,         /* I: surface pressure */
-    float tpres[7],     /* I: surface pressure table */
-    float aot550nm[22], /* I: AOT look-up table */
-    float ****rolutt,   /* I: intrinsic reflectance table
-                              [NSR_BANDS][7][22][8000] */
-    float **tsmax,      /* I: maximum scattering angle table [20][22] */
-    float **tsmin,      /* I: minimum scattering angle table [20][22] */
-    float **nbfic,      /* I: communitive number of azimuth angles [20][22] */
-    float **nbfi,       /* I: number of azimuth angles [20][22] */
-    float tts[22],      /* I: sun angle table */
-    int32 indts[22],
-    float **ttv,        /* I: view angle table [20][22] */
-    float xtsstep,      /* I: solar zenith step value */
-    float xtsmin,       /* I: minimum solar zenith value */
-    float xtvstep,      /* I: observation step value */
-    float xtvmin,       /* I: minimum observation value */
+    Lut_t *lut,         /* I: look-up tables */
     int its,            /* I: index for the sun angle table */
     int itv,            /* I: index for the view angle table */
     float *roatm        /* O: atmospheric reflectance */
@@ -175,24 +231,7 @@ void comproatm
 
 int readluts
 (
-    float **tsmax,              /* O: maximum scattering angle table [20][22] */
-    float **tsmin,              /* O: minimum scattering angle table [20][22] */
-    float **ttv,                /* O: view angle table [20][22] */
-    float tts[22],              /* O: sun angle table */
-    float **nbfic,              /* O: communitive number of azimuth angles
-                                      [20][22] */
-    float **nbfi,               /* O: number of azimuth angles [20][22] */
-    int32 indts[22],            /* O: */
-    float ****rolutt,           /* O: intrinsic reflectance table
-                                      [NSR_BANDS][7][22][8000] */
-    float ****transt,           /* O: transmission table
-                                      [NSR_BANDS][7][22][22] */
-    float ***sphalbt,           /* O: spherical albedo table
-                                      [NSR_BANDS][7][22] */
-    float ***normext,           /* O: ?????
-                                      [NSR_BANDS][7][22] */
-    float xtsstep,              /* I: solar zenith step value */
-    float xtsmin,               /* I: minimum solar zenith value */
+    Lut_t *lut,                 /* O: look-up tables */
     char anglehdf[STR_SIZE],    /* I: angle HDF filename */
     char intrefnm[STR_SIZE],    /* I: intrinsic reflectance filename */
     char transmnm[STR_SIZE],    /* I: transmission filename */
@@ -216,37 +255,9 @@ int subaeroret
                                            water vapor) */
     float erelc[NSR_BANDS],          /* I: band ratio variable */
     float troatm[NSR_BANDS],         /* I: atmospheric reflectance table */
-    float tpres[7],                  /* I: surface pressure table */
-    float aot550nm[22],              /* I: AOT look-up table */
-    float ****rolutt,                /* I: intrinsic reflectance table
-                                           [NSR_BANDS][7][22][8000] */
-    float ****transt,                /* I: transmission table
-                                           [NSR_BANDS][7][22][22] */
-    float xtsstep,                   /* I: solar zenith step value */
-    float xtsmin,                    /* I: minimum solar zenith value */
-    float xtvstep,                   /* I: observation step value */
-    float xtvmin,                    /* I: minimum observation value */
-    float ***sphalbt,                /* I: spherical albedo table
-                                           [NSR_BANDS][7][22] */
-    float ***normext,                /* I: ????
-                                           [NSR_BANDS][7][22] */
-    float **tsmax,                   /* I: maximum scattering angle table
-                                           [20][22] */
-    float **tsmin,                   /* I: minimum scattering angle table
-                                           [20][22] */
-    float **nbfic,                   /* I: communitive number of azimuth angles
-                                           [20][22] */
-    float **nbfi,                    /* I: number of azimuth anglesi [20][22] */
-    float tts[22],                   /* I: sun angle table */
-    int32 indts[22],
-    float **ttv,                     /* I: view angle table [20][22] */
-    float tauray[NSR_BANDS],         /* I: molecular optical thickness coeff */
-    double ogtransa1[NSR_BANDS],     /* I: other gases transmission coeff */
-    double ogtransb0[NSR_BANDS],     /* I: other gases transmission coeff */
-    double ogtransb1[NSR_BANDS],     /* I: other gases transmission coeff */
-    double wvtransa[NSR_BANDS],      /* I: water vapor transmission coeff */
-    double wvtransb[NSR_BANDS],      /* I: water vapor transmission coeff */
-    double oztransa[NSR_BANDS],      /* I: ozone transmission coeff */
+    Lut_t *lut,                      /* I: look-up tables */
+    Scene_lut_t *slut,               /* I: look-up table of the scene, NULL
+                                           to interpolate the LUTs */
     float *raot,                     /* O: AOT reflectance */
     float *residual,                 /* O: model residual */
     float *snext                     /* O: ????? */
@@ -276,100 +287,101 @@ int subaeroret_residual
                                            water vapor) */
     float erelc[NSR_BANDS],          /* I: band ratio variable */
     float troatm[NSR_BANDS],         /* I: atmospheric reflectance table */
-    float tpres[7],                  /* I: surface pressure table */
-    float aot550nm[22],              /* I: AOT look-up table */
-    float ****rolutt,                /* I: intrinsic reflectance table
-                                           [NSR_BANDS][7][22][8000] */
-    float ****transt,                /* I: transmission table
-                                           [NSR_BANDS][7][22][22] */
-    float xtsstep,                   /* I: solar zenith step value */
-    float xtsmin,                    /* I: minimum solar zenith value */
-    float xtvstep,                   /* I: observation step value */
-    float xtvmin,                    /* I: minimum observation value */
-    float ***sphalbt,                /* I: spherical albedo table
-                                           [NSR_BANDS][7][22] */
-    float ***normext,                /* I: ????
-                                           [NSR_BANDS][7][22] */
-    float **tsmax,                   /* I: maximum scattering angle table
-                                           [20][22] */
-    float **tsmin,                   /* I: minimum scattering angle table
-                                           [20][22] */
-    float **nbfic,                   /* I: communitive number of azimuth angles
-                                           [20][22] */
-    float **nbfi,                    /* I: number of azimuth anglesi [20][22] */
-    float tts[22],                   /* I: sun angle table */
-    int32 indts[22],
-    float **ttv,                     /* I: view angle table [20][22] */
-    float tauray[NSR_BANDS],         /* I: molecular optical thickness coeff */
-    double ogtransa1[NSR_BANDS],     /* I: other gases transmission coeff */
-    double ogtransb0[NSR_BANDS],     /* I: other gases transmission coeff */
-    double ogtransb1[NSR_BANDS],     /* I: other gases transmission coeff */
-    double wvtransa[NSR_BANDS],      /* I: water vapor transmission coeff */
-    double wvtransb[NSR_BANDS],      /* I: water vapor transmission coeff */
-    double oztransa[NSR_BANDS],      /* I: ozone transmission coeff */
+    Lut_t *lut,                      /* I: look-up tables */
+    Scene_lut_t *slut,               /* I: look-up table of the scene, NULL
+                                           to interpolate the LUTs */
     float *residual,                 /* O: model residual */
     float *snext                     /* O: ????? */
 );
 
-int memory_allocation_main
+int memory_allocation_bands
 (
-    int nlines,          /* I: number of lines in the scene */
+    int nlines,          /* I: number of lines of the stripe */
     int nsamps,          /* I: number of samples in the scene */
-    uint16 **qaband,     /* O: QA band for the input image, nlines x nsamps */
-    int16 ***sband       /* O: output surface reflectance and brightness temp
-                               bands */
+    uint16 **qaband,     /* O: QA band of the stripe, nlines x nsamps */
+    int16 ***sband       /* O: output TOA reflectance and brightness temp
+                               bands of the stripe */
 );
 
 int memory_allocation_sr
 (
-    int nlines,          /* I: number of lines in the scene */
-    int nsamps,          /* I: number of samples in the scene */
-    int16 **aerob1,      /* O: atmospherically corrected band 1 data
-                               (TOA refl), nlines x nsamps */
-    int16 **aerob2,      /* O: atmospherically corrected band 2 data
-                               (TOA refl), nlines x nsamps */
-    int16 **aerob4,      /* O: atmospherically corrected band 4 data
-                               (TOA refl), nlines x nsamps */
-    int16 **aerob5,      /* O: atmospherically corrected band 5 data
-                               (TOA refl), nlines x nsamps */
-    int16 **aerob7,      /* O: atmospherically corrected band 7 data
-                               (TOA refl), nlines x nsamps */
-    uint8 **cloud,       /* O: bit-packed value that represent clouds,
-                               nlines x nsamps */
-    float **twvi,        /* O: interpolated water vapor value,
-                               nlines x nsamps */
-    float **tozi,        /* O: interpolated ozone value, nlines x nsamps */
-    float **tp,          /* O: interpolated pressure value, nlines x nsamps */
-    float **tresi,       /* O: residuals for each pixel, nlines x nsamps */
-    float **taero,       /* O: aerosol values for each pixel, nlines x nsamps */
-    uint8 **lw_mask,     /* O: land/water mask data, nlines x nsamps */
-    int16 ***dem,        /* O: CMG DEM data array [DEM_NBLAT][DEM_NBLON] */
-    int16 ***andwi,      /* O: avg NDWI [RATIO_NBLAT][RATIO_NBLON] */
-    int16 ***sndwi,      /* O: standard NDWI [RATIO_NBLAT][RATIO_NBLON] */
-    int16 ***ratiob1,    /* O: mean band1 ratio [RATIO_NBLAT][RATIO_NBLON] */
-    int16 ***ratiob2,    /* O: mean band2 ratio [RATIO_NBLAT][RATIO_NBLON] */
-    int16 ***ratiob7,    /* O: mean band7 ratio [RATIO_NBLAT][RATIO_NBLON] */
-    int16 ***intratiob1, /* O: band1 ratio [RATIO_NBLAT][RATIO_NBLON] */
-    int16 ***intratiob2, /* O: band2 ratio [RATIO_NBLAT][RATIO_NBLON] */
-    int16 ***intratiob7, /* O: band7 ratio [RATIO_NBLAT][RATIO_NBLON] */
-    int16 ***slpratiob1, /* O: slope band1 ratio [RATIO_NBLAT][RATIO_NBLON] */
-    int16 ***slpratiob2, /* O: slope band2 ratio [RATIO_NBLAT][RATIO_NBLON] */
-    int16 ***slpratiob7, /* O: slope band7 ratio [RATIO_NBLAT][RATIO_NBLON] */
-    uint16 ***wv,        /* O: water vapor values [CMG_NBLAT][CMG_NBLON] */
-    uint8 ***oz,         /* O: ozone values [CMG_NBLAT][CMG_NBLON] */
-    float *****rolutt,   /* O: intrinsic reflectance table
-                               [NSR_BANDS][7][22][8000] */
-    float *****transt,   /* O: transmission table
-                               [NSR_BANDS][7][22][22] */
-    float ****sphalbt,   /* O: spherical albedo table [NSR_BANDS][7][22] */
-    float ****normext,   /* O: aerosol extinction coefficient at the current
-                               wavelength (normalized at 550nm)
-                               [NSR_BANDS][7][22] */
-    float ***tsmax,      /* O: maximum scattering angle table [20][22] */
-    float ***tsmin,      /* O: minimum scattering angle table [20][22] */
-    float ***nbfic,      /* O: communitive number of azimuth angles [20][22] */
-    float ***nbfi,       /* O: number of azimuth angles [20][22] */
-    float ***ttv         /* O: view angle table [20][22] */
+    int cmg_nlines,      /* I: number of lines of the CMG window */
+    int cmg_nsamps,      /* I: number of samples of the CMG window */
+    int16 ***dem,        /* O: CMG DEM data array [cmg_nlines][cmg_nsamps] */
+    int16 ***andwi,      /* O: avg NDWI [cmg_nlines][cmg_nsamps] */
+    int16 ***sndwi,      /* O: standard NDWI [cmg_nlines][cmg_nsamps] */
+    int16 ***ratiob1,    /* O: mean band1 ratio [cmg_nlines][cmg_nsamps] */
+    int16 ***ratiob2,    /* O: mean band2 ratio [cmg_nlines][cmg_nsamps] */
+    int16 ***ratiob7,    /* O: mean band7 ratio [cmg_nlines][cmg_nsamps] */
+    int16 ***intratiob1, /* O: band1 ratio [cmg_nlines][cmg_nsamps] */
+    int16 ***intratiob2, /* O: band2 ratio [cmg_nlines][cmg_nsamps] */
+    int16 ***intratiob7, /* O: band7 ratio [cmg_nlines][cmg_nsamps] */
+    int16 ***slpratiob1, /* O: slope band1 ratio [cmg_nlines][cmg_nsamps] */
+    int16 ***slpratiob2, /* O: slope band2 ratio [cmg_nlines][cmg_nsamps] */
+    int16 ***slpratiob7, /* O: slope band7 ratio [cmg_nlines][cmg_nsamps] */
+    uint16 ***wv,        /* O: water vapor values [cmg_nlines][cmg_nsamps] */
+    uint8 ***oz          /* O: ozone values [cmg_nlines][cmg_nsamps] */
+);
+
+void lut_filenames
+(
+    char *aux_path,             /* I: directory of the auxiliary products */
+    char anglehdf[STR_SIZE],    /* O: angle HDF filename */
+    char intrefnm[STR_SIZE],    /* O: intrinsic reflectance filename */
+    char transmnm[STR_SIZE],    /* O: transmission filename */
+    char spheranm[STR_SIZE]     /* O: spherical albedo filename */
+);
+
+int write_lut_file
+(
+    char *lutfile,      /* I: name of the binary look-up table file */
+    char *anglehdf,     /* I: angle HDF filename */
+    char *intrefnm,     /* I: intrinsic reflectance filename */
+    char *transmnm,     /* I: transmission filename */
+    char *spheranm,     /* I: spherical albedo filename */
+    Lut_t *lut          /* I/O: look-up tables, the checksum and the source
+                                file stamps are set */
+);
+
+int map_lut_file
+(
+    char *lutfile,      /* I: name of the binary look-up table file */
+    char *anglehdf,     /* I: angle HDF filename */
+    char *intrefnm,     /* I: intrinsic reflectance filename */
+    char *transmnm,     /* I: transmission filename */
+    char *spheranm,     /* I: spherical albedo filename */
+    Lut_t **lut         /* O: look-up tables mapped read-only */
+);
+
+void unmap_lut_file
+(
+    Lut_t *lut          /* I: look-up tables mapped by map_lut_file */
+);
+
+int init_scene_lut
+(
+    float xts,          /* I: solar zenith angle (deg) */
+    float xtv,          /* I: observation zenith angle (deg) */
+    float xmus,         /* I: cosine of solar zenith angle */
+    float xmuv,         /* I: cosine of observation zenith angle */
+    float xfi,          /* I: azimuthal difference between sun and
+                              observation (deg) */
+    float cosxfi,       /* I: cosine of azimuthal difference */
+    Lut_t *lut,         /* I: look-up tables */
+    Scene_lut_t *slut   /* O: look-up table of the scene */
+);
+
+int compare_scene_lut
+(
+    float xts,          /* I: solar zenith angle (deg) */
+    float xtv,          /* I: observation zenith angle (deg) */
+    float xmus,         /* I: cosine of solar zenith angle */
+    float xmuv,         /* I: cosine of observation zenith angle */
+    float xfi,          /* I: azimuthal difference between sun and
+                              observation (deg) */
+    float cosxfi,       /* I: cosine of azimuthal difference */
+    Lut_t *lut,         /* I: look-up tables */
+    Scene_lut_t *slut   /* I: look-up table of the scene */
 );
 
 int read_auxiliary_files
@@ -381,20 +393,21 @@ int read_auxiliary_files
     char *cmgdemnm,     /* I: climate modeling grid DEM filename */
     char *rationm,      /* I: ratio averages filename */
     char *auxnm,        /* I: auxiliary filename for ozone and water vapor */
-    int16 **dem,        /* O: CMG DEM data array [DEM_NBLAT][DEM_NBLON] */
-    int16 **andwi,      /* O: avg NDWI [RATIO_NBLAT][RATIO_NBLON] */
-    int16 **sndwi,      /* O: standard NDWI [RATIO_NBLAT][RATIO_NBLON] */
-    int16 **ratiob1,    /* O: mean band1 ratio [RATIO_NBLAT][RATIO_NBLON] */
-    int16 **ratiob2,    /* O: mean band2 ratio [RATIO_NBLAT][RATIO_NBLON] */
-    int16 **ratiob7,    /* O: mean band7 ratio [RATIO_NBLAT][RATIO_NBLON] */
-    int16 **intratiob1, /* O: band1 ratio [RATIO_NBLAT][RATIO_NBLON] */
-    int16 **intratiob2, /* O: band2 ratio [RATIO_NBLAT][RATIO_NBLON] */
-    int16 **intratiob7, /* O: band7 ratio [RATIO_NBLAT][RATIO_NBLON] */
-    int16 **slpratiob1, /* O: slope band1 ratio [RATIO_NBLAT][RATIO_NBLON] */
-    int16 **slpratiob2, /* O: slope band2 ratio [RATIO_NBLAT][RATIO_NBLON] */
-    int16 **slpratiob7, /* O: slope band7 ratio [RATIO_NBLAT][RATIO_NBLON] */
-    uint16 **wv,        /* O: water vapor values [CMG_NBLAT][CMG_NBLON] */
-    uint8 **oz          /* O: ozone values [CMG_NBLAT][CMG_NBLON] */
+    Cmg_window_t *cmg_win,  /* I: window of the CMG grids to be read */
+    int16 **dem,        /* O: CMG DEM data array [CMG window] */
+    int16 **andwi,      /* O: avg NDWI [CMG window] */
+    int16 **sndwi,      /* O: standard NDWI [CMG window] */
+    int16 **ratiob1,    /* O: mean band1 ratio [CMG window] */
+    int16 **ratiob2,    /* O: mean band2 ratio [CMG window] */
+    int16 **ratiob7,    /* O: mean band7 ratio [CMG window] */
+    int16 **intratiob1, /* O: band1 ratio [CMG window] */
+    int16 **intratiob2, /* O: band2 ratio [CMG window] */
+    int16 **intratiob7, /* O: band7 ratio [CMG window] */
+    int16 **slpratiob1, /* O: slope band1 ratio [CMG window] */
+    int16 **slpratiob2, /* O: slope band2 ratio [CMG window] */
+    int16 **slpratiob7, /* O: slope band7 ratio [CMG window] */
+    uint16 **wv,        /* O: water vapor values [CMG window] */
+    uint8 **oz          /* O: ozone values [CMG window] */
 );
 
 #endif
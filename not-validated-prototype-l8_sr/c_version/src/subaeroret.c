@@ -76,37 +76,9 @@ int subaeroret
                                            water vapor) */
     float erelc[NSR_BANDS],          /* I: band ratio variable */
     float troatm[NSR_BANDS],         /* I: atmospheric reflectance table */
-    float tpres[7],                  /* I: surface pressure table */
-    float aot550nm[22],              /* I: AOT look-up table */
-    float ****rolutt,                /* I: intrinsic reflectance table
-                                           [NSR_BANDS][7][22][8000] */
-    float ****transt,                /* I: transmission table
-                                           [NSR_BANDS][7][22][22] */
-    float xtsstep,                   /* I: solar zenith step value */
-    float xtsmin,                    /* I: minimum solar zenith value */
-    float xtvstep,                   /* I: observation step value */
-    float xtvmin,                    /* I: minimum observation value */
-    float ***sphalbt,                /* I: spherical albedo table
-                                           [NSR_BANDS][7][22] */
-    float ***normext,                /* I: ????
-                                           [NSR_BANDS][7][22] */
-    float **tsmax,                   /* I: maximum scattering angle table
-                                           [20][22] */
-    float **tsmin,                   /* I: minimum scattering angle table
-                                           [20][22] */
-    float **nbfic,                   /* I: communitive number of azimuth angles
-                                           [20][22] */
-    float **nbfi,                    /* I: number of azimuth anglesi [20][22] */
-    float tts[22],                   /* I: sun angle table */
-    int32 indts[22],
-    float **ttv,                     /* I: view angle table [20][22] */
-    float tauray[NSR_BANDS],         /* I: molecular optical thickness coeff */
-    double ogtransa1[NSR_BANDS],     /* I: other gases transmission coeff */
-    double ogtransb0[NSR_BANDS],     /* I: other gases transmission coeff */
-    double ogtransb1[NSR_BANDS],     /* I: other gases transmission coeff */
-    double wvtransa[NSR_BANDS],      /* I: water vapor transmission coeff */
-    double wvtransb[NSR_BANDS],      /* I: water vapor transmission coeff */
-    double oztransa[NSR_BANDS],      /* I: ozone transmission coeff */
+    Lut_t *lut,                      /* I: look-up tables */
+    Scene_lut_t *slut,               /* I: look-up table of the scene, NULL
+                                           to interpolate the LUTs */
     float *raot,                     /* O: AOT reflectance */
     float *residual,                 /* O: model residual */
     float *snext                     /* O: ????? */
@@ -168,9 +140,9 @@ int subaeroret
         /* If flagn is set... start converge to the AOT bounds by dichotomy to
            increase the accuracy of the retrieval */
         if (!flagn)
-            raot550nm = aot550nm[iaot];
+            raot550nm = lut->aot550nm[iaot];
         else
-            raot550nm = (raot1 + aot550nm[iaot]) * 0.5;
+            raot550nm = (raot1 + lut->aot550nm[iaot]) * 0.5;
 
         /* Loop until convergence.  Add a mechanism to stop the loop from being
            infinite by stopping at 50 iterations. */
@@ -181,7 +153,7 @@ int subaeroret
             {
                 if (iaot >= 1)
                 {
-                    raot550nm = (raot550nm + aot550nm[iaot-1]) * 0.5;
+                    raot550nm = (raot550nm + lut->aot550nm[iaot-1]) * 0.5;
                 }
                 else
                 {
@@ -190,11 +162,8 @@ int subaeroret
                     *raot = raot550nm;
                     retval = subaeroret_residual (iband1, iband3, ros1, ros3,
                         roslamb, pratio, raot550nm, xts, xtv, xmus, xmuv, xfi,
-                        cosxfi, pres, uoz, uwv, erelc, troatm, tpres, aot550nm,
-                        rolutt, transt, xtsstep, xtsmin, xtvstep, xtvmin,
-                        sphalbt, normext, tsmax, tsmin, nbfic, nbfi, tts,
-                        indts, ttv, tauray, ogtransa1, ogtransb0, ogtransb1,
-                        wvtransa, wvtransb, oztransa, residual, snext);
+                        cosxfi, pres, uoz, uwv, erelc, troatm, lut, slut,
+                        residual, snext);
                     if (retval != SUCCESS)
                     {
                         sprintf (errmsg, "Computing the subaeroret model "
@@ -209,11 +178,8 @@ int subaeroret
 
             /* Atmospheric correction for band 3 */
             retval = atmcorlamb2 (xts, xtv, xmus, xmuv, xfi, cosxfi, raot550nm,
-                iband3, pres, tpres, aot550nm, rolutt, transt, xtsstep, xtsmin,
-                xtvstep, xtvmin, sphalbt, normext, tsmax, tsmin, nbfic, nbfi,
-                tts, indts, ttv, uoz, uwv, tauray, ogtransa1, ogtransb0,
-                ogtransb1, wvtransa, wvtransb, oztransa, troatm[iband3],
-                &roslamb, &tgo, &roatm, &ttatmg, &satm, &xrorayp, &next);
+                iband3, pres, lut, slut, uoz, uwv, troatm[iband3], &roslamb,
+                &tgo, &roatm, &ttatmg, &satm, &xrorayp, &next);
             if (retval != SUCCESS)
             {
                 sprintf (errmsg, "Performing lambertian atmospheric correction "
@@ -225,11 +191,8 @@ int subaeroret
 
             /* Atmospheric correction for band 1 */
             retval = atmcorlamb2 (xts, xtv, xmus, xmuv, xfi, cosxfi, raot550nm,
-                iband1, pres, tpres, aot550nm, rolutt, transt, xtsstep, xtsmin,
-                xtvstep, xtvmin, sphalbt, normext, tsmax, tsmin, nbfic, nbfi,
-                tts, indts, ttv, uoz, uwv, tauray, ogtransa1, ogtransb0,
-                ogtransb1, wvtransa, wvtransb, oztransa, troatm[iband1],
-                &roslamb, &tgo, &roatm, &ttatmg, &satm, &xrorayp, &next);
+                iband1, pres, lut, slut, uoz, uwv, troatm[iband1], &roslamb,
+                &tgo, &roatm, &ttatmg, &satm, &xrorayp, &next);
             if (retval != SUCCESS)
             {
                 sprintf (errmsg, "Performing lambertian atmospheric correction "
@@ -274,10 +237,7 @@ int subaeroret
 
         retval = subaeroret_residual (iband1, iband3, ros1, ros3, roslamb,
             pratio, raot550nm, xts, xtv, xmus, xmuv, xfi, cosxfi, pres, uoz,
-            uwv, erelc, troatm, tpres, aot550nm, rolutt, transt, xtsstep,
-            xtsmin, xtvstep, xtvmin, sphalbt, normext, tsmax, tsmin, nbfic,
-            nbfi, tts, indts, ttv, tauray, ogtransa1, ogtransb0, ogtransb1,
-            wvtransa, wvtransb, oztransa, residual, snext);
+            uwv, erelc, troatm, lut, slut, residual, snext);
         if (retval != SUCCESS)
         {
             sprintf (errmsg, "Computing the subaeroret model residual");
@@ -296,11 +256,8 @@ int subaeroret
     /* Atmospheric correction for band 3 */
     raot550nm = eaot;
     retval = atmcorlamb2 (xts, xtv, xmus, xmuv, xfi, cosxfi, raot550nm, iband3,
-        pres, tpres, aot550nm, rolutt, transt, xtsstep, xtsmin, xtvstep, xtvmin,
-        sphalbt, normext, tsmax, tsmin, nbfic, nbfi, tts, indts, ttv, uoz,
-        uwv, tauray, ogtransa1, ogtransb0, ogtransb1, wvtransa, wvtransb,
-        oztransa, troatm[iband3], &roslamb, &tgo, &roatm, &ttatmg, &satm,
-        &xrorayp, &next);
+        pres, lut, slut, uoz, uwv, troatm[iband3], &roslamb, &tgo, &roatm,
+        &ttatmg, &satm, &xrorayp, &next);
     if (retval != SUCCESS)
     {
         sprintf (errmsg, "Performing lambertian atmospheric correction "
@@ -312,11 +269,8 @@ int subaeroret
 
     /* Atmospheric correction for band 1 */
     retval = atmcorlamb2 (xts, xtv, xmus, xmuv, xfi, cosxfi, raot550nm, iband1,
-        pres, tpres, aot550nm, rolutt, transt, xtsstep, xtsmin, xtvstep, xtvmin,
-        sphalbt, normext, tsmax, tsmin, nbfic, nbfi, tts, indts, ttv, uoz,
-        uwv, tauray, ogtransa1, ogtransb0, ogtransb1, wvtransa, wvtransb,
-        oztransa, troatm[iband1], &roslamb, &tgo, &roatm, &ttatmg, &satm,
-        &xrorayp, &next);
+        pres, lut, slut, uoz, uwv, troatm[iband1], &roslamb, &tgo, &roatm,
+        &ttatmg, &satm, &xrorayp, &next);
     if (retval != SUCCESS)
     {
         sprintf (errmsg, "Performing lambertian atmospheric correction "
@@ -344,11 +298,8 @@ int subaeroret
     /* Atmospheric correction for band 3 */
     raot550nm = eaot;
     retval = atmcorlamb2 (xts, xtv, xmus, xmuv, xfi, cosxfi, raot550nm, iband3,
-        pres, tpres, aot550nm, rolutt, transt, xtsstep, xtsmin, xtvstep, xtvmin,
-        sphalbt, normext, tsmax, tsmin, nbfic, nbfi, tts, indts, ttv, uoz,
-        uwv, tauray, ogtransa1, ogtransb0, ogtransb1, wvtransa, wvtransb,
-        oztransa, troatm[iband3], &roslamb, &tgo, &roatm, &ttatmg, &satm,
-        &xrorayp, &next);
+        pres, lut, slut, uoz, uwv, troatm[iband3], &roslamb, &tgo, &roatm,
+        &ttatmg, &satm, &xrorayp, &next);
     if (retval != SUCCESS)
     {
         sprintf (errmsg, "Performing lambertian atmospheric correction "
@@ -360,11 +311,8 @@ int subaeroret
 
     /* Atmospheric correction for band 1 */
     retval = atmcorlamb2 (xts, xtv, xmus, xmuv, xfi, cosxfi, raot550nm, iband1,
-        pres, tpres, aot550nm, rolutt, transt, xtsstep, xtsmin, xtvstep, xtvmin,
-        sphalbt, normext, tsmax, tsmin, nbfic, nbfi, tts, indts, ttv, uoz,
-        uwv, tauray, ogtransa1, ogtransb0, ogtransb1, wvtransa, wvtransb,
-        oztransa, troatm[iband1], &roslamb, &tgo, &roatm, &ttatmg, &satm,
-        &xrorayp, &next);
+        pres, lut, slut, uoz, uwv, troatm[iband1], &roslamb, &tgo, &roatm,
+        &ttatmg, &satm, &xrorayp, &next);
     if (retval != SUCCESS)
     {
         sprintf (errmsg, "Performing lambertian atmospheric correction "
@@ -391,12 +339,9 @@ int subaeroret
                 pros3 = ros3;
                 raot550nm += 0.005;
                 retval = atmcorlamb2 (xts, xtv, xmus, xmuv, xfi, cosxfi,
-                    raot550nm, iband3, pres, tpres, aot550nm, rolutt, transt,
-                    xtsstep, xtsmin, xtvstep, xtvmin, sphalbt, normext, tsmax,
-                    tsmin, nbfic, nbfi, tts, indts, ttv, uoz, uwv, tauray,
-                    ogtransa1, ogtransb0, ogtransb1, wvtransa, wvtransb,
-                    oztransa, troatm[iband3], &roslamb, &tgo, &roatm, &ttatmg,
-                    &satm, &xrorayp, &next);
+                    raot550nm, iband3, pres, lut, slut, uoz, uwv,
+                    troatm[iband3], &roslamb, &tgo, &roatm, &ttatmg, &satm,
+                    &xrorayp, &next);
                 if (retval != SUCCESS)
                 {
                     sprintf (errmsg, "Performing lambertian atmospheric "
@@ -408,12 +353,9 @@ int subaeroret
 
                 /* Atmospheric correction for band 1 */
                 retval = atmcorlamb2 (xts, xtv, xmus, xmuv, xfi, cosxfi,
-                    raot550nm, iband1, pres, tpres, aot550nm, rolutt, transt,
-                    xtsstep, xtsmin, xtvstep, xtvmin, sphalbt, normext, tsmax,
-                    tsmin, nbfic, nbfi, tts, indts, ttv, uoz, uwv, tauray,
-                    ogtransa1, ogtransb0, ogtransb1, wvtransa, wvtransb,
-                    oztransa, troatm[iband1], &roslamb, &tgo, &roatm, &ttatmg,
-                    &satm, &xrorayp, &next);
+                    raot550nm, iband1, pres, lut, slut, uoz, uwv,
+                    troatm[iband1], &roslamb, &tgo, &roatm, &ttatmg, &satm,
+                    &xrorayp, &next);
                 if (retval != SUCCESS)
                 {
                     sprintf (errmsg, "Performing lambertian atmospheric "
@@ -444,12 +386,9 @@ int subaeroret
                 pros3 = ros3;
                 raot550nm -= 0.005;
                 retval = atmcorlamb2 (xts, xtv, xmus, xmuv, xfi, cosxfi,
-                    raot550nm, iband3, pres, tpres, aot550nm, rolutt, transt,
-                    xtsstep, xtsmin, xtvstep, xtvmin, sphalbt, normext, tsmax,
-                    tsmin, nbfic, nbfi, tts, indts, ttv, uoz, uwv, tauray,
-                    ogtransa1, ogtransb0, ogtransb1, wvtransa, wvtransb,
-                    oztransa, troatm[iband3], &roslamb, &tgo, &roatm, &ttatmg,
-                    &satm, &xrorayp, &next);
+                    raot550nm, iband3, pres, lut, slut, uoz, uwv,
+                    troatm[iband3], &roslamb, &tgo, &roatm, &ttatmg, &satm,
+                    &xrorayp, &next);
                 if (retval != SUCCESS)
                 {
                     sprintf (errmsg, "Performing lambertian atmospheric "
@@ -461,12 +400,9 @@ int subaeroret
 
                 /* Atmospheric correction for band 1 */
                 retval = atmcorlamb2 (xts, xtv, xmus, xmuv, xfi, cosxfi,
-                    raot550nm, iband1, pres, tpres, aot550nm, rolutt, transt,
-                    xtsstep, xtsmin, xtvstep, xtvmin, sphalbt, normext, tsmax,
-                    tsmin, nbfic, nbfi, tts, indts, ttv, uoz, uwv, tauray,
-                    ogtransa1, ogtransb0, ogtransb1, wvtransa, wvtransb,
-                    oztransa, troatm[iband1], &roslamb, &tgo, &roatm, &ttatmg,
-                    &satm, &xrorayp, &next);
+                    raot550nm, iband1, pres, lut, slut, uoz, uwv,
+                    troatm[iband1], &roslamb, &tgo, &roatm, &ttatmg, &satm,
+                    &xrorayp, &next);
                 if (retval != SUCCESS)
                 {
                     sprintf (errmsg, "Performing lambertian atmospheric "
@@ -491,12 +427,9 @@ int subaeroret
     *raot = raot550nm;
 
     /* Compute the model residual */
-    retval = subaeroret_residual (iband1, iband3, ros1, ros3, roslamb,
-        pratio, raot550nm, xts, xtv, xmus, xmuv, xfi, cosxfi, pres, uoz, uwv,
-        erelc, troatm, tpres, aot550nm, rolutt, transt, xtsstep, xtsmin,
-        xtvstep, xtvmin, sphalbt, normext, tsmax, tsmin, nbfic, nbfi, tts,
-        indts, ttv, tauray, ogtransa1, ogtransb0, ogtransb1, wvtransa,
-        wvtransb, oztransa, residual, snext);
+    retval = subaeroret_residual (iband1, iband3, ros1, ros3, roslamb, pratio,
+        raot550nm, xts, xtv, xmus, xmuv, xfi, cosxfi, pres, uoz, uwv, erelc,
+        troatm, lut, slut, residual, snext);
     if (retval != SUCCESS)
     {
         sprintf (errmsg, "Computing the subaeroret model residual");
@@ -552,37 +485,9 @@ int subaeroret_residual
                                            water vapor) */
     float erelc[NSR_BANDS],          /* I: band ratio variable */
     float troatm[NSR_BANDS],         /* I: atmospheric reflectance table */
-    float tpres[7],                  /* I: surface pressure table */
-    float aot550nm[22],              /* I: AOT look-up table */
-    float ****rolutt,                /* I: intrinsic reflectance table
-                                           [NSR_BANDS][7][22][8000] */
-    float ****transt,                /* I: transmission table
-                                           [NSR_BANDS][7][22][22] */
-    float xtsstep,                   /* I: solar zenith step value */
-    float xtsmin,                    /* I: minimum solar zenith value */
-    float xtvstep,                   /* I: observation step value */
-    float xtvmin,                    /* I: minimum observation value */
-    float ***sphalbt,                /* I: spherical albedo table
-                                           [NSR_BANDS][7][22] */
-    float ***normext,                /* I: ????
-                                           [NSR_BANDS][7][22] */
-    float **tsmax,                   /* I: maximum scattering angle table
-                                           [20][22] */
-    float **tsmin,                   /* I: minimum scattering angle table
-                                           [20][22] */
-    float **nbfic,                   /* I: communitive number of azimuth angles
-                                           [20][22] */
-    float **nbfi,                    /* I: number of azimuth anglesi [20][22] */
-    float tts[22],                   /* I: sun angle table */
-    int32 indts[22],
-    float **ttv,                     /* I: view angle table [20][22] */
-    float tauray[NSR_BANDS],         /* I: molecular optical thickness coeff */
-    double ogtransa1[NSR_BANDS],     /* I: other gases transmission coeff */
-    double ogtransb0[NSR_BANDS],     /* I: other gases transmission coeff */
-    double ogtransb1[NSR_BANDS],     /* I: other gases transmission coeff */
-    double wvtransa[NSR_BANDS],      /* I: water vapor transmission coeff */
-    double wvtransb[NSR_BANDS],      /* I: water vapor transmission coeff */
-    double oztransa[NSR_BANDS],      /* I: ozone transmission coeff */
+    Lut_t *lut,                      /* I: look-up tables */
+    Scene_lut_t *slut,               /* I: look-up table of the scene, NULL
+                                           to interpolate the LUTs */
     float *residual,                 /* O: model residual */
     float *snext                     /* O: ????? */
 )
@@ -607,11 +512,8 @@ int subaeroret_residual
         if (erelc[iband] > 0.0)
         {
             retval = atmcorlamb2 (xts, xtv, xmus, xmuv, xfi, cosxfi, raot550nm,
-                iband, pres, tpres, aot550nm, rolutt, transt, xtsstep, xtsmin,
-                xtvstep, xtvmin, sphalbt, normext, tsmax, tsmin, nbfic, nbfi,
-                tts, indts, ttv, uoz, uwv, tauray, ogtransa1, ogtransb0,
-                ogtransb1, wvtransa, wvtransb, oztransa, troatm[iband],
-                &roslamb, &tgo, &roatm, &ttatmg, &satm, &xrorayp, &next);
+                iband, pres, lut, slut, uoz, uwv, troatm[iband], &roslamb, &tgo,
+                &roatm, &ttatmg, &satm, &xrorayp, &next);
             if (retval != SUCCESS)
             {
                 sprintf (errmsg, "Performing lambertian atmospheric correction "